@@ -0,0 +1,324 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Stand-in for ffmpeg to load-test the process handling of UMoviePipelineCustomEncoder without real encodes.
+// Set it as ExecutablePath of the Command Line Encoder project settings, the configured CommandLineFormat stays as is.
+//
+// Build (no engine dependencies):
+//   Windows: cl /std:c++17 /O2 /EHsc FakeEncoder.cpp /Fe:FakeEncoder.exe
+//   Linux:   g++ -std=c++17 -O2 -pthread FakeEncoder.cpp -o FakeEncoder
+//
+// It reads the concat input lists ("-f concat -i <list> -r <fps>") to know how many frames to "encode", prints ffmpeg
+// style progress and writes a placeholder file to every output. Behavior is scripted with space separated key=value
+// options, taken from the MRQ_FAKE_ENCODER environment variable (inherited from the engine) and then from any
+// "-fake <options>" argument, e.g. through the encoder's AdditionalCommandLineArgs:
+//
+//   fps=240              simulated encode throughput in frames per second
+//   frames=<n>           frame count to encode, overrides the count read from the input lists
+//   update_frames=10     frames between two progress updates
+//   progress=info        "info" prints ffmpeg's one-line stats ending in '\r' to stderr,
+//                        "pipe" prints -progress style key=value blocks to stdout
+//   write_bytes=0        split the output into writes of at most this many bytes (0 = one write per update), so
+//                        lines arrive cut in arbitrary places
+//   noise=0              extra non-progress lines per update, to put load on line classification
+//   error_at=<frame>     print an ffmpeg style error line at this frame and keep going
+//   crash_at=<frame>     abort the process at this frame
+//   hang_at=<frame>      stop all output at this frame and never exit
+//   exit_delay=0         seconds to wait after the last frame before exiting
+//   exit_code=0          exit code after a normal run
+//   output_bytes=1024    size of the placeholder written to each output file
+//   rate=<fps>           frame rate of the output, by default the "-r" of the first input list (or ffmpeg's 25)
+//   record=<file>        append this process' arguments to the file, one tab separated line per launch
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using FOptions = std::map<std::string, std::string>;
+
+	void ParseOptions(const std::string& InText, FOptions& OutOptions)
+	{
+		std::istringstream Stream(InText);
+		std::string Token;
+		while (Stream >> Token)
+		{
+			const size_t Equals = Token.find('=');
+			if (Equals != std::string::npos)
+			{
+				OutOptions[Token.substr(0, Equals)] = Token.substr(Equals + 1);
+			}
+		}
+	}
+
+	double GetNumber(const FOptions& InOptions, const char* InKey, const double InDefault)
+	{
+		const FOptions::const_iterator It = InOptions.find(InKey);
+		return It != InOptions.end() ? std::atof(It->second.c_str()) : InDefault;
+	}
+
+	std::string GetString(const FOptions& InOptions, const char* InKey, const std::string& InDefault)
+	{
+		const FOptions::const_iterator It = InOptions.find(InKey);
+		return It != InOptions.end() ? It->second : InDefault;
+	}
+
+	std::string Unquote(std::string InText)
+	{
+		if (InText.size() >= 2 && (InText.front() == '\'' || InText.front() == '"') && InText.back() == InText.front())
+		{
+			InText = InText.substr(1, InText.size() - 2);
+		}
+		return InText;
+	}
+
+	/** Output frames a concat list stands for, 0 if it isn't one. Entries with a duration hold their frame that long. */
+	int CountListedFrames(const std::string& InPath, const double InFrameRate)
+	{
+		std::ifstream File(InPath);
+		int Frames = 0;
+		bool bPendingFile = false;
+		std::string Line;
+		while (std::getline(File, Line))
+		{
+			if (Line.rfind("file ", 0) == 0)
+			{
+				Frames += bPendingFile ? 1 : 0;
+				bPendingFile = true;
+			}
+			else if (Line.rfind("duration ", 0) == 0 && bPendingFile)
+			{
+				const double Duration = std::atof(Line.c_str() + 9);
+				Frames += InFrameRate > 0.0 ? std::max(1, static_cast<int>(std::lround(Duration * InFrameRate))) : 1;
+				bPendingFile = false;
+			}
+		}
+		return Frames + (bPendingFile ? 1 : 0);
+	}
+
+	/** Output paths, including the ones inside a tee muxer list: "[select=\'v:0,a\']beauty.mp4|[select=\'v:1,a\']depth.mp4". */
+	std::vector<std::string> SplitOutputs(const std::string& InOutputArg)
+	{
+		std::vector<std::string> Outputs;
+		std::string Remaining = InOutputArg;
+		while (!Remaining.empty())
+		{
+			const size_t Bar = Remaining.find('|');
+			std::string Output = Remaining.substr(0, Bar);
+			if (!Output.empty() && Output.front() == '[')
+			{
+				const size_t Close = Output.find(']');
+				Output = Close != std::string::npos ? Output.substr(Close + 1) : std::string();
+			}
+			if (!Output.empty())
+			{
+				Outputs.push_back(Unquote(Output));
+			}
+			Remaining = Bar != std::string::npos ? Remaining.substr(Bar + 1) : std::string();
+		}
+		return Outputs;
+	}
+
+	bool IsValuelessFlag(const std::string& InArg)
+	{
+		static const char* const Flags[] = { "-y", "-n", "-hide_banner", "-nostdin", "-stats", "-nostats", "-shortest", "-an", "-vn", "-sn", "-dn" };
+		return std::find(std::begin(Flags), std::end(Flags), InArg) != std::end(Flags);
+	}
+
+	void WriteChunked(FILE* InStream, const std::string& InText, const size_t InWriteBytes)
+	{
+		const size_t ChunkSize = InWriteBytes > 0 ? InWriteBytes : InText.size();
+		for (size_t Offset = 0; Offset < InText.size(); Offset += ChunkSize)
+		{
+			std::fwrite(InText.data() + Offset, 1, std::min(ChunkSize, InText.size() - Offset), InStream);
+			std::fflush(InStream);
+		}
+	}
+
+	void SleepSeconds(const double InSeconds)
+	{
+		if (InSeconds > 0.0)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(InSeconds));
+		}
+	}
+}
+
+int main(int Argc, char** Argv)
+{
+	FOptions Options;
+	if (const char* EnvOptions = std::getenv("MRQ_FAKE_ENCODER"))
+	{
+		ParseOptions(EnvOptions, Options);
+	}
+
+	// Inputs are "-i <path>", optionally followed by "-r <fps>" for the concat lists. The output is the last positional argument.
+	std::vector<std::pair<std::string, double>> Inputs;
+	std::string OutputArg;
+	for (int Index = 1; Index < Argc; Index++)
+	{
+		const std::string Arg = Argv[Index];
+		const bool bHasValue = Index + 1 < Argc;
+		if (Arg == "-fake" && bHasValue)
+		{
+			ParseOptions(Argv[++Index], Options);
+		}
+		else if (Arg == "-i" && bHasValue)
+		{
+			Inputs.emplace_back(Unquote(Argv[++Index]), 0.0);
+		}
+		else if (Arg == "-r" && bHasValue)
+		{
+			const double Rate = std::atof(Argv[++Index]);
+			if (!Inputs.empty())
+			{
+				Inputs.back().second = Rate;
+			}
+		}
+		else if (!Arg.empty() && Arg[0] == '-' && !IsValuelessFlag(Arg) && bHasValue)
+		{
+			++Index;
+		}
+		else if (!Arg.empty() && Arg[0] != '-')
+		{
+			OutputArg = Arg;
+		}
+	}
+
+	const std::string RecordPath = GetString(Options, "record", "");
+	if (!RecordPath.empty())
+	{
+		std::ofstream Record(RecordPath, std::ios::app);
+		Record << getpid();
+		for (int Index = 1; Index < Argc; Index++)
+		{
+			Record << '\t' << Argv[Index];
+		}
+		Record << '\n';
+	}
+
+	int TotalFrames = static_cast<int>(GetNumber(Options, "frames", 0.0));
+	if (TotalFrames <= 0)
+	{
+		for (const std::pair<std::string, double>& Input : Inputs)
+		{
+			TotalFrames = std::max(TotalFrames, CountListedFrames(Input.first, Input.second));
+		}
+	}
+
+	const double Fps = std::max(GetNumber(Options, "fps", 240.0), 0.001);
+	const int UpdateFrames = std::max(static_cast<int>(GetNumber(Options, "update_frames", 10.0)), 1);
+	const bool bPipeProgress = GetString(Options, "progress", "info") == "pipe";
+	const size_t WriteBytes = static_cast<size_t>(std::max(GetNumber(Options, "write_bytes", 0.0), 0.0));
+	const int NoiseLines = static_cast<int>(GetNumber(Options, "noise", 0.0));
+	const int ErrorAt = static_cast<int>(GetNumber(Options, "error_at", -1.0));
+	const int CrashAt = static_cast<int>(GetNumber(Options, "crash_at", -1.0));
+	const int HangAt = static_cast<int>(GetNumber(Options, "hang_at", -1.0));
+	const double OutputBytes = GetNumber(Options, "output_bytes", 1024.0);
+
+	// speed= and time= are in media time, which the output frame rate converts frames into.
+	double InputRate = 25.0;
+	for (const std::pair<std::string, double>& Input : Inputs)
+	{
+		if (Input.second > 0.0)
+		{
+			InputRate = Input.second;
+			break;
+		}
+	}
+	const double OutputRate = std::max(GetNumber(Options, "rate", InputRate), 0.001);
+
+	std::fprintf(stderr, "Input #0, concat, from 'fake':\n  Duration: N/A, start: 0.000000, bitrate: N/A\n");
+	std::fprintf(stderr, "Output #0, fake, to '%s':\nPress [q] to stop, [?] for help\n", OutputArg.c_str());
+	std::fflush(stderr);
+
+	const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+	int Frame = 0;
+	while (Frame < TotalFrames)
+	{
+		const int PreviousFrame = Frame;
+		Frame = std::min(Frame + UpdateFrames, TotalFrames);
+
+		// Pace against the start time so the rate holds however long the writes take.
+		const std::chrono::steady_clock::time_point DueTime = StartTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(Frame / Fps));
+		std::this_thread::sleep_until(DueTime);
+
+		const auto Passed = [&](const int InAt) { return InAt >= 0 && PreviousFrame < InAt && Frame >= InAt; };
+		if (Passed(CrashAt))
+		{
+			std::abort();
+		}
+		if (Passed(HangAt))
+		{
+			for (;;)
+			{
+				SleepSeconds(3600.0);
+			}
+		}
+
+		const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+		const double CurrentFps = Seconds > 0.0 ? Frame / Seconds : 0.0;
+		const double SizeKiB = OutputBytes / 1024.0 * Frame / std::max(TotalFrames, 1);
+		const double MediaSeconds = Frame / OutputRate;
+		const double Speed = Seconds > 0.0 ? MediaSeconds / Seconds : 0.0;
+		const int MediaCentiseconds = static_cast<int>(MediaSeconds * 100.0);
+		char MediaTime[32];
+		std::snprintf(MediaTime, sizeof(MediaTime), "%02d:%02d:%02d.%02d",
+			MediaCentiseconds / 360000, MediaCentiseconds / 6000 % 60, MediaCentiseconds / 100 % 60, MediaCentiseconds % 100);
+
+		std::string Text;
+		for (int Noise = 0; Noise < NoiseLines; Noise++)
+		{
+			Text += "[h264 @ 0x0000fake] frame I:1 Avg QP:20.00 size: 12345 (noise)\n";
+		}
+		if (Passed(ErrorAt))
+		{
+			Text += "[vost#0:0 @ 0x0000fake] Error submitting a packet to the muxer: Broken pipe (fake)\n";
+		}
+
+		char Buffer[256];
+		if (bPipeProgress)
+		{
+			std::snprintf(Buffer, sizeof(Buffer), "frame=%d\nfps=%.2f\ntotal_size=%.0f\nout_time=%s0000\nspeed=%.3fx\nprogress=%s\n",
+				Frame, CurrentFps, SizeKiB * 1024.0, MediaTime, Speed, Frame < TotalFrames ? "continue" : "end");
+			Text += Buffer;
+			WriteChunked(stdout, Text, WriteBytes);
+		}
+		else
+		{
+			std::snprintf(Buffer, sizeof(Buffer), "frame=%5d fps=%4.0f q=28.0 size=%8.0fKiB time=%s bitrate=N/A speed=%.3gx    \r",
+				Frame, CurrentFps, SizeKiB, MediaTime, Speed);
+			Text += Buffer;
+			WriteChunked(stderr, Text, WriteBytes);
+		}
+	}
+
+	for (const std::string& Output : SplitOutputs(OutputArg))
+	{
+		std::ofstream File(Output, std::ios::binary | std::ios::trunc);
+		const std::string Placeholder(static_cast<size_t>(std::max(OutputBytes, 0.0)), '\0');
+		File.write(Placeholder.data(), static_cast<std::streamsize>(Placeholder.size()));
+	}
+
+	std::fprintf(stderr, "\nvideo:%.0fKiB audio:0KiB subtitle:0KiB other streams:0KiB global headers:0KiB muxing overhead: 0.000000%%\n", OutputBytes / 1024.0);
+	std::fflush(stderr);
+
+	SleepSeconds(GetNumber(Options, "exit_delay", 0.0));
+	return static_cast<int>(GetNumber(Options, "exit_code", 0.0));
+}
@@ -43,12 +43,23 @@ public class MoviePipelineExt : ModuleRules
 				"HTTP", 
 				"LevelSequence",
 				"MovieRenderPipelineRenderPasses",
-				"JsonUtilities"
+				"JsonUtilities",
+				"ImageWriteQueue",
+				"AssetRegistry",
+				"Projects",
+				"RHI",
+				"RenderCore"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
 		
 		
+		if (Target.Platform == UnrealTargetPlatform.Win64)
+		{
+			// Per process video memory for the resource monitor
+			PublicSystemLibraries.Add("dxgi.lib");
+		}
+
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
@@ -12,12 +12,26 @@
 #include "MoviePipelineUtils.h"
 #include "MoviePipelineQueue.h"
 #include "MoviePipelineDebugSettings.h"
+#include "MoviePipelineDedupImageSequenceOutput.h"
 #include "MoviePipelineBlueprintLibrary.h"
 #include "Misc/FileHelper.h"
 #include "HAL/FileManager.h"
 #include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformOutputDevices.h"
 #include "GenericPlatform/GenericPlatformFile.h"
 #include "Internationalization/Text.h"
+#include "Tasks/Task.h"
+#include "Algo/BinarySearch.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include "Windows/WindowsHWrapper.h"
+#include "Windows/HideWindowsPlatformTypes.h"
+#elif PLATFORM_LINUX
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(MoviePipelineCustomEncoder)
 
@@ -53,34 +67,206 @@ namespace
 		return true;;
 	}
 
-	FString MakeEtaStatusMessage(const double InRemainingSeconds)
+	/** Reads a decimal statistic like "fps= 58.3" or "speed=2.41x" from an encoder progress line. */
+	bool TryExtractStatValue(const FString& Line, const TCHAR* InToken, double& OutValue)
 	{
-		if (!FMath::IsFinite(InRemainingSeconds) || InRemainingSeconds < 0.0)
+		const int32 TokenIndex = Line.Find(InToken, ESearchCase::IgnoreCase, ESearchDir::FromStart);
+		if (TokenIndex == INDEX_NONE)
 		{
-			return FString();
+			return false;
 		}
 
-		const int64 RoundedSeconds = FMath::RoundToInt64(InRemainingSeconds);
-		const int32 TotalSeconds = static_cast<int32>(FMath::Clamp<int64>(RoundedSeconds, 0, TNumericLimits<int32>::Max()));
-		const int32 Hours = TotalSeconds / 3600;
-		const int32 Minutes = (TotalSeconds % 3600) / 60;
-		const int32 Seconds = TotalSeconds % 60;
+		int32 Index = TokenIndex + FCString::Strlen(InToken);
+		while (Index < Line.Len() && FChar::IsWhitespace(Line[Index]))
+		{
+			++Index;
+		}
 
-		FString FormattedTime;
-		if (Hours > 0)
+		const int32 StartIndex = Index;
+		while (Index < Line.Len() && (FChar::IsDigit(Line[Index]) || Line[Index] == TEXT('.')))
 		{
-			FormattedTime = FString::Printf(TEXT("%02d:%02d:%02d"), Hours, Minutes, Seconds);
+			++Index;
 		}
-		else
+
+		if (StartIndex == Index)
 		{
-			FormattedTime = FString::Printf(TEXT("%02d:%02d"), Minutes, Seconds);
+			return false;
 		}
 
-		UE_LOG(LogTemp, Log, TEXT("%s: Encoding ETA FormattedTime: %s"), ANSI_TO_TCHAR(__FUNCTION__), *FormattedTime);
+		OutValue = FCString::Atod(*Line.Mid(StartIndex, Index - StartIndex));
+		return true;
+	}
 
-		return FString::Printf(TEXT("Encoding ETA: %d"), TotalSeconds);
+	/** Reads the output size from an encoder progress line, "size=    2048KiB" (or "kB" on older ffmpeg). */
+	bool TryExtractByteSize(const FString& Line, int64& OutBytes)
+	{
+		double Value = 0.0;
+		if (!TryExtractStatValue(Line, TEXT("size="), Value))
+		{
+			return false;
+		}
+
+		int32 UnitIndex = Line.Find(TEXT("size="), ESearchCase::IgnoreCase) + 5;
+		while (UnitIndex < Line.Len() && (FChar::IsWhitespace(Line[UnitIndex]) || FChar::IsDigit(Line[UnitIndex]) || Line[UnitIndex] == TEXT('.')))
+		{
+			++UnitIndex;
+		}
+
+		const FString Unit = Line.Mid(UnitIndex, 3);
+		double Scale = 1.0;
+		if (Unit.StartsWith(TEXT("k"), ESearchCase::IgnoreCase))
+		{
+			Scale = 1024.0;
+		}
+		else if (Unit.StartsWith(TEXT("M"), ESearchCase::IgnoreCase))
+		{
+			Scale = 1024.0 * 1024.0;
+		}
+		else if (Unit.StartsWith(TEXT("G"), ESearchCase::IgnoreCase))
+		{
+			Scale = 1024.0 * 1024.0 * 1024.0;
+		}
+
+		OutBytes = static_cast<int64>(Value * Scale);
+		return true;
+	}
+
+	/** Number of consumed source frames to accumulate before handing them off to a background delete. */
+	constexpr int32 MinSourceFrameDeleteBatch = 64;
+
+	/** Keyframe interval of intermediate shot segments. Every segment starts on a keyframe regardless. */
+	constexpr double ShotSegmentKeyframeIntervalSeconds = 2.0;
+
+	/** A file name inside the tee muxer's output list, where | separates outputs and [ ] : ' \\ are syntax. */
+	FString EscapeTeeOutputPath(const FString& InPath)
+	{
+		FString Escaped;
+		Escaped.Reserve(InPath.Len() * 2);
+		for (const TCHAR Character : InPath)
+		{
+			if (Character == TEXT('|') || Character == TEXT('[') || Character == TEXT(']') || Character == TEXT(':')
+				|| Character == TEXT('\\') || Character == TEXT('\''))
+			{
+				Escaped.AppendChar(TEXT('\\'));
+			}
+			Escaped.AppendChar(Character);
+		}
+		return Escaped;
+	}
+
+	/** Parses a core list like "0-3,8,10-11" into an affinity mask. Cores past 63 can't be expressed and are dropped. */
+	uint64 ParseCpuAffinityMask(const FString& InCpuList)
+	{
+		uint64 Mask = 0;
+		TArray<FString> Ranges;
+		InCpuList.ParseIntoArray(Ranges, TEXT(","));
+		for (const FString& Range : Ranges)
+		{
+			FString FirstString;
+			FString LastString;
+			if (!Range.Split(TEXT("-"), &FirstString, &LastString))
+			{
+				FirstString = LastString = Range;
+			}
+
+			const int32 First = FCString::Atoi(*FirstString.TrimStartAndEnd());
+			const int32 Last = FCString::Atoi(*LastString.TrimStartAndEnd());
+			for (int32 Core = FMath::Max(First, 0); Core <= FMath::Min(Last, 63); Core++)
+			{
+				Mask |= uint64(1) << Core;
+			}
+		}
+		return Mask;
+	}
+
+	/** A cgroup below /sys/fs/cgroup: relative, made of [A-Za-z0-9_.-] names, none of them "." or "..". */
+	bool IsValidCgroupPath(const FString& InPath)
+	{
+		TArray<FString> Parts;
+		InPath.ParseIntoArray(Parts, TEXT("/"), false);
+		if (Parts.Num() == 0)
+		{
+			return false;
+		}
+		for (const FString& Part : Parts)
+		{
+			if (Part.IsEmpty() || Part == TEXT(".") || Part == TEXT(".."))
+			{
+				return false;
+			}
+			for (const TCHAR Char : Part)
+			{
+				if (!FChar::IsAlnum(Char) && Char != TEXT('_') && Char != TEXT('.') && Char != TEXT('-'))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/** Resident memory of another process. Zero once it is gone. */
+	uint64 GetProcessMemoryBytes(const uint32 InProcessId)
+	{
+#if PLATFORM_LINUX
+		// The second field of statm is the resident set in pages.
+		FString Statm;
+		TArray<FString> Fields;
+		if (FFileHelper::LoadFileToString(Statm, *FString::Printf(TEXT("/proc/%u/statm"), InProcessId)) && Statm.ParseIntoArrayWS(Fields) > 1)
+		{
+			return FCString::Strtoui64(*Fields[1], nullptr, 10) * static_cast<uint64>(sysconf(_SC_PAGESIZE));
+		}
+#else
+		SIZE_T MemoryUsage = 0;
+		if (FPlatformProcess::GetApplicationMemoryUsage(InProcessId, &MemoryUsage))
+		{
+			return MemoryUsage;
+		}
+#endif
+		return 0;
+	}
+
+	/** User and kernel CPU time another process has used so far. Zero once it is gone. */
+	double GetProcessCpuSeconds(FProcHandle& InProcessHandle, const uint32 InProcessId)
+	{
+#if PLATFORM_WINDOWS
+		FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+		if (::GetProcessTimes(InProcessHandle.Get(), &CreationTime, &ExitTime, &KernelTime, &UserTime))
+		{
+			// In 100 ns units.
+			const uint64 Kernel = (static_cast<uint64>(KernelTime.dwHighDateTime) << 32) | KernelTime.dwLowDateTime;
+			const uint64 User = (static_cast<uint64>(UserTime.dwHighDateTime) << 32) | UserTime.dwLowDateTime;
+			return (Kernel + User) / 1.0e7;
+		}
+#elif PLATFORM_LINUX
+		// utime and stime are fields 14 and 15. The command name before them is in parentheses and may contain spaces.
+		FString Stat;
+		int32 NameEnd = INDEX_NONE;
+		if (FFileHelper::LoadFileToString(Stat, *FString::Printf(TEXT("/proc/%u/stat"), InProcessId)) && Stat.FindLastChar(TEXT(')'), NameEnd))
+		{
+			TArray<FString> Fields;
+			if (Stat.RightChop(NameEnd + 1).ParseIntoArrayWS(Fields) > 12)
+			{
+				return (FCString::Atod(*Fields[11]) + FCString::Atod(*Fields[12])) / static_cast<double>(sysconf(_SC_CLK_TCK));
+			}
+		}
+#endif
+		return 0.0;
+	}
+
+	void DeleteFilesBlocking(const TArray<FString>& InFilesToDelete)
+	{
+		IFileManager& FileManager = IFileManager::Get();
+		const bool bRequireExist = false;
+		const bool bEvenReadOnly = false;
+		const bool bQuiet = false;
+
+		// Only ever the files we were handed: the directory around them may hold anything else by the time this runs.
+		for (const FString& FilePath : InFilesToDelete)
+		{
+			FileManager.Delete(*FilePath, bRequireExist, bEvenReadOnly, bQuiet);
+		}
 	}
-	
 }
 
 // Forward Declare
@@ -100,6 +286,35 @@ UMoviePipelineCustomEncoder::UMoviePipelineCustomEncoder()
 	bDeleteSourceFiles = false;
 	bSkipEncodeOnRenderCanceled = true;
 	bWriteEachFrameDuration = true;
+	bEncodeRenderPassesTogether = false;
+	bEncodeShotSegments = false;
+	bFragmentedOutput = false;
+	ProcessPriority = -1;
+	CpuQuota = 0.f;
+	TargetEncodeSeconds = 0.f;
+	DeadlineCalibrationFrames = 90;
+}
+
+void UMoviePipelineCustomEncoder::BeginDestroy()
+{
+#if PLATFORM_WINDOWS
+	if (CpuQuotaJobObject)
+	{
+		::CloseHandle(CpuQuotaJobObject);
+		CpuQuotaJobObject = nullptr;
+	}
+#endif
+
+	// Every encoder has exited by now; an empty cgroup is removed with rmdir.
+	if (!CreatedCgroupPath.IsEmpty())
+	{
+		IFileManager::Get().DeleteDirectory(*CreatedCgroupPath, false, false);
+		CreatedCgroupPath.Reset();
+	}
+
+	LogSink.Reset();
+
+	Super::BeginDestroy();
 }
 
 bool UMoviePipelineCustomEncoder::HasFinishedExportingImpl()
@@ -108,7 +323,14 @@ bool UMoviePipelineCustomEncoder::HasFinishedExportingImpl()
 	// manually canceling a job stops ticking the engine and repeatedly calls HasFinishedExportingImpl
 	OnTick();
 
-	return ActiveEncodeJobs.Num() == 0;
+	const bool bFinished = ActiveEncodeJobs.Num() == 0 && PendingFileDeletions.Num() == 0 && !bPendingShotSegmentConcat;
+	if (bFinished && LogSink)
+	{
+		const bool bWait = true;
+		LogSink->Flush(bWait);
+	}
+
+	return bFinished;
 }
 
 void UMoviePipelineCustomEncoder::BeginExportImpl()
@@ -125,6 +347,13 @@ void UMoviePipelineCustomEncoder::BeginExportImpl()
 		return;
 	}
 
+	// Every shot has been encoded into a segment already (or still is). OnTick joins them once the last one is done.
+	if (bShotSegmentsActive)
+	{
+		bPendingShotSegmentConcat = true;
+		return;
+	}
+
 	// However, if they didn't want a per-shot flush (ie: rendering one video) then we start now.
 	FMoviePipelineOutputData OutputData = GetPipeline()->GetOutputDataParams();
 	const bool bIsShotEncode = false;
@@ -133,12 +362,15 @@ void UMoviePipelineCustomEncoder::BeginExportImpl()
 
 void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShotOutputData>& InOutData, const bool bInIsShotEncode)
 {
-	// If the format string isn't split per shot, we can't start encoding now.
-	if(bInIsShotEncode && !NeedsPerShotFlushing())
+	// If the format string isn't split per shot, we can't start encoding now. Unless each shot becomes a segment of the final file.
+	if(bInIsShotEncode && !NeedsPerShotFlushing() && !bShotSegmentsActive)
 	{
 		return;
 	}
 
+	const bool bEncodeShotSegment = bInIsShotEncode && bShotSegmentsActive;
+	const bool bConcatShotSegments = !bInIsShotEncode && bShotSegmentsActive;
+
 	const UMoviePipelineCommandLineEncoderSettings* EncoderSettings = GetDefault<UMoviePipelineCommandLineEncoderSettings>();
 
 	// Early out if there's any errors
@@ -169,6 +401,9 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 
 	/** We produce one file per render pass we detect */
 	TMap<FMoviePipelinePassIdentifier, FEncoderParams> RenderPasses;
+
+	// Frames identical to their predecessor were never written; the output setting tells us how long each written one is held.
+	const UMoviePipelineDedupImageSequenceOutput_PNG* DedupOutput = GetPipeline()->GetPipelinePrimaryConfig()->FindSetting<UMoviePipelineDedupImageSequenceOutput_PNG>();
 	
 	// The path shouldn't have quotes on it as it's already kept as a separate argument right up until creating the process, at which point
 	// the platform puts quotes around the FString if needed.
@@ -182,7 +417,7 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 	FFrameRate RenderFrameRate = GetPipeline()->GetPipelinePrimaryConfig()->GetEffectiveFrameRate(GetPipeline()->GetTargetSequence());
 	SharedArguments.Add(TEXT("FrameRate"), RenderFrameRate.AsDecimal());
 	SharedArguments.Add(TEXT("AdditionalLocalArgs"), AdditionalCommandLineArgs);
-	SharedArguments.Add(TEXT("Quality"), GetQualitySettingString());
+	SharedArguments.Add(TEXT("Quality"), GetQualitySettingString(EffectiveQuality));
 
 	for (FMoviePipelineShotOutputData& Data : InOutData)
 	{
@@ -193,11 +428,27 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 				continue;
 			}
 
+			const bool bIsNewRenderPass = !RenderPasses.Contains(RenderPass.Key.Name);
 			FEncoderParams& EncoderParams = RenderPasses.FindOrAdd(RenderPass.Key.Name);
 			if (!EncoderParams.Shot.IsValid())
 			{
 				EncoderParams.Shot = Data.Shot;
 			}
+			EncoderParams.bIsShotSegment = bEncodeShotSegment;
+			EncoderParams.bConcatSegments = bConcatShotSegments;
+
+			// Frames a previous attempt already rendered go in front of everything this attempt produced.
+			const FResumedSourceFrames* Resumed = ResumedSourceFrames.Find(RenderPass.Key.Name);
+			if (bIsNewRenderPass && !bInIsShotEncode && Resumed)
+			{
+				for (int32 FileIndex = 0; FileIndex < Resumed->FilePaths.Num(); FileIndex++)
+				{
+					const FString Extension = FPaths::GetExtension(Resumed->FilePaths[FileIndex]);
+					EncoderParams.FilesByExtensionType.FindOrAdd(Extension).Add(Resumed->FilePaths[FileIndex]);
+					EncoderParams.HeldFrameCountsByExtensionType.FindOrAdd(Extension).Add(Resumed->HeldFrameCounts[FileIndex]);
+					EncoderParams.ExpectedFrameCount += Resumed->HeldFrameCounts[FileIndex];
+				}
+			}
 			if (UMoviePipelineExecutorShot* Shot = Data.Shot.Get())
 			{
 				const int32 ShotFrameCount = Shot->ShotInfo.WorkMetrics.TotalOutputFrameCount;
@@ -207,10 +458,52 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 				}
 			}
 			
-			for (const FString& FilePath : RenderPass.Value.FilePaths)
+			if (bConcatShotSegments)
+			{
+				// The frames went into the shot segments already, the final file is just those segments back to back.
+				const TArray<FString>* Segments = ShotSegmentsByPass.Find(RenderPass.Key.Name);
+				const int32* ResumedSegmentFrameCount = ResumedSegmentFrameCounts.Find(RenderPass.Key.Name);
+				if (bIsNewRenderPass && ResumedSegmentFrameCount)
+				{
+					EncoderParams.ExpectedFrameCount += *ResumedSegmentFrameCount;
+				}
+				if (bIsNewRenderPass && Segments)
+				{
+					for (const FString& SegmentPath : *Segments)
+					{
+						const FString Extension = FPaths::GetExtension(SegmentPath);
+						EncoderParams.FilesByExtensionType.FindOrAdd(Extension).Add(SegmentPath);
+						EncoderParams.HeldFrameCountsByExtensionType.FindOrAdd(Extension).Add(1);
+					}
+				}
+			}
+			else
+			{
+				const TArray<int32>* HeldFrameCounts = DedupOutput ? DedupOutput->GetHeldFrameCounts(Data.Shot.Get(), RenderPass.Key) : nullptr;
+				if (HeldFrameCounts && HeldFrameCounts->Num() != RenderPass.Value.FilePaths.Num())
+				{
+					UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Render pass '%s' wrote %d files but %d were tracked for deduplication, encoding them one frame each."),
+						*RenderPass.Key.Name, RenderPass.Value.FilePaths.Num(), HeldFrameCounts->Num());
+					HeldFrameCounts = nullptr;
+				}
+
+				for (int32 FileIndex = 0; FileIndex < RenderPass.Value.FilePaths.Num(); FileIndex++)
+				{
+					const FString& FilePath = RenderPass.Value.FilePaths[FileIndex];
+					FString Extension = FPaths::GetExtension(FilePath);
+					EncoderParams.FilesByExtensionType.FindOrAdd(Extension).Add(FilePath);
+					EncoderParams.HeldFrameCountsByExtensionType.FindOrAdd(Extension).Add(HeldFrameCounts ? (*HeldFrameCounts)[FileIndex] : 1);
+					if (bEncodeShotSegment)
+					{
+						EncoderParams.Segment.FrameCount += HeldFrameCounts ? (*HeldFrameCounts)[FileIndex] : 1;
+					}
+				}
+			}
+
+			// Segments are video only. The audio of all shots is encoded once when the segments are joined.
+			if (bEncodeShotSegment)
 			{
-				FString Extension = FPaths::GetExtension(FilePath);
-				EncoderParams.FilesByExtensionType.FindOrAdd(Extension).Add(FilePath);
+				continue;
 			}
 
 			// Search for audio to attach it to every render pass
@@ -222,6 +515,7 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 					{
 						FString Extension = FPaths::GetExtension(FilePath);
 						EncoderParams.FilesByExtensionType.FindOrAdd(Extension).Add(FilePath);
+						EncoderParams.HeldFrameCountsByExtensionType.FindOrAdd(Extension).Add(1);
 					}
 				}
 			}
@@ -237,15 +531,22 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 		}
 	}
 
+	TArray<FEncoderParams> PassesToEncodeTogether;
+	bool bLaunchedCountedEncode = false;
 	for (TTuple<FMoviePipelinePassIdentifier, FEncoderParams>& RenderPass : RenderPasses)
 	{
 		// Copy the shared arguments into our render pass
 		RenderPass.Value.NamedArguments = SharedArguments;
+		if (RenderPass.Value.bConcatSegments)
+		{
+			RenderPass.Value.NamedArguments.Add(TEXT("VideoCodec"), TEXT("copy"));
+			RenderPass.Value.NamedArguments.Add(TEXT("Quality"), TEXT(""));
+		}
 
 		// Generate a filename for this encoded file
 		TMap<FString, FString> FormatOverrides;
 		FormatOverrides.Add(TEXT("render_pass"), RenderPass.Key.Name);
-		FormatOverrides.Add(TEXT("ext"), EncoderSettings->OutputFileExtension);
+		FormatOverrides.Add(TEXT("ext"), GetOutputFileExtension());
 		UMoviePipelineExecutorShot* Shot = RenderPass.Value.Shot.Get();
 		if (Shot)
 		{
@@ -279,6 +580,17 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 		FPaths::NormalizeFilename(FinalFilePath);
 		FPaths::CollapseRelativeDirectories(FinalFilePath);
 
+		// A segment sits next to the final file, numbered in shot order.
+		if (RenderPass.Value.bIsShotSegment)
+		{
+			TArray<FString>& Segments = ShotSegmentsByPass.FindOrAdd(RenderPass.Key.Name);
+			FinalFilePath = FPaths::GetPath(FinalFilePath) / TEXT("ShotSegments") / FString::Printf(TEXT("%s.%04d.%s"), *RenderPass.Key.Name, Segments.Num(), *GetOutputFileExtension());
+			RenderPass.Value.Segment.PassName = RenderPass.Key.Name;
+			RenderPass.Value.Segment.Index = Segments.Num();
+			RenderPass.Value.Segment.FilePath = FinalFilePath;
+			Segments.Add(FinalFilePath);
+		}
+
 		FString FinalFileDirectory = FPaths::GetPath(FinalFilePath);
 
 		// Ensure the output directory is created
@@ -293,7 +605,7 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 		// and not the copy that we're currently iterating through.
 		for (FMoviePipelineShotOutputData& Data : InOutData)
 		{
-			if (Data.Shot != RenderPass.Value.Shot)
+			if (Data.Shot != RenderPass.Value.Shot || RenderPass.Value.bIsShotSegment)
 			{
 				continue;
 			}
@@ -302,76 +614,200 @@ void UMoviePipelineCustomEncoder::StartEncodingProcess(TArray<FMoviePipelineShot
 		}
 		
 		RenderPass.Value.NamedArguments.Add(TEXT("OutputPath"), FinalFilePath);
-		LaunchEncoder(RenderPass.Value);
+		if (bEncodeRenderPassesTogether)
+		{
+			PassesToEncodeTogether.Add(MoveTemp(RenderPass.Value));
+		}
+		else
+		{
+			// Every pass encodes the same frames, only the first one counts toward the progress of the video.
+			LaunchEncoder(MakeArrayView(&RenderPass.Value, 1), !bLaunchedCountedEncode);
+			bLaunchedCountedEncode = true;
+		}
+	}
+
+	if (PassesToEncodeTogether.Num() > 0)
+	{
+		const bool bCountsTowardOutput = true;
+		LaunchEncoder(PassesToEncodeTogether, bCountsTowardOutput);
 	}
 }
 
-void UMoviePipelineCustomEncoder::LaunchEncoder(const FEncoderParams& InParams)
+void UMoviePipelineCustomEncoder::GetProcessUsage(uint64& OutMemoryBytes, double& OutCpuSeconds) const
 {
-	UMoviePipelineOutputSetting* OutputSetting = GetPipeline()->GetPipelinePrimaryConfig()->FindSetting<UMoviePipelineOutputSetting>();
+	OutMemoryBytes = 0;
+	OutCpuSeconds = ExitedProcessCpuSeconds;
+	for (const FActiveJob& Job : ActiveEncodeJobs)
+	{
+		FProcHandle ProcessHandle = Job.ProcessHandle;
+		OutMemoryBytes += GetProcessMemoryBytes(Job.ProcessId);
+		OutCpuSeconds += GetProcessCpuSeconds(ProcessHandle, Job.ProcessId);
+	}
+}
 
-	// Generate a text file for each input type which lists the files for that input type. We generate a FGuid in case there are
-	// multiple encode jobs going at once.
-	TStringBuilder<64> StringBuilder;
-	TArray<FString> VideoInputs;
-	TArray<FString> AudioInputs;
+uint32 UMoviePipelineCustomEncoder::LaunchUnmanagedProcess(const FString& InExecutable, const FString& InArguments, const int32 InExpectedFrameCount, TArray<FString>&& InFilesToDelete)
+{
+	void* PipeRead = nullptr;
+	void* PipeWrite = nullptr;
+	verify(FPlatformProcess::CreatePipe(PipeRead, PipeWrite));
 
-	double InFrameRate = InParams.NamedArguments[TEXT("FrameRate")].DoubleValue;
-	double FrameRateAsDuration = 1.0 / InFrameRate;
+	const bool bLaunchDetached = false;
+	const bool bLaunchHidden = true;
+	const bool bLaunchReallyHidden = bLaunchHidden;
+	uint32 ProcessId = 0;
+	FProcHandle ProcessHandle = FPlatformProcess::CreateProc(*InExecutable, *InArguments, bLaunchDetached, bLaunchHidden, bLaunchReallyHidden, &ProcessId, ProcessPriority, nullptr, PipeWrite, PipeRead);
+	if (!ProcessHandle.IsValid())
+	{
+		FPlatformProcess::ClosePipe(PipeRead, PipeWrite);
+		return 0;
+	}
+	LaunchedProcessCount++;
+
+	FActiveJob& NewJob = ActiveEncodeJobs.AddDefaulted_GetRef();
+	NewJob.ProcessHandle = ProcessHandle;
+	NewJob.ProcessId = ProcessId;
+	NewJob.ReadPipe = PipeRead;
+	NewJob.WritePipe = PipeWrite;
+	NewJob.ExpectedFrameCount = InExpectedFrameCount;
+	NewJob.EncodeStartTimeSeconds = FPlatformTime::Seconds();
+	NewJob.EncodeId = NextEncodeId++;
+	NewJob.FilesToDelete = MoveTemp(InFilesToDelete);
+	return ProcessId;
+}
+
+void UMoviePipelineCustomEncoder::SetResumedSourceFrames(const FString& InPassName, TArray<FString>&& InFilePaths, TArray<int32>&& InHeldFrameCounts)
+{
+	check(InFilePaths.Num() == InHeldFrameCounts.Num());
+
+	FResumedSourceFrames& Resumed = ResumedSourceFrames.FindOrAdd(InPassName);
+	Resumed.FilePaths = MoveTemp(InFilePaths);
+	Resumed.HeldFrameCounts = MoveTemp(InHeldFrameCounts);
+}
 
-	for (const TTuple<FString, TArray<FString>>& Pair : InParams.FilesByExtensionType)
+void UMoviePipelineCustomEncoder::SetResumedShotSegments(const FString& InPassName, TArray<FMoviePipelineShotSegment>&& InSegments)
+{
+	TArray<FString>& Segments = ShotSegmentsByPass.FindOrAdd(InPassName);
+	int32& FrameCount = ResumedSegmentFrameCounts.FindOrAdd(InPassName);
+	for (const FMoviePipelineShotSegment& Segment : InSegments)
 	{
-		FGuid FileGuid = FGuid::NewGuid();
-		FString FilePath = OutputSetting->OutputDirectory.Path / FileGuid.ToString() + TEXT("_input");
+		check(Segment.Index == Segments.Num());
+		Segments.Add(Segment.FilePath);
+		FrameCount += Segment.FrameCount;
+	}
+}
 
-		FMoviePipelineFormatArgs FinalFormatArgs;
+FString UMoviePipelineCustomEncoder::WriteInputListFile(const TArray<FString>& InFilePaths, const TArray<int32>& InHeldFrameCounts, const bool bInWriteFrameDurations, const double InFrameRateAsDuration)
+{
+	UMoviePipelineOutputSetting* OutputSetting = GetPipeline()->GetPipelinePrimaryConfig()->FindSetting<UMoviePipelineOutputSetting>();
 
-		FString FinalFilePath;
-		TMap<FString, FString> FormatOverrides;
-		FormatOverrides.Add(TEXT("ext"), TEXT("txt"));
+	// We generate a FGuid in case there are multiple encode jobs going at once.
+	FGuid FileGuid = FGuid::NewGuid();
+	FString FilePath = OutputSetting->OutputDirectory.Path / FileGuid.ToString() + TEXT("_input");
 
-		GetPipeline()->ResolveFilenameFormatArguments(FilePath, FormatOverrides, FinalFilePath, FinalFormatArgs);
-		
+	FMoviePipelineFormatArgs FinalFormatArgs;
 
-		UE_LOG(LogMovieRenderPipelineIO, Log, TEXT("Generated Path '%s' for input data."), *FinalFilePath);
-		StringBuilder.Reset();
-		for (const FString& Path : Pair.Value)
-		{
-			StringBuilder.Appendf(TEXT("file 'file:%s'%s"), *Path, LINE_TERMINATOR);
+	FString FinalFilePath;
+	TMap<FString, FString> FormatOverrides;
+	FormatOverrides.Add(TEXT("ext"), TEXT("txt"));
 
-			// Some encoders require the duration of each file to be listed after the file.
-			if (Pair.Key != TEXT("wav") && bWriteEachFrameDuration)
-			{
-				StringBuilder.Appendf(TEXT("duration %f%s"), FrameRateAsDuration, LINE_TERMINATOR);
-			}
-		}
+	GetPipeline()->ResolveFilenameFormatArguments(FilePath, FormatOverrides, FinalFilePath, FinalFormatArgs);
+	
 
-		// Save this to disk.
-		FFileHelper::SaveStringToFile(StringBuilder.ToString(), *FinalFilePath);
+	UE_LOG(LogMovieRenderPipelineIO, Log, TEXT("Generated Path '%s' for input data."), *FinalFilePath);
+	TStringBuilder<64> StringBuilder;
+	for (int32 FileIndex = 0; FileIndex < InFilePaths.Num(); FileIndex++)
+	{
+		const FString& Path = InFilePaths[FileIndex];
+		const int32 HeldFrameCount = InHeldFrameCounts[FileIndex];
+		const bool bIsLastFile = FileIndex == InFilePaths.Num() - 1;
 
-		// Not a great solution but best we've got right now
-		if (Pair.Key == TEXT("wav"))
+		// The concat demuxer doesn't honor the duration of the very last entry, so a held last frame is split into
+		// the held portion followed by the same file once more for the final frame.
+		const int32 ListedFrameCount = (bIsLastFile && HeldFrameCount > 1) ? HeldFrameCount - 1 : HeldFrameCount;
+		StringBuilder.Appendf(TEXT("file 'file:%s'%s"), *Path, LINE_TERMINATOR);
+
+		// Some encoders require the duration of each file to be listed after the file. Held frames always need it.
+		if (bInWriteFrameDurations && (bWriteEachFrameDuration || HeldFrameCount > 1))
 		{
-			AudioInputs.Add(FinalFilePath);
+			StringBuilder.Appendf(TEXT("duration %f%s"), InFrameRateAsDuration * ListedFrameCount, LINE_TERMINATOR);
 		}
-		else
+
+		if (ListedFrameCount != HeldFrameCount)
+		{
+			StringBuilder.Appendf(TEXT("file 'file:%s'%s"), *Path, LINE_TERMINATOR);
+			StringBuilder.Appendf(TEXT("duration %f%s"), InFrameRateAsDuration, LINE_TERMINATOR);
+		}
+	}
+
+	// Save this to disk.
+	FFileHelper::SaveStringToFile(StringBuilder.ToString(), *FinalFilePath);
+	return FinalFilePath;
+}
+
+void UMoviePipelineCustomEncoder::LaunchEncoder(TConstArrayView<FEncoderParams> InPasses, const bool bInCountsTowardOutput)
+{
+	check(InPasses.Num() > 0);
+
+	// With several render passes, one process reads every pass and writes one file per pass through the tee muxer.
+	// The audio is then decoded and encoded once and muxed into every output instead of once per pass.
+	const FEncoderParams& PrimaryParams = InPasses[0];
+	const bool bMultiOutput = InPasses.Num() > 1;
+
+	// Generate a text file for each input type which lists the files for that input type.
+	TArray<FString> VideoInputs;
+	TArray<FString> AudioInputs;
+	TArray<TArray<int32>> VideoStreamsByPass;
+
+	double InFrameRate = PrimaryParams.NamedArguments[TEXT("FrameRate")].DoubleValue;
+	double FrameRateAsDuration = 1.0 / InFrameRate;
+
+	for (int32 PassIndex = 0; PassIndex < InPasses.Num(); PassIndex++)
+	{
+		TArray<int32>& VideoStreams = VideoStreamsByPass.AddDefaulted_GetRef();
+		for (const TTuple<FString, TArray<FString>>& Pair : InPasses[PassIndex].FilesByExtensionType)
 		{
-			VideoInputs.Add(FinalFilePath);
+			// Not a great solution but best we've got right now
+			const bool bIsAudio = Pair.Key == TEXT("wav");
+
+			// Every pass carries the same audio files, the first pass's list stands for all of them.
+			if (bIsAudio && PassIndex > 0)
+			{
+				continue;
+			}
+
+			const bool bWriteFrameDurations = !bIsAudio && !PrimaryParams.bConcatSegments;
+			const FString InputListPath = WriteInputListFile(Pair.Value, InPasses[PassIndex].HeldFrameCountsByExtensionType.FindChecked(Pair.Key), bWriteFrameDurations, FrameRateAsDuration);
+			if (bIsAudio)
+			{
+				AudioInputs.Add(InputListPath);
+			}
+			else
+			{
+				VideoStreams.Add(VideoInputs.Num());
+				VideoInputs.Add(InputListPath);
+			}
 		}
 	}
 
 	// Build our final command line arguments
 	const UMoviePipelineCommandLineEncoderSettings* EncoderSettings = GetDefault<UMoviePipelineCommandLineEncoderSettings>();
-	FStringFormatNamedArguments FinalNamedArgs = InParams.NamedArguments;
+	FStringFormatNamedArguments FinalNamedArgs = PrimaryParams.NamedArguments;
 	
 	FString VideoInputArg;
 	FString AudioInputArg;
 
 	for (const FString& FilePath : VideoInputs)
 	{
+		// Segments already carry their timestamps, forcing an input frame rate on them would only retime the copy.
+		if (PrimaryParams.bConcatSegments)
+		{
+			VideoInputArg += FString::Printf(TEXT(" -f concat -safe 0 -i \"%s\""), *FilePath);
+			continue;
+		}
+
 		FStringFormatNamedArguments NamedArgs;
 		NamedArgs.Add(TEXT("InputFile"), *FilePath);
-		NamedArgs.Add(TEXT("FrameRate"), InParams.NamedArguments[TEXT("FrameRate")]);
+		NamedArgs.Add(TEXT("FrameRate"), PrimaryParams.NamedArguments[TEXT("FrameRate")]);
 			
 		VideoInputArg += TEXT(" ") + FString::Format(*EncoderSettings->VideoInputStringFormat, NamedArgs);
 	}
@@ -384,6 +820,77 @@ void UMoviePipelineCustomEncoder::LaunchEncoder(const FEncoderParams& InParams)
 		AudioInputArg += TEXT(" ") + FString::Format(*EncoderSettings->AudioInputStringFormat, NamedArgs);
 	}
 
+	// Output options have to follow the inputs, and the project's command line format has no placeholder of its own
+	// there. They ride along at the end of the audio inputs instead.
+	FString OutputFlags;
+	if (PrimaryParams.bIsShotSegment)
+	{
+		// Fixed GOP with closed keyframes so the segments join by stream copy.
+		const int32 KeyframeInterval = FMath::Max(FMath::RoundToInt32(InFrameRate * ShotSegmentKeyframeIntervalSeconds), 1);
+		AudioInputArg += FString::Printf(TEXT(" -an -g %d -keyint_min %d -sc_threshold 0"), KeyframeInterval, KeyframeInterval);
+		OutputFlags += TEXT("+cgop");
+	}
+
+	// Fragments are written once and never revisited, so the server can upload the file while it grows. Segments are
+	// only intermediate files and stay regular MP4s.
+	const FString OutputExtension = GetOutputFileExtension();
+	const bool bFragmented = bFragmentedOutput && !PrimaryParams.bIsShotSegment
+		&& (OutputExtension.Equals(TEXT("mp4"), ESearchCase::IgnoreCase) || OutputExtension.Equals(TEXT("mov"), ESearchCase::IgnoreCase));
+	const TCHAR* FragmentedMovFlags = TEXT("+frag_keyframe+empty_moov+default_base_moof");
+
+	if (bMultiOutput)
+	{
+		// The project's command line format only has room for one output. The stream mapping and tee muxer follow the
+		// inputs, so the codec and quality arguments that come after still apply to every stream, and {OutputPath}
+		// becomes the tee output list: "[select=\'v:0,a\']beauty.mp4|[select=\'v:1,a\']depth.mp4".
+		for (int32 InputIndex = 0; InputIndex < VideoInputs.Num(); InputIndex++)
+		{
+			AudioInputArg += FString::Printf(TEXT(" -map %d:v"), InputIndex);
+		}
+		for (int32 InputIndex = 0; InputIndex < AudioInputs.Num(); InputIndex++)
+		{
+			AudioInputArg += FString::Printf(TEXT(" -map %d:a"), VideoInputs.Num() + InputIndex);
+		}
+		AudioInputArg += FString::Printf(TEXT(" -flags %s+global_header -f tee"), *OutputFlags);
+		OutputFlags.Reset();
+
+		TArray<FString> TeeOutputs;
+		for (int32 PassIndex = 0; PassIndex < InPasses.Num(); PassIndex++)
+		{
+			TArray<FString> StreamSpecifiers;
+			for (const int32 VideoStream : VideoStreamsByPass[PassIndex])
+			{
+				StreamSpecifiers.Add(FString::Printf(TEXT("v:%d"), VideoStream));
+			}
+			if (AudioInputs.Num() > 0)
+			{
+				StreamSpecifiers.Add(TEXT("a"));
+			}
+
+			const FString OutputPath = InPasses[PassIndex].NamedArguments[TEXT("OutputPath")].StringValue;
+			const FString MuxerOptions = bFragmented ? FString::Printf(TEXT(":movflags=%s"), FragmentedMovFlags) : FString();
+			TeeOutputs.Add(FString::Printf(TEXT("[select=\\'%s\\'%s]%s"), *FString::Join(StreamSpecifiers, TEXT(",")), *MuxerOptions, *EscapeTeeOutputPath(OutputPath)));
+		}
+
+		// The list is one argument even where a path has spaces; the shipped format already quotes {OutputPath}.
+		FString TeeArgument = FString::Join(TeeOutputs, TEXT("|"));
+		if (!EncoderSettings->CommandLineFormat.Contains(TEXT("\"{OutputPath}\"")))
+		{
+			TeeArgument = FString::Printf(TEXT("\"%s\""), *TeeArgument);
+		}
+		FinalNamedArgs.Add(TEXT("OutputPath"), TeeArgument);
+	}
+
+	if (!OutputFlags.IsEmpty())
+	{
+		AudioInputArg += FString::Printf(TEXT(" -flags %s"), *OutputFlags);
+	}
+
+	if (bFragmented && !bMultiOutput)
+	{
+		AudioInputArg += FString::Printf(TEXT(" -movflags %s"), FragmentedMovFlags);
+	}
+
 	FinalNamedArgs.Add(TEXT("VideoInputs"), VideoInputArg);
 	FinalNamedArgs.Add(TEXT("AudioInputs"), AudioInputArg);
 	FString CommandLineArgs = FString::Format(*EncoderSettings->CommandLineFormat, FinalNamedArgs);
@@ -399,21 +906,66 @@ void UMoviePipelineCustomEncoder::LaunchEncoder(const FEncoderParams& InParams)
 
 	verify(FPlatformProcess::CreatePipe(PipeRead, PipeWrite));
 
-	FString ExecutableArg = FString::Format(TEXT("{Executable}"), InParams.NamedArguments);
-	FProcHandle ProcessHandle = FPlatformProcess::CreateProc(*ExecutableArg, *CommandLineArgs, bLaunchDetached, bLaunchHidden, bLaunchReallyHidden, nullptr, 0, nullptr, PipeWrite, PipeRead);
+	FString ExecutableArg = FString::Format(TEXT("{Executable}"), PrimaryParams.NamedArguments);
+	uint32 ProcessId = 0;
+	FProcHandle ProcessHandle = FPlatformProcess::CreateProc(*ExecutableArg, *CommandLineArgs, bLaunchDetached, bLaunchHidden, bLaunchReallyHidden, &ProcessId, ProcessPriority, nullptr, PipeWrite, PipeRead);
 	if (ProcessHandle.IsValid())
 	{
+		LaunchedProcessCount++;
+		if (!ApplyProcessControls(ProcessHandle, ProcessId))
+		{
+			ProcessControlFailureCount++;
+		}
+
 		FActiveJob& NewJob = ActiveEncodeJobs.AddDefaulted_GetRef();
 		NewJob.ProcessHandle = ProcessHandle;
+		NewJob.ProcessId = ProcessId;
 		NewJob.ReadPipe = PipeRead;
 		NewJob.WritePipe = PipeWrite;
-		NewJob.ExpectedFrameCount = InParams.ExpectedFrameCount;
+		NewJob.ExpectedFrameCount = 0;
+		for (const FEncoderParams& Params : InPasses)
+		{
+			NewJob.ExpectedFrameCount = FMath::Max(NewJob.ExpectedFrameCount, Params.ExpectedFrameCount);
+		}
 		NewJob.LastReportedFrame = 0;
-		NewJob.LastProgressSentTimeSeconds = -1.0;
 		NewJob.EncodeStartTimeSeconds = FPlatformTime::Seconds();
-		NewJob.LastReportedEtaSeconds = -1.0;
 		NewJob.PendingStdOut.Reset();
-		NewJob.Shot = InParams.Shot;
+		NewJob.EncodeId = NextEncodeId++;
+		NewJob.bCountsTowardOutput = bInCountsTowardOutput && !PrimaryParams.bConcatSegments;
+		NewJob.Shot = PrimaryParams.Shot;
+		NewJob.bIsShotSegment = PrimaryParams.bIsShotSegment;
+		if (NewJob.bIsShotSegment)
+		{
+			for (const FEncoderParams& Params : InPasses)
+			{
+				NewJob.Segments.Add(Params.Segment);
+			}
+		}
+		NewJob.Quality = EffectiveQuality;
+
+		if (LogSink)
+		{
+			LogSink->Write(FString::Printf(TEXT("[encode %d] Launched process %u: %s %s"), NewJob.EncodeId, ProcessId, *ExecutableArg, *CommandLineArgs));
+		}
+
+		// With a deadline, the first frames are a calibration run. If they are too slow the process is restarted on the
+		// next faster preset, so until then it keeps everything it needs to launch again.
+		if (TargetEncodeSeconds > 0.f && !PrimaryParams.bConcatSegments && EffectiveQuality != EMoviePipelineEncodeQuality::Low)
+		{
+			if (RequiredEncodeFps <= 0.0)
+			{
+				int32 CurrentOutputFrame = 0;
+				int32 TotalOutputFrames = 0;
+				UMoviePipelineBlueprintLibrary::GetOverallOutputFrames(GetPipeline(), CurrentOutputFrame, TotalOutputFrames);
+				RequiredEncodeFps = FMath::Max(TotalOutputFrames, NewJob.ExpectedFrameCount) / static_cast<double>(TargetEncodeSeconds);
+			}
+
+			NewJob.bCalibrating = NewJob.ExpectedFrameCount > DeadlineCalibrationFrames;
+			if (NewJob.bCalibrating)
+			{
+				NewJob.Passes.Append(InPasses.GetData(), InPasses.Num());
+			}
+		}
 
 		// Automatically delete the input files we generated when the job is done
 		bool bDeleteInputTexts = true;
@@ -428,14 +980,70 @@ void UMoviePipelineCustomEncoder::LaunchEncoder(const FEncoderParams& InParams)
 		{
 			NewJob.FilesToDelete.Append(VideoInputs);
 			NewJob.FilesToDelete.Append(AudioInputs);
+			if (NewJob.bCalibrating)
+			{
+				NewJob.InputListFiles.Append(VideoInputs);
+				NewJob.InputListFiles.Append(AudioInputs);
+			}
+		}
+
+		// Shot segments are our own intermediates as well.
+		if (bDeleteInputTexts && PrimaryParams.bConcatSegments)
+		{
+			for (const FEncoderParams& Params : InPasses)
+			{
+				for (const TTuple<FString, TArray<FString>>& Pair : Params.FilesByExtensionType)
+				{
+					if (Pair.Key != TEXT("wav"))
+					{
+						NewJob.FilesToDelete.Append(Pair.Value);
+					}
+				}
+			}
 		}
 
 		// And the user's input files (if requested), though we ignore this if you have the Debug Setting asking you to write all samples.
+		// Every video input advances with the encoder's one output frame counter (the tee muxer too), so each input list
+		// maps onto that counter and its frames can be deleted while the encode is still running. Audio is shared across
+		// render passes and is only removed at the end.
 		if (bDeleteSourceFiles && bDeleteInputTexts)
 		{
-			for (const TTuple<FString, TArray<FString>>& Pair : InParams.FilesByExtensionType)
+			TMap<FString, int32> EndIndexByPath;
+			for (int32 PassIndex = 0; PassIndex < InPasses.Num(); PassIndex++)
+			{
+				const FEncoderParams& Params = InPasses[PassIndex];
+				for (const TTuple<FString, TArray<FString>>& Pair : Params.FilesByExtensionType)
+				{
+					if ((Pair.Key == TEXT("wav") && PassIndex > 0) || (Pair.Key != TEXT("wav") && Params.bConcatSegments))
+					{
+						continue;
+					}
+
+					if (Pair.Key == TEXT("wav"))
+					{
+						NewJob.FilesToDelete.Append(Pair.Value);
+						continue;
+					}
+
+					// Walk the input list the way the encoder reads it: each entry spans its held frames, and a file
+					// listed more than once is only free once the counter has passed its last entry.
+					const TArray<int32>& HeldFrameCounts = Params.HeldFrameCountsByExtensionType.FindChecked(Pair.Key);
+					int32 EndIndex = 0;
+					for (int32 FileIndex = 0; FileIndex < Pair.Value.Num(); FileIndex++)
+					{
+						EndIndex += HeldFrameCounts[FileIndex];
+						int32& PathEndIndex = EndIndexByPath.FindOrAdd(Pair.Value[FileIndex], 0);
+						PathEndIndex = FMath::Max(PathEndIndex, EndIndex);
+					}
+				}
+			}
+
+			// The passes' lists interleave on the counter; released in the order the counter reaches them.
+			EndIndexByPath.ValueStableSort([](const int32 A, const int32 B) { return A < B; });
+			for (const TPair<FString, int32>& Pair : EndIndexByPath)
 			{
-				NewJob.FilesToDelete.Append(Pair.Value);
+				NewJob.SourceFramesToDelete.Add(Pair.Key);
+				NewJob.SourceFrameEndIndices.Add(Pair.Value);
 			}
 		}
 	}
@@ -446,9 +1054,144 @@ void UMoviePipelineCustomEncoder::LaunchEncoder(const FEncoderParams& InParams)
 	}
 }
 
+bool UMoviePipelineCustomEncoder::ApplyProcessControls(FProcHandle& InProcessHandle, const uint32 InProcessId)
+{
+	bool bAllApplied = true;
+	const uint64 AffinityMask = CpuAffinity.IsEmpty() ? 0 : ParseCpuAffinityMask(CpuAffinity);
+	if (!CpuAffinity.IsEmpty() && AffinityMask == 0)
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoder CPU affinity '%s' names no usable core, ignoring it."), *CpuAffinity);
+		bAllApplied = false;
+	}
+
+#if PLATFORM_WINDOWS
+	HANDLE ProcessHandle = InProcessHandle.Get();
+	if (AffinityMask != 0 && !::SetProcessAffinityMask(ProcessHandle, static_cast<DWORD_PTR>(AffinityMask)))
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to set encoder CPU affinity '%s' (error %u)."), *CpuAffinity, ::GetLastError());
+		bAllApplied = false;
+	}
+
+	if (CpuQuota > 0.f)
+	{
+		if (!CpuQuotaJobObject)
+		{
+			CpuQuotaJobObject = ::CreateJobObjectW(nullptr, nullptr);
+
+			// CpuRate is in 1/100th of a percent of the whole machine.
+			JOBOBJECT_CPU_RATE_CONTROL_INFORMATION RateControl = {};
+			RateControl.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+			RateControl.CpuRate = static_cast<DWORD>(FMath::Clamp(CpuQuota / FPlatformMisc::NumberOfCoresIncludingHyperthreads() * 10000.f, 1.f, 10000.f));
+			if (CpuQuotaJobObject && !::SetInformationJobObject(CpuQuotaJobObject, JobObjectCpuRateControlInformation, &RateControl, sizeof(RateControl)))
+			{
+				::CloseHandle(CpuQuotaJobObject);
+				CpuQuotaJobObject = nullptr;
+			}
+		}
+
+		if (!CpuQuotaJobObject || !::AssignProcessToJobObject(CpuQuotaJobObject, ProcessHandle))
+		{
+			UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to cap the encoder at %.2f cores (error %u)."), CpuQuota, ::GetLastError());
+			bAllApplied = false;
+		}
+	}
+
+	if (!Cgroup.IsEmpty())
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoder cgroup '%s' ignored, cgroups are Linux only."), *Cgroup);
+	}
+#elif PLATFORM_LINUX
+	const pid_t Pid = static_cast<pid_t>(InProcessId);
+
+	// CreateProc doesn't renice on Linux. Map -2..2 onto nice 19..-10; raising priority needs CAP_SYS_NICE.
+	static const int32 NiceByPriority[] = { 19, 10, 0, -5, -10 };
+	const int32 Nice = NiceByPriority[FMath::Clamp(ProcessPriority, -2, 2) + 2];
+	if (Nice != 0 && setpriority(PRIO_PROCESS, Pid, Nice) != 0)
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to set encoder nice level %d (errno %d)."), Nice, errno);
+		bAllApplied = false;
+	}
+
+	if (AffinityMask != 0)
+	{
+		cpu_set_t CpuSet;
+		CPU_ZERO(&CpuSet);
+		for (int32 Core = 0; Core < 64; Core++)
+		{
+			if (AffinityMask & (uint64(1) << Core))
+			{
+				CPU_SET(Core, &CpuSet);
+			}
+		}
+
+		if (sched_setaffinity(Pid, sizeof(CpuSet), &CpuSet) != 0)
+		{
+			UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to set encoder CPU affinity '%s' (errno %d)."), *CpuAffinity, errno);
+			bAllApplied = false;
+		}
+	}
+
+	if (!Cgroup.IsEmpty() && (!IsValidCgroupPath(Cgroup) || (!CgroupChildName.IsEmpty() && !IsValidCgroupPath(CgroupChildName))))
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoder cgroup '%s' / '%s' is not a relative cgroup path, ignoring it."), *Cgroup, *CgroupChildName);
+		bAllApplied = false;
+	}
+	else if (!Cgroup.IsEmpty())
+	{
+		const FString ParentCgroupPath = FString(TEXT("/sys/fs/cgroup")) / Cgroup;
+		const FString CgroupPath = CgroupChildName.IsEmpty() ? ParentCgroupPath : ParentCgroupPath / CgroupChildName;
+		IFileManager::Get().MakeDirectory(*CgroupPath, true);
+		if (CgroupPath != ParentCgroupPath && CreatedCgroupPath.IsEmpty())
+		{
+			CreatedCgroupPath = CgroupPath;
+			// The child only has a cpu.max once its parent hands the cpu controller down.
+			if (CpuQuota > 0.f)
+			{
+				FFileHelper::SaveStringToFile(FString(TEXT("+cpu")), *(ParentCgroupPath / TEXT("cgroup.subtree_control")));
+			}
+		}
+
+		// cpu.max is "<quota> <period>" in microseconds.
+		constexpr int32 CpuPeriodMicroseconds = 100000;
+		if (CpuQuota > 0.f)
+		{
+			const FString CpuMax = FString::Printf(TEXT("%d %d"), FMath::Max(FMath::RoundToInt32(CpuQuota * CpuPeriodMicroseconds), 1000), CpuPeriodMicroseconds);
+			if (!FFileHelper::SaveStringToFile(CpuMax, *(CgroupPath / TEXT("cpu.max"))))
+			{
+				UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to set cpu.max of cgroup '%s'."), *CgroupPath);
+				bAllApplied = false;
+			}
+		}
+
+		if (!FFileHelper::SaveStringToFile(FString::Printf(TEXT("%u"), InProcessId), *(CgroupPath / TEXT("cgroup.procs"))))
+		{
+			UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to move the encoder into cgroup '%s'."), *CgroupPath);
+			bAllApplied = false;
+		}
+	}
+	else if (CpuQuota > 0.f)
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoder CPU quota ignored, set a cgroup to enforce it on Linux."));
+		bAllApplied = false;
+	}
+#else
+	if (AffinityMask != 0 || CpuQuota > 0.f || !Cgroup.IsEmpty())
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoder affinity, CPU quota and cgroup aren't supported on this platform."));
+		bAllApplied = false;
+	}
+#endif
+
+	UE_LOG(LogMovieRenderPipelineIO, Log, TEXT("Encoder process %u: priority %d, affinity '%s', CPU quota %.2f, cgroup '%s'%s."),
+		InProcessId, ProcessPriority, *CpuAffinity, CpuQuota, *Cgroup, bAllApplied ? TEXT("") : TEXT(" (partially applied)"));
+	return bAllApplied;
+}
+
 void UMoviePipelineCustomEncoder::OnTick()
 {
 	UMoviePipeline* Pipeline = GetPipeline();
+
+	PendingFileDeletions.RemoveAllSwap([](const UE::Tasks::FTask& InTask) { return InTask.IsCompleted(); });
 	
 	for (int32 Index = ActiveEncodeJobs.Num() - 1; Index >= 0; Index--)
 	{
@@ -464,7 +1207,33 @@ void UMoviePipelineCustomEncoder::OnTick()
 				return;
 			}
 
-			UE_LOG(LogMovieRenderPipeline, Error, TEXT("%s: Trimmed ffmpeg output log: %s"), ANSI_TO_TCHAR(__FUNCTION__), *TrimmedLine);
+			if (LogSink)
+			{
+				LogSink->Write(FString::Printf(TEXT("[encode %d] %s"), Job.EncodeId, *TrimmedLine));
+			}
+
+			// Everything goes to the encoder log, the engine log only gets what someone needs to act on.
+			const ELogVerbosity::Type Verbosity = FMoviePipelineLogSink::ClassifyEncoderLine(TrimmedLine);
+			if (Verbosity == ELogVerbosity::Error || Verbosity == ELogVerbosity::Warning)
+			{
+				static const FName ErrorCategory(TEXT("EncoderError"));
+				static const FName WarningCategory(TEXT("EncoderWarning"));
+				const bool bIsError = Verbosity == ELogVerbosity::Error;
+
+				int32 SuppressedCount = 0;
+				if (EncoderLogLimiter.Allow(bIsError ? ErrorCategory : WarningCategory, SuppressedCount))
+				{
+					const FString Suppressed = SuppressedCount > 0 ? FString::Printf(TEXT(" (%d similar lines suppressed)"), SuppressedCount) : FString();
+					if (bIsError)
+					{
+						UE_LOG(LogMovieRenderPipelineIO, Error, TEXT("Encoder %d: %s%s"), Job.EncodeId, *TrimmedLine, *Suppressed);
+					}
+					else
+					{
+						UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoder %d: %s%s"), Job.EncodeId, *TrimmedLine, *Suppressed);
+					}
+				}
+			}
 
 			int32 ParsedFrameValue = 0;
 			if (!TryExtractFrameCount(TrimmedLine, ParsedFrameValue))
@@ -472,63 +1241,40 @@ void UMoviePipelineCustomEncoder::OnTick()
 				return;
 			}
 
-			if (ParsedFrameValue <= Job.LastReportedFrame)
+			double ParsedStatValue = 0.0;
+			if (TryExtractStatValue(TrimmedLine, TEXT("speed="), ParsedStatValue) && ParsedStatValue > 0.0)
 			{
-				return;
+				Job.ReportedSpeed = ParsedStatValue;
 			}
-
-			Job.LastReportedFrame = ParsedFrameValue;
-
-			if (Job.ExpectedFrameCount <= 0)
+			if (TryExtractStatValue(TrimmedLine, TEXT("fps="), ParsedStatValue) && ParsedStatValue > 0.0)
 			{
-				return;
+				Job.ReportedFps = ParsedStatValue;
 			}
-
-			const float Progress = FMath::Clamp(static_cast<float>(Job.LastReportedFrame) / static_cast<float>(Job.ExpectedFrameCount), 0.0f, 1.0f);
-			const double NowSeconds = FPlatformTime::Seconds();
-			
-
-			if (Job.EncodeStartTimeSeconds < 0.0)
+			else if (Job.ReportedSpeed > 0.0 && Job.Passes.Num() > 0)
 			{
-				Job.EncodeStartTimeSeconds = NowSeconds;
+				Job.ReportedFps = Job.ReportedSpeed * Job.Passes[0].NamedArguments[TEXT("FrameRate")].DoubleValue;
 			}
-			
-			constexpr double MinUpdateIntervalSeconds = 0.1;
+			TryExtractByteSize(TrimmedLine, Job.BytesOut);
 
-			const double ElapsedSeconds = Job.EncodeStartTimeSeconds >= 0.0 ? FMath::Max(NowSeconds - Job.EncodeStartTimeSeconds, 0.0) : -1.0;
-			double EstimatedRemainingSeconds = -1.0;
-			if (ElapsedSeconds > SMALL_NUMBER && Progress > KINDA_SMALL_NUMBER)
+			if (ParsedFrameValue <= Job.LastReportedFrame)
 			{
-				const double EstimatedTotalSeconds = ElapsedSeconds / FMath::Clamp(static_cast<double>(Progress), KINDA_SMALL_NUMBER, 1.0);
-				EstimatedRemainingSeconds = FMath::Max(EstimatedTotalSeconds - ElapsedSeconds, 0.0);
+				return;
 			}
-			
 
-			const bool bShouldForceUpdate = Progress >= 1.f;
-			if (bShouldForceUpdate || Job.LastProgressSentTimeSeconds < 0.0 || (NowSeconds - Job.LastProgressSentTimeSeconds) >= MinUpdateIntervalSeconds)
+			Job.LastReportedFrame = ParsedFrameValue;
+			if (Job.bCalibrating && Job.LastReportedFrame >= DeadlineCalibrationFrames)
 			{
-				Job.LastProgressSentTimeSeconds = NowSeconds;
-				if (UMoviePipelineExecutorShot* Shot = Job.Shot.Get())
-				{
-					UE_LOG(LogTemp, Log, TEXT("%s: Shot status progress: %d"), ANSI_TO_TCHAR(__FUNCTION__), static_cast<int>(Progress * 100.0f));
-					Shot->SetStatusProgress(Progress);
+				FinishDeadlineCalibration(Job);
+			}
 
-					if (EstimatedRemainingSeconds >= 0.0)
-					{
-						const bool bShouldUpdateEta = bShouldForceUpdate || Job.LastReportedEtaSeconds < 0.0 || FMath::Abs(Job.LastReportedEtaSeconds - EstimatedRemainingSeconds) >= 1.0;
-						if (bShouldUpdateEta)
-						{
-							Job.LastReportedEtaSeconds = EstimatedRemainingSeconds;
-							const FString EtaMessage = MakeEtaStatusMessage(EstimatedRemainingSeconds);
-							if (!EtaMessage.IsEmpty())
-							{
-								Shot->SetStatusMessage(EtaMessage);
-							}
-						}
-					}
-				}
-				
+			if (!Job.bCalibrating)
+			{
+				ReleaseConsumedSourceFrames(Job, false);
 			}
+
+			const bool bFinished = false;
+			const bool bRestarted = false;
+			BroadcastProgress(Job, bFinished, bRestarted, 0);
 		};
 
 		auto ConsumOutput = [&](const FString& InOutput, const bool bFlushTail)
@@ -561,15 +1307,46 @@ void UMoviePipelineCustomEncoder::OnTick()
 		FString Results = FPlatformProcess::ReadPipe(Job.ReadPipe);
 		if (Results.Len() > 0)
 		{
+			// We can't tell stdout from stderr using a non-blocking platform process launch, so every line is classified by its content.
 			ConsumOutput(Results, false);
-			// The default global arguments suppress everything but errors. We unfortunately can't tell stdout from stderr
-			// using a non-blocking platform process launch, so we'll just promote all the output as an error log.
-			UE_LOG(LogMovieRenderPipeline, Error, TEXT("Command Line Encoder: %s"), *Results);
+		}
+
+		const bool bRestartEncode = Job.bRestartFaster && FPlatformProcess::IsProcRunning(Job.ProcessHandle) && !(bSkipEncodeOnRenderCanceled && Pipeline && Pipeline->IsShutdownRequested());
+		if (bRestartEncode)
+		{
+			// Nothing of the output is kept, the new process starts over from the first frame and overwrites it.
+			TArray<FEncoderParams> Passes = MoveTemp(Job.Passes);
+			TArray<FString> InputListFiles = MoveTemp(Job.InputListFiles);
+			const bool bCountsTowardOutput = Job.bCountsTowardOutput;
+
+			const bool bKillTree = true;
+			FPlatformProcess::TerminateProc(Job.ProcessHandle, bKillTree);
+			FPlatformProcess::WaitForProc(Job.ProcessHandle);
+
+			const bool bFinished = true;
+			const bool bRestarted = true;
+			BroadcastProgress(Job, bFinished, bRestarted, -1);
+			ExitedProcessCpuSeconds += GetProcessCpuSeconds(Job.ProcessHandle, Job.ProcessId);
+			FPlatformProcess::ClosePipe(Job.ReadPipe, Job.WritePipe);
+			FPlatformProcess::CloseProc(Job.ProcessHandle);
+			ActiveEncodeJobs.RemoveAt(Index);
+
+			if (InputListFiles.Num() > 0)
+			{
+				LaunchFileDeletion(MoveTemp(InputListFiles));
+			}
+
+			for (FEncoderParams& Params : Passes)
+			{
+				Params.NamedArguments.Add(TEXT("Quality"), GetQualitySettingString(EffectiveQuality));
+			}
+			LaunchEncoder(Passes, bCountsTowardOutput);
+			continue;
 		}
 
 		// If they hit escape during  a render, (potentially) cancel the encode job
 		bool bCancelEncode = false;
-		if (bSkipEncodeOnRenderCanceled && Pipeline && Pipeline->IsShutdownRequested())
+		if (bCancelRequested || (bSkipEncodeOnRenderCanceled && Pipeline && Pipeline->IsShutdownRequested()))
 		{
 			bCancelEncode = true;
 
@@ -584,31 +1361,132 @@ void UMoviePipelineCustomEncoder::OnTick()
 		if (bProcessFinished || bCancelEncode)
 		{
 			ConsumOutput(TEXT(""), true);
-			if (Job.ExpectedFrameCount > 0 && !bCancelEncode)
+
+			int32 ReturnCode = bCancelEncode ? -1 : 0;
+			if (!bCancelEncode && !FPlatformProcess::GetProcReturnCode(Job.ProcessHandle, &ReturnCode))
+			{
+				ReturnCode = 0;
+			}
+
+			// A clean exit encoded everything, even if the last progress line wasn't printed.
+			if (ReturnCode == 0)
+			{
+				Job.LastReportedFrame = FMath::Max(Job.LastReportedFrame, Job.ExpectedFrameCount);
+			}
+
+			const bool bFinished = true;
+			const bool bRestarted = false;
+			BroadcastProgress(Job, bFinished, bRestarted, ReturnCode);
+
+			if (!bCancelEncode && ReturnCode != 0)
+			{
+				UE_LOG(LogMovieRenderPipelineIO, Error, TEXT("Encoder %d exited with code %d, its full output is in '%s'."),
+					Job.EncodeId, ReturnCode, LogSink ? *LogSink->GetFilePath() : TEXT(""));
+			}
+
+			if (Job.bIsShotSegment && !bCancelEncode && ReturnCode != 0)
+			{
+				UE_LOG(LogMovieRenderPipelineIO, Error, TEXT("Encoding a shot segment failed with exit code %d, the segments won't be joined."), ReturnCode);
+				bShotSegmentFailed = true;
+			}
+			else if (Job.bIsShotSegment && !bCancelEncode)
 			{
-				const float Progress = 1.f;
-				if (UMoviePipelineExecutorShot* Shot = Job.Shot.Get())
+				for (const FMoviePipelineShotSegment& Segment : Job.Segments)
 				{
-					Shot->SetStatusProgress(Progress);
-					Shot->SetStatusMessage(TEXT(""));
+					ShotSegmentEncodedDelegate.Broadcast(Segment);
 				}
 			}
-			
+
+			ExitedProcessCpuSeconds += GetProcessCpuSeconds(Job.ProcessHandle, Job.ProcessId);
 			FPlatformProcess::ClosePipe(Job.ReadPipe, Job.WritePipe);
 			FPlatformProcess::CloseProc(Job.ProcessHandle);
 
-			IFileManager& FileManager = IFileManager::Get();
-			for (const FString& FilePath : Job.FilesToDelete)
-			{
-				const bool bRequireExist = false;
-				const bool bEvenReadOnly = false;
-				const bool bQuiet = false;
-				FileManager.Delete(*FilePath, bRequireExist, bEvenReadOnly, bQuiet);
-			}
+			ReleaseConsumedSourceFrames(Job, true);
 
 			ActiveEncodeJobs.RemoveAt(Index);
 		}
 	}
+
+	if (LogSink)
+	{
+		const bool bWait = false;
+		LogSink->Flush(bWait);
+	}
+
+	if (bPendingShotSegmentConcat && ActiveEncodeJobs.Num() == 0)
+	{
+		bPendingShotSegmentConcat = false;
+		if (bSkipEncodeOnRenderCanceled && Pipeline && Pipeline->IsShutdownRequested())
+		{
+			return;
+		}
+
+		if (bShotSegmentFailed)
+		{
+			UE_LOG(LogMovieRenderPipelineIO, Error, TEXT("Skipping the final encode because a shot segment failed to encode, see the log above."));
+			return;
+		}
+
+		FMoviePipelineOutputData OutputData = Pipeline->GetOutputDataParams();
+		const bool bIsShotEncode = false;
+		StartEncodingProcess(OutputData.ShotData, bIsShotEncode);
+	}
+}
+
+void UMoviePipelineCustomEncoder::ReleaseConsumedSourceFrames(FActiveJob& InJob, const bool bReleaseAll)
+{
+	const int32 ConsumedCount = bReleaseAll ? InJob.SourceFramesToDelete.Num() : Algo::UpperBound(InJob.SourceFrameEndIndices, InJob.LastReportedFrame);
+	const int32 ReleaseCount = ConsumedCount - InJob.NextSourceFrameToDelete;
+
+	if (bReleaseAll)
+	{
+		TArray<FString> FilesToDelete = MoveTemp(InJob.FilesToDelete);
+		if (ReleaseCount > 0)
+		{
+			FilesToDelete.Append(InJob.SourceFramesToDelete.GetData() + InJob.NextSourceFrameToDelete, ReleaseCount);
+		}
+		InJob.NextSourceFrameToDelete = ConsumedCount;
+		KeepSourceFramesInUse(FilesToDelete);
+
+		if (FilesToDelete.Num() > 0)
+		{
+			LaunchFileDeletion(MoveTemp(FilesToDelete));
+		}
+		return;
+	}
+
+	if (ReleaseCount < MinSourceFrameDeleteBatch)
+	{
+		return;
+	}
+
+	// The encoder has emitted LastReportedFrame frames, so it has already read every source file that ends at or before it.
+	TArray<FString> FilesToDelete(InJob.SourceFramesToDelete.GetData() + InJob.NextSourceFrameToDelete, ReleaseCount);
+	InJob.NextSourceFrameToDelete = ConsumedCount;
+	KeepSourceFramesInUse(FilesToDelete);
+	if (FilesToDelete.Num() > 0)
+	{
+		LaunchFileDeletion(MoveTemp(FilesToDelete));
+	}
+}
+
+void UMoviePipelineCustomEncoder::KeepSourceFramesInUse(TArray<FString>& InOutFilesToDelete) const
+{
+	if (SourceFrameReleaseHandler)
+	{
+		InOutFilesToDelete.RemoveAll([this](const FString& FilePath) { return SourceFrameReleaseHandler(FilePath); });
+	}
+}
+
+void UMoviePipelineCustomEncoder::LaunchFileDeletion(TArray<FString>&& InFilesToDelete)
+{
+	PendingFileDeletions.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[FilesToDelete = MoveTemp(InFilesToDelete)]()
+		{
+			DeleteFilesBlocking(FilesToDelete);
+			UE_LOG(LogMovieRenderPipelineIO, Verbose, TEXT("Command Line Encoder: Deleted %d files in the background."), FilesToDelete.Num());
+		},
+		UE::Tasks::ETaskPriority::BackgroundNormal));
 }
 
 bool UMoviePipelineCustomEncoder::NeedsPerShotFlushing() const
@@ -625,21 +1503,129 @@ bool UMoviePipelineCustomEncoder::NeedsPerShotFlushing() const
 	return false;
 }
 
+void UMoviePipelineCustomEncoder::BroadcastProgress(const FActiveJob& InJob, const bool bInFinished, const bool bInRestarted, const int32 InExitCode)
+{
+	FMoviePipelineEncodeProgress Progress;
+	Progress.EncodeId = InJob.EncodeId;
+	Progress.Shot = InJob.Shot;
+	Progress.FramesDone = InJob.LastReportedFrame;
+	Progress.FramesTotal = InJob.ExpectedFrameCount;
+	Progress.Fps = InJob.ReportedFps;
+	Progress.Speed = InJob.ReportedSpeed;
+	Progress.BytesOut = InJob.BytesOut;
+	Progress.bCountsTowardOutput = InJob.bCountsTowardOutput;
+	Progress.bFinished = bInFinished;
+	Progress.bRestarted = bInRestarted;
+	Progress.ExitCode = InExitCode;
+
+	const double ElapsedSeconds = FPlatformTime::Seconds() - InJob.EncodeStartTimeSeconds;
+	if (bInFinished)
+	{
+		Progress.EtaSeconds = 0.0;
+	}
+	else if (InJob.ExpectedFrameCount > 0 && InJob.LastReportedFrame > 0 && ElapsedSeconds > SMALL_NUMBER)
+	{
+		const double RemainingFrames = FMath::Max(InJob.ExpectedFrameCount - InJob.LastReportedFrame, 0);
+		Progress.EtaSeconds = RemainingFrames * ElapsedSeconds / InJob.LastReportedFrame;
+	}
+
+	EncodeProgressDelegate.Broadcast(Progress);
+}
+
+void UMoviePipelineCustomEncoder::FinishDeadlineCalibration(FActiveJob& InJob)
+{
+	InJob.bCalibrating = false;
+
+	double Fps = InJob.ReportedFps;
+	if (Fps <= 0.0)
+	{
+		const double ElapsedSeconds = FPlatformTime::Seconds() - InJob.EncodeStartTimeSeconds;
+		Fps = ElapsedSeconds > SMALL_NUMBER ? InJob.LastReportedFrame / ElapsedSeconds : 0.0;
+	}
+
+	if (Fps >= RequiredEncodeFps || InJob.Quality == EMoviePipelineEncodeQuality::Low)
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Log, TEXT("Encoding at %.1f fps on quality %d, %.1f fps are needed to finish in %.0fs."),
+			Fps, static_cast<int32>(InJob.Quality), RequiredEncodeFps, TargetEncodeSeconds);
+		InJob.Passes.Reset();
+		InJob.InputListFiles.Reset();
+		return;
+	}
+
+	// Another encode may have stepped down already, never go back up from there.
+	const EMoviePipelineEncodeQuality FasterQuality = static_cast<EMoviePipelineEncodeQuality>(static_cast<int32>(InJob.Quality) - 1);
+	EffectiveQuality = FMath::Min(EffectiveQuality, FasterQuality);
+	InJob.bRestartFaster = true;
+
+	UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Encoding at %.1f fps on quality %d can't finish in %.0fs (%.1f fps needed), restarting on quality %d."),
+		Fps, static_cast<int32>(InJob.Quality), TargetEncodeSeconds, RequiredEncodeFps, static_cast<int32>(EffectiveQuality));
+}
+
 void UMoviePipelineCustomEncoder::SetupForPipelineImpl(UMoviePipeline* InPipeline)
 {
-	if (InPipeline && NeedsPerShotFlushing())
+	EffectiveQuality = Quality;
+	RequiredEncodeFps = 0.0;
+
+	// Frames of an interrupted attempt don't belong to any shot of this one, so resuming from frames encodes everything at
+	// the end. Resuming from segments keeps encoding segments, the earlier ones have to be joined with the new ones.
+	bShotSegmentsActive = (bEncodeShotSegments || ShotSegmentsByPass.Num() > 0) && !NeedsPerShotFlushing() && ResumedSourceFrames.Num() == 0;
+
+	if (InPipeline && (NeedsPerShotFlushing() || bShotSegmentsActive))
 	{
 		InPipeline->SetFlushDiskWritesPerShot(true);
+		InPipeline->OnMoviePipelineShotWorkFinished().AddUObject(this, &UMoviePipelineCustomEncoder::OnShotWorkFinished);
+	}
+
+	if (InPipeline)
+	{
+		FString LogPath = LogFilePath;
+		if (LogPath.IsEmpty())
+		{
+			// Next to the engine's own log, which the server points at the job's logs directory, rather than among the frames.
+			const FString EngineLogPath = FPlatformOutputDevices::GetAbsoluteLogFilename();
+			LogPath = FPaths::GetPath(EngineLogPath) / (FPaths::GetBaseFilename(EngineLogPath) + TEXT("-encoder.log"));
+		}
+		if (FPaths::IsRelative(LogPath))
+		{
+			LogPath = FPaths::ConvertRelativePathToFull(LogPath);
+		}
+		LogSink = MakeUnique<FMoviePipelineLogSink>(LogPath);
+		UE_LOG(LogMovieRenderPipelineIO, Log, TEXT("Writing encoder output to '%s'."), *LogSink->GetFilePath());
 	}
 
 	// Register a delegate so we can listen each frame for finished encode processes
 	FCoreDelegates::OnEndFrame.AddUObject(this, &UMoviePipelineCustomEncoder::OnTick);
 }
 
-FString UMoviePipelineCustomEncoder::GetQualitySettingString() const
+void UMoviePipelineCustomEncoder::OnShotWorkFinished(FMoviePipelineOutputData InOutputData)
+{
+	// Only start on shots we haven't encoded yet, in case the output data carries earlier shots as well.
+	TArray<FMoviePipelineShotOutputData> FinishedShots;
+	for (FMoviePipelineShotOutputData& Data : InOutputData.ShotData)
+	{
+		if (!EncodedShots.Contains(Data.Shot))
+		{
+			EncodedShots.Add(Data.Shot);
+			FinishedShots.Add(MoveTemp(Data));
+		}
+	}
+
+	if (FinishedShots.Num() > 0)
+	{
+		const bool bIsShotEncode = true;
+		StartEncodingProcess(FinishedShots, bIsShotEncode);
+	}
+}
+
+FString UMoviePipelineCustomEncoder::GetOutputFileExtension() const
+{
+	return OutputFileExtensionOverride.IsEmpty() ? GetDefault<UMoviePipelineCommandLineEncoderSettings>()->OutputFileExtension : OutputFileExtensionOverride;
+}
+
+FString UMoviePipelineCustomEncoder::GetQualitySettingString(const EMoviePipelineEncodeQuality InQuality) const
 {
 	const UMoviePipelineCommandLineEncoderSettings* EncoderSettings = GetDefault<UMoviePipelineCommandLineEncoderSettings>();
-	switch (Quality)
+	switch (InQuality)
 	{
 	case EMoviePipelineEncodeQuality::Low:
 		return EncoderSettings->EncodeSettings_Low;
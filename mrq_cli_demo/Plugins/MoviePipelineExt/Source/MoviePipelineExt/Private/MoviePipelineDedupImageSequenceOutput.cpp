@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineDedupImageSequenceOutput.h"
+#include "MoviePipeline.h"
+#include "MoviePipelineQueue.h"
+#include "MovieRenderPipelineCoreModule.h"
+#include "MovieRenderPipelineDataTypes.h"
+#include "ImagePixelData.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(MoviePipelineDedupImageSequenceOutput)
+
+UMoviePipelineDedupImageSequenceOutput_PNG::UMoviePipelineDedupImageSequenceOutput_PNG()
+{
+	bSkipDuplicateFrames = true;
+}
+
+const TArray<int32>* UMoviePipelineDedupImageSequenceOutput_PNG::GetHeldFrameCounts(const UMoviePipelineExecutorShot* InShot, const FMoviePipelinePassIdentifier& InPassIdentifier) const
+{
+	const FHeldFrameTrack* Track = HeldFrameTracks.Find(MakeTuple(TWeakObjectPtr<const UMoviePipelineExecutorShot>(InShot), InPassIdentifier));
+	return Track ? &Track->HeldFrameCounts : nullptr;
+}
+
+void UMoviePipelineDedupImageSequenceOutput_PNG::OnReceiveImageDataImpl(FMoviePipelineMergerOutputFrame* InMergedOutputFrame)
+{
+	check(InMergedOutputFrame);
+
+	const TArray<UMoviePipelineExecutorShot*>& ActiveShots = GetPipeline()->GetActiveShotList();
+	const int32 ShotIndex = InMergedOutputFrame->FrameOutputState.ShotIndex;
+	const UMoviePipelineExecutorShot* Shot = ActiveShots.IsValidIndex(ShotIndex) ? ActiveShots[ShotIndex] : nullptr;
+
+	// Burn-ins and other overlays get composited onto every pass by the base class, so a frame that carries one
+	// can't be judged by its own pixels. Write those frames as-is.
+	bool bHasCompositePass = false;
+	for (const TPair<FMoviePipelinePassIdentifier, TUniquePtr<FImagePixelData>>& Pair : InMergedOutputFrame->ImageOutputData)
+	{
+		const FImagePixelDataPayload* Payload = Pair.Value->GetPayload<FImagePixelDataPayload>();
+		bHasCompositePass |= Payload && Payload->bCompositeToFinalImage;
+	}
+
+	TArray<FMoviePipelinePassIdentifier> DuplicatePasses;
+	for (const TPair<FMoviePipelinePassIdentifier, TUniquePtr<FImagePixelData>>& Pair : InMergedOutputFrame->ImageOutputData)
+	{
+		FHeldFrameTrack& Track = HeldFrameTracks.FindOrAdd(MakeTuple(TWeakObjectPtr<const UMoviePipelineExecutorShot>(Shot), Pair.Key));
+
+		const void* RawData = nullptr;
+		int64 SizeInBytes = 0;
+		Pair.Value->GetRawData(RawData, SizeInBytes);
+
+		FFrameFingerprint Fingerprint;
+		Fingerprint.Hash = FXxHash128::HashBuffer(RawData, SizeInBytes);
+		Fingerprint.Resolution = Pair.Value->GetSize();
+		Fingerprint.SizeInBytes = SizeInBytes;
+
+		const bool bIsDuplicate = bSkipDuplicateFrames && !bHasCompositePass && Track.bHasLastWritten && Track.LastWritten == Fingerprint;
+		if (bIsDuplicate)
+		{
+			Track.HeldFrameCounts.Last()++;
+			DuplicatePasses.Add(Pair.Key);
+			continue;
+		}
+
+		Track.LastWritten = Fingerprint;
+		Track.bHasLastWritten = true;
+		Track.HeldFrameCounts.Add(1);
+	}
+
+	for (const FMoviePipelinePassIdentifier& PassIdentifier : DuplicatePasses)
+	{
+		InMergedOutputFrame->ImageOutputData.Remove(PassIdentifier);
+	}
+	SkippedFrameCount += DuplicatePasses.Num();
+
+	if (InMergedOutputFrame->ImageOutputData.Num() > 0)
+	{
+		Super::OnReceiveImageDataImpl(InMergedOutputFrame);
+	}
+}
+
+void UMoviePipelineDedupImageSequenceOutput_PNG::BeginFinalizeImpl()
+{
+	Super::BeginFinalizeImpl();
+
+	UE_LOG(LogMovieRenderPipelineIO, Log, TEXT("Skipped writing %d duplicate frame(s) across all render passes."), SkippedFrameCount);
+}
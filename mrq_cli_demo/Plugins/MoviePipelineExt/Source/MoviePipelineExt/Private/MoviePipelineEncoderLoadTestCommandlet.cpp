@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineEncoderLoadTestCommandlet.h"
+#include "MoviePipelineCustomEncoder.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+
+namespace
+{
+	/** One frame of a render at 60 fps, the rate OnTick runs at while rendering. */
+	constexpr float TickIntervalSeconds = 1.f / 60.f;
+	/** A run that takes longer than this is stuck, whatever the script says. */
+	constexpr double RoundTimeoutSeconds = 600.0;
+
+	struct FRoundResult
+	{
+		int32 EncoderCount = 0;
+		int32 TickCount = 0;
+		TArray<double> TickSeconds;
+		double CancelLatencySeconds = -1.0;
+		int32 CompleteEncodes = 0;
+		int32 FailedEncodes = 0;
+		int32 LeftoverFiles = 0;
+		int32 LeftoverProcesses = 0;
+		bool bTimedOut = false;
+	};
+
+	double GetPercentile(TArray<double> InValues, const double InPercentile)
+	{
+		if (InValues.Num() == 0)
+		{
+			return 0.0;
+		}
+		InValues.Sort();
+		return InValues[FMath::Clamp(FMath::CeilToInt32(InPercentile * InValues.Num()) - 1, 0, InValues.Num() - 1)];
+	}
+
+	FRoundResult RunRound(const FString& InExecutable, const FString& InWorkDir, const int32 InEncoderCount, const int32 InFrameCount, const FString& InFakeOptions, const double InCancelAfterSeconds)
+	{
+		FRoundResult Result;
+		Result.EncoderCount = InEncoderCount;
+
+		UMoviePipelineCustomEncoder* Encoder = NewObject<UMoviePipelineCustomEncoder>(GetTransientPackage());
+		Encoder->AddToRoot();
+
+		Encoder->OnEncodeProgress().AddLambda([&Result](const FMoviePipelineEncodeProgress& InProgress)
+		{
+			if (!InProgress.bFinished)
+			{
+				return;
+			}
+			if (InProgress.ExitCode == 0 && InProgress.FramesDone >= InProgress.FramesTotal)
+			{
+				Result.CompleteEncodes++;
+			}
+			else
+			{
+				Result.FailedEncodes++;
+			}
+		});
+
+		// Every encode reads its own concat list. The list and a stand-in source frame are the files it has to clean up.
+		const FString RoundDir = InWorkDir / FString::Printf(TEXT("Round%d"), InEncoderCount);
+		IFileManager::Get().MakeDirectory(*RoundDir, true);
+		TArray<FString> AllInputFiles;
+		TArray<uint32> ProcessIds;
+		for (int32 Index = 0; Index < InEncoderCount; Index++)
+		{
+			const FString FramePath = RoundDir / FString::Printf(TEXT("frame_%03d.png"), Index);
+			const FString ListPath = RoundDir / FString::Printf(TEXT("input_%03d.txt"), Index);
+			const FString OutputPath = RoundDir / FString::Printf(TEXT("output_%03d.mp4"), Index);
+			FFileHelper::SaveStringToFile(TEXT("fake"), *FramePath);
+
+			TStringBuilder<4096> ListBuilder;
+			for (int32 Frame = 0; Frame < InFrameCount; Frame++)
+			{
+				ListBuilder.Appendf(TEXT("file 'file:%s'%s"), *FramePath, LINE_TERMINATOR);
+			}
+			FFileHelper::SaveStringToFile(ListBuilder.ToView(), *ListPath);
+
+			const FString Arguments = FString::Printf(TEXT("-hide_banner -y -f concat -safe 0 -i \"%s\" -r 24 -fake \"%s\" \"%s\""), *ListPath, *InFakeOptions, *OutputPath);
+			TArray<FString> FilesToDelete = { ListPath, FramePath };
+			const uint32 ProcessId = Encoder->LaunchUnmanagedProcess(InExecutable, Arguments, InFrameCount, MoveTemp(FilesToDelete));
+			if (ProcessId == 0)
+			{
+				UE_LOG(LogTemp, Error, TEXT("%s: Failed to start %s."), ANSI_TO_TCHAR(__FUNCTION__), *InExecutable);
+				Result.FailedEncodes++;
+				continue;
+			}
+			ProcessIds.Add(ProcessId);
+			AllInputFiles.Add(ListPath);
+			AllInputFiles.Add(FramePath);
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		double CancelTime = -1.0;
+		for (;;)
+		{
+			const double Now = FPlatformTime::Seconds();
+			if (InCancelAfterSeconds >= 0.0 && CancelTime < 0.0 && Now - StartTime >= InCancelAfterSeconds)
+			{
+				Encoder->CancelEncodes();
+				CancelTime = Now;
+			}
+
+			const double TickStart = FPlatformTime::Seconds();
+			const bool bFinished = Encoder->HasFinishedExportingImpl();
+			Result.TickSeconds.Add(FPlatformTime::Seconds() - TickStart);
+			Result.TickCount++;
+
+			if (bFinished)
+			{
+				if (CancelTime >= 0.0)
+				{
+					Result.CancelLatencySeconds = FPlatformTime::Seconds() - CancelTime;
+				}
+				break;
+			}
+			if (Now - StartTime > RoundTimeoutSeconds)
+			{
+				Result.bTimedOut = true;
+				Encoder->CancelEncodes();
+				while (!Encoder->HasFinishedExportingImpl())
+				{
+					FPlatformProcess::Sleep(TickIntervalSeconds);
+				}
+				break;
+			}
+			FPlatformProcess::Sleep(TickIntervalSeconds);
+		}
+
+		for (const FString& InputFile : AllInputFiles)
+		{
+			Result.LeftoverFiles += IFileManager::Get().FileExists(*InputFile) ? 1 : 0;
+		}
+		for (const uint32 ProcessId : ProcessIds)
+		{
+			Result.LeftoverProcesses += FPlatformProcess::IsApplicationRunning(ProcessId) ? 1 : 0;
+		}
+
+		Encoder->RemoveFromRoot();
+		IFileManager::Get().DeleteDirectory(*RoundDir, false, true);
+		return Result;
+	}
+}
+
+UMoviePipelineEncoderLoadTestCommandlet::UMoviePipelineEncoderLoadTestCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UMoviePipelineEncoderLoadTestCommandlet::Main(const FString& Params)
+{
+	FString Executable;
+	FParse::Value(*Params, TEXT("-FakeEncoder="), Executable);
+	if (Executable.IsEmpty() || !FPaths::FileExists(Executable))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=MoviePipelineEncoderLoadTest -FakeEncoder=<executable> [-Counts=1,10,100] [-Frames=600] [-Fake=\"<options>\"] [-CancelAfter=<seconds>] [-WorkDir=<dir>]"));
+		return 1;
+	}
+
+	FString CountsText = TEXT("1,10,100");
+	FParse::Value(*Params, TEXT("-Counts="), CountsText);
+	TArray<FString> CountTexts;
+	CountsText.ParseIntoArray(CountTexts, TEXT(","));
+
+	int32 FrameCount = 600;
+	FParse::Value(*Params, TEXT("-Frames="), FrameCount);
+	FrameCount = FMath::Max(FrameCount, 1);
+
+	FString FakeOptions = TEXT("fps=240 update_frames=10");
+	FParse::Value(*Params, TEXT("-Fake="), FakeOptions, false);
+
+	double CancelAfterSeconds = -1.0;
+	FParse::Value(*Params, TEXT("-CancelAfter="), CancelAfterSeconds);
+
+	FString WorkDir = FPaths::ProjectSavedDir() / TEXT("EncoderLoadTest");
+	FParse::Value(*Params, TEXT("-WorkDir="), WorkDir);
+	WorkDir = FPaths::ConvertRelativePathToFull(WorkDir);
+
+	bool bAllClean = true;
+	for (const FString& CountText : CountTexts)
+	{
+		const int32 EncoderCount = FMath::Clamp(FCString::Atoi(*CountText), 1, 100);
+		const FRoundResult Result = RunRound(Executable, WorkDir, EncoderCount, FrameCount, FakeOptions, CancelAfterSeconds);
+
+		double TotalTickSeconds = 0.0;
+		for (const double Seconds : Result.TickSeconds)
+		{
+			TotalTickSeconds += Seconds;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("%d encoder(s): %d tick(s), OnTick %.3f ms average, %.3f ms p99, %.3f ms max, %.3f ms per encoder per tick."),
+			Result.EncoderCount, Result.TickCount, TotalTickSeconds * 1000.0 / FMath::Max(Result.TickCount, 1), GetPercentile(Result.TickSeconds, 0.99) * 1000.0,
+			GetPercentile(Result.TickSeconds, 1.0) * 1000.0, TotalTickSeconds * 1000.0 / FMath::Max(Result.TickCount * Result.EncoderCount, 1));
+		UE_LOG(LogTemp, Display, TEXT("%d encoder(s): %d complete, %d failed or canceled, cancel settled after %s, %d input file(s) and %d process(es) left behind%s."),
+			Result.EncoderCount, Result.CompleteEncodes, Result.FailedEncodes,
+			Result.CancelLatencySeconds >= 0.0 ? *FString::Printf(TEXT("%.3f s"), Result.CancelLatencySeconds) : TEXT("-"),
+			Result.LeftoverFiles, Result.LeftoverProcesses, Result.bTimedOut ? TEXT(", timed out") : TEXT(""));
+
+		bAllClean &= Result.LeftoverFiles == 0 && Result.LeftoverProcesses == 0 && !Result.bTimedOut;
+	}
+
+	return bAllClean ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineEtaEstimator.h"
+
+namespace
+{
+	/** Rates are sampled over at least this long, per-frame deltas are too noisy to average. */
+	constexpr double MinSampleSeconds = 1.0;
+
+	/** How quickly the average follows a new rate. After this long a change is ~63% reflected. */
+	constexpr double RateTimeConstantSeconds = 15.0;
+}
+
+void FMoviePipelineEtaEstimator::FRate::Update(const int32 InFrames, const double InNowSeconds, const bool bInActive)
+{
+	// Start a new sample when idle, before the first frame, or when the count went back (a restarted process).
+	if (!bInActive || InFrames <= 0 || SampleStartSeconds < 0.0 || InFrames < SampleFrames)
+	{
+		Frames = InFrames;
+		SampleFrames = InFrames;
+		SampleStartSeconds = bInActive ? InNowSeconds : -1.0;
+		return;
+	}
+
+	Frames = InFrames;
+	const double SampleSeconds = InNowSeconds - SampleStartSeconds;
+	if (SampleSeconds < MinSampleSeconds)
+	{
+		return;
+	}
+
+	// Weight by sample length so irregular update intervals average the same way.
+	const double SampleFps = (InFrames - SampleFrames) / SampleSeconds;
+	const double Alpha = 1.0 - FMath::Exp(-SampleSeconds / RateTimeConstantSeconds);
+	Fps = Fps < 0.0 ? SampleFps : Fps + Alpha * (SampleFps - Fps);
+
+	SampleFrames = InFrames;
+	SampleStartSeconds = InNowSeconds;
+}
+
+void FMoviePipelineEtaEstimator::Reset(const int32 InTotalOutputFrames)
+{
+	RenderRate = FRate();
+	EncodeRate = FRate();
+	SetTotalOutputFrames(InTotalOutputFrames);
+}
+
+double FMoviePipelineEtaEstimator::GetEffectiveEncodeFps() const
+{
+	return EncodeRate.Fps > 0.0 ? EncodeRate.Fps : EncodeFpsHint;
+}
+
+double FMoviePipelineEtaEstimator::GetRenderRemainingSeconds() const
+{
+	const int32 RemainingFrames = TotalOutputFrames - RenderRate.Frames;
+	if (RemainingFrames <= 0)
+	{
+		return 0.0;
+	}
+
+	return RenderRate.Fps > 0.0 ? RemainingFrames / RenderRate.Fps : -1.0;
+}
+
+double FMoviePipelineEtaEstimator::GetEncodeRemainingSeconds() const
+{
+	const int32 RemainingFrames = TotalOutputFrames - EncodeRate.Frames;
+	if (RemainingFrames <= 0)
+	{
+		return 0.0;
+	}
+
+	const double EncodeFps = GetEffectiveEncodeFps();
+	return EncodeFps > 0.0 ? RemainingFrames / EncodeFps : -1.0;
+}
+
+double FMoviePipelineEtaEstimator::GetRemainingSeconds() const
+{
+	if (TotalOutputFrames <= 0)
+	{
+		return -1.0;
+	}
+
+	const double RenderSeconds = GetRenderRemainingSeconds();
+	if (RenderSeconds < 0.0)
+	{
+		return -1.0;
+	}
+
+	// Without any encode rate yet, the render time is the best lower bound there is.
+	const double EncodeSeconds = GetEncodeRemainingSeconds();
+	if (EncodeSeconds < 0.0)
+	{
+		return RenderSeconds + UploadSeconds;
+	}
+
+	// Overlapping encodes can't finish before the last frame is rendered, nor faster than their own throughput.
+	const double WorkSeconds = bEncodeOverlapsRender ? FMath::Max(RenderSeconds, EncodeSeconds) : RenderSeconds + EncodeSeconds;
+	return WorkSeconds + UploadSeconds;
+}
@@ -0,0 +1,267 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineHlsPreview.h"
+#include "MovieRenderPipelineCoreModule.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+
+namespace
+{
+	/** How long the destructor waits for the last segment before giving up on it. */
+	constexpr double ShutdownWaitSeconds = 10.0;
+
+	/** Encoder output kept for the warning when a segment fails. */
+	constexpr int32 MaxKeptOutputChars = 4096;
+}
+
+FMoviePipelineHlsPreview::FMoviePipelineHlsPreview(const FSettings& InSettings)
+	: Settings(InSettings)
+{
+	// scale=-2:h needs an even height for yuv420p.
+	Settings.Height = FMath::Max(Settings.Height & ~1, 2);
+	Settings.BitrateKbps = FMath::Max(Settings.BitrateKbps, 50);
+	SegmentFrameCount = FMath::Max(FMath::RoundToInt32(Settings.SegmentSeconds * Settings.FrameRate.AsDecimal()), 1);
+
+	// A preview left behind by an earlier attempt of the job describes frames that may no longer exist.
+	const bool bRequireExists = false;
+	const bool bTree = true;
+	IFileManager::Get().DeleteDirectory(*Settings.OutputDirectory, bRequireExists, bTree);
+	IFileManager::Get().MakeDirectory(*Settings.OutputDirectory, bTree);
+}
+
+FMoviePipelineHlsPreview::~FMoviePipelineHlsPreview()
+{
+	Finish();
+
+	const double DeadlineSeconds = FPlatformTime::Seconds() + ShutdownWaitSeconds;
+	while (!bPlaylistClosed && FPlatformTime::Seconds() < DeadlineSeconds)
+	{
+		Tick();
+		FPlatformProcess::Sleep(0.05f);
+	}
+
+	if (ProcessHandle.IsValid())
+	{
+		const bool bKillTree = true;
+		FPlatformProcess::TerminateProc(ProcessHandle, bKillTree);
+		FPlatformProcess::CloseProc(ProcessHandle);
+		ProcessHandle.Reset();
+		ClosePipes();
+		IFileManager::Get().Delete(*RunningListPath, false, false, true);
+	}
+
+	if (!bPlaylistClosed)
+	{
+		bPlaylistClosed = true;
+		WritePlaylist();
+	}
+
+	// Nothing reads the frames anymore, whether their segments made it or not.
+	for (const FString& FilePath : FilePathsToDelete)
+	{
+		IFileManager::Get().Delete(*FilePath, false, false, true);
+	}
+}
+
+void FMoviePipelineHlsPreview::AddFrame(const FString& InFilePath, const int32 InHeldFrameCount)
+{
+	if (bFinishing || InHeldFrameCount <= 0)
+	{
+		return;
+	}
+
+	QueuedFrames.Add({ InFilePath, InHeldFrameCount });
+	QueuedFrameCount += InHeldFrameCount;
+	UnreadFilePaths.Add(InFilePath);
+}
+
+bool FMoviePipelineHlsPreview::TakeOverDeletion(const FString& InFilePath)
+{
+	if (bPlaylistClosed || !UnreadFilePaths.Contains(InFilePath))
+	{
+		return false;
+	}
+
+	FilePathsToDelete.Add(InFilePath);
+	return true;
+}
+
+void FMoviePipelineHlsPreview::Tick()
+{
+	if (bPlaylistClosed)
+	{
+		return;
+	}
+
+	if (ProcessHandle.IsValid())
+	{
+		RunningOutput += FPlatformProcess::ReadPipe(ReadPipe);
+		if (RunningOutput.Len() > MaxKeptOutputChars)
+		{
+			RunningOutput.RightInline(MaxKeptOutputChars);
+		}
+
+		if (FPlatformProcess::IsProcRunning(ProcessHandle))
+		{
+			return;
+		}
+
+		int32 ReturnCode = -1;
+		FPlatformProcess::GetProcReturnCode(ProcessHandle, &ReturnCode);
+		RunningOutput += FPlatformProcess::ReadPipe(ReadPipe);
+		FPlatformProcess::CloseProc(ProcessHandle);
+		ProcessHandle.Reset();
+		ClosePipes();
+		OnSegmentExited(ReturnCode);
+	}
+
+	if (QueuedFrameCount >= SegmentFrameCount || (bFinishing && QueuedFrameCount > 0))
+	{
+		LaunchSegment();
+	}
+	else if (bFinishing)
+	{
+		bPlaylistClosed = true;
+		WritePlaylist();
+	}
+}
+
+void FMoviePipelineHlsPreview::LaunchSegment()
+{
+	// Take one segment's worth of frames off the queue. A held frame straddling the cut is split between two segments.
+	const double FrameDuration = Settings.FrameRate.AsInterval();
+	TStringBuilder<1024> ListBuilder;
+	int32 FrameCount = 0;
+	RunningFilePaths.Reset();
+	while (QueuedFrames.Num() > 0 && FrameCount < SegmentFrameCount)
+	{
+		FQueuedFrame& Frame = QueuedFrames[0];
+		const int32 TakenFrameCount = FMath::Min(Frame.HeldFrameCount, SegmentFrameCount - FrameCount);
+		const bool bIsLastEntry = FrameCount + TakenFrameCount == SegmentFrameCount || QueuedFrames.Num() == 1;
+
+		// The concat demuxer ignores the duration of the very last entry, so it is listed once more for its final frame.
+		const int32 ListedFrameCount = (bIsLastEntry && TakenFrameCount > 1) ? TakenFrameCount - 1 : TakenFrameCount;
+		ListBuilder.Appendf(TEXT("file 'file:%s'%sduration %f%s"), *Frame.FilePath, LINE_TERMINATOR, FrameDuration * ListedFrameCount, LINE_TERMINATOR);
+		if (ListedFrameCount != TakenFrameCount)
+		{
+			ListBuilder.Appendf(TEXT("file 'file:%s'%sduration %f%s"), *Frame.FilePath, LINE_TERMINATOR, FrameDuration, LINE_TERMINATOR);
+		}
+
+		RunningFilePaths.Add(Frame.FilePath);
+		FrameCount += TakenFrameCount;
+		Frame.HeldFrameCount -= TakenFrameCount;
+		if (Frame.HeldFrameCount == 0)
+		{
+			QueuedFrames.RemoveAt(0);
+		}
+	}
+	QueuedFrameCount -= FrameCount;
+
+	RunningSegment = FSegment();
+	RunningSegment.FileName = FString::Printf(TEXT("segment_%05d.ts"), NextSegmentIndex);
+	RunningSegment.DurationSeconds = FrameCount * FrameDuration;
+	RunningSegment.bDiscontinuity = bSkippedSegment;
+	RunningFrameCount = FrameCount;
+	RunningListPath = Settings.OutputDirectory / FString::Printf(TEXT("segment_%05d.txt"), NextSegmentIndex);
+	RunningOutput.Reset();
+	NextSegmentIndex++;
+	FFileHelper::SaveStringToFile(ListBuilder.ToView(), *RunningListPath);
+
+	// Timestamps continue from the previous segment so players can treat the segments as one stream.
+	const FString CommandLineArgs = FString::Printf(
+		TEXT("-hide_banner -nostdin -loglevel error -y -f concat -safe 0 -i \"%s\" -an -vf \"scale=-2:%d,format=yuv420p\" -r %d/%d -fps_mode cfr -frames:v %d ")
+		TEXT("-c:v libx264 -preset veryfast -tune zerolatency -b:v %dk -maxrate %dk -bufsize %dk -g %d -output_ts_offset %f -f mpegts \"%s\""),
+		*RunningListPath, Settings.Height, Settings.FrameRate.Numerator, Settings.FrameRate.Denominator, FrameCount,
+		Settings.BitrateKbps, Settings.BitrateKbps, Settings.BitrateKbps * 2, SegmentFrameCount, EncodedFrameCount * FrameDuration,
+		*(Settings.OutputDirectory / RunningSegment.FileName));
+
+	const bool bLaunchDetached = false;
+	const bool bLaunchHidden = true;
+	const bool bLaunchReallyHidden = bLaunchHidden;
+	const int32 PriorityModifier = -1; // The preview must never slow down the render or the real encode.
+
+	verify(FPlatformProcess::CreatePipe(ReadPipe, WritePipe));
+	ProcessHandle = FPlatformProcess::CreateProc(*Settings.ExecutablePath, *CommandLineArgs, bLaunchDetached, bLaunchHidden, bLaunchReallyHidden, nullptr, PriorityModifier, nullptr, WritePipe, ReadPipe);
+	if (!ProcessHandle.IsValid())
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to launch the preview encoder '%s'."), *Settings.ExecutablePath);
+		ClosePipes();
+		OnSegmentExited(-1);
+	}
+}
+
+void FMoviePipelineHlsPreview::OnSegmentExited(const int32 InReturnCode)
+{
+	IFileManager::Get().Delete(*RunningListPath, false, false, true);
+	EncodedFrameCount += RunningFrameCount;
+	DeleteReadFrames();
+
+	const FString SegmentPath = Settings.OutputDirectory / RunningSegment.FileName;
+	if (InReturnCode != 0 || IFileManager::Get().FileSize(*SegmentPath) <= 0)
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Preview segment %s failed with code %d, leaving it out. %s"), *RunningSegment.FileName, InReturnCode, *RunningOutput.TrimStartAndEnd());
+		IFileManager::Get().Delete(*SegmentPath, false, false, true);
+		bSkippedSegment = true;
+		return;
+	}
+
+	bSkippedSegment = false;
+	Segments.Add(RunningSegment);
+	WritePlaylist();
+}
+
+void FMoviePipelineHlsPreview::DeleteReadFrames()
+{
+	for (const FString& FilePath : RunningFilePaths)
+	{
+		// A held frame split at the end of the segment is still at the front of the queue for the next one.
+		if (QueuedFrames.Num() > 0 && QueuedFrames[0].FilePath == FilePath)
+		{
+			continue;
+		}
+
+		UnreadFilePaths.Remove(FilePath);
+		if (FilePathsToDelete.Remove(FilePath) > 0)
+		{
+			IFileManager::Get().Delete(*FilePath, false, false, true);
+		}
+	}
+	RunningFilePaths.Reset();
+}
+
+void FMoviePipelineHlsPreview::WritePlaylist() const
+{
+	TStringBuilder<2048> PlaylistBuilder;
+	PlaylistBuilder.Append(TEXT("#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-PLAYLIST-TYPE:EVENT\n"));
+	PlaylistBuilder.Appendf(TEXT("#EXT-X-TARGETDURATION:%d\n#EXT-X-MEDIA-SEQUENCE:0\n"), FMath::CeilToInt32(SegmentFrameCount * Settings.FrameRate.AsInterval()));
+	for (const FSegment& Segment : Segments)
+	{
+		if (Segment.bDiscontinuity)
+		{
+			PlaylistBuilder.Append(TEXT("#EXT-X-DISCONTINUITY\n"));
+		}
+		PlaylistBuilder.Appendf(TEXT("#EXTINF:%.3f,\n%s\n"), Segment.DurationSeconds, *Segment.FileName);
+	}
+	if (bPlaylistClosed)
+	{
+		PlaylistBuilder.Append(TEXT("#EXT-X-ENDLIST\n"));
+	}
+
+	// Written aside and moved over the old one, so a player polling the playlist never reads half of it.
+	const FString PlaylistPath = GetPlaylistPath();
+	const FString TempPath = PlaylistPath + TEXT(".tmp");
+	const bool bReplace = true;
+	if (!FFileHelper::SaveStringToFile(PlaylistBuilder.ToView(), *TempPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM)
+		|| !IFileManager::Get().Move(*PlaylistPath, *TempPath, bReplace))
+	{
+		UE_LOG(LogMovieRenderPipelineIO, Warning, TEXT("Failed to write the preview playlist %s."), *PlaylistPath);
+	}
+}
+
+void FMoviePipelineHlsPreview::ClosePipes()
+{
+	FPlatformProcess::ClosePipe(ReadPipe, WritePipe);
+	ReadPipe = nullptr;
+	WritePipe = nullptr;
+}
@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineLogSink.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	/** Buffered text is written out early once it grows past this, regardless of the tick rate. */
+	constexpr int32 MaxPendingChars = 64 * 1024;
+
+	bool ContainsAny(const FString& InLine, std::initializer_list<const TCHAR*> InTokens)
+	{
+		for (const TCHAR* Token : InTokens)
+		{
+			if (InLine.Contains(Token, ESearchCase::IgnoreCase))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool FMoviePipelineLogRateLimiter::Allow(const FName InCategory, int32& OutSuppressedCount)
+{
+	OutSuppressedCount = 0;
+
+	const double NowSeconds = FPlatformTime::Seconds();
+	FWindow& Window = Windows.FindOrAdd(InCategory);
+	if (Window.StartSeconds < 0.0 || NowSeconds - Window.StartSeconds >= 1.0)
+	{
+		Window.StartSeconds = NowSeconds;
+		Window.Count = 0;
+	}
+
+	if (Window.Count >= MaxPerSecond)
+	{
+		Window.Suppressed++;
+		return false;
+	}
+
+	Window.Count++;
+	OutSuppressedCount = Window.Suppressed;
+	Window.Suppressed = 0;
+	return true;
+}
+
+FMoviePipelineLogSink::FMoviePipelineLogSink(const FString& InFilePath)
+	: FilePath(InFilePath)
+	, StartSeconds(FPlatformTime::Seconds())
+{
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
+}
+
+FMoviePipelineLogSink::~FMoviePipelineLogSink()
+{
+	const bool bWait = true;
+	Flush(bWait);
+}
+
+void FMoviePipelineLogSink::Write(const FString& InLine)
+{
+	PendingText.Appendf(TEXT("[%9.3f] %s%s"), FPlatformTime::Seconds() - StartSeconds, *InLine, LINE_TERMINATOR);
+	if (PendingText.Len() >= MaxPendingChars)
+	{
+		const bool bWait = false;
+		Flush(bWait);
+	}
+}
+
+void FMoviePipelineLogSink::Flush(const bool bWait)
+{
+	if (WriteTask.IsValid() && !WriteTask.IsCompleted())
+	{
+		if (!bWait)
+		{
+			return;
+		}
+		WriteTask.Wait();
+	}
+
+	if (PendingText.Len() > 0)
+	{
+		WriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[Text = FString(PendingText.ToView()), Path = FilePath]()
+			{
+				FFileHelper::SaveStringToFile(Text, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+			},
+			UE::Tasks::ETaskPriority::BackgroundNormal);
+		PendingText.Reset();
+	}
+
+	if (bWait && WriteTask.IsValid())
+	{
+		WriteTask.Wait();
+	}
+}
+
+ELogVerbosity::Type FMoviePipelineLogSink::ClassifyEncoderLine(const FString& InLine)
+{
+	// "frame=  120 fps= 58 q=28.0 size=  512KiB time=00:00:04.00 bitrate=1048.6kbits/s speed=1.93x"
+	if (InLine.Contains(TEXT("frame="), ESearchCase::IgnoreCase) && InLine.Contains(TEXT("fps="), ESearchCase::IgnoreCase))
+	{
+		return ELogVerbosity::Verbose;
+	}
+
+	// Decoders recovering from damaged input and notices about options only sound bad, the output is still written.
+	if (ContainsAny(InLine, { TEXT("concealing"), TEXT("concealment"), TEXT("deprecated"), TEXT("Past duration"), TEXT("warning") }))
+	{
+		return ELogVerbosity::Warning;
+	}
+
+	if (ContainsAny(InLine, { TEXT("error"), TEXT("failed"), TEXT("invalid"), TEXT("No such file"), TEXT("could not"), TEXT("cannot"),
+		TEXT("unable to"), TEXT("not found"), TEXT("Permission denied"), TEXT("Unknown encoder"), TEXT("Unrecognized option") }))
+	{
+		return ELogVerbosity::Error;
+	}
+
+	return ELogVerbosity::Log;
+}
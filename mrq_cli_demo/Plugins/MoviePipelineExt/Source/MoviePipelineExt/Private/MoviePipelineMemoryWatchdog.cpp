@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineMemoryWatchdog.h"
+#include "HAL/PlatformTime.h"
+#include "RenderingThread.h"
+#include "RenderTargetPool.h"
+#include "RHI.h"
+#include "UObject/UObjectGlobals.h"
+
+FMoviePipelineMemoryWatchdog::FMoviePipelineMemoryWatchdog()
+	: RenderTargetPoolBytes(MakeShared<std::atomic<uint64>, ESPMode::ThreadSafe>(0))
+{
+}
+
+void FMoviePipelineMemoryWatchdog::Configure(const FSettings& InSettings)
+{
+	Settings = InSettings;
+	Settings.SampleIntervalFrames = FMath::Max(Settings.SampleIntervalFrames, 1);
+	FramesSinceSample = 0;
+}
+
+void FMoviePipelineMemoryWatchdog::Tick()
+{
+	if (FramesSinceSample++ % Settings.SampleIntervalFrames == 0)
+	{
+		Sample();
+	}
+}
+
+void FMoviePipelineMemoryWatchdog::OnShotBoundary()
+{
+	if (IsOverThreshold())
+	{
+		Trim();
+	}
+}
+
+bool FMoviePipelineMemoryWatchdog::IsOverThreshold() const
+{
+	return (Settings.ProcessThresholdMB > 0.0 && GetProcessMB() > Settings.ProcessThresholdMB)
+		|| (Settings.GpuThresholdMB > 0.0 && GetGpuMB() > Settings.GpuThresholdMB);
+}
+
+void FMoviePipelineMemoryWatchdog::Sample()
+{
+	ProcessBytes = FPlatformMemory::GetStats().UsedPhysical;
+	PeakProcessBytes = FMath::Max(PeakProcessBytes, ProcessBytes);
+
+	FTextureMemoryStats TextureMemoryStats;
+	RHIGetTextureMemoryStats(TextureMemoryStats);
+	const int64 TextureBytes = FMath::Max<int64>(TextureMemoryStats.StreamingMemorySize + TextureMemoryStats.NonStreamingMemorySize, 0);
+	GpuBytes = static_cast<uint64>(TextureBytes) + RenderTargetPoolBytes->load();
+	PeakGpuBytes = FMath::Max(PeakGpuBytes, GpuBytes);
+
+	RequestRenderTargetPoolSize();
+}
+
+void FMoviePipelineMemoryWatchdog::RequestRenderTargetPoolSize()
+{
+	ENQUEUE_RENDER_COMMAND(MoviePipelineSampleRenderTargetPool)([PoolBytes = RenderTargetPoolBytes](FRHICommandListImmediate&)
+	{
+		uint32 WholeCount = 0;
+		uint32 WholePoolKB = 0;
+		uint32 UsedKB = 0;
+		GRenderTargetPool.GetStats(WholeCount, WholePoolKB, UsedKB);
+		PoolBytes->store(static_cast<uint64>(WholePoolKB) * 1024);
+	});
+}
+
+void FMoviePipelineMemoryWatchdog::Trim()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const uint64 ProcessBytesBefore = ProcessBytes;
+	const uint64 GpuBytesBefore = GpuBytes;
+
+	// Spawnables of finished shots and whatever they kept alive, then the targets nothing renders into any more.
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS, true);
+	ENQUEUE_RENDER_COMMAND(MoviePipelineTrimRenderTargetPool)([](FRHICommandListImmediate&)
+	{
+		GRenderTargetPool.FreeUnusedResources();
+	});
+	RequestRenderTargetPoolSize();
+	FlushRenderingCommands();
+	GMalloc->Trim(true);
+
+	// The flush ran the pool read, so this sample sees the trimmed pool rather than the one of the last sample.
+	Sample();
+
+	TrimCount++;
+	const int64 FreedBytes = static_cast<int64>(ProcessBytesBefore + GpuBytesBefore) - static_cast<int64>(ProcessBytes + GpuBytes);
+	TrimmedBytes += FMath::Max<int64>(FreedBytes, 0);
+	UE_LOG(LogTemp, Log, TEXT("%s: Trimmed memory at a shot boundary in %.2f s: process %.0f -> %.0f MB, GPU %.0f -> %.0f MB."), ANSI_TO_TCHAR(__FUNCTION__),
+		FPlatformTime::Seconds() - StartTime, ProcessBytesBefore / (1024.0 * 1024.0), GetProcessMB(), GpuBytesBefore / (1024.0 * 1024.0), GetGpuMB());
+}
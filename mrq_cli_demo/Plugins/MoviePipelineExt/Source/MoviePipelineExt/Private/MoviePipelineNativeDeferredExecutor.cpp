@@ -9,13 +9,30 @@
 #include "MoviePipelineCustomEncoder.h"
 #include "LevelSequence.h"
 #include "MoviePipelineDeferredPasses.h"
-#include "MoviePipelineImageSequenceOutput.h"
+#include "MoviePipelineDedupImageSequenceOutput.h"
 #include "MoviePipelineGameOverrideSetting.h"
+#include "MoviePipelineAntiAliasingSetting.h"
+#include "MoviePipelineCommandLineEncoderSettings.h"
+#include "MoviePipelinePrimaryConfig.h"
+#include "MoviePipelineShaderWarmUpManifest.h"
+#include "Materials/MaterialInterface.h"
+#include "MaterialShared.h"
 #include "ShaderCompiler.h"
 #include "HAL/IConsoleManager.h"
-#include "Misc/DefaultValueHelper.h"
 #include "HttpModule.h"
 #include "HttpManager.h"
+#include "MovieScene.h"
+#include "MovieSceneTimeHelpers.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformOutputDevices.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/PackageName.h"
+#include "Misc/SecureHash.h"
+#include "Modules/ModuleManager.h"
+#include "Engine/Level.h"
 
 #define LOCTEXT_NAMESPACE "MoviePipelineExecutorExt"
 
@@ -57,6 +74,67 @@ void UMoviePipelineNativeDeferredExecutor::InitFromCommandLineParams()
     }
 
 	FParse::Value(FCommandLine::Get(), TEXT("-MRQServerBaseUrl="), MRQServerBaseUrl);
+	bResumeRender = FParse::Param(FCommandLine::Get(), TEXT("ResumeRender"));
+
+	FParse::Value(FCommandLine::Get(), TEXT("-RenderChunk="), RenderChunkIndex);
+	FParse::Value(FCommandLine::Get(), TEXT("-RenderChunkCount="), RenderChunkCount);
+	FParse::Value(FCommandLine::Get(), TEXT("-ChunkWarmUpFrames="), ChunkWarmUpFrameCount);
+
+	int32 RangeValue = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-FrameRangeStart="), RangeValue))
+	{
+		RequestedRangeStart = RangeValue;
+	}
+	if (FParse::Value(FCommandLine::Get(), TEXT("-FrameRangeEnd="), RangeValue))
+	{
+		RequestedRangeEnd = RangeValue;
+	}
+
+	int32 OverrideValue = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-SpatialSamples="), OverrideValue))
+	{
+		SpatialSampleCount = FMath::Max(OverrideValue, 1);
+	}
+	if (FParse::Value(FCommandLine::Get(), TEXT("-TemporalSamples="), OverrideValue))
+	{
+		TemporalSampleCount = FMath::Max(OverrideValue, 1);
+	}
+	if (FParse::Value(FCommandLine::Get(), TEXT("-WarmUpFrames="), OverrideValue))
+	{
+		WarmUpFrameCount = FMath::Max(OverrideValue, 0);
+	}
+	FParse::Value(FCommandLine::Get(), TEXT("-ResolutionScale="), ResolutionScale);
+	ResolutionScale = FMath::Clamp(ResolutionScale, 0.05f, 1.f);
+
+	FParse::Value(FCommandLine::Get(), TEXT("-FrameStride="), FrameStride);
+	FrameStride = FMath::Max(FrameStride, 1);
+	if (FrameStride > 1)
+	{
+		RenderFrameRate = FFrameRate(RenderFrameRate.Numerator, RenderFrameRate.Denominator * FrameStride);
+	}
+
+	FParse::Value(FCommandLine::Get(), TEXT("-MemoryWatchdogFrames="), MemoryWatchdogSettings.SampleIntervalFrames);
+	FParse::Value(FCommandLine::Get(), TEXT("-MemoryTrimThresholdMB="), MemoryWatchdogSettings.ProcessThresholdMB);
+	FParse::Value(FCommandLine::Get(), TEXT("-GpuMemoryTrimThresholdMB="), MemoryWatchdogSettings.GpuThresholdMB);
+
+	int32 PriorityValue = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-EncoderPriority="), PriorityValue))
+	{
+		EncoderPriority = FMath::Clamp(PriorityValue, -2, 2);
+	}
+	FParse::Value(FCommandLine::Get(), TEXT("-EncoderCpuAffinity="), EncoderCpuAffinity);
+	FParse::Value(FCommandLine::Get(), TEXT("-EncoderCpuQuota="), EncoderCpuQuota);
+	FParse::Value(FCommandLine::Get(), TEXT("-EncoderCgroup="), EncoderCgroup);
+	FParse::Value(FCommandLine::Get(), TEXT("-EncoderTargetSeconds="), EncoderTargetSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("-EncoderLogPath="), EncoderLogPath);
+	bFragmentedOutput = FParse::Param(FCommandLine::Get(), TEXT("FragmentedOutput"));
+	bPreviewHls = FParse::Param(FCommandLine::Get(), TEXT("PreviewHls"));
+	FParse::Value(FCommandLine::Get(), TEXT("-PreviewHeight="), PreviewHeight);
+	FParse::Value(FCommandLine::Get(), TEXT("-PreviewBitrateKbps="), PreviewBitrateKbps);
+	FParse::Value(FCommandLine::Get(), TEXT("-PreviewSegmentSeconds="), PreviewSegmentSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("-EncodeFpsHint="), EncodeFpsHint);
+	FParse::Value(FCommandLine::Get(), TEXT("-UploadEtaSeconds="), UploadEtaSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("-ShaderWarmUpManifest="), ShaderWarmUpManifestPath);
 }
 
 void UMoviePipelineNativeDeferredExecutor::CheckGameModeOverrides()
@@ -111,6 +189,17 @@ void UMoviePipelineNativeDeferredExecutor::Execute_Implementation(UMoviePipeline
 
 	MRQ_OutputSetting = Cast<UMoviePipelineOutputSetting>(PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineOutputSetting::StaticClass()));
     MRQ_CommandLineEncoder = Cast<UMoviePipelineCustomEncoder>(PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineCustomEncoder::StaticClass()));
+    MRQ_CommandLineEncoder->OnEncodeProgress().AddUObject(this, &UMoviePipelineNativeDeferredExecutor::OnEncodeProgress);
+    MRQ_CommandLineEncoder->OnShotSegmentEncoded().AddUObject(this, &UMoviePipelineNativeDeferredExecutor::AppendShotSegmentToManifest);
+    ResourceMonitor.SetChildProcessSampler([this](uint64& OutMemoryBytes, double& OutCpuSeconds)
+    {
+        MRQ_CommandLineEncoder->GetProcessUsage(OutMemoryBytes, OutCpuSeconds);
+    });
+    // The encoder deletes frames as it reads them, the preview may not have encoded them yet.
+    MRQ_CommandLineEncoder->SetSourceFrameReleaseHandler([this](const FString& InFilePath)
+    {
+        return HlsPreview && HlsPreview->TakeOverDeletion(InFilePath);
+    });
     MRQ_GameOverrideSetting = Cast<UMoviePipelineGameOverrideSetting>(PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineGameOverrideSetting::StaticClass()));
 
     ULevelSequence* LevelSequence = Cast<ULevelSequence>(PendingJob->Sequence.TryLoad());
@@ -152,9 +241,49 @@ void UMoviePipelineNativeDeferredExecutor::Execute_Implementation(UMoviePipeline
 
     MRQ_CommandLineEncoder->Quality = static_cast<EMoviePipelineEncodeQuality>(MovieQuality);
     MRQ_CommandLineEncoder->bDeleteSourceFiles = true;
+    if (EncoderPriority.IsSet())
+    {
+        MRQ_CommandLineEncoder->ProcessPriority = EncoderPriority.GetValue();
+    }
+    MRQ_CommandLineEncoder->CpuAffinity = EncoderCpuAffinity;
+    MRQ_CommandLineEncoder->CpuQuota = FMath::Max(EncoderCpuQuota, 0.f);
+    MRQ_CommandLineEncoder->Cgroup = EncoderCgroup;
+    MRQ_CommandLineEncoder->CgroupChildName = CurrentJobId;
+    MRQ_CommandLineEncoder->TargetEncodeSeconds = FMath::Max(EncoderTargetSeconds, 0.f);
+    if (EncoderLogPath.IsEmpty())
+    {
+        // The server passes ABSLOG=<DATA_ROOT>/jobs/<id>/logs/ue_<id>.log; the encoder log goes beside it.
+        EncoderLogPath = FPaths::GetPath(FPlatformOutputDevices::GetAbsoluteLogFilename()) / FString::Printf(TEXT("encoder_%s.log"), *CurrentJobId);
+    }
+    MRQ_CommandLineEncoder->LogFilePath = EncoderLogPath;
+    if (MovieFormat == TEXT("mp4") || MovieFormat == TEXT("mov"))
+    {
+        MRQ_CommandLineEncoder->OutputFileExtensionOverride = MovieFormat;
+    }
+    MRQ_CommandLineEncoder->bFragmentedOutput = bFragmentedOutput;
+    // Finished shots are encoded while later ones render, and a resumed render continues after the last finished one.
+    MRQ_CommandLineEncoder->bEncodeShotSegments = true;
+    // Extra render passes share one encoder process and one audio encode instead of one process each.
+    MRQ_CommandLineEncoder->bEncodeRenderPassesTogether = true;
+
+    // A chunk only produces frames. The server stitches all chunks into one video once every chunk is done.
+    const bool bIsRenderChunk = RenderChunkCount > 1 && RenderChunkIndex >= 0;
+    MRQ_CommandLineEncoder->SetIsEnabled(!bIsRenderChunk);
 
     PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineDeferredPassBase::StaticClass());
-    PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineImageSequenceOutput_PNG::StaticClass());
+    PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineDedupImageSequenceOutput_PNG::StaticClass());
+    ApplyRenderOverrides();
+
+    // Fingerprint the job before the range is narrowed for resume/warm-up, so every attempt of it maps to the same video.
+    if (MRQ_CommandLineEncoder->IsEnabled())
+    {
+        RenderFingerprint = ComputeRenderFingerprint(LevelSequence);
+    }
+
+    ResolveRenderRange(LevelSequence);
+    TryResumeFromFrameManifest(LevelSequence);
+    ApplyRenderRange();
+
     PendingJob->GetConfiguration()->InitializeTransientSettings();
 
     DeferredMoviePipeline = NewObject<UMoviePipeline>(World, UMoviePipeline::StaticClass());
@@ -165,8 +294,11 @@ void UMoviePipelineNativeDeferredExecutor::Execute_Implementation(UMoviePipeline
     FApp::SetFixedDeltaTime(RenderFrameRate.AsInterval());
 
 
+    VerifyShaderWarmUpManifest(LevelSequence);
     WaitShaderCompilingComplete();
 
+    RequestRenderCacheLookup();
+
     PollTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
         FTickerDelegate::CreateUObject(this, &UMoviePipelineNativeDeferredExecutor::PollReady),
         PollIntervalSec
@@ -191,92 +323,59 @@ void UMoviePipelineNativeDeferredExecutor::OnBeginFrame_Implementation()
 {
 	EMovieRenderPipelineState PipelineState = UMoviePipelineBlueprintLibrary::GetPipelineState(DeferredMoviePipeline);
 
-	// For states that only fire once, check if the state has changed.
-	// ProducingFrames is handled separately as it needs to update continuously (with throttling).
-	if (PipelineState == LastPipelineState && PipelineState != EMovieRenderPipelineState::ProducingFrames && PipelineState != EMovieRenderPipelineState::Export)
+	if (PipelineState == EMovieRenderPipelineState::ProducingFrames || PipelineState == EMovieRenderPipelineState::Finalize)
 	{
-		return;
+		const bool bHeldCountsFinal = PipelineState == EMovieRenderPipelineState::Finalize;
+		AppendFlushedFramesToManifest(bHeldCountsFinal);
 	}
 
-	if (PipelineState != EMovieRenderPipelineState::Export)
+	if (HlsPreview)
 	{
-		bExportFinalUpdateSent = false;
-	}
-	
-	FString PipelineStateName = EnumToString<EMovieRenderPipelineState>(PipelineState);
-	UE_LOG(LogTemp, Warning, TEXT("%s MoviePipelineState changed to: %s"), ANSI_TO_TCHAR(__FUNCTION__), *PipelineStateName);
-
-	const auto ComputeEncodingProgress = [this]() -> float
-	{
-		if (!PendingJob)
-		{
-			return -1.f;
-		}
-
-		double WeightedProgress = 0.0;
-		double TotalFrameCount = 0.0;
-
-		for (UMoviePipelineExecutorShot* Shot : PendingJob->ShotInfo)
+		// Every frame is in the preview queue once the pipeline gets past Finalize.
+		if (PipelineState == EMovieRenderPipelineState::Export || PipelineState == EMovieRenderPipelineState::Finished)
 		{
-			if (!Shot || !Shot->ShouldRender())
-			{
-				continue;
-			}
-
-			const int32 ShotFrameCount = Shot->ShotInfo.WorkMetrics.TotalOutputFrameCount;
-			if (ShotFrameCount <= 0)
-			{
-				continue;
-			}
-
-			const float ShotProgress = FMath::Clamp(Shot->GetStatusProgress(), 0.f, 1.f);
-			WeightedProgress += static_cast<double>(ShotFrameCount) * ShotProgress;
-			TotalFrameCount += static_cast<double>(ShotFrameCount);
-		}
-
-		if (TotalFrameCount <= 0.0)
-		{
-			return -1.f;
+			HlsPreview->Finish();
 		}
+		HlsPreview->Tick();
+	}
 
-		const float NormalizedProgress = static_cast<float>(WeightedProgress / TotalFrameCount);
-		return FMath::Clamp(NormalizedProgress, 0.f, 1.f);
-		
-	};
+	if (PipelineState == EMovieRenderPipelineState::ProducingFrames || PipelineState == EMovieRenderPipelineState::Export)
+	{
+		UpdateEtaEstimator();
+		ResourceMonitor.Tick(ProgressReportInterval);
+	}
 
-	const auto ExtractEncodingEtaSeconds = [this](int32& OutEtaSeconds) -> bool
+	if (PipelineState == EMovieRenderPipelineState::ProducingFrames)
 	{
-		if (!PendingJob)
+		// The previous shot's spawnables are gone once the next one starts, so that is where a trim frees the most.
+		const int32 ShotIndex = DeferredMoviePipeline->GetCurrentShotIndex();
+		if (LastShotIndex != INDEX_NONE && ShotIndex != LastShotIndex)
 		{
-			return false;
+			MemoryWatchdog.OnShotBoundary();
 		}
+		LastShotIndex = ShotIndex;
+		MemoryWatchdog.Tick();
+	}
 
-		const FString EtaPrefix(TEXT("Encoding ETA:"));
-		for (UMoviePipelineExecutorShot* Shot : PendingJob->ShotInfo)
-		{
-			if (!Shot || !Shot->ShouldRender())
-			{
-				continue;
-			}
-
-			const FString StatusMessage = Shot->GetStatusMessage();
-			if (!StatusMessage.StartsWith(EtaPrefix))
-			{
-				continue;
-			}
-
-			const FString EtaString = StatusMessage.Mid(EtaPrefix.Len()).TrimStartAndEnd();
-			int32 ParsedEtaSeconds = 0;
-			if (FDefaultValueHelper::ParseInt(EtaString, ParsedEtaSeconds))
-			{
-				OutEtaSeconds = FMath::Max(ParsedEtaSeconds, 0);
-				return true;
-			}
-		}
+	// For states that only fire once, check if the state has changed.
+	// ProducingFrames is handled separately as it needs to update continuously (with throttling).
+	if (PipelineState == LastPipelineState && PipelineState != EMovieRenderPipelineState::ProducingFrames && PipelineState != EMovieRenderPipelineState::Export)
+	{
+		return;
+	}
 
-		return false;
-	};
+	if (PipelineState != EMovieRenderPipelineState::Export)
+	{
+		bExportFinalUpdateSent = false;
+	}
 	
+	// ProducingFrames and Export come through here every frame, only actual changes are worth a line.
+	if (PipelineState != LastPipelineState)
+	{
+		FString PipelineStateName = EnumToString<EMovieRenderPipelineState>(PipelineState);
+		UE_LOG(LogTemp, Log, TEXT("%s MoviePipelineState changed to: %s"), ANSI_TO_TCHAR(__FUNCTION__), *PipelineStateName);
+	}
+
 	const FString InURL = FString::Printf(TEXT("%sue-notifications/job/%s/progress"), *MRQServerBaseUrl, *CurrentJobId);
 	const FString InVerb = TEXT("POST");
 	FString InMessage;
@@ -311,17 +410,9 @@ void UMoviePipelineNativeDeferredExecutor::OnBeginFrame_Implementation()
 				JsonWrapper.JsonObject.Get()->SetStringField(TEXT("status"), GetStatusString(ERenderJobStatus::rendering));
 				JsonWrapper.JsonObject.Get()->SetNumberField(TEXT("progress_percent"), CompletionPercentage);
 
-				FTimespan OutEstimate;
-				if (UMoviePipelineBlueprintLibrary::GetEstimatedTimeRemaining(DeferredMoviePipeline, OutEstimate))
-				{
-					UE_LOG(LogTemp, Log, TEXT("%s: Estimated time remaining: %.1f"), ANSI_TO_TCHAR(__FUNCTION__), OutEstimate.GetTotalSeconds());
-					int32 EtaSecs = static_cast<int32>(OutEstimate.GetTotalSeconds());
-					JsonWrapper.JsonObject.Get()->SetNumberField(TEXT("progress_eta_seconds"), EtaSecs);
-				}
-				else
-				{
-					JsonWrapper.JsonObject.Get()->SetNumberField(TEXT("progress_eta_seconds"), -1);
-				}
+				AddEtaFields(*JsonWrapper.JsonObject);
+				AddPreviewFields(*JsonWrapper.JsonObject);
+				AddMemoryFields(*JsonWrapper.JsonObject);
 
 				JsonWrapper.JsonObjectToString(InMessage);
 
@@ -340,6 +431,9 @@ void UMoviePipelineNativeDeferredExecutor::OnBeginFrame_Implementation()
 			{
 				JsonWrapper.JsonObject.Get()->SetStringField(TEXT("status"), GetStatusString(ERenderJobStatus::encoding));
 				JsonWrapper.JsonObject.Get()->SetNumberField(TEXT("progress_percent"), 1.f);
+				AddEtaFields(*JsonWrapper.JsonObject);
+				AddPreviewFields(*JsonWrapper.JsonObject);
+				AddMemoryFields(*JsonWrapper.JsonObject);
 				JsonWrapper.JsonObjectToString(InMessage);
 			
 				int32 RequestIndex = SendHTTPRequest(InURL, InVerb, InMessage, InHeaders);
@@ -381,16 +475,17 @@ void UMoviePipelineNativeDeferredExecutor::OnBeginFrame_Implementation()
 			{
 				UE_LOG(LogTemp, Log, TEXT("%s: Encoding progress: %.1f%%"), ANSI_TO_TCHAR(__FUNCTION__), EncodingProgress * 100.f);
 				
-				int32 ProgressEtaSeconds = -1;
-				const bool bHasShotEta = ExtractEncodingEtaSeconds(ProgressEtaSeconds);
-				if (!bHasShotEta)
-				{
-					ProgressEtaSeconds = bEncodingComplete ? 0 : -1;
-				}
-				
 				JsonWrapper.JsonObject.Get()->SetStringField(TEXT("status"), GetStatusString(ERenderJobStatus::encoding));
 				JsonWrapper.JsonObject.Get()->SetNumberField(TEXT("progress_percent"), TotalProgress); // rendering progress is 1.f already.
-				JsonWrapper.JsonObject.Get()->SetNumberField(TEXT("progress_eta_seconds"), ProgressEtaSeconds);
+				AddEtaFields(*JsonWrapper.JsonObject);
+				AddPreviewFields(*JsonWrapper.JsonObject);
+				AddMemoryFields(*JsonWrapper.JsonObject);
+
+				// Lets the server start uploading the fragmented video before it is complete.
+				if (bFragmentedOutput)
+				{
+					JsonWrapper.JsonObject.Get()->SetStringField(TEXT("video_directory"), GetVideoOutputDirectory());
+				}
 
 				JsonWrapper.JsonObjectToString(InMessage);
 
@@ -417,6 +512,142 @@ void UMoviePipelineNativeDeferredExecutor::OnBeginFrame_Implementation()
 	LastPipelineState = PipelineState;
 }
 
+float UMoviePipelineNativeDeferredExecutor::ComputeEncodingProgress() const
+{
+	int32 CurrentOutputFrame = 0;
+	int32 TotalOutputFrames = 0;
+	UMoviePipelineBlueprintLibrary::GetOverallOutputFrames(DeferredMoviePipeline, CurrentOutputFrame, TotalOutputFrames);
+	if (TotalOutputFrames <= 0)
+	{
+		return -1.f;
+	}
+
+	// The segment join runs after every frame is encoded, so the video isn't done while any encoder still runs.
+	const float Progress = FMath::Clamp(static_cast<float>(EncodedOutputFrames) / TotalOutputFrames, 0.f, 1.f);
+	return ActiveEncodes.Num() > 0 ? FMath::Min(Progress, 0.99f) : Progress;
+}
+
+void UMoviePipelineNativeDeferredExecutor::OnEncodeProgress(const FMoviePipelineEncodeProgress& InProgress)
+{
+	const FMoviePipelineEncodeProgress* Previous = ActiveEncodes.Find(InProgress.EncodeId);
+	const int32 PreviousFrames = Previous ? Previous->FramesDone : 0;
+	const int64 PreviousBytes = Previous ? Previous->BytesOut : 0;
+
+	// A restarted encode starts over, its frames and output are gone.
+	const int32 Frames = InProgress.bRestarted ? 0 : InProgress.FramesDone;
+	const int64 Bytes = InProgress.bRestarted ? 0 : InProgress.BytesOut;
+	if (InProgress.bCountsTowardOutput)
+	{
+		EncodedOutputFrames += Frames - PreviousFrames;
+	}
+	EncodedBytes += Bytes - PreviousBytes;
+
+	if (!InProgress.bFinished)
+	{
+		ActiveEncodes.Add(InProgress.EncodeId, InProgress);
+		return;
+	}
+
+	ActiveEncodes.Remove(InProgress.EncodeId);
+	if (InProgress.ExitCode != 0 && !InProgress.bRestarted)
+	{
+		FailedEncodeCount++;
+		UE_LOG(LogTemp, Error, TEXT("%s: Encoder process %d exited with code %d."), ANSI_TO_TCHAR(__FUNCTION__), InProgress.EncodeId, InProgress.ExitCode);
+	}
+}
+
+void UMoviePipelineNativeDeferredExecutor::UpdateEtaEstimator()
+{
+	int32 CurrentOutputFrame = 0;
+	int32 TotalOutputFrames = 0;
+	UMoviePipelineBlueprintLibrary::GetOverallOutputFrames(DeferredMoviePipeline, CurrentOutputFrame, TotalOutputFrames);
+	EtaEstimator.SetTotalOutputFrames(TotalOutputFrames);
+
+	const double NowSeconds = FPlatformTime::Seconds();
+	const EMovieRenderPipelineState PipelineState = UMoviePipelineBlueprintLibrary::GetPipelineState(DeferredMoviePipeline);
+	if (PipelineState == EMovieRenderPipelineState::ProducingFrames)
+	{
+		EtaEstimator.UpdateRendered(CurrentOutputFrame, NowSeconds);
+	}
+	else
+	{
+		EtaEstimator.UpdateRendered(TotalOutputFrames, NowSeconds);
+	}
+
+	// Chunks leave encoding to the server, there's nothing left to encode here.
+	if (!MRQ_CommandLineEncoder || !MRQ_CommandLineEncoder->IsEnabled())
+	{
+		const bool bEncoderRunning = false;
+		EtaEstimator.UpdateEncoded(TotalOutputFrames, NowSeconds, bEncoderRunning);
+		return;
+	}
+
+	EtaEstimator.SetEncodeOverlapsRender(MRQ_CommandLineEncoder->EncodesWhileRendering());
+	EtaEstimator.UpdateEncoded(FMath::Min(EncodedOutputFrames, TotalOutputFrames), NowSeconds, ActiveEncodes.Num() > 0);
+}
+
+void UMoviePipelineNativeDeferredExecutor::AddEtaFields(FJsonObject& InOutJson) const
+{
+	const double RemainingSeconds = EtaEstimator.GetRemainingSeconds();
+	UE_LOG(LogTemp, Log, TEXT("%s: Estimated time remaining: %.1f (render %.1f fps, encode %.1f fps)"), ANSI_TO_TCHAR(__FUNCTION__), RemainingSeconds, EtaEstimator.GetRenderFps(), EtaEstimator.GetEncodeFps());
+
+	InOutJson.SetNumberField(TEXT("progress_eta_seconds"), RemainingSeconds >= 0.0 ? FMath::RoundToInt32(RemainingSeconds) : -1);
+	InOutJson.SetNumberField(TEXT("eta_render_seconds"), EtaEstimator.GetRenderRemainingSeconds());
+	InOutJson.SetNumberField(TEXT("eta_encode_seconds"), EtaEstimator.GetEncodeRemainingSeconds());
+	InOutJson.SetNumberField(TEXT("render_fps"), EtaEstimator.GetRenderFps());
+	InOutJson.SetNumberField(TEXT("encode_fps"), EtaEstimator.GetEncodeFps());
+}
+
+void UMoviePipelineNativeDeferredExecutor::StartHlsPreview()
+{
+	if (!bPreviewHls)
+	{
+		return;
+	}
+
+	// A chunk is only a slice of the job, the server has nowhere to show it.
+	if (RenderChunkCount > 1)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: No preview for chunk renders."), ANSI_TO_TCHAR(__FUNCTION__));
+		return;
+	}
+
+	FMoviePipelineHlsPreview::FSettings Settings;
+	Settings.ExecutablePath = GetDefault<UMoviePipelineCommandLineEncoderSettings>()->ExecutablePath.Replace(TEXT("\""), TEXT(""));
+	Settings.OutputDirectory = GetVideoOutputDirectory() / TEXT("preview");
+	Settings.FrameRate = RenderFrameRate;
+	Settings.SegmentSeconds = FMath::Max(PreviewSegmentSeconds, 0.5f);
+	Settings.Height = PreviewHeight;
+	Settings.BitrateKbps = PreviewBitrateKbps;
+	if (Settings.ExecutablePath.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: No encoder executable configured, rendering without a preview."), ANSI_TO_TCHAR(__FUNCTION__));
+		return;
+	}
+
+	HlsPreview = MakeUnique<FMoviePipelineHlsPreview>(Settings);
+	PreviewPassName.Reset();
+	UE_LOG(LogTemp, Log, TEXT("%s: Writing a %dp preview to %s"), ANSI_TO_TCHAR(__FUNCTION__), Settings.Height, *HlsPreview->GetPlaylistPath());
+}
+
+void UMoviePipelineNativeDeferredExecutor::AddPreviewFields(FJsonObject& InOutJson) const
+{
+	// Only once there is something to play, so the server never hands out a playlist that doesn't exist yet.
+	if (HlsPreview && HlsPreview->HasSegments())
+	{
+		InOutJson.SetStringField(TEXT("preview_playlist"), HlsPreview->GetPlaylistPath());
+	}
+}
+
+void UMoviePipelineNativeDeferredExecutor::AddMemoryFields(FJsonObject& InOutJson) const
+{
+	InOutJson.SetNumberField(TEXT("memory_mb"), FMath::RoundToInt32(MemoryWatchdog.GetProcessMB()));
+	InOutJson.SetNumberField(TEXT("memory_peak_mb"), FMath::RoundToInt32(MemoryWatchdog.GetPeakProcessMB()));
+	InOutJson.SetNumberField(TEXT("gpu_memory_mb"), FMath::RoundToInt32(MemoryWatchdog.GetGpuMB()));
+	InOutJson.SetNumberField(TEXT("gpu_memory_peak_mb"), FMath::RoundToInt32(MemoryWatchdog.GetPeakGpuMB()));
+	InOutJson.SetNumberField(TEXT("memory_trims"), MemoryWatchdog.GetTrimCount());
+}
+
 void UMoviePipelineNativeDeferredExecutor::RequestForJobInfo(const FString& JobId)
 {
 }
@@ -425,9 +656,300 @@ void UMoviePipelineNativeDeferredExecutor::OnReceiveJobInfo(int32 RequestIndex,
 {
 }
 
+namespace
+{
+	/** Hard package dependencies of InRootPackage, itself included. Engine and script packages are covered by the engine version. */
+	void CollectContentPackages(const FName InRootPackage, TSet<FName>& OutPackages)
+	{
+		IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+
+		TArray<FName> PendingPackages = { InRootPackage };
+		while (PendingPackages.Num() > 0)
+		{
+			const FName PackageName = PendingPackages.Pop();
+			const FString PackageString = PackageName.ToString();
+			if (OutPackages.Contains(PackageName) || FPackageName::IsScriptPackage(PackageString) || PackageString.StartsWith(TEXT("/Engine/")))
+			{
+				continue;
+			}
+			OutPackages.Add(PackageName);
+
+			TArray<FName> Dependencies;
+			AssetRegistry.GetDependencies(PackageName, Dependencies, UE::AssetRegistry::EDependencyCategory::Package, UE::AssetRegistry::EDependencyQuery::Hard);
+			PendingPackages.Append(Dependencies);
+		}
+	}
+
+	/**
+	 * MD5s of files the fingerprint covers, kept between renders in Saved/RenderFingerprint. A file whose size and
+	 * modification time are unchanged keeps its hash, so only edited packages are read again. Renders running at the
+	 * same time may overwrite each other's additions, which costs a rehash and nothing else.
+	 */
+	class FFileHashCache
+	{
+	public:
+		FFileHashCache()
+			: CachePath(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("RenderFingerprint"), TEXT("FileHashes.tsv")))
+		{
+			TArray<FString> Lines;
+			FFileHelper::LoadFileToStringArray(Lines, *CachePath);
+			for (const FString& Line : Lines)
+			{
+				// <md5>\t<size>\t<modified ticks>\t<path>; the path goes last since it is the only field with spaces
+				TArray<FString> Fields;
+				const bool bCullEmpty = false;
+				if (Line.ParseIntoArray(Fields, TEXT("\t"), bCullEmpty) == 4)
+				{
+					FEntry& Entry = Entries.Add(Fields[3]);
+					Entry.Hash = Fields[0];
+					LexFromString(Entry.Size, *Fields[1]);
+					LexFromString(Entry.ModifiedTicks, *Fields[2]);
+				}
+			}
+		}
+
+		FString HashFile(const FString& InPath)
+		{
+			const FFileStatData Stat = IFileManager::Get().GetStatData(*InPath);
+			if (const FEntry* Entry = Entries.Find(InPath))
+			{
+				if (Stat.bIsValid && Entry->Size == Stat.FileSize && Entry->ModifiedTicks == Stat.ModificationTime.GetTicks())
+				{
+					return Entry->Hash;
+				}
+			}
+
+			const FString Hash = LexToString(FMD5Hash::HashFile(*InPath));
+			if (Stat.bIsValid)
+			{
+				Entries.Add(InPath, { Hash, Stat.FileSize, Stat.ModificationTime.GetTicks() });
+			}
+			HashedCount++;
+			return Hash;
+		}
+
+		int32 GetHashedCount() const { return HashedCount; }
+
+		void Save() const
+		{
+			if (HashedCount == 0)
+			{
+				return;
+			}
+
+			TStringBuilder<16384> Text;
+			for (const TPair<FString, FEntry>& Pair : Entries)
+			{
+				Text.Appendf(TEXT("%s\t%lld\t%lld\t%s\n"), *Pair.Value.Hash, Pair.Value.Size, Pair.Value.ModifiedTicks, *Pair.Key);
+			}
+
+			const FString TempPath = CachePath + TEXT(".tmp");
+			const bool bReplace = true;
+			const bool bEvenIfReadOnly = true;
+			if (!FFileHelper::SaveStringToFile(Text.ToView(), *TempPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM)
+				|| !IFileManager::Get().Move(*CachePath, *TempPath, bReplace, bEvenIfReadOnly))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%s: Couldn't save the file hash cache '%s', the next render hashes its packages again."), ANSI_TO_TCHAR(__FUNCTION__), *CachePath);
+			}
+		}
+
+	private:
+		struct FEntry
+		{
+			FString Hash;
+			int64 Size = -1;
+			int64 ModifiedTicks = 0;
+		};
+
+		FString CachePath;
+		TMap<FString, FEntry> Entries;
+		int32 HashedCount = 0;
+	};
+
+	/** Appends "Class.Property=Value" lines for every non-transient property of InObject that InIncludeProperty accepts. */
+	void AppendObjectProperties(const UObject* InObject, TFunctionRef<bool(FName)> InIncludeProperty, FStringBuilderBase& OutText)
+	{
+		for (TFieldIterator<FProperty> It(InObject->GetClass()); It; ++It)
+		{
+			if (It->HasAnyPropertyFlags(CPF_Transient | CPF_DuplicateTransient) || !InIncludeProperty(It->GetFName()))
+			{
+				continue;
+			}
+
+			FString Value;
+			It->ExportTextItem_InContainer(Value, InObject, nullptr, nullptr, PPF_None);
+			OutText.Appendf(TEXT("%s.%s=%s\n"), *InObject->GetClass()->GetName(), *It->GetName(), *Value);
+		}
+	}
+}
+
+FString UMoviePipelineNativeDeferredExecutor::ComputeRenderFingerprint(ULevelSequence* InLevelSequence) const
+{
+	const double StartTime = FPlatformTime::Seconds();
+	TStringBuilder<16384> FingerprintText;
+	FFileHashCache FileHashes;
+
+	// Build: engine version plus the binary of this plugin, which carries the executor and encoder logic.
+	FingerprintText.Appendf(TEXT("Engine=%s Build=%s\n"), *FEngineVersion::Current().ToString(), FApp::GetBuildVersion());
+	const FString ModuleFilename = FModuleManager::Get().GetModuleFilename(TEXT("MoviePipelineExt"));
+	if (!ModuleFilename.IsEmpty() && IFileManager::Get().FileExists(*ModuleFilename))
+	{
+		FingerprintText.Appendf(TEXT("PluginBinary=%s\n"), *FileHashes.HashFile(FPaths::ConvertRelativePathToFull(ModuleFilename)));
+	}
+	else if (TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("MoviePipelineExt")))
+	{
+		FingerprintText.Appendf(TEXT("PluginVersion=%s\n"), *Plugin->GetDescriptor().VersionName);
+	}
+
+	// Content: the sequence and the map, with everything they hard-reference. A World Partition map keeps its actors
+	// in external packages that the map package doesn't reference, so those are walked as well.
+	TSet<FName> Packages;
+	CollectContentPackages(InLevelSequence->GetOutermost()->GetFName(), Packages);
+	if (UWorld* World = FindGameWorld())
+	{
+		const FString MapPackageName = World->GetOutermost()->GetName();
+		CollectContentPackages(FName(*MapPackageName), Packages);
+
+		FString ExternalActorsDir;
+		if (FPackageName::TryConvertLongPackageNameToFilename(ULevel::GetExternalActorsPath(MapPackageName), ExternalActorsDir))
+		{
+			TArray<FString> ExternalActorFiles;
+			IFileManager::Get().FindFilesRecursive(ExternalActorFiles, *ExternalActorsDir, *(TEXT("*") + FPackageName::GetAssetPackageExtension()), true, false);
+			for (const FString& ExternalActorFile : ExternalActorFiles)
+			{
+				FString ExternalActorPackage;
+				if (FPackageName::TryConvertFilenameToLongPackageName(ExternalActorFile, ExternalActorPackage))
+				{
+					CollectContentPackages(FName(*ExternalActorPackage), Packages);
+				}
+			}
+		}
+	}
+
+	TArray<FName> SortedPackages = Packages.Array();
+	SortedPackages.Sort(FNameLexicalLess());
+	for (const FName& PackageName : SortedPackages)
+	{
+		FString PackageFilename;
+		if (FPackageName::DoesPackageExist(PackageName.ToString(), &PackageFilename))
+		{
+			FingerprintText.Appendf(TEXT("Package %s=%s\n"), *PackageName.ToString(), *FileHashes.HashFile(FPaths::ConvertRelativePathToFull(PackageFilename)));
+		}
+	}
+	FileHashes.Save();
+
+	// Configuration: every enabled setting of the job. The output directory is per job and doesn't change the video.
+	TArray<UMoviePipelineSetting*> Settings = PendingJob->GetConfiguration()->GetAllSettings();
+	Settings.Sort([](const UMoviePipelineSetting& A, const UMoviePipelineSetting& B) { return A.GetClass()->GetName() < B.GetClass()->GetName(); });
+	const TSet<FName> SkippedProperties = { GET_MEMBER_NAME_CHECKED(UMoviePipelineOutputSetting, OutputDirectory) };
+	// The encoder also carries per-job names, its log and process controls; only these decide what it writes. A deadline
+	// picks its preset by how fast this machine encodes, which no setting captures.
+	const TSet<FName> EncoderOutputProperties = {
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, FileNameFormatOverride),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, Quality),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, AdditionalCommandLineArgs),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, bWriteEachFrameDuration),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, bEncodeRenderPassesTogether),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, bEncodeShotSegments),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, OutputFileExtensionOverride),
+		GET_MEMBER_NAME_CHECKED(UMoviePipelineCustomEncoder, bFragmentedOutput),
+	};
+	for (const UMoviePipelineSetting* Setting : Settings)
+	{
+		if (Setting->IsA<UMoviePipelineCustomEncoder>())
+		{
+			AppendObjectProperties(Setting, [&EncoderOutputProperties](FName InName) { return EncoderOutputProperties.Contains(InName); }, FingerprintText);
+		}
+		else
+		{
+			AppendObjectProperties(Setting, [&SkippedProperties](FName InName) { return !SkippedProperties.Contains(InName); }, FingerprintText);
+		}
+	}
+
+	// Encoder: the ffmpeg path and per-quality arguments live in Project Settings rather than in the job.
+	AppendObjectProperties(GetDefault<UMoviePipelineCommandLineEncoderSettings>(), [](FName) { return true; }, FingerprintText);
+
+	// The render range this job asked for. Resume and chunk ranges are derived from it.
+	FingerprintText.Appendf(TEXT("Quality=%d Format=%s Range=%d:%d\n"), MovieQuality, *MovieFormat, RequestedRangeStart.Get(INT_MIN), RequestedRangeEnd.Get(INT_MAX));
+
+	// Two runs of the same job must come out equal. Anything naming this job would make every fingerprint unique and the
+	// cache useless, so such a fingerprint isn't used at all.
+	if (!CurrentJobId.IsEmpty() && FString(FingerprintText.ToView()).Contains(CurrentJobId))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s: The render fingerprint includes the job id %s, so no other job could match it. Skipping the render cache; a setting that names the job needs to be left out of the fingerprint."),
+			ANSI_TO_TCHAR(__FUNCTION__), *CurrentJobId);
+		return FString();
+	}
+
+	FTCHARToUTF8 FingerprintUtf8(FingerprintText.ToString(), FingerprintText.Len());
+	uint8 Digest[FSHA1::DigestSize];
+	FSHA1::HashBuffer(FingerprintUtf8.Get(), FingerprintUtf8.Length(), Digest);
+	const FString Fingerprint = BytesToHex(Digest, FSHA1::DigestSize);
+
+	UE_LOG(LogTemp, Log, TEXT("%s: Render fingerprint %s over %d package(s) (%d file(s) hashed, the rest cached) and %d setting(s), took %.2fs."), ANSI_TO_TCHAR(__FUNCTION__),
+		*Fingerprint, SortedPackages.Num(), FileHashes.GetHashedCount(), Settings.Num(), FPlatformTime::Seconds() - StartTime);
+	return Fingerprint;
+}
+
+void UMoviePipelineNativeDeferredExecutor::RequestRenderCacheLookup()
+{
+	if (RenderFingerprint.IsEmpty())
+	{
+		return;
+	}
+
+	const FString InURL = FString::Printf(TEXT("%sue-notifications/job/%s/render-fingerprint"), *MRQServerBaseUrl, *CurrentJobId);
+	const FString InVerb = TEXT("POST");
+	FString InMessage;
+	FJsonObjectWrapper JsonObjectWrapper;
+	JsonObjectWrapper.JsonObject.Get()->SetStringField(TEXT("fingerprint"), RenderFingerprint);
+	JsonObjectWrapper.JsonObjectToString(InMessage);
+
+	TMap<FString, FString> InHeaders;
+	InHeaders.Add(TEXT("Content-Type"), TEXT("application/json"));
+
+	HTTPResponseRecievedDelegate.AddUniqueDynamic(this, &UMoviePipelineNativeDeferredExecutor::OnReceiveRenderCacheLookup);
+	bRenderCacheLookupPending = true;
+	RenderCacheRequestIndex = SendHTTPRequest(InURL, InVerb, InMessage, InHeaders);
+}
+
+void UMoviePipelineNativeDeferredExecutor::OnReceiveRenderCacheLookup(int32 RequestIndex, int32 ResponseCode, const FString& Message)
+{
+	if (RequestIndex != RenderCacheRequestIndex || !bRenderCacheLookupPending)
+	{
+		return;
+	}
+	bRenderCacheLookupPending = false;
+
+	FJsonObjectWrapper JsonObjectWrapper;
+	bool bCached = false;
+	if (ResponseCode == 200 && JsonObjectWrapper.JsonObjectFromString(Message))
+	{
+		JsonObjectWrapper.JsonObject->TryGetBoolField(TEXT("cached"), bCached);
+	}
+
+	if (!bCached || !bWaiting)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: No cached video for this job (HTTP %d), rendering."), ANSI_TO_TCHAR(__FUNCTION__), ResponseCode);
+		return;
+	}
+
+	// The server has already completed the job with the cached video. Leave without rendering anything.
+	UE_LOG(LogTemp, Log, TEXT("%s: Server has a video with fingerprint %s, skipping the render."), ANSI_TO_TCHAR(__FUNCTION__), *RenderFingerprint);
+	bWaiting = false;
+
+	if (PollTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(PollTickerHandle);
+		PollTickerHandle.Reset();
+	}
+
+	OnExecutorFinishedImpl();
+}
+
 void UMoviePipelineNativeDeferredExecutor::CallbackOnEnginePreExit()
 {
-	if (DeferredMoviePipeline && DeferredMoviePipeline->GetPipelineState() != EMovieRenderPipelineState::Finished)
+	if (DeferredMoviePipeline && bRendering && DeferredMoviePipeline->GetPipelineState() != EMovieRenderPipelineState::Finished)
 	{
 		UE_LOG(LogTemp, Log, TEXT("%s Application quit while Movie Pipeline was still active. Stalling to do full shutdown."), ANSI_TO_TCHAR(__FUNCTION__));
 		DeferredMoviePipeline->RequestShutdown();
@@ -443,14 +965,14 @@ bool UMoviePipelineNativeDeferredExecutor::PollReady(float DeltaTime)
         return false; // Stop Ticker
 
     const double Elapsed = FPlatformTime::Seconds() - StartSeconds;
-    UE_LOG(LogTemp, Warning, TEXT("[MRQ] %s Poll for rendering, Elapsed: %.0f s; TimeoutSec: %.0f s"), ANSI_TO_TCHAR(__FUNCTION__), Elapsed, TimeoutSec);
+    UE_LOG(LogTemp, Verbose, TEXT("[MRQ] %s Poll for rendering, Elapsed: %.0f s; TimeoutSec: %.0f s"), ANSI_TO_TCHAR(__FUNCTION__), Elapsed, TimeoutSec);
     bool bCanStart = false;
 
     // 1) Find world（-game）
     UWorld* World = FindGameWorld();
     if (World)
     {
-        UE_LOG(LogTemp, Log, TEXT("[MRQ] GameWorld: %s"), *World->GetName());
+        UE_LOG(LogTemp, Verbose, TEXT("[MRQ] GameWorld: %s"), *World->GetName());
 
         // 2) Check the level: BeginPlay
         if (!World->HasBegunPlay())
@@ -489,12 +1011,20 @@ bool UMoviePipelineNativeDeferredExecutor::PollReady(float DeltaTime)
     	}
     }
 	
+    // The level is ready but the server hasn't said whether this video already exists.
+    if (bCanStart && bRenderCacheLookupPending)
+    {
+        UE_LOG(LogTemp, Log, TEXT("[MRQ] Level content is ready, waiting for the render cache lookup..."));
+        bCanStart = false;
+    }
+
     // —— Unified timeout processing exit ——
     if (bCanStart || Elapsed >= TimeoutSec)
     {
         if (!bCanStart)
         {
             UE_LOG(LogTemp, Warning, TEXT("[MRQ] Wait timed out: %.1fs/%.1fs, start anyway."), Elapsed, TimeoutSec);
+            bRenderCacheLookupPending = false;
         }
 
         StartRenderNow();
@@ -510,10 +1040,21 @@ void UMoviePipelineNativeDeferredExecutor::StartRenderNow()
     if (!bWaiting || bRendering || !PendingQueue)
         return;
 
+    // PollReady starts the render once the lookup has been answered.
+    if (bRenderCacheLookupPending)
+        return;
+
     bWaiting = false;
     bRendering = true;
 
+    EtaEstimator.Reset(0);
+    EtaEstimator.SetEncodeFpsHint(EncodeFpsHint);
+    EtaEstimator.SetUploadSeconds(UploadEtaSeconds);
+    MemoryWatchdog.Configure(MemoryWatchdogSettings);
+    LastShotIndex = INDEX_NONE;
+
     DeferredMoviePipeline->Initialize(PendingJob);
+    StartHlsPreview();
 
     // Progress updates are now handled in OnBeginFrame with throttling.
 }
@@ -549,6 +1090,16 @@ void UMoviePipelineNativeDeferredExecutor::CallbackOnExecutorFinished(UMoviePipe
 
 void UMoviePipelineNativeDeferredExecutor::CallbackOnMoviePipelineWorkFinished(FMoviePipelineOutputData MoviePipelineOutputData)
 {
+	// The encoded video supersedes the frames, which the encoder has deleted by now, so there is nothing left to resume.
+	// Chunks keep both: the server needs the frames and the manifest for the final encode.
+	if (MoviePipelineOutputData.bSuccess && MRQ_CommandLineEncoder->IsEnabled())
+	{
+		IFileManager::Get().Delete(*GetFrameManifestPath(), false, false, true);
+	}
+
+	// Lets the last segment finish and closes the playlist before the server hears the render is over.
+	HlsPreview.Reset();
+
 	SendHttpOnMoviePipelineWorkFinished(MoviePipelineOutputData);
 	
 	if (PollTickerHandle.IsValid())
@@ -573,6 +1124,407 @@ void UMoviePipelineNativeDeferredExecutor::OnExecutorFinishedImpl()
     Super::OnExecutorFinishedImpl();
 }
 
+FString UMoviePipelineNativeDeferredExecutor::GetFrameManifestPath() const
+{
+	return MRQ_OutputSetting->OutputDirectory.Path / TEXT("frames.manifest");
+}
+
+FString UMoviePipelineNativeDeferredExecutor::GetVideoOutputDirectory() const
+{
+	return FPaths::IsRelative(MRQ_OutputSetting->OutputDirectory.Path) ? FPaths::ConvertRelativePathToFull(MRQ_OutputSetting->OutputDirectory.Path) : MRQ_OutputSetting->OutputDirectory.Path;
+}
+
+namespace
+{
+	/** A frame only counts as finished if the image writer got all the way to the end of the file. */
+	bool IsCompleteFrameFile(const FString& InFilePath)
+	{
+		IFileManager& FileManager = IFileManager::Get();
+		const int64 FileSize = FileManager.FileSize(*InFilePath);
+		if (FileSize <= 0)
+		{
+			return false;
+		}
+
+		if (!FPaths::GetExtension(InFilePath).Equals(TEXT("png"), ESearchCase::IgnoreCase))
+		{
+			return true;
+		}
+
+		// Every PNG ends with an IEND chunk: zero length, type, CRC.
+		static const uint8 PngTrailer[] = { 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82 };
+		if (FileSize < UE_ARRAY_COUNT(PngTrailer))
+		{
+			return false;
+		}
+
+		TUniquePtr<FArchive> Reader(FileManager.CreateFileReader(*InFilePath));
+		if (!Reader)
+		{
+			return false;
+		}
+
+		uint8 Tail[UE_ARRAY_COUNT(PngTrailer)];
+		Reader->Seek(FileSize - UE_ARRAY_COUNT(PngTrailer));
+		Reader->Serialize(Tail, UE_ARRAY_COUNT(Tail));
+		return Reader->Close() && FMemory::Memcmp(Tail, PngTrailer, UE_ARRAY_COUNT(PngTrailer)) == 0;
+	}
+}
+
+void UMoviePipelineNativeDeferredExecutor::TryResumeFromFrameManifest(ULevelSequence* InLevelSequence)
+{
+	const FString ManifestPath = GetFrameManifestPath();
+	TArray<FString> ManifestLines;
+	if (!bResumeRender || !FFileHelper::LoadFileToStringArray(ManifestLines, *ManifestPath))
+	{
+		// A fresh attempt starts with a fresh manifest.
+		IFileManager::Get().Delete(*ManifestPath, false, false, true);
+		return;
+	}
+
+	struct FPassFrames
+	{
+		TArray<FString> FilePaths;
+		TArray<int32> HeldFrameCounts;
+		int32 FrameCount = 0;
+		bool bHasGap = false;
+		TArray<FMoviePipelineShotSegment> Segments;
+	};
+
+	// Frame lines are "<pass>\t<held frame count>\t<file path>" in render order. Only the unbroken prefix of each pass is usable.
+	// Segment lines are "segment\t<pass>\t<index>\t<frame count>\t<file path>", written when a shot segment finished encoding.
+	// A "resumed\t<frame count>" line means an earlier resume started after that many frames of segments, so the frame
+	// lines don't start at the first frame and only the segments can be resumed from.
+	TMap<FString, FPassFrames> FramesByPass;
+	bool bFramesStartAtFirstFrame = true;
+	for (const FString& Line : ManifestLines)
+	{
+		TArray<FString> Fields;
+		const int32 FieldCount = Line.ParseIntoArray(Fields, TEXT("\t"), false);
+		if (FieldCount == 2 && Fields[0] == TEXT("resumed"))
+		{
+			bFramesStartAtFirstFrame = false;
+			continue;
+		}
+		if (FieldCount == 5 && Fields[0] == TEXT("segment"))
+		{
+			FMoviePipelineShotSegment& Segment = FramesByPass.FindOrAdd(Fields[1]).Segments.AddDefaulted_GetRef();
+			Segment.PassName = Fields[1];
+			Segment.Index = FCString::Atoi(*Fields[2]);
+			Segment.FrameCount = FCString::Atoi(*Fields[3]);
+			Segment.FilePath = Fields[4];
+			continue;
+		}
+		if (FieldCount != 3)
+		{
+			continue;
+		}
+
+		FPassFrames& Pass = FramesByPass.FindOrAdd(Fields[0]);
+		const int32 HeldFrameCount = FCString::Atoi(*Fields[1]);
+		if (Pass.bHasGap || HeldFrameCount <= 0 || !bFramesStartAtFirstFrame || !IsCompleteFrameFile(Fields[2]))
+		{
+			Pass.bHasGap = true;
+			continue;
+		}
+
+		Pass.FilePaths.Add(Fields[2]);
+		Pass.HeldFrameCounts.Add(HeldFrameCount);
+		Pass.FrameCount += HeldFrameCount;
+	}
+
+	if (FramesByPass.Num() == 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: No reusable frames in %s, rendering from the start."), ANSI_TO_TCHAR(__FUNCTION__), *ManifestPath);
+		IFileManager::Get().Delete(*ManifestPath, false, false, true);
+		return;
+	}
+
+	// The custom playback range is expressed in display rate frames, so only resume on a frame both rates agree on,
+	// and always leave at least one frame for MRQ to render.
+	const FFrameRate DisplayRate = InLevelSequence->GetMovieScene()->GetDisplayRate();
+	const int32 MaxDisplayOffset = FMath::Max((RenderEndDisplayFrame - RenderStartDisplayFrame).Value - 1, 0);
+	auto ToDisplayOffset = [this, &DisplayRate, MaxDisplayOffset](const int32 InOutputFrameCount)
+	{
+		return FMath::Min(FFrameRate::TransformTime(FFrameTime(InOutputFrameCount), RenderFrameRate, DisplayRate).FloorToFrame().Value, MaxDisplayOffset);
+	};
+	auto ToOutputFrameCount = [this, &DisplayRate](const int32 InDisplayOffset)
+	{
+		return FFrameRate::TransformTime(FFrameTime(InDisplayOffset), DisplayRate, RenderFrameRate).FloorToFrame().Value;
+	};
+
+	int32 ResumeFrameCount = TNumericLimits<int32>::Max();
+	for (const TPair<FString, FPassFrames>& Pair : FramesByPass)
+	{
+		ResumeFrameCount = FMath::Min(ResumeFrameCount, Pair.Value.FrameCount);
+	}
+	int32 DisplayOffset = ToDisplayOffset(ResumeFrameCount);
+	ResumeFrameCount = ToOutputFrameCount(DisplayOffset);
+
+	// Shot segments take the frames they were encoded from with them, so past the first segment the frames above run
+	// into a gap. Every pass needs the same unbroken run of segments from the first one, and the render can only pick up
+	// exactly where a segment ends, not somewhere inside it.
+	int32 SegmentCount = TNumericLimits<int32>::Max();
+	for (TPair<FString, FPassFrames>& Pair : FramesByPass)
+	{
+		TArray<FMoviePipelineShotSegment>& Segments = Pair.Value.Segments;
+		Segments.Sort([](const FMoviePipelineShotSegment& A, const FMoviePipelineShotSegment& B) { return A.Index < B.Index; });
+
+		int32 UnbrokenCount = 0;
+		while (UnbrokenCount < Segments.Num() && Segments[UnbrokenCount].Index == UnbrokenCount
+			&& Segments[UnbrokenCount].FrameCount > 0 && IFileManager::Get().FileSize(*Segments[UnbrokenCount].FilePath) > 0)
+		{
+			UnbrokenCount++;
+		}
+		SegmentCount = FMath::Min(SegmentCount, UnbrokenCount);
+	}
+
+	int32 ResumedSegmentCount = 0;
+	int32 SegmentFrameCount = 0;
+	int32 SegmentDisplayOffset = 0;
+	const TArray<FMoviePipelineShotSegment>& FirstPassSegments = FramesByPass.CreateConstIterator().Value().Segments;
+	int32 SegmentBoundary = 0;
+	for (int32 Index = 0; Index < SegmentCount; Index++)
+	{
+		bool bSameInEveryPass = true;
+		for (const TPair<FString, FPassFrames>& Pair : FramesByPass)
+		{
+			bSameInEveryPass &= Pair.Value.Segments[Index].FrameCount == FirstPassSegments[Index].FrameCount;
+		}
+		if (!bSameInEveryPass)
+		{
+			break;
+		}
+
+		SegmentBoundary += FirstPassSegments[Index].FrameCount;
+		const int32 Offset = ToDisplayOffset(SegmentBoundary);
+		if (ToOutputFrameCount(Offset) == SegmentBoundary)
+		{
+			ResumedSegmentCount = Index + 1;
+			SegmentFrameCount = SegmentBoundary;
+			SegmentDisplayOffset = Offset;
+		}
+	}
+
+	if (ResumeFrameCount <= 0 && SegmentFrameCount <= 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: No reusable frames in %s, rendering from the start."), ANSI_TO_TCHAR(__FUNCTION__), *ManifestPath);
+		IFileManager::Get().Delete(*ManifestPath, false, false, true);
+		return;
+	}
+
+	TStringBuilder<4096> ManifestBuilder;
+	const bool bResumeFromSegments = SegmentFrameCount > ResumeFrameCount;
+	if (bResumeFromSegments)
+	{
+		// Resume after the last segment every pass has. The encoder joins them with the segments of this attempt, and the
+		// manifest only keeps those segments.
+		ManifestBuilder.Appendf(TEXT("resumed\t%d%s"), SegmentFrameCount, LINE_TERMINATOR);
+		for (TPair<FString, FPassFrames>& Pair : FramesByPass)
+		{
+			TArray<FMoviePipelineShotSegment> Segments(Pair.Value.Segments.GetData(), ResumedSegmentCount);
+			for (const FMoviePipelineShotSegment& Segment : Segments)
+			{
+				ManifestBuilder.Appendf(TEXT("segment\t%s\t%d\t%d\t%s%s"), *Segment.PassName, Segment.Index, Segment.FrameCount, *Segment.FilePath, LINE_TERMINATOR);
+			}
+			MRQ_CommandLineEncoder->SetResumedShotSegments(Pair.Key, MoveTemp(Segments));
+		}
+
+		ResumeFrameCount = SegmentFrameCount;
+		DisplayOffset = SegmentDisplayOffset;
+	}
+	else
+	{
+		// Trim every pass to exactly ResumeFrameCount frames, shortening a held frame that straddles the cut, and rewrite
+		// the manifest so it only lists what this attempt builds on.
+		for (TPair<FString, FPassFrames>& Pair : FramesByPass)
+		{
+			TArray<FString> FilePaths;
+			TArray<int32> HeldFrameCounts;
+			int32 FrameCount = 0;
+			for (int32 Index = 0; Index < Pair.Value.FilePaths.Num() && FrameCount < ResumeFrameCount; Index++)
+			{
+				const int32 HeldFrameCount = FMath::Min(Pair.Value.HeldFrameCounts[Index], ResumeFrameCount - FrameCount);
+				FilePaths.Add(Pair.Value.FilePaths[Index]);
+				HeldFrameCounts.Add(HeldFrameCount);
+				FrameCount += HeldFrameCount;
+				ManifestBuilder.Appendf(TEXT("%s\t%d\t%s%s"), *Pair.Key, HeldFrameCount, *Pair.Value.FilePaths[Index], LINE_TERMINATOR);
+			}
+
+			MRQ_CommandLineEncoder->SetResumedSourceFrames(Pair.Key, MoveTemp(FilePaths), MoveTemp(HeldFrameCounts));
+		}
+	}
+	FFileHelper::SaveStringToFile(ManifestBuilder.ToView(), *ManifestPath);
+
+	RenderStartDisplayFrame += DisplayOffset;
+	ResumedOutputFrameCount = ResumeFrameCount;
+
+	UE_LOG(LogTemp, Log, TEXT("%s: Resuming after %d already rendered frame(s)%s, display frames [%d, %d)."), ANSI_TO_TCHAR(__FUNCTION__),
+		ResumedOutputFrameCount, bResumeFromSegments ? *FString::Printf(TEXT(" in %d shot segment(s)"), ResumedSegmentCount) : TEXT(""),
+		RenderStartDisplayFrame.Value, RenderEndDisplayFrame.Value);
+}
+
+void UMoviePipelineNativeDeferredExecutor::ResolveRenderRange(ULevelSequence* InLevelSequence)
+{
+	UMovieScene* MovieScene = InLevelSequence->GetMovieScene();
+	const FFrameRate TickResolution = MovieScene->GetTickResolution();
+	const FFrameRate DisplayRate = MovieScene->GetDisplayRate();
+	const TRange<FFrameNumber> PlaybackRange = MovieScene->GetPlaybackRange();
+
+	SequenceStartDisplayFrame = FFrameRate::TransformTime(FFrameTime(UE::MovieScene::DiscreteInclusiveLower(PlaybackRange)), TickResolution, DisplayRate).RoundToFrame();
+	SequenceEndDisplayFrame = FFrameRate::TransformTime(FFrameTime(UE::MovieScene::DiscreteExclusiveUpper(PlaybackRange)), TickResolution, DisplayRate).RoundToFrame();
+	RenderStartDisplayFrame = SequenceStartDisplayFrame;
+	RenderEndDisplayFrame = SequenceEndDisplayFrame;
+
+	if (RequestedRangeStart.IsSet())
+	{
+		RenderStartDisplayFrame = FMath::Clamp(RequestedRangeStart.GetValue(), SequenceStartDisplayFrame.Value, SequenceEndDisplayFrame.Value);
+	}
+	if (RequestedRangeEnd.IsSet())
+	{
+		RenderEndDisplayFrame = FMath::Clamp(RequestedRangeEnd.GetValue(), RenderStartDisplayFrame.Value, SequenceEndDisplayFrame.Value);
+	}
+
+	if (RenderChunkCount > 1 && RenderChunkIndex >= 0 && RenderChunkIndex < RenderChunkCount)
+	{
+		// Slice the (possibly explicit) range into equal parts; the remainder is spread over the first chunks.
+		const int32 FrameCount = (RenderEndDisplayFrame - RenderStartDisplayFrame).Value;
+		const int32 BaseCount = FrameCount / RenderChunkCount;
+		const int32 Remainder = FrameCount % RenderChunkCount;
+		const int32 ChunkStart = RenderChunkIndex * BaseCount + FMath::Min(RenderChunkIndex, Remainder);
+		const int32 ChunkCount = BaseCount + (RenderChunkIndex < Remainder ? 1 : 0);
+
+		RenderEndDisplayFrame = RenderStartDisplayFrame + ChunkStart + ChunkCount;
+		RenderStartDisplayFrame = RenderStartDisplayFrame + ChunkStart;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("%s: Rendering display frames [%d, %d) of [%d, %d)."), ANSI_TO_TCHAR(__FUNCTION__),
+		RenderStartDisplayFrame.Value, RenderEndDisplayFrame.Value, SequenceStartDisplayFrame.Value, SequenceEndDisplayFrame.Value);
+}
+
+void UMoviePipelineNativeDeferredExecutor::ApplyRenderOverrides()
+{
+	if (ResolutionScale < 1.f)
+	{
+		// Even sizes, the encoder's 4:2:0 output can't take odd ones.
+		const FIntPoint FullResolution = MRQ_OutputSetting->OutputResolution;
+		MRQ_OutputSetting->OutputResolution = FIntPoint(
+			FMath::Max(FMath::RoundToInt32(FullResolution.X * ResolutionScale) & ~1, 2),
+			FMath::Max(FMath::RoundToInt32(FullResolution.Y * ResolutionScale) & ~1, 2));
+		UE_LOG(LogTemp, Log, TEXT("%s: Output resolution %dx%d (%.2f of %dx%d)."), ANSI_TO_TCHAR(__FUNCTION__),
+			MRQ_OutputSetting->OutputResolution.X, MRQ_OutputSetting->OutputResolution.Y, ResolutionScale, FullResolution.X, FullResolution.Y);
+	}
+
+	if (FrameStride > 1)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: Rendering one frame in %d, at %.2f fps."), ANSI_TO_TCHAR(__FUNCTION__), FrameStride, RenderFrameRate.AsDecimal());
+	}
+
+	if (!SpatialSampleCount.IsSet() && !TemporalSampleCount.IsSet() && !WarmUpFrameCount.IsSet())
+	{
+		return;
+	}
+
+	UMoviePipelineAntiAliasingSetting* AntiAliasingSetting = Cast<UMoviePipelineAntiAliasingSetting>(PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineAntiAliasingSetting::StaticClass()));
+	AntiAliasingSetting->SpatialSampleCount = SpatialSampleCount.Get(AntiAliasingSetting->SpatialSampleCount);
+	AntiAliasingSetting->TemporalSampleCount = TemporalSampleCount.Get(AntiAliasingSetting->TemporalSampleCount);
+	if (WarmUpFrameCount.IsSet())
+	{
+		// ApplyRenderRange raises it again for a range that starts mid-sequence.
+		AntiAliasingSetting->EngineWarmUpCount = WarmUpFrameCount.GetValue();
+		AntiAliasingSetting->RenderWarmUpCount = FMath::Min(AntiAliasingSetting->RenderWarmUpCount, WarmUpFrameCount.GetValue());
+	}
+	UE_LOG(LogTemp, Log, TEXT("%s: %d spatial x %d temporal sample(s), %d warm-up frame(s)."), ANSI_TO_TCHAR(__FUNCTION__),
+		AntiAliasingSetting->SpatialSampleCount, AntiAliasingSetting->TemporalSampleCount, AntiAliasingSetting->EngineWarmUpCount);
+}
+
+void UMoviePipelineNativeDeferredExecutor::ApplyRenderRange()
+{
+	if (RenderStartDisplayFrame == SequenceStartDisplayFrame && RenderEndDisplayFrame == SequenceEndDisplayFrame)
+	{
+		return;
+	}
+
+	MRQ_OutputSetting->bUseCustomPlaybackRange = true;
+	MRQ_OutputSetting->CustomStartFrame = RenderStartDisplayFrame.Value;
+	MRQ_OutputSetting->CustomEndFrame = RenderEndDisplayFrame.Value;
+
+	// Starting mid-sequence means TAA, motion blur and particles have no history. Run (and render, but don't write)
+	// some warm-up frames first so the first frame of this range matches what a full render would produce.
+	if (RenderStartDisplayFrame > SequenceStartDisplayFrame && ChunkWarmUpFrameCount > 0)
+	{
+		UMoviePipelineAntiAliasingSetting* AntiAliasingSetting = Cast<UMoviePipelineAntiAliasingSetting>(PendingJob->GetConfiguration()->FindOrAddSettingByClass(UMoviePipelineAntiAliasingSetting::StaticClass()));
+		AntiAliasingSetting->EngineWarmUpCount = FMath::Max(AntiAliasingSetting->EngineWarmUpCount, ChunkWarmUpFrameCount);
+		AntiAliasingSetting->bRenderWarmUpFrames = true;
+	}
+}
+
+void UMoviePipelineNativeDeferredExecutor::AppendFlushedFramesToManifest(const bool bHeldCountsFinal)
+{
+	const double CurrentTime = FPlatformTime::Seconds();
+	if (!DeferredMoviePipeline || (!bHeldCountsFinal && CurrentTime - LastManifestWriteTime < ProgressReportInterval))
+	{
+		return;
+	}
+	LastManifestWriteTime = CurrentTime;
+
+	const UMoviePipelineDedupImageSequenceOutput_PNG* DedupOutput = PendingJob->GetConfiguration()->FindSetting<UMoviePipelineDedupImageSequenceOutput_PNG>();
+	const FMoviePipelineOutputData OutputData = DeferredMoviePipeline->GetOutputDataParams();
+
+	// File paths only show up here once their write has completed, so everything listed is safe to resume from.
+	TStringBuilder<1024> ManifestBuilder;
+	for (int32 ShotIndex = 0; ShotIndex < OutputData.ShotData.Num(); ShotIndex++)
+	{
+		const FMoviePipelineShotOutputData& ShotData = OutputData.ShotData[ShotIndex];
+		for (const TPair<FMoviePipelinePassIdentifier, FMoviePipelineRenderPassOutputData>& Pair : ShotData.RenderPassData)
+		{
+			if (Pair.Key == FMoviePipelinePassIdentifier(TEXT("Audio")))
+			{
+				continue;
+			}
+
+			const TArray<int32>* HeldFrameCounts = DedupOutput ? DedupOutput->GetHeldFrameCounts(ShotData.Shot.Get(), Pair.Key) : nullptr;
+
+			// The most recent held frame may still grow until the pipeline stops producing frames.
+			int32 FinalFileCount = Pair.Value.FilePaths.Num();
+			if (HeldFrameCounts)
+			{
+				FinalFileCount = FMath::Min(FinalFileCount, bHeldCountsFinal ? HeldFrameCounts->Num() : HeldFrameCounts->Num() - 1);
+			}
+
+			// The preview shows the first pass that writes frames, usually FinalImage.
+			if (HlsPreview && PreviewPassName.IsEmpty())
+			{
+				PreviewPassName = Pair.Key.Name;
+			}
+			FMoviePipelineHlsPreview* Preview = Pair.Key.Name == PreviewPassName ? HlsPreview.Get() : nullptr;
+
+			int32& RecordedCount = ManifestRecordedFileCounts.FindOrAdd(MakeTuple(ShotIndex, Pair.Key.Name));
+			for (; RecordedCount < FinalFileCount; RecordedCount++)
+			{
+				const int32 HeldFrameCount = HeldFrameCounts ? (*HeldFrameCounts)[RecordedCount] : 1;
+				ManifestBuilder.Appendf(TEXT("%s\t%d\t%s%s"), *Pair.Key.Name, HeldFrameCount, *Pair.Value.FilePaths[RecordedCount], LINE_TERMINATOR);
+				ResourceMonitor.AddDiskBytes(IFileManager::Get().FileSize(*Pair.Value.FilePaths[RecordedCount]));
+				if (Preview)
+				{
+					Preview->AddFrame(Pair.Value.FilePaths[RecordedCount], HeldFrameCount);
+				}
+			}
+		}
+	}
+
+	if (ManifestBuilder.Len() > 0)
+	{
+		FFileHelper::SaveStringToFile(ManifestBuilder.ToView(), *GetFrameManifestPath(), FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+	}
+}
+
+void UMoviePipelineNativeDeferredExecutor::AppendShotSegmentToManifest(const FMoviePipelineShotSegment& InSegment)
+{
+	const FString Line = FString::Printf(TEXT("segment\t%s\t%d\t%d\t%s%s"), *InSegment.PassName, InSegment.Index, InSegment.FrameCount, *InSegment.FilePath, LINE_TERMINATOR);
+	FFileHelper::SaveStringToFile(Line, *GetFrameManifestPath(), FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+}
+
 void UMoviePipelineNativeDeferredExecutor::SendHttpOnMoviePipelineWorkFinished(
     const FMoviePipelineOutputData& MoviePipelineOutputData)
 {
@@ -585,8 +1537,37 @@ void UMoviePipelineNativeDeferredExecutor::SendHttpOnMoviePipelineWorkFinished(
 	FJsonObjectWrapper JsonObjectWrapper;
 	JsonObjectWrapper.JsonObject.Get()->SetBoolField(TEXT("movie_pipeline_success"), bSuccess);
 
-    FString VideoOutputDir = (FPaths::IsRelative(MRQ_OutputSetting->OutputDirectory.Path)) ? FPaths::ConvertRelativePathToFull(MRQ_OutputSetting->OutputDirectory.Path) : MRQ_OutputSetting->OutputDirectory.Path;
-	JsonObjectWrapper.JsonObject.Get()->SetStringField(TEXT("video_directory"), VideoOutputDir);
+	JsonObjectWrapper.JsonObject.Get()->SetStringField(TEXT("video_directory"), GetVideoOutputDirectory());
+
+	// The process controls the encoder actually ran with, so slow encodes can be traced back to their placement
+	TSharedRef<FJsonObject> MetricsObject = MakeShared<FJsonObject>();
+	MetricsObject->SetNumberField(TEXT("encoder_priority"), MRQ_CommandLineEncoder->ProcessPriority);
+	MetricsObject->SetStringField(TEXT("encoder_cpu_affinity"), MRQ_CommandLineEncoder->CpuAffinity);
+	MetricsObject->SetNumberField(TEXT("encoder_cpu_quota"), MRQ_CommandLineEncoder->CpuQuota);
+	MetricsObject->SetStringField(TEXT("encoder_cgroup"), MRQ_CommandLineEncoder->Cgroup);
+	MetricsObject->SetNumberField(TEXT("encoder_processes"), MRQ_CommandLineEncoder->GetLaunchedProcessCount());
+	MetricsObject->SetNumberField(TEXT("encoder_control_failures"), MRQ_CommandLineEncoder->GetProcessControlFailureCount());
+	MetricsObject->SetNumberField(TEXT("encoder_target_seconds"), MRQ_CommandLineEncoder->TargetEncodeSeconds);
+	MetricsObject->SetNumberField(TEXT("encoder_quality"), static_cast<int32>(MRQ_CommandLineEncoder->GetEffectiveQuality()));
+	MetricsObject->SetNumberField(TEXT("render_fps"), EtaEstimator.GetRenderFps());
+	MetricsObject->SetNumberField(TEXT("encode_fps"), EtaEstimator.GetEncodeFps());
+	MetricsObject->SetNumberField(TEXT("encoded_bytes"), static_cast<double>(EncodedBytes));
+	MetricsObject->SetNumberField(TEXT("encoder_failed_processes"), FailedEncodeCount);
+	MetricsObject->SetNumberField(TEXT("peak_vram_mb"), FMath::RoundToInt32(ResourceMonitor.GetPeakVideoMemoryMB()));
+	MetricsObject->SetNumberField(TEXT("peak_ram_mb"), FMath::RoundToInt32(ResourceMonitor.GetPeakPhysicalMemoryMB()));
+	MetricsObject->SetNumberField(TEXT("peak_cpu_cores"), ResourceMonitor.GetPeakCpuCores());
+	// Frames stay until their shot is encoded, so frames plus video is an upper bound of what the job had on disk at once.
+	MetricsObject->SetNumberField(TEXT("peak_disk_mb"), FMath::RoundToInt32(ResourceMonitor.GetDiskMB(EncodedBytes)));
+	MetricsObject->SetBoolField(TEXT("shader_warmup_manifest"), bShaderWarmUpManifestFound);
+	MetricsObject->SetNumberField(TEXT("shader_cache_hits"), ShaderCacheHits);
+	MetricsObject->SetNumberField(TEXT("shader_cache_misses"), ShaderCacheMisses);
+	MetricsObject->SetNumberField(TEXT("shader_jobs_at_start"), ShaderJobsAtStart);
+	MetricsObject->SetNumberField(TEXT("shader_wait_seconds"), ShaderWaitSeconds);
+	MetricsObject->SetNumberField(TEXT("memory_peak_mb"), FMath::RoundToInt32(MemoryWatchdog.GetPeakProcessMB()));
+	MetricsObject->SetNumberField(TEXT("gpu_memory_peak_mb"), FMath::RoundToInt32(MemoryWatchdog.GetPeakGpuMB()));
+	MetricsObject->SetNumberField(TEXT("memory_trims"), MemoryWatchdog.GetTrimCount());
+	MetricsObject->SetNumberField(TEXT("memory_trimmed_mb"), FMath::RoundToInt32(MemoryWatchdog.GetTrimmedMB()));
+	JsonObjectWrapper.JsonObject.Get()->SetObjectField(TEXT("metrics"), MetricsObject);
 	JsonObjectWrapper.JsonObjectToString(InMessage);
 
 	TMap<FString, FString> InHeaders;
@@ -603,21 +1584,85 @@ void UMoviePipelineNativeDeferredExecutor::WaitShaderCompilingComplete()
 {
     if (GShaderCompilingManager)
     {
+        const double WaitStartSeconds = FPlatformTime::Seconds();
+        double LastLogSeconds = -ShaderWaitLogIntervalSec;
 	    while (GShaderCompilingManager->IsCompiling())
 	    {
             GShaderCompilingManager->ProcessAsyncResults(false, false);
             FPlatformProcess::Sleep(0.5f);
-            GLog->Flush();
 
-            UE_LOG(LogTemp, Warning, TEXT("%s: Wait shader compile complete..."), ANSI_TO_TCHAR(__FUNCTION__));
+            // The engine doesn't tick while we wait, so flush by hand, but only when there is something new to show.
+            const double NowSeconds = FPlatformTime::Seconds();
+            if (NowSeconds - LastLogSeconds >= ShaderWaitLogIntervalSec)
+            {
+                LastLogSeconds = NowSeconds;
+                UE_LOG(LogTemp, Log, TEXT("%s: Waiting for %d shader compile job(s), %.0f s so far..."), ANSI_TO_TCHAR(__FUNCTION__),
+                    GShaderCompilingManager->GetNumRemainingJobs(), NowSeconds - WaitStartSeconds);
+                GLog->Flush();
+            }
 	    }
 
         GShaderCompilingManager->ProcessAsyncResults(false, true);
         GShaderCompilingManager->FinishAllCompilation();
-        UE_LOG(LogTemp, Warning, TEXT("%s: GShaderCompilingManager->FinishAllCompilation"), ANSI_TO_TCHAR(__FUNCTION__));
+        ShaderWaitSeconds = FPlatformTime::Seconds() - WaitStartSeconds;
+        UE_LOG(LogTemp, Log, TEXT("%s: Shader compilation finished after %.1f s."), ANSI_TO_TCHAR(__FUNCTION__), ShaderWaitSeconds);
     }
 }
 
+void UMoviePipelineNativeDeferredExecutor::VerifyShaderWarmUpManifest(ULevelSequence* InLevelSequence)
+{
+	ShaderJobsAtStart = GShaderCompilingManager ? GShaderCompilingManager->GetNumRemainingJobs() : 0;
+
+	const FString ManifestPath = ShaderWarmUpManifestPath.IsEmpty() ? FMoviePipelineShaderWarmUpManifest::GetDefaultPath(InLevelSequence->GetPathName()) : ShaderWarmUpManifestPath;
+	FMoviePipelineShaderWarmUpManifest Manifest;
+	bShaderWarmUpManifestFound = Manifest.Load(ManifestPath);
+	if (!bShaderWarmUpManifestFound)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: No shader warm-up manifest at %s, %d shader job(s) queued at start."), ANSI_TO_TCHAR(__FUNCTION__), *ManifestPath, ShaderJobsAtStart);
+		return;
+	}
+
+	// Shader maps are keyed by engine and platform, a manifest from another one says nothing about this DDC.
+	const bool bSameBuild = Manifest.EngineVersion == FMoviePipelineShaderWarmUpManifest::GetCurrentEngineVersion()
+		&& Manifest.ShaderPlatform == FMoviePipelineShaderWarmUpManifest::GetCurrentShaderPlatform();
+	if (!bSameBuild)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: Manifest %s was made with %s on %s, this render runs %s on %s. Run the warm-up again."), ANSI_TO_TCHAR(__FUNCTION__), *ManifestPath,
+			*Manifest.EngineVersion, *Manifest.ShaderPlatform, *FMoviePipelineShaderWarmUpManifest::GetCurrentEngineVersion(), *FMoviePipelineShaderWarmUpManifest::GetCurrentShaderPlatform());
+	}
+
+	TArray<FString> MissedMaterials;
+	for (const FMoviePipelineShaderWarmUpManifest::FMaterialEntry& Entry : Manifest.Materials)
+	{
+		bool bHit = false;
+		if (bSameBuild && FMoviePipelineShaderWarmUpManifest::HashObjectPackage(Entry.MaterialPath) == Entry.PackageHash)
+		{
+			// Loading takes a material's shader map from the DDC if it's there and queues compile jobs if not,
+			// so one that is still compiling now was not warmed up.
+			const UMaterialInterface* Material = LoadObject<UMaterialInterface>(nullptr, *Entry.MaterialPath);
+			const FMaterialResource* Resource = Material ? Material->GetMaterialResource(GMaxRHIFeatureLevel) : nullptr;
+			bHit = Resource && Resource->GetGameThreadShaderMap() && Resource->IsCompilationFinished();
+		}
+
+		if (bHit)
+		{
+			ShaderCacheHits++;
+		}
+		else
+		{
+			ShaderCacheMisses++;
+			MissedMaterials.Add(Entry.MaterialPath);
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("%s: Shader warm-up from %s: %d hit(s), %d miss(es), %d shader job(s) queued at start."), ANSI_TO_TCHAR(__FUNCTION__),
+		*Manifest.CreatedAt, ShaderCacheHits, ShaderCacheMisses, ShaderJobsAtStart);
+	for (int32 Index = 0; Index < FMath::Min(MissedMaterials.Num(), 20); Index++)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: Not warmed up: %s"), ANSI_TO_TCHAR(__FUNCTION__), *MissedMaterials[Index]);
+	}
+}
+
 UWorld* UMoviePipelineNativeDeferredExecutor::FindGameWorld() const
 {
     if (!GEngine) return nullptr;
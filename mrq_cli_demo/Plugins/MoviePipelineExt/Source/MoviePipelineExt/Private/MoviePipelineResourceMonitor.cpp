@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineResourceMonitor.h"
+#include "RHI.h"
+#include "DynamicRHI.h"
+#include "HAL/PlatformTime.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <dxgi1_4.h>
+#include <d3d12.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+namespace
+{
+#if PLATFORM_WINDOWS
+	/** The DXGI adapter the RHI renders on. Unlike the RHI's own stats, it reports everything this process allocated on it. */
+	TRefCountPtr<IDXGIAdapter3> FindRenderingAdapter()
+	{
+		TRefCountPtr<IDXGIAdapter3> Adapter;
+		void* NativeDevice = GDynamicRHI ? GDynamicRHI->RHIGetNativeDevice() : nullptr;
+		if (!NativeDevice)
+		{
+			return Adapter;
+		}
+
+		LUID AdapterLuid = {};
+		const ERHIInterfaceType InterfaceType = RHIGetInterfaceType();
+		if (InterfaceType == ERHIInterfaceType::D3D12)
+		{
+			AdapterLuid = static_cast<ID3D12Device*>(NativeDevice)->GetAdapterLuid();
+		}
+		else if (InterfaceType == ERHIInterfaceType::D3D11)
+		{
+			TRefCountPtr<IDXGIDevice> DxgiDevice;
+			TRefCountPtr<IDXGIAdapter> DxgiAdapter;
+			DXGI_ADAPTER_DESC AdapterDesc;
+			if (FAILED(static_cast<IUnknown*>(NativeDevice)->QueryInterface(IID_PPV_ARGS(DxgiDevice.GetInitReference())))
+				|| FAILED(DxgiDevice->GetAdapter(DxgiAdapter.GetInitReference()))
+				|| FAILED(DxgiAdapter->GetDesc(&AdapterDesc)))
+			{
+				return Adapter;
+			}
+			AdapterLuid = AdapterDesc.AdapterLuid;
+		}
+		else
+		{
+			return Adapter;
+		}
+
+		TRefCountPtr<IDXGIFactory4> Factory;
+		if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(Factory.GetInitReference()))))
+		{
+			Factory->EnumAdapterByLuid(AdapterLuid, IID_PPV_ARGS(Adapter.GetInitReference()));
+		}
+		return Adapter;
+	}
+#endif
+
+	/** Video memory this process has in use on its GPU: textures, buffers, heaps and whatever the driver allocated for it. */
+	bool QueryProcessVideoMemory(uint64& OutBytes)
+	{
+#if PLATFORM_WINDOWS
+		static TRefCountPtr<IDXGIAdapter3> Adapter = FindRenderingAdapter();
+		DXGI_QUERY_VIDEO_MEMORY_INFO LocalInfo;
+		DXGI_QUERY_VIDEO_MEMORY_INFO NonLocalInfo;
+		if (Adapter.IsValid()
+			&& SUCCEEDED(Adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &LocalInfo))
+			&& SUCCEEDED(Adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &NonLocalInfo)))
+		{
+			// Whatever was demoted to system memory still has to fit on the GPU once it is needed again.
+			OutBytes = LocalInfo.CurrentUsage + NonLocalInfo.CurrentUsage;
+			return true;
+		}
+#endif
+		return false;
+	}
+}
+
+void FMoviePipelineResourceMonitor::Tick(const double InIntervalSeconds)
+{
+	// Relative to one core, so 400% is four cores busy.
+	CpuPercentSum += FPlatformTime::GetCPUTime().CPUTimePct;
+	CpuPercentCount++;
+
+	const double NowSeconds = FPlatformTime::Seconds();
+	if (LastSampleSeconds < 0.0)
+	{
+		LastSampleSeconds = NowSeconds;
+		return;
+	}
+
+	if (NowSeconds - LastSampleSeconds >= InIntervalSeconds)
+	{
+		const double WindowSeconds = NowSeconds - LastSampleSeconds;
+		LastSampleSeconds = NowSeconds;
+		Sample(WindowSeconds);
+	}
+}
+
+double FMoviePipelineResourceMonitor::GetPeakPhysicalMemoryMB() const
+{
+	return FMath::Max<uint64>(FPlatformMemory::GetStats().PeakUsedPhysical, PeakCombinedPhysicalBytes) / (1024.0 * 1024.0);
+}
+
+void FMoviePipelineResourceMonitor::Sample(const double InWindowSeconds)
+{
+	uint64 ChildMemoryBytes = 0;
+	double ChildCpuSeconds = 0.0;
+	if (ChildProcessSampler)
+	{
+		ChildProcessSampler(ChildMemoryBytes, ChildCpuSeconds);
+	}
+
+	// The CPU time of a process that has exited and been reaped can't be read any more, so the total may go down.
+	const double ChildCores = FMath::Max(ChildCpuSeconds - LastChildCpuSeconds, 0.0) / FMath::Max(InWindowSeconds, UE_SMALL_NUMBER);
+	LastChildCpuSeconds = ChildCpuSeconds;
+
+	if (CpuPercentCount > 0)
+	{
+		PeakCpuCores = FMath::Max(PeakCpuCores, CpuPercentSum / CpuPercentCount / 100.0 + ChildCores);
+		CpuPercentSum = 0.0;
+		CpuPercentCount = 0;
+	}
+
+	PeakCombinedPhysicalBytes = FMath::Max(PeakCombinedPhysicalBytes, FPlatformMemory::GetStats().UsedPhysical + ChildMemoryBytes);
+
+	// Without a per process figure, textures and render targets are the bulk of what a render keeps on the GPU. The
+	// server never sizes a job below MIN_FREE_VRAM_MB to cover the rest.
+	uint64 VideoMemoryBytes = 0;
+	if (!QueryProcessVideoMemory(VideoMemoryBytes))
+	{
+		FTextureMemoryStats TextureMemoryStats;
+		RHIGetTextureMemoryStats(TextureMemoryStats);
+		VideoMemoryBytes = static_cast<uint64>(FMath::Max<int64>(TextureMemoryStats.StreamingMemorySize + TextureMemoryStats.NonStreamingMemorySize, 0));
+	}
+	PeakVideoMemoryBytes = FMath::Max(PeakVideoMemoryBytes, VideoMemoryBytes);
+}
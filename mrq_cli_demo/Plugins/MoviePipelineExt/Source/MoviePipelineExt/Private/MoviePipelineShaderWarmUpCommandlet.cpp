@@ -0,0 +1,306 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineShaderWarmUpCommandlet.h"
+#include "MoviePipelineShaderWarmUpManifest.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/FileManager.h"
+#include "LevelSequence.h"
+#include "Materials/MaterialInterface.h"
+#include "MovieScene.h"
+#include "Misc/App.h"
+#include "Misc/PackageName.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "PipelineStateCache.h"
+#include "PSOPrecache.h"
+#include "RenderingThread.h"
+#include "ShaderCompiler.h"
+#include "UObject/UObjectHash.h"
+
+namespace
+{
+	/** The mesh type a component draws its materials with. Static meshes need no usage flag, every material compiles for them. */
+	TOptional<EMaterialUsage> GetComponentMaterialUsage(const UPrimitiveComponent* InComponent)
+	{
+		if (InComponent->IsA<USkinnedMeshComponent>())
+		{
+			return MATUSAGE_SkeletalMesh;
+		}
+		if (InComponent->IsA<UInstancedStaticMeshComponent>())
+		{
+			return MATUSAGE_InstancedStaticMeshes;
+		}
+		if (InComponent->IsA<UParticleSystemComponent>())
+		{
+			return MATUSAGE_ParticleSprites;
+		}
+		if (const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(InComponent))
+		{
+			if (StaticMeshComponent->GetStaticMesh() && StaticMeshComponent->GetStaticMesh()->HasValidNaniteData())
+			{
+				return MATUSAGE_Nanite;
+			}
+		}
+		return {};
+	}
+
+	FString GetMaterialUsageName(const TOptional<EMaterialUsage> InUsage)
+	{
+		if (!InUsage.IsSet())
+		{
+			return TEXT("StaticMesh");
+		}
+
+		switch (InUsage.GetValue())
+		{
+		case MATUSAGE_SkeletalMesh: return TEXT("SkeletalMesh");
+		case MATUSAGE_InstancedStaticMeshes: return TEXT("InstancedStaticMeshes");
+		case MATUSAGE_ParticleSprites: return TEXT("ParticleSprites");
+		case MATUSAGE_Nanite: return TEXT("Nanite");
+		default: return FString::Printf(TEXT("Usage%d"), static_cast<int32>(InUsage.GetValue()));
+		}
+	}
+
+	/** Waits for every outstanding shader job. Returns the most jobs that were queued at once. */
+	int32 WaitForShaderCompiling()
+	{
+		int32 PeakJobCount = 0;
+		if (!GShaderCompilingManager)
+		{
+			return PeakJobCount;
+		}
+
+		double LastLogSeconds = 0.0;
+		while (GShaderCompilingManager->IsCompiling())
+		{
+			PeakJobCount = FMath::Max(PeakJobCount, GShaderCompilingManager->GetNumRemainingJobs());
+			GShaderCompilingManager->ProcessAsyncResults(false, false);
+			FPlatformProcess::Sleep(0.5f);
+
+			const double NowSeconds = FPlatformTime::Seconds();
+			if (NowSeconds - LastLogSeconds >= 10.0)
+			{
+				LastLogSeconds = NowSeconds;
+				UE_LOG(LogTemp, Display, TEXT("Compiling shaders, %d job(s) left..."), GShaderCompilingManager->GetNumRemainingJobs());
+			}
+		}
+		GShaderCompilingManager->FinishAllCompilation();
+		return PeakJobCount;
+	}
+}
+
+UMoviePipelineShaderWarmUpCommandlet::UMoviePipelineShaderWarmUpCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UMoviePipelineShaderWarmUpCommandlet::Main(const FString& Params)
+{
+	FString MapPath;
+	FString LevelSequencePath;
+	FParse::Value(*Params, TEXT("-Map="), MapPath);
+	FParse::Value(*Params, TEXT("-LevelSequence="), LevelSequencePath);
+	if (MapPath.IsEmpty() || LevelSequencePath.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=MoviePipelineShaderWarmUp -Map=<map> -LevelSequence=<sequence> [-Manifest=<file>]"));
+		return 1;
+	}
+
+	FString ManifestPath = FMoviePipelineShaderWarmUpManifest::GetDefaultPath(LevelSequencePath);
+	FParse::Value(*Params, TEXT("-Manifest="), ManifestPath);
+
+	if (!FApp::CanEverRender())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Running on the null RHI: shaders compile for %s, which renders won't use. Pass -AllowCommandletRendering."),
+			*FMoviePipelineShaderWarmUpManifest::GetCurrentShaderPlatform());
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// The map, its sublevels and, for World Partition, every actor package. The world is never initialized, the
+	// components are only read.
+	const FString MapPackageName = FPackageName::ObjectPathToPackageName(MapPath);
+	UPackage* MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load map %s."), *MapPath);
+		return 1;
+	}
+	CollectPackageObjects(MapPackage);
+
+	for (const ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+	{
+		if (StreamingLevel)
+		{
+			if (UPackage* LevelPackage = LoadPackage(nullptr, *StreamingLevel->GetWorldAssetPackageName(), LOAD_None))
+			{
+				CollectPackageObjects(LevelPackage);
+			}
+		}
+	}
+
+	FString ExternalActorsDir;
+	if (FPackageName::TryConvertLongPackageNameToFilename(ULevel::GetExternalActorsPath(MapPackageName), ExternalActorsDir))
+	{
+		TArray<FString> ExternalActorFiles;
+		IFileManager::Get().FindFilesRecursive(ExternalActorFiles, *ExternalActorsDir, *(TEXT("*") + FPackageName::GetAssetPackageExtension()), true, false);
+		for (const FString& ExternalActorFile : ExternalActorFiles)
+		{
+			FString ExternalActorPackage;
+			if (FPackageName::TryConvertFilenameToLongPackageName(ExternalActorFile, ExternalActorPackage))
+			{
+				if (UPackage* ActorPackage = LoadPackage(nullptr, *ExternalActorPackage, LOAD_None))
+				{
+					CollectPackageObjects(ActorPackage);
+				}
+			}
+		}
+	}
+
+	// The sequence: the templates of its spawnables, and materials its tracks assign directly.
+	ULevelSequence* LevelSequence = LoadObject<ULevelSequence>(nullptr, *LevelSequencePath);
+	if (!LevelSequence)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load sequence %s."), *LevelSequencePath);
+		return 1;
+	}
+
+	UMovieScene* MovieScene = LevelSequence->GetMovieScene();
+	for (int32 Index = 0; Index < MovieScene->GetSpawnableCount(); Index++)
+	{
+		if (const AActor* SpawnableTemplate = Cast<AActor>(MovieScene->GetSpawnable(Index).GetObjectTemplate()))
+		{
+			TInlineComponentArray<UPrimitiveComponent*> Components(SpawnableTemplate);
+			for (UPrimitiveComponent* Component : Components)
+			{
+				CollectComponent(Component);
+			}
+		}
+	}
+
+	IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+	TArray<FName> SequenceDependencies;
+	AssetRegistry.GetDependencies(LevelSequence->GetOutermost()->GetFName(), SequenceDependencies, UE::AssetRegistry::EDependencyCategory::Package, UE::AssetRegistry::EDependencyQuery::Hard);
+	for (const FName& Dependency : SequenceDependencies)
+	{
+		TArray<FAssetData> Assets;
+		AssetRegistry.GetAssetsByPackageName(Dependency, Assets);
+		for (const FAssetData& Asset : Assets)
+		{
+			if (Asset.IsInstanceOf<UMaterialInterface>())
+			{
+				if (UMaterialInterface* Material = Cast<UMaterialInterface>(Asset.GetAsset()))
+				{
+					MaterialUsages.FindOrAdd(Material).Add(GetMaterialUsageName({}));
+				}
+			}
+		}
+	}
+
+	// Loading already queued the shader maps the DDC doesn't have. Ask again in the background for every material
+	// in use, so instances that were loaded before their usage was known compile too, then wait for all of it.
+	UE_LOG(LogTemp, Display, TEXT("Compiling shaders for %d material(s) on %s..."), MaterialUsages.Num(), *FMoviePipelineShaderWarmUpManifest::GetCurrentShaderPlatform());
+	for (const TPair<UMaterialInterface*, TSet<FString>>& Pair : MaterialUsages)
+	{
+		Pair.Key->CacheShaders(EMaterialShaderPrecompileMode::Background);
+	}
+	const int32 CompileJobCount = WaitForShaderCompiling();
+
+	// The PSOs were requested while collecting; they compile on the driver and end up in its pipeline cache.
+	if (PrecachedComponentCount > 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Waiting for PSOs of %d component(s)..."), PrecachedComponentCount);
+		while (PipelineStateCache::NumActivePrecacheRequests() > 0)
+		{
+			FlushRenderingCommands();
+			FPlatformProcess::Sleep(0.1f);
+		}
+	}
+
+	FMoviePipelineShaderWarmUpManifest Manifest;
+	Manifest.EngineVersion = FMoviePipelineShaderWarmUpManifest::GetCurrentEngineVersion();
+	Manifest.ShaderPlatform = FMoviePipelineShaderWarmUpManifest::GetCurrentShaderPlatform();
+	Manifest.Map = MapPath;
+	Manifest.LevelSequence = LevelSequencePath;
+	Manifest.CreatedAt = FDateTime::UtcNow().ToIso8601();
+	Manifest.CompileSeconds = FPlatformTime::Seconds() - StartTime;
+	Manifest.CompileJobCount = CompileJobCount;
+
+	for (const TPair<UMaterialInterface*, TSet<FString>>& Pair : MaterialUsages)
+	{
+		// Created at load time (dynamic instances of construction scripts), there is no asset to look for later.
+		if (Pair.Key->GetOutermost() == GetTransientPackage())
+		{
+			continue;
+		}
+
+		FMoviePipelineShaderWarmUpManifest::FMaterialEntry& Entry = Manifest.Materials.AddDefaulted_GetRef();
+		Entry.MaterialPath = Pair.Key->GetPathName();
+		Entry.PackageHash = FMoviePipelineShaderWarmUpManifest::HashObjectPackage(Entry.MaterialPath);
+		Entry.Usages = Pair.Value.Array();
+		Entry.Usages.Sort();
+	}
+	Manifest.Materials.Sort([](const FMoviePipelineShaderWarmUpManifest::FMaterialEntry& A, const FMoviePipelineShaderWarmUpManifest::FMaterialEntry& B) { return A.MaterialPath < B.MaterialPath; });
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(ManifestPath), true);
+	if (!Manifest.Save(ManifestPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write the manifest %s."), *ManifestPath);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Warmed up %d material(s), %d shader job(s), in %.1f s. Manifest: %s"),
+		Manifest.Materials.Num(), CompileJobCount, Manifest.CompileSeconds, *ManifestPath);
+	return 0;
+}
+
+void UMoviePipelineShaderWarmUpCommandlet::CollectPackageObjects(const UPackage* InPackage)
+{
+	ForEachObjectWithPackage(InPackage, [this](UObject* Object)
+	{
+		if (UPrimitiveComponent* Component = Cast<UPrimitiveComponent>(Object))
+		{
+			CollectComponent(Component);
+		}
+		return true;
+	});
+}
+
+void UMoviePipelineShaderWarmUpCommandlet::CollectComponent(UPrimitiveComponent* InComponent)
+{
+	TArray<UMaterialInterface*> Materials;
+	InComponent->GetUsedMaterials(Materials);
+
+	const TOptional<EMaterialUsage> Usage = GetComponentMaterialUsage(InComponent);
+	for (UMaterialInterface* Material : Materials)
+	{
+		if (!Material)
+		{
+			continue;
+		}
+
+		// A -game render doesn't set missing usage flags, it draws the default material instead.
+		if (Usage.IsSet() && !Material->CheckMaterialUsage_Concurrent(Usage.GetValue()))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s is used on %s (%s) without that usage flag set, renders draw the default material there."),
+				*Material->GetPathName(), *GetMaterialUsageName(Usage), *InComponent->GetPathName());
+		}
+		MaterialUsages.FindOrAdd(Material).Add(GetMaterialUsageName(Usage));
+	}
+
+	if (FApp::CanEverRender() && IsComponentPSOPrecachingEnabled())
+	{
+		InComponent->PrecachePSOs();
+		PrecachedComponentCount++;
+	}
+}
@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "MoviePipelineShaderWarmUpManifest.h"
+#include "DataDrivenShaderPlatformInfo.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "RHIGlobals.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	constexpr int32 ManifestVersion = 1;
+}
+
+bool FMoviePipelineShaderWarmUpManifest::Save(const FString& InPath) const
+{
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetNumberField(TEXT("version"), ManifestVersion);
+	Root->SetStringField(TEXT("engine"), EngineVersion);
+	Root->SetStringField(TEXT("shader_platform"), ShaderPlatform);
+	Root->SetStringField(TEXT("map"), Map);
+	Root->SetStringField(TEXT("level_sequence"), LevelSequence);
+	Root->SetStringField(TEXT("created_at"), CreatedAt);
+	Root->SetNumberField(TEXT("compile_seconds"), CompileSeconds);
+	Root->SetNumberField(TEXT("compile_jobs"), CompileJobCount);
+
+	TArray<TSharedPtr<FJsonValue>> MaterialValues;
+	for (const FMaterialEntry& Entry : Materials)
+	{
+		TSharedRef<FJsonObject> MaterialObject = MakeShared<FJsonObject>();
+		MaterialObject->SetStringField(TEXT("path"), Entry.MaterialPath);
+		MaterialObject->SetStringField(TEXT("package_hash"), Entry.PackageHash);
+
+		TArray<TSharedPtr<FJsonValue>> UsageValues;
+		for (const FString& Usage : Entry.Usages)
+		{
+			UsageValues.Add(MakeShared<FJsonValueString>(Usage));
+		}
+		MaterialObject->SetArrayField(TEXT("usages"), UsageValues);
+		MaterialValues.Add(MakeShared<FJsonValueObject>(MaterialObject));
+	}
+	Root->SetArrayField(TEXT("materials"), MaterialValues);
+
+	FString Text;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Text);
+	if (!FJsonSerializer::Serialize(Root, Writer))
+	{
+		return false;
+	}
+
+	// Renders may read the manifest at any time, so it only ever appears complete.
+	const FString TempPath = InPath + TEXT(".tmp");
+	return FFileHelper::SaveStringToFile(Text, *TempPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM)
+		&& IFileManager::Get().Move(*InPath, *TempPath, true, true);
+}
+
+bool FMoviePipelineShaderWarmUpManifest::Load(const FString& InPath)
+{
+	FString Text;
+	if (!FFileHelper::LoadFileToString(Text, *InPath))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> Root;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Root) || !Root.IsValid())
+	{
+		return false;
+	}
+
+	int32 Version = 0;
+	if (!Root->TryGetNumberField(TEXT("version"), Version) || Version != ManifestVersion)
+	{
+		return false;
+	}
+
+	Root->TryGetStringField(TEXT("engine"), EngineVersion);
+	Root->TryGetStringField(TEXT("shader_platform"), ShaderPlatform);
+	Root->TryGetStringField(TEXT("map"), Map);
+	Root->TryGetStringField(TEXT("level_sequence"), LevelSequence);
+	Root->TryGetStringField(TEXT("created_at"), CreatedAt);
+	Root->TryGetNumberField(TEXT("compile_seconds"), CompileSeconds);
+	Root->TryGetNumberField(TEXT("compile_jobs"), CompileJobCount);
+
+	Materials.Reset();
+	const TArray<TSharedPtr<FJsonValue>>* MaterialValues = nullptr;
+	if (Root->TryGetArrayField(TEXT("materials"), MaterialValues))
+	{
+		for (const TSharedPtr<FJsonValue>& Value : *MaterialValues)
+		{
+			const TSharedPtr<FJsonObject>* MaterialObject = nullptr;
+			if (!Value->TryGetObject(MaterialObject))
+			{
+				continue;
+			}
+
+			FMaterialEntry& Entry = Materials.AddDefaulted_GetRef();
+			(*MaterialObject)->TryGetStringField(TEXT("path"), Entry.MaterialPath);
+			(*MaterialObject)->TryGetStringField(TEXT("package_hash"), Entry.PackageHash);
+			(*MaterialObject)->TryGetStringArrayField(TEXT("usages"), Entry.Usages);
+		}
+	}
+	return true;
+}
+
+FString FMoviePipelineShaderWarmUpManifest::GetDefaultPath(const FString& InLevelSequencePath)
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ShaderWarmUp"), FPackageName::GetShortName(FPackageName::ObjectPathToPackageName(InLevelSequencePath)) + TEXT(".json"));
+}
+
+FString FMoviePipelineShaderWarmUpManifest::GetCurrentEngineVersion()
+{
+	return FEngineVersion::Current().ToString();
+}
+
+FString FMoviePipelineShaderWarmUpManifest::GetCurrentShaderPlatform()
+{
+	return FDataDrivenShaderPlatformInfo::GetName(GMaxRHIShaderPlatform).ToString();
+}
+
+FString FMoviePipelineShaderWarmUpManifest::HashObjectPackage(const FString& InObjectPath)
+{
+	FString PackageFilename;
+	if (!FPackageName::DoesPackageExist(FPackageName::ObjectPathToPackageName(InObjectPath), &PackageFilename))
+	{
+		return FString();
+	}
+	return LexToString(FMD5Hash::HashFile(*PackageFilename));
+}
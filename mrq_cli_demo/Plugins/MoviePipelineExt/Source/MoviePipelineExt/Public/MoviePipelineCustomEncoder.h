@@ -7,8 +7,56 @@
 #include "MoviePipelineCommandLineEncoder.h"
 #include "Engine/EngineTypes.h"
 #include "MovieRenderPipelineDataTypes.h"
+#include "Tasks/Task.h"
+#include "MoviePipelineLogSink.h"
 #include "MoviePipelineCustomEncoder.generated.h"
 
+class UMoviePipelineExecutorShot;
+
+/** State of one encoder process, sent whenever its output advances and once more when it exits. */
+struct FMoviePipelineEncodeProgress
+{
+	/** Unique per process for the lifetime of the encoder setting. */
+	int32 EncodeId = INDEX_NONE;
+	TWeakObjectPtr<UMoviePipelineExecutorShot> Shot;
+
+	int32 FramesDone = 0;
+	int32 FramesTotal = 0;
+	/** Average frames per second and speed relative to real time, as the encoder reports them. Negative if unknown. */
+	double Fps = -1.0;
+	double Speed = -1.0;
+	/** Size of the output written so far. */
+	int64 BytesOut = 0;
+	/** Linear estimate for this process alone. Negative until the first frames are in. */
+	double EtaSeconds = -1.0;
+
+	/**
+	 * The frames are frames of the final video. False for the stream copy joining shot segments and for every pass but
+	 * the first when passes are encoded by separate processes, so summing FramesDone counts each output frame once.
+	 */
+	bool bCountsTowardOutput = true;
+
+	bool bFinished = false;
+	/** Finished because it was replaced by a process on a faster preset, its frames will be encoded again. */
+	bool bRestarted = false;
+	int32 ExitCode = 0;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMoviePipelineEncodeProgress, const FMoviePipelineEncodeProgress&);
+
+/** One render pass of one shot, encoded on its own while later shots render. */
+struct FMoviePipelineShotSegment
+{
+	FString PassName;
+	/** Position of the segment in the final file. */
+	int32 Index = INDEX_NONE;
+	FString FilePath;
+	/** Output frames the segment holds. */
+	int32 FrameCount = 0;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMoviePipelineShotSegmentEncoded, const FMoviePipelineShotSegment&);
+
 /**
  * 
  */
@@ -19,19 +67,76 @@ class MOVIEPIPELINEEXT_API UMoviePipelineCustomEncoder : public UMoviePipelineSe
 	{
 		FEncoderParams()
 			: ExpectedFrameCount(0)
+			, bIsShotSegment(false)
+			, bConcatSegments(false)
 		{
 		}
 		
 		FStringFormatNamedArguments NamedArguments;
 		TMap<FString, TArray<FString>> FilesByExtensionType;
+		/** How many output frames each file in FilesByExtensionType stands for. Greater than 1 for deduplicated held frames. */
+		TMap<FString, TArray<int32>> HeldFrameCountsByExtensionType;
 		TWeakObjectPtr<class UMoviePipelineExecutorShot> Shot;
 		int32 ExpectedFrameCount;
+		/** Video-only intermediate of one shot, encoded while later shots render. */
+		bool bIsShotSegment;
+		/** The inputs are shot segments that are joined by stream copy, only the audio is encoded. */
+		bool bConcatSegments;
+		/** Where this pass of a shot segment goes. */
+		FMoviePipelineShotSegment Segment;
 	};
 
 	GENERATED_BODY()
 public:
 	UMoviePipelineCustomEncoder();
 	void StartEncodingProcess(TArray<FMoviePipelineShotOutputData>& InOutData, const bool bInIsShotEncode);
+
+	/**
+	 * Register frames that an earlier, interrupted attempt of this job already rendered for the given render pass.
+	 * They are encoded ahead of the frames rendered by this attempt. Only used when encoding a single file at the end.
+	 */
+	void SetResumedSourceFrames(const FString& InPassName, TArray<FString>&& InFilePaths, TArray<int32>&& InHeldFrameCounts);
+
+	/**
+	 * Register shot segments that an earlier, interrupted attempt of this job already encoded for the given render pass,
+	 * in shot order. The shots this attempt renders become the segments after them. Turns shot segments on for this render.
+	 */
+	void SetResumedShotSegments(const FString& InPassName, TArray<FMoviePipelineShotSegment>&& InSegments);
+
+	/** How many encoder processes were launched, and how many of them didn't get all of the requested process controls. */
+	int32 GetLaunchedProcessCount() const { return LaunchedProcessCount; }
+	int32 GetProcessControlFailureCount() const { return ProcessControlFailureCount; }
+
+	/** Memory the running encoder processes use right now, and the CPU time all of them have used so far. */
+	void GetProcessUsage(uint64& OutMemoryBytes, double& OutCpuSeconds) const;
+
+	/**
+	 * Starts InExecutable outside of any render and supervises it like an encode: its output is parsed, its progress
+	 * broadcast and InFilesToDelete are deleted once it exits. For load tests with a stand-in encoder, see
+	 * UMoviePipelineEncoderLoadTestCommandlet. Returns the process id, 0 if it didn't start.
+	 */
+	uint32 LaunchUnmanagedProcess(const FString& InExecutable, const FString& InArguments, const int32 InExpectedFrameCount, TArray<FString>&& InFilesToDelete);
+
+	/**
+	 * Offered each source frame the encoder is done with before it deletes it. Returning true keeps the frame: whoever
+	 * still reads it takes over deleting it. Called on the game thread.
+	 */
+	typedef TFunction<bool(const FString& InFilePath)> FSourceFrameReleaseHandler;
+	void SetSourceFrameReleaseHandler(FSourceFrameReleaseHandler&& InHandler) { SourceFrameReleaseHandler = MoveTemp(InHandler); }
+
+	/** Kills every running encode at the next tick, as a render canceled with bSkipEncodeOnRenderCanceled does. */
+	void CancelEncodes() { bCancelRequested = true; }
+
+	/** Quality the encoder ended up using. Lower than Quality if a deadline forced a faster preset. */
+	EMoviePipelineEncodeQuality GetEffectiveQuality() const { return EffectiveQuality; }
+
+	/** Progress of every encoder process. Broadcast on the game thread while the encoder ticks. */
+	FOnMoviePipelineEncodeProgress& OnEncodeProgress() { return EncodeProgressDelegate; }
+	/** A shot segment encode exited cleanly, once per render pass. Broadcast on the game thread. */
+	FOnMoviePipelineShotSegmentEncoded& OnShotSegmentEncoded() { return ShotSegmentEncodedDelegate; }
+	/** Shots are encoded as soon as they're rendered instead of all at the end. */
+	bool EncodesWhileRendering() const { return bShotSegmentsActive || (GetPipeline() && NeedsPerShotFlushing()); }
+	FString GetOutputFileExtension() const;
 public:
 #if WITH_EDITOR
 	virtual FText GetDisplayText() const override { return NSLOCTEXT("MovieRenderPipeline", "CommandLineEncode_DisplayText", "Command Line Encoder"); }
@@ -44,12 +149,19 @@ public:
 	virtual bool IsValidOnPrimary() const override { return true; }
 	virtual bool HasFinishedExportingImpl() override;
 	virtual void BeginExportImpl() override;
+	virtual void BeginDestroy() override;
 	
 protected:
 	bool NeedsPerShotFlushing() const;
-	void LaunchEncoder(const FEncoderParams& InParams);
+	/** Encodes the given render passes in one encoder process, one output file per pass. */
+	void LaunchEncoder(TConstArrayView<FEncoderParams> InPasses, const bool bInCountsTowardOutput);
+	/** Writes the concat list the encoder reads a single input from and returns its path. */
+	FString WriteInputListFile(const TArray<FString>& InFilePaths, const TArray<int32>& InHeldFrameCounts, const bool bInWriteFrameDurations, const double InFrameRateAsDuration);
+	void OnShotWorkFinished(FMoviePipelineOutputData InOutputData);
+	/** Applies affinity, CPU quota and cgroup placement to a freshly launched encoder. Returns false if any of them failed. */
+	bool ApplyProcessControls(FProcHandle& InProcessHandle, const uint32 InProcessId);
 	void OnTick();
-	FString GetQualitySettingString() const;
+	FString GetQualitySettingString(const EMoviePipelineEncodeQuality InQuality) const;
 
 public:
 	/** 
@@ -80,6 +192,78 @@ public:
 	/** Write the duration for each frame into the generated text file. Needed for some input types on some CLI encoding software. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder")
 	bool bWriteEachFrameDuration;
+
+	/**
+	 * Encode all render passes with a single encoder process that writes one file per pass (ffmpeg tee muxer), decoding and
+	 * encoding the audio once for all of them. Otherwise every pass gets its own process, the default.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder")
+	bool bEncodeRenderPassesTogether;
+
+	/**
+	 * When encoding to a single file, encode each finished shot into an intermediate segment while later shots render.
+	 * At the end the segments are only joined by stream copy and the audio is muxed in. Finished segments go into the frame
+	 * manifest, so a resumed render continues after the last of them even though their frames are gone. Segments are
+	 * encoded with a fixed keyframe interval, so the joined video differs from a single-pass encode; off by default.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder")
+	bool bEncodeShotSegments;
+
+	/** Container of the encoded videos, "mp4" or "mov". Empty uses the project's Command Line Encoder OutputFileExtension. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder")
+	FString OutputFileExtensionOverride;
+
+	/**
+	 * File all encoder output is written to, from a background task. Only errors and warnings reach the engine log.
+	 * Empty writes <engine log name>-encoder.log next to the engine log.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder")
+	FString LogFilePath;
+
+	/**
+	 * Write MP4/MOV output as fragmented MP4 (moov up front, then self-contained fragments). Nothing is rewritten once
+	 * written, so the file can be uploaded while it is still being encoded.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder")
+	bool bFragmentedOutput;
+
+	/**
+	 * Target time to encode the whole output in, in seconds. 0 disables it. Every encode is timed over its first
+	 * DeadlineCalibrationFrames frames and restarted with the next faster quality preset if it can't keep up with
+	 * output frames / TargetEncodeSeconds. Later encodes of the job start from the preset that was picked.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Deadline", meta = (ClampMin = "0", Units = "s"))
+	float TargetEncodeSeconds;
+
+	/** How many frames an encode runs before its throughput is checked against TargetEncodeSeconds. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Deadline", meta = (ClampMin = "1"))
+	int32 DeadlineCalibrationFrames;
+
+	/** Scheduling priority of encoder processes, from -2 (idle) to 2 (highest). Below normal keeps encoders from starving the render threads. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Process", meta = (ClampMin = "-2", ClampMax = "2"))
+	int32 ProcessPriority;
+
+	/** Cores encoder processes may run on, e.g. "8-15" or "4,6,8-11". Leave cores for the engine's game and render threads. Empty uses all cores. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Process")
+	FString CpuAffinity;
+
+	/**
+	 * Upper bound on the CPU all encoder processes of this job may use together, in cores (4.0 = four cores' worth). 0 is unlimited.
+	 * Enforced with a job object on Windows and through the cgroup's cpu.max on Linux, which requires Cgroup to be set.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Process", meta = (ClampMin = "0"))
+	float CpuQuota;
+
+	/** Linux only: cgroup v2 group (relative to /sys/fs/cgroup) encoder processes are moved into. Created if missing. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Process")
+	FString Cgroup;
+
+	/**
+	 * Linux only: child group created below Cgroup for the encoders of this job and removed with it, so jobs sharing
+	 * Cgroup each get their own cpu.max. Empty moves the encoders into Cgroup itself.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Command Line Encoder|Process")
+	FString CgroupChildName;
 	
 private:
 	struct FActiveJob
@@ -87,27 +271,121 @@ private:
 		FActiveJob()
 			: ReadPipe(nullptr)
 			, WritePipe(nullptr)
+			, ProcessId(0)
 			, ExpectedFrameCount(0)
 			, LastReportedFrame(0)
-			, LastProgressSentTimeSeconds(-1.0)
 			, EncodeStartTimeSeconds(-1.0)
-			, LastReportedEtaSeconds(-1.0)
+			, NextSourceFrameToDelete(0)
+			, bIsShotSegment(false)
+			, Quality(EMoviePipelineEncodeQuality::Low)
+			, bCalibrating(false)
+			, bRestartFaster(false)
+			, ReportedFps(-1.0)
+			, EncodeId(INDEX_NONE)
+			, ReportedSpeed(-1.0)
+			, BytesOut(0)
+			, bCountsTowardOutput(true)
 		{}
 
 		FProcHandle ProcessHandle;
 		void* ReadPipe;
 		void* WritePipe;
+		uint32 ProcessId;
 
 		int32 ExpectedFrameCount;
 		int32 LastReportedFrame;
-		double LastProgressSentTimeSeconds;
 		double EncodeStartTimeSeconds;
-		double LastReportedEtaSeconds;
 		FString PendingStdOut;
 		TWeakObjectPtr<UMoviePipelineExecutorShot> Shot;
 
 		TArray<FString> FilesToDelete;
+
+		/** Source frames of every video input in the order the encoder is done with them, deleted incrementally as the parsed frame counter passes them. */
+		TArray<FString> SourceFramesToDelete;
+		/** Output frame by which the input list's last entry of each source frame is consumed. Held frames span several. */
+		TArray<int32> SourceFrameEndIndices;
+		int32 NextSourceFrameToDelete;
+
+		bool bIsShotSegment;
+		/** Segments the process writes, one per render pass. */
+		TArray<FMoviePipelineShotSegment> Segments;
+
+		/** Quality preset this process was launched with. */
+		EMoviePipelineEncodeQuality Quality;
+		/** Still inside the deadline calibration window. Source frames are kept so the encode can be restarted. */
+		bool bCalibrating;
+		bool bRestartFaster;
+		/** Average encode rate from the encoder's own fps= (or speed=) statistic. */
+		double ReportedFps;
+		/** What the process was launched with, kept during calibration for a restart. */
+		TArray<FEncoderParams> Passes;
+		TArray<FString> InputListFiles;
+
+		int32 EncodeId;
+		double ReportedSpeed;
+		int64 BytesOut;
+		bool bCountsTowardOutput;
 	};
 
+	/** Hands off every source frame the encoder has read past to a background deletion task. */
+	void ReleaseConsumedSourceFrames(FActiveJob& InJob, const bool bReleaseAll);
+	/** Drops the frames SourceFrameReleaseHandler keeps from a list about to be deleted. */
+	void KeepSourceFramesInUse(TArray<FString>& InOutFilesToDelete) const;
+	/** Compares the throughput of a calibrating encode against TargetEncodeSeconds and flags it for a faster restart if needed. */
+	void FinishDeadlineCalibration(FActiveJob& InJob);
+	void BroadcastProgress(const FActiveJob& InJob, const bool bInFinished, const bool bInRestarted, const int32 InExitCode);
+	void LaunchFileDeletion(TArray<FString>&& InFilesToDelete);
+
 	TArray<FActiveJob> ActiveEncodeJobs;
+
+	struct FResumedSourceFrames
+	{
+		TArray<FString> FilePaths;
+		TArray<int32> HeldFrameCounts;
+	};
+
+	/** Frames from a previous attempt, keyed by render pass name. */
+	TMap<FString, FResumedSourceFrames> ResumedSourceFrames;
+
+	/** Deletions still running on background workers. Exporting isn't finished until these are done. */
+	TArray<UE::Tasks::FTask> PendingFileDeletions;
+
+	/** Shot segment mode is on for this render (decided once the pipeline is set up). */
+	bool bShotSegmentsActive = false;
+	/** Rendering is done, the segments get joined as soon as the last segment encode exits. */
+	bool bPendingShotSegmentConcat = false;
+	bool bShotSegmentFailed = false;
+	bool bCancelRequested = false;
+
+	/** Encoded segments in shot order, keyed by render pass name. Starts with the segments of an earlier attempt. */
+	TMap<FString, TArray<FString>> ShotSegmentsByPass;
+	/** Output frames the segments of an earlier attempt hold, keyed by render pass name. */
+	TMap<FString, int32> ResumedSegmentFrameCounts;
+	TSet<TWeakObjectPtr<UMoviePipelineExecutorShot>> EncodedShots;
+
+	/** Quality preset new encodes start with. Starts at Quality and only goes down to meet TargetEncodeSeconds. */
+	EMoviePipelineEncodeQuality EffectiveQuality = EMoviePipelineEncodeQuality::Epic;
+	/** Output frames per second every encode has to sustain to meet TargetEncodeSeconds. 0 until the first launch. */
+	double RequiredEncodeFps = 0.0;
+
+	FOnMoviePipelineEncodeProgress EncodeProgressDelegate;
+	FOnMoviePipelineShotSegmentEncoded ShotSegmentEncodedDelegate;
+	FSourceFrameReleaseHandler SourceFrameReleaseHandler;
+	int32 NextEncodeId = 0;
+
+	int32 LaunchedProcessCount = 0;
+	/** CPU time of the encoder processes that have exited, as far as it could be read before they were gone. */
+	double ExitedProcessCpuSeconds = 0.0;
+	int32 ProcessControlFailureCount = 0;
+
+	/** Encoder output of this job, see LogFilePath. */
+	TUniquePtr<FMoviePipelineLogSink> LogSink;
+	/** Keeps a failing encoder that repeats itself every frame from flooding the engine log. */
+	FMoviePipelineLogRateLimiter EncoderLogLimiter;
+
+	/** Windows job object carrying the CPU quota, shared by every encoder of this job. */
+	void* CpuQuotaJobObject = nullptr;
+
+	/** Linux cgroup this job's encoders went into, when it was created for them (CgroupChildName); removed on destroy. */
+	FString CreatedCgroupPath;
 };
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MoviePipelineImageSequenceOutput.h"
+#include "Hash/xxhash.h"
+#include "MoviePipelineDedupImageSequenceOutput.generated.h"
+
+class UMoviePipelineExecutorShot;
+
+/**
+ * PNG image sequence output that skips writing a frame when its pixels are identical to the previous frame of the
+ * same render pass. Each written file records how many output frames it stands for, which the Command Line Encoder
+ * turns into a longer concat "duration" so the encoded video is unchanged.
+ */
+UCLASS()
+class MOVIEPIPELINEEXT_API UMoviePipelineDedupImageSequenceOutput_PNG : public UMoviePipelineImageSequenceOutput_PNG
+{
+	GENERATED_BODY()
+
+public:
+	UMoviePipelineDedupImageSequenceOutput_PNG();
+
+#if WITH_EDITOR
+	virtual FText GetDisplayText() const override { return NSLOCTEXT("MovieRenderPipeline", "ImgSequenceDedupPNGSettingDisplayName", ".png Sequence [8bit, Deduplicated]"); }
+#endif
+
+	/**
+	 * How many output frames each written file of this shot/pass covers, in the order the files were written.
+	 * Returns nullptr if nothing was tracked for the pair.
+	 */
+	const TArray<int32>* GetHeldFrameCounts(const UMoviePipelineExecutorShot* InShot, const FMoviePipelinePassIdentifier& InPassIdentifier) const;
+
+protected:
+	virtual void OnReceiveImageDataImpl(FMoviePipelineMergerOutputFrame* InMergedOutputFrame) override;
+	virtual void BeginFinalizeImpl() override;
+
+public:
+	/** Skip writing frames that are pixel-identical to the previous frame of the same pass (held frames, static title cards). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings")
+	bool bSkipDuplicateFrames;
+
+private:
+	struct FFrameFingerprint
+	{
+		FXxHash128 Hash;
+		FIntPoint Resolution = FIntPoint::ZeroValue;
+		int64 SizeInBytes = 0;
+
+		bool operator==(const FFrameFingerprint& Other) const
+		{
+			return Hash == Other.Hash && Resolution == Other.Resolution && SizeInBytes == Other.SizeInBytes;
+		}
+	};
+
+	struct FHeldFrameTrack
+	{
+		FFrameFingerprint LastWritten;
+		bool bHasLastWritten = false;
+		TArray<int32> HeldFrameCounts;
+	};
+
+	TMap<TPair<TWeakObjectPtr<const UMoviePipelineExecutorShot>, FMoviePipelinePassIdentifier>, FHeldFrameTrack> HeldFrameTracks;
+	int32 SkippedFrameCount = 0;
+};
@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MoviePipelineEncoderLoadTestCommandlet.generated.h"
+
+/**
+ * Load test of the encoder supervision in UMoviePipelineCustomEncoder, with the stand-in encoder from
+ * Extras/FakeEncoder instead of real encodes:
+ *
+ *   UnrealEditor-Cmd <project> -run=MoviePipelineEncoderLoadTest -FakeEncoder=<executable>
+ *       [-Counts=1,10,100] [-Frames=600] [-Fake="<options>"] [-CancelAfter=<seconds>] [-WorkDir=<dir>]
+ *
+ * For every count, starts that many fake encoders at once on one encoder setting and calls HasFinishedExportingImpl
+ * (which ticks OnTick) once per simulated frame until all of them are done. -Fake scripts the stand-in (see
+ * FakeEncoder.cpp), -CancelAfter cancels the encodes that long after the start. Logs per count the time OnTick
+ * spends per call, how long a cancel took to settle, how many encodes reported all of their frames, and whether every
+ * input file was deleted and every process is gone. Returns 1 if anything was left behind.
+ */
+UCLASS()
+class MOVIEPIPELINEEXT_API UMoviePipelineEncoderLoadTestCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMoviePipelineEncoderLoadTestCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
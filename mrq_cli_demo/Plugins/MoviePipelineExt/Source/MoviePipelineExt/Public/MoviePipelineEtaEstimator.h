@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * End-to-end time remaining for a job: rendering, encoding (including the frames that aren't rendered yet) and upload.
+ * Keeps an exponentially weighted moving average of the render and encode throughput in output frames per second,
+ * so a slow first shot or a burst of cheap frames only moves the estimate gradually.
+ */
+class MOVIEPIPELINEEXT_API FMoviePipelineEtaEstimator
+{
+public:
+	/** Starts a new job. Throughput measured so far is dropped, the hint is kept. */
+	void Reset(const int32 InTotalOutputFrames);
+
+	void SetTotalOutputFrames(const int32 InTotalOutputFrames) { TotalOutputFrames = FMath::Max(InTotalOutputFrames, 0); }
+
+	/** Encodes of finished shots run while later shots render, so encode time mostly hides behind rendering. */
+	void SetEncodeOverlapsRender(const bool bInOverlaps) { bEncodeOverlapsRender = bInOverlaps; }
+
+	/** Encode throughput to assume until the encoder has reported any, e.g. from an earlier job of the same template. */
+	void SetEncodeFpsHint(const double InFps) { EncodeFpsHint = InFps; }
+
+	/** Fixed time after encoding, for uploading the video. */
+	void SetUploadSeconds(const double InSeconds) { UploadSeconds = FMath::Max(InSeconds, 0.0); }
+
+	/**
+	 * Feed the cumulative number of output frames rendered / encoded so far. Time while no encoder runs (waiting for
+	 * the next shot to render) doesn't count against the encode rate.
+	 */
+	void UpdateRendered(const int32 InFramesRendered, const double InNowSeconds) { RenderRate.Update(InFramesRendered, InNowSeconds, true); }
+	void UpdateEncoded(const int32 InFramesEncoded, const double InNowSeconds, const bool bInEncoderRunning) { EncodeRate.Update(InFramesEncoded, InNowSeconds, bInEncoderRunning); }
+
+	/** Seconds until the job is done, or a negative value while there isn't enough data yet. */
+	double GetRemainingSeconds() const;
+	double GetRenderRemainingSeconds() const;
+	double GetEncodeRemainingSeconds() const;
+
+	/** Smoothed throughput in output frames per second, negative until measured. */
+	double GetRenderFps() const { return RenderRate.Fps; }
+	double GetEncodeFps() const { return EncodeRate.Fps; }
+
+private:
+	struct FRate
+	{
+		double Fps = -1.0;
+		int32 Frames = 0;
+		int32 SampleFrames = 0;
+		double SampleStartSeconds = -1.0;
+
+		void Update(const int32 InFrames, const double InNowSeconds, const bool bInActive);
+	};
+
+	double GetEffectiveEncodeFps() const;
+
+	FRate RenderRate;
+	FRate EncodeRate;
+	int32 TotalOutputFrames = 0;
+	bool bEncodeOverlapsRender = false;
+	double EncodeFpsHint = -1.0;
+	double UploadSeconds = 0.0;
+};
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Low bitrate HLS preview of a render in progress. Finished frames are cut into short MPEG-TS segments by a small
+ * encoder process, one segment at a time, and listed in an EVENT playlist that only ever grows, so the preview can be
+ * watched while later frames are still rendering. Best effort: a segment that fails to encode is left out of the
+ * playlist and the preview carries on with the next one.
+ */
+class MOVIEPIPELINEEXT_API FMoviePipelineHlsPreview
+{
+public:
+	struct FSettings
+	{
+		FString ExecutablePath;
+		FString OutputDirectory;
+		FFrameRate FrameRate = FFrameRate(30, 1);
+		float SegmentSeconds = 2.f;
+		int32 Height = 360;
+		int32 BitrateKbps = 600;
+	};
+
+	explicit FMoviePipelineHlsPreview(const FSettings& InSettings);
+
+	/** Gives a running segment a few seconds to finish, then closes the playlist with what made it and deletes the frames it took over. */
+	~FMoviePipelineHlsPreview();
+
+	/** Queues a finished frame, shown for InHeldFrameCount frames. Frames must be added in playback order. */
+	void AddFrame(const FString& InFilePath, const int32 InHeldFrameCount);
+
+	/**
+	 * Takes over deleting a frame the preview hasn't encoded yet, so the real encode can't delete it from under a queued
+	 * segment. It is deleted once the last segment reading it exits. Returns false for frames the preview is done with.
+	 */
+	bool TakeOverDeletion(const FString& InFilePath);
+
+	/** No more frames are coming: what is queued goes into a last, possibly short, segment before the playlist is closed. */
+	void Finish() { bFinishing = true; }
+
+	/** Reaps the segment encoder if it exited and starts the next segment once a full one is queued. Call every frame. */
+	void Tick();
+
+	bool IsFinished() const { return bPlaylistClosed; }
+	bool HasSegments() const { return Segments.Num() > 0; }
+	FString GetPlaylistPath() const { return Settings.OutputDirectory / TEXT("index.m3u8"); }
+
+private:
+	struct FQueuedFrame
+	{
+		FString FilePath;
+		int32 HeldFrameCount = 1;
+	};
+
+	struct FSegment
+	{
+		FString FileName;
+		double DurationSeconds = 0.0;
+		bool bDiscontinuity = false;
+	};
+
+	void LaunchSegment();
+	void OnSegmentExited(const int32 InReturnCode);
+	/** Deletes the frames of the exited segment that were handed over and that no queued frame still needs. */
+	void DeleteReadFrames();
+	void WritePlaylist() const;
+	void ClosePipes();
+
+	FSettings Settings;
+	int32 SegmentFrameCount = 1;
+
+	TArray<FQueuedFrame> QueuedFrames;
+	int32 QueuedFrameCount = 0;
+	/** Frames queued or read by the running segment. */
+	TSet<FString> UnreadFilePaths;
+	/** Unread frames the preview deletes once it is done with them. */
+	TSet<FString> FilePathsToDelete;
+
+	TArray<FSegment> Segments;
+	int32 NextSegmentIndex = 0;
+	int32 EncodedFrameCount = 0;
+	bool bSkippedSegment = false;
+
+	FProcHandle ProcessHandle;
+	void* ReadPipe = nullptr;
+	void* WritePipe = nullptr;
+	FString RunningListPath;
+	FSegment RunningSegment;
+	int32 RunningFrameCount = 0;
+	TArray<FString> RunningFilePaths;
+	FString RunningOutput;
+
+	bool bFinishing = false;
+	bool bPlaylistClosed = false;
+};
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+
+/**
+ * Caps how many messages per second each category may log. Messages over the cap are counted instead, and the count
+ * is handed back with the first message the category is allowed to log again.
+ */
+class MOVIEPIPELINEEXT_API FMoviePipelineLogRateLimiter
+{
+public:
+	explicit FMoviePipelineLogRateLimiter(const int32 InMaxPerSecond = 10)
+		: MaxPerSecond(InMaxPerSecond)
+	{}
+
+	/** Returns true if the message may be logged. OutSuppressedCount is how many were dropped since the last one that was. */
+	bool Allow(const FName InCategory, int32& OutSuppressedCount);
+
+private:
+	struct FWindow
+	{
+		double StartSeconds = -1.0;
+		int32 Count = 0;
+		int32 Suppressed = 0;
+	};
+
+	int32 MaxPerSecond;
+	TMap<FName, FWindow> Windows;
+};
+
+/**
+ * Appends lines to a file from a background task so log I/O never stalls the game thread. Lines are buffered on the
+ * calling thread and written in batches, at most one write in flight so they land in order.
+ */
+class MOVIEPIPELINEEXT_API FMoviePipelineLogSink
+{
+public:
+	explicit FMoviePipelineLogSink(const FString& InFilePath);
+	~FMoviePipelineLogSink();
+
+	const FString& GetFilePath() const { return FilePath; }
+
+	/** Buffers a line, prefixed with the time since the sink was created. */
+	void Write(const FString& InLine);
+
+	/** Hands the buffered lines to a background write unless one is still running. Waits for everything to be written if bWait. */
+	void Flush(const bool bWait);
+
+	/**
+	 * How interesting an encoder output line is. Progress statistics are Verbose, real failures are Error, lines that
+	 * only look alarming (e.g. "error concealment" notes, deprecation notices) are at most Warning.
+	 */
+	static ELogVerbosity::Type ClassifyEncoderLine(const FString& InLine);
+
+private:
+	FString FilePath;
+	double StartSeconds;
+	TStringBuilder<4096> PendingText;
+	UE::Tasks::FTask WriteTask;
+};
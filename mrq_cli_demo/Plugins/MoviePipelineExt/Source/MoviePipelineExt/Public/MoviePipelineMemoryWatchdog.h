@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Keeps a long render's memory bounded. Samples the process's physical memory and the GPU pools (textures and the
+ * render target pool) every few frames, and once either is over its threshold, collects garbage and frees unused
+ * render targets at the next shot boundary, where the previous shot's spawnables and targets are no longer needed.
+ * High-water marks go out with every progress report, so the server sees growth before it becomes a crash.
+ */
+class MOVIEPIPELINEEXT_API FMoviePipelineMemoryWatchdog
+{
+public:
+	struct FSettings
+	{
+		int32 SampleIntervalFrames = 30;
+		// Zero leaves that kind of memory alone, it is only reported.
+		double ProcessThresholdMB = 0.0;
+		double GpuThresholdMB = 0.0;
+	};
+
+	FMoviePipelineMemoryWatchdog();
+
+	void Configure(const FSettings& InSettings);
+
+	/** Call every frame while rendering. Takes a sample every SampleIntervalFrames frames. */
+	void Tick();
+
+	/** Call when the pipeline moves on to another shot. Trims if the last sample was over a threshold. */
+	void OnShotBoundary();
+
+	double GetProcessMB() const { return ProcessBytes / (1024.0 * 1024.0); }
+	double GetPeakProcessMB() const { return PeakProcessBytes / (1024.0 * 1024.0); }
+	double GetGpuMB() const { return GpuBytes / (1024.0 * 1024.0); }
+	double GetPeakGpuMB() const { return PeakGpuBytes / (1024.0 * 1024.0); }
+	int32 GetTrimCount() const { return TrimCount; }
+	double GetTrimmedMB() const { return TrimmedBytes / (1024.0 * 1024.0); }
+
+private:
+	void Sample();
+	void RequestRenderTargetPoolSize();
+	void Trim();
+	bool IsOverThreshold() const;
+
+	FSettings Settings;
+	int32 FramesSinceSample = 0;
+
+	uint64 ProcessBytes = 0;
+	uint64 PeakProcessBytes = 0;
+	uint64 GpuBytes = 0;
+	uint64 PeakGpuBytes = 0;
+
+	int32 TrimCount = 0;
+	int64 TrimmedBytes = 0;
+
+	// Written on the render thread, which owns the pool. Each sample reads the size the previous one requested.
+	TSharedRef<std::atomic<uint64>, ESPMode::ThreadSafe> RenderTargetPoolBytes;
+};
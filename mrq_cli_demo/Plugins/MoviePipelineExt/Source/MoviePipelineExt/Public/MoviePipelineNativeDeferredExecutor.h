@@ -2,13 +2,19 @@
 
 #include "CoreMinimal.h"
 #include "MoviePipelineExecutor.h"
+#include "MoviePipelineEtaEstimator.h"
+#include "MoviePipelineHlsPreview.h"
+#include "MoviePipelineMemoryWatchdog.h"
+#include "MoviePipelineResourceMonitor.h"
+#include "MoviePipelineCustomEncoder.h"
 #include "MoviePipelineNativeDeferredExecutor.generated.h"
 
-class UMoviePipelineCustomEncoder;
 class URenderGateWorldSubsystem;
 class UMoviePipelineBase;
 class UMoviePipelineOutputSetting;
 class UMoviePipelineGameOverrideSetting;
+class ULevelSequence;
+class FJsonObject;
 
 // Render job status enumeration for server communication
 UENUM(BlueprintType)
@@ -56,6 +62,18 @@ private:
 	UFUNCTION()
 	void OnReceiveJobInfo(int32 RequestIndex, int32 ResponseCode, const FString& Message);
 
+	/**
+	 * Deterministic hash of everything that decides the output video: the sequence and map packages with their
+	 * dependencies, the resolved job configuration, the project's encoder settings and the engine/plugin build.
+	 */
+	FString ComputeRenderFingerprint(ULevelSequence* InLevelSequence) const;
+
+	/** Reports the fingerprint to the server, which answers whether a video with the same fingerprint already exists. */
+	void RequestRenderCacheLookup();
+
+	UFUNCTION()
+	void OnReceiveRenderCacheLookup(int32 RequestIndex, int32 ResponseCode, const FString& Message);
+
 	void CallbackOnEnginePreExit();
 
 	bool PollReady(float DeltaTime);
@@ -72,6 +90,30 @@ private:
 
 	void WaitShaderCompilingComplete();
 
+	/** Checks the materials the warm-up commandlet compiled for this template against what loading found in the DDC. */
+	void VerifyShaderWarmUpManifest(ULevelSequence* InLevelSequence);
+
+	FString GetFrameManifestPath() const;
+	FString GetVideoOutputDirectory() const;
+
+	/** Works out the display rate frames this process renders: the whole sequence, an explicit range or one chunk of it. */
+	void ResolveRenderRange(ULevelSequence* InLevelSequence);
+
+	/** Scales the output resolution and replaces the anti-aliasing sample and warm-up counts for draft renders. */
+	void ApplyRenderOverrides();
+
+	/** Pushes the resolved range into the MRQ output setting, with warm-up frames when it starts mid-sequence. */
+	void ApplyRenderRange();
+
+	/** Moves the render range past frames an earlier attempt's manifest lists as finished and hands those to the encoder. */
+	void TryResumeFromFrameManifest(ULevelSequence* InLevelSequence);
+
+	/** Appends frames that have been flushed to disk since the last call. Held frames are only recorded once their length is final. */
+	void AppendFlushedFramesToManifest(const bool bHeldCountsFinal);
+
+	/** Records a finished shot segment, so a resumed render can start after it even once its frames are deleted. */
+	void AppendShotSegmentToManifest(const FMoviePipelineShotSegment& InSegment);
+
 private:
 	UPROPERTY()
 	UMoviePipeline* DeferredMoviePipeline = nullptr;
@@ -105,8 +147,86 @@ private:
 	bool bWaiting = false;
 	bool bRendering = false;
 
+	// -ResumeRender: continue from the frames an earlier attempt of this job left on disk.
+	bool bResumeRender = false;
+	int32 ResumedOutputFrameCount = 0;
+
+	// Files already written to the frame manifest, keyed by (shot output index, render pass name).
+	TMap<TPair<int32, FString>, int32> ManifestRecordedFileCounts;
+	double LastManifestWriteTime = 0.0;
+
+	// -RenderChunk=<i> -RenderChunkCount=<k>: render only the i-th of k equal slices and leave encoding to the server.
+	int32 RenderChunkIndex = INDEX_NONE;
+	int32 RenderChunkCount = 0;
+
+	// -FrameRangeStart=<n> -FrameRangeEnd=<n>: explicit display rate range, end exclusive.
+	TOptional<int32> RequestedRangeStart;
+	TOptional<int32> RequestedRangeEnd;
+
+	// -ChunkWarmUpFrames=<n>: frames run before a range that starts mid-sequence so temporal effects have history.
+	int32 ChunkWarmUpFrameCount = 8;
+
+	// -ResolutionScale=<0..1> -SpatialSamples=<n> -TemporalSamples=<n> -WarmUpFrames=<n>: draft overrides of the output
+	// resolution and the anti-aliasing setting. Unset ones keep the job configuration's values.
+	float ResolutionScale = 1.f;
+	TOptional<int32> SpatialSampleCount;
+	TOptional<int32> TemporalSampleCount;
+	TOptional<int32> WarmUpFrameCount;
+
+	// -FrameStride=<n>: render every n-th frame, at 1/n of the frame rate so the video keeps the sequence's length.
+	int32 FrameStride = 1;
+
+	// -EncoderPriority=<-2..2> -EncoderCpuAffinity=<cpus> -EncoderCpuQuota=<cores> -EncoderCgroup=<path>: keep the encoder off the render's cores.
+	TOptional<int32> EncoderPriority;
+	FString EncoderCpuAffinity;
+	float EncoderCpuQuota = 0.f;
+	FString EncoderCgroup;
+
+	// -EncoderTargetSeconds=<s>: encode deadline, the encoder drops to faster presets if it can't make it.
+	float EncoderTargetSeconds = 0.f;
+
+	// -EncoderLogPath=<file>: where the encoder writes its output. Defaults to encoder_<JobId>.log beside the engine log.
+	FString EncoderLogPath;
+
+	// -FragmentedOutput: encode fragmented MP4 so the server can upload the video while it is being written.
+	bool bFragmentedOutput = false;
+
+	// -PreviewHls -PreviewHeight=<px> -PreviewBitrateKbps=<kbps> -PreviewSegmentSeconds=<s>: live HLS preview of the frames rendered so far.
+	bool bPreviewHls = false;
+	int32 PreviewHeight = 360;
+	int32 PreviewBitrateKbps = 600;
+	float PreviewSegmentSeconds = 2.f;
+	TUniquePtr<FMoviePipelineHlsPreview> HlsPreview;
+	FString PreviewPassName;
+	void StartHlsPreview();
+	void AddPreviewFields(FJsonObject& InOutJson) const;
+
+	// -EncodeFpsHint=<fps> -UploadEtaSeconds=<s>: what the server knows about this template's encode rate and upload time.
+	float EncodeFpsHint = -1.f;
+	float UploadEtaSeconds = 0.f;
+
+	// -ShaderWarmUpManifest=<file>: manifest of the shader warm-up commandlet, by default Saved/ShaderWarmUp/<sequence>.json.
+	// Hits are manifest materials whose shaders were ready once loaded, misses had to be compiled (or changed since).
+	FString ShaderWarmUpManifestPath;
+	bool bShaderWarmUpManifestFound = false;
+	int32 ShaderCacheHits = 0;
+	int32 ShaderCacheMisses = 0;
+	int32 ShaderJobsAtStart = 0;
+	double ShaderWaitSeconds = 0.0;
+
+	// Rendering waits for the server's answer; a hit finishes the job without rendering.
+	FString RenderFingerprint;
+	int32 RenderCacheRequestIndex = INDEX_NONE;
+	bool bRenderCacheLookupPending = false;
+
+	FFrameNumber SequenceStartDisplayFrame;
+	FFrameNumber SequenceEndDisplayFrame;
+	FFrameNumber RenderStartDisplayFrame;
+	FFrameNumber RenderEndDisplayFrame;
+
 	float TimeoutSec = 120.f; // Waiting for scene data synchronization
 	float PollIntervalSec = 1.f;
+	const double ShaderWaitLogIntervalSec = 10.0;
 
 	double StartSeconds = 0.0;
 	FTSTicker::FDelegateHandle PollTickerHandle;
@@ -127,4 +247,27 @@ private:
 	float LastReportedProgress = -1.f;
 	const float ProgressReportInterval = 1.0f; // In seconds
 	const float ProgressReportStep = 0.01f;	// 1% step
+
+	// Remaining time of render, encode and upload together, reported as progress_eta_seconds.
+	FMoviePipelineEtaEstimator EtaEstimator;
+	void UpdateEtaEstimator();
+	float ComputeEncodingProgress() const;
+
+	// Encoder processes as last reported, and running totals over all of them, kept up to date per report.
+	void OnEncodeProgress(const FMoviePipelineEncodeProgress& InProgress);
+	TMap<int32, FMoviePipelineEncodeProgress> ActiveEncodes;
+	int32 EncodedOutputFrames = 0;
+	int64 EncodedBytes = 0;
+	int32 FailedEncodeCount = 0;
+	void AddEtaFields(FJsonObject& InOutJson) const;
+
+	// Peak VRAM, RAM, CPU and disk use of the job, reported with render-complete for the server's per-template profile.
+	FMoviePipelineResourceMonitor ResourceMonitor;
+
+	// -MemoryWatchdogFrames=<n> -MemoryTrimThresholdMB=<mb> -GpuMemoryTrimThresholdMB=<mb>: sample process and GPU-pool
+	// memory every n frames and trim at the next shot boundary once one is over its threshold (0: only report).
+	FMoviePipelineMemoryWatchdog::FSettings MemoryWatchdogSettings;
+	FMoviePipelineMemoryWatchdog MemoryWatchdog;
+	int32 LastShotIndex = INDEX_NONE;
+	void AddMemoryFields(FJsonObject& InOutJson) const;
 };
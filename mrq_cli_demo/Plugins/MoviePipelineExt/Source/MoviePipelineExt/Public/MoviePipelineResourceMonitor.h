@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Peak resource use of a job, reported to the server so it can learn how much room each template needs before it
+ * packs the next jobs onto the machine. Sampled while the job runs; CPU use is averaged per sample window so a single
+ * busy frame doesn't count as the peak. Processes the job starts (the encoders) count toward its RAM and CPU peaks.
+ */
+class MOVIEPIPELINEEXT_API FMoviePipelineResourceMonitor
+{
+public:
+	/** Reports the memory and the total CPU time so far of the processes the job started, read once per sample. */
+	typedef TFunction<void(uint64& OutMemoryBytes, double& OutCpuSeconds)> FChildProcessSampler;
+
+	/** Call every frame. Takes a sample once InIntervalSeconds have passed since the last one. */
+	void Tick(const double InIntervalSeconds);
+
+	void SetChildProcessSampler(FChildProcessSampler&& InSampler) { ChildProcessSampler = MoveTemp(InSampler); }
+
+	/** Bytes written to the output directory that stay on disk at least until the encoder consumes them. */
+	void AddDiskBytes(const int64 InBytes) { DiskBytes += FMath::Max<int64>(InBytes, 0); }
+
+	double GetPeakVideoMemoryMB() const { return PeakVideoMemoryBytes / (1024.0 * 1024.0); }
+	double GetPeakPhysicalMemoryMB() const;
+	double GetPeakCpuCores() const { return PeakCpuCores; }
+	double GetDiskMB(const int64 InExtraBytes) const { return (DiskBytes + InExtraBytes) / (1024.0 * 1024.0); }
+
+private:
+	void Sample(const double InWindowSeconds);
+
+	double LastSampleSeconds = -1.0;
+	double CpuPercentSum = 0.0;
+	int32 CpuPercentCount = 0;
+
+	FChildProcessSampler ChildProcessSampler;
+	double LastChildCpuSeconds = 0.0;
+
+	double PeakCpuCores = 0.0;
+	uint64 PeakVideoMemoryBytes = 0;
+	/** This process and its children together, at the moment of a sample. */
+	uint64 PeakCombinedPhysicalBytes = 0;
+	int64 DiskBytes = 0;
+};
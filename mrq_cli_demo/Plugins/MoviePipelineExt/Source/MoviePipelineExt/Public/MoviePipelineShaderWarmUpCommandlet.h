@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MoviePipelineShaderWarmUpCommandlet.generated.h"
+
+class UMaterialInterface;
+class UPrimitiveComponent;
+
+/**
+ * Compiles, ahead of the first render, the shaders a template needs, so renders find them in the DDC instead of
+ * compiling them while the job waits:
+ *
+ *   UnrealEditor-Cmd <project> -run=MoviePipelineShaderWarmUp -Map=<map> -LevelSequence=<sequence>
+ *       [-Manifest=<file>] [-SharedDataCachePath=<dir>] -AllowCommandletRendering
+ *
+ * Loads the map (with its sublevels and World Partition actors) and the sequence (with its spawnables), collects
+ * every material their primitive components render with and the mesh types each is used on, compiles the
+ * materials' shader maps for the running shader platform and requests the PSOs of the components. The shader maps
+ * go to the DDC, so -SharedDataCachePath (or UE-SharedDataCachePath) should point where the render nodes read.
+ * Run it with the RHI the renders use; -AllowCommandletRendering keeps the commandlet from falling back to the
+ * null RHI, which compiles nothing a render can use. Writes a FMoviePipelineShaderWarmUpManifest for the executor.
+ */
+UCLASS()
+class MOVIEPIPELINEEXT_API UMoviePipelineShaderWarmUpCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMoviePipelineShaderWarmUpCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	/** Adds the materials of InComponent, with the mesh type they are used on, and requests its PSOs. */
+	void CollectComponent(UPrimitiveComponent* InComponent);
+
+	void CollectPackageObjects(const UPackage* InPackage);
+
+	// Nothing is garbage collected while the commandlet runs, so the materials stay valid until the manifest is written.
+	TMap<UMaterialInterface*, TSet<FString>> MaterialUsages;
+	int32 PrecachedComponentCount = 0;
+};
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * What the shader warm-up commandlet compiled for one template: every material its map and sequence render with,
+ * the mesh types each is used on, and the package hash it was compiled from. The shaders themselves live in the
+ * DDC; the manifest lets a render tell which of them it should find there, and whether it did.
+ */
+struct MOVIEPIPELINEEXT_API FMoviePipelineShaderWarmUpManifest
+{
+	struct FMaterialEntry
+	{
+		FString MaterialPath;
+		FString PackageHash;
+		TArray<FString> Usages;
+	};
+
+	FString EngineVersion;
+	FString ShaderPlatform;
+	FString Map;
+	FString LevelSequence;
+	FString CreatedAt;
+	double CompileSeconds = 0.0;
+	int32 CompileJobCount = 0;
+	TArray<FMaterialEntry> Materials;
+
+	bool Save(const FString& InPath) const;
+	bool Load(const FString& InPath);
+
+	/** Where the commandlet writes, and the executor looks, when neither is told otherwise. */
+	static FString GetDefaultPath(const FString& InLevelSequencePath);
+
+	/** Engine version and shader platform of the running process, the part of a manifest that has to match as a whole. */
+	static FString GetCurrentEngineVersion();
+	static FString GetCurrentShaderPlatform();
+
+	/** MD5 of the package file the object lives in, empty if it has none on disk. */
+	static FString HashObjectPackage(const FString& InObjectPath);
+};
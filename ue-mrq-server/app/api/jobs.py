@@ -2,17 +2,24 @@ import json, uuid, math
 from datetime import datetime
 from typing import Optional, Union
 from fastapi import APIRouter, HTTPException, Depends, Header, Query, Request
+from fastapi.responses import Response, StreamingResponse
 from sqlalchemy.orm import Session
 from sqlalchemy import select
 from app.storage.oss_adapter import *
 from ..db.database import session_scope
 from ..db.models import Job
-from ..models.schemas import CreateJobRequest, JobResponse, Progress, CancelResponse, UEJobResponse, JobNoParamsResponse, JobParamsResponse
-from ..models.status import JobStatus
+from ..db.job_events import job_events
+from ..models.schemas import CreateJobRequest, JobResponse, Progress, CancelResponse, RetryResponse, UEJobResponse, JobNoParamsResponse, JobParamsResponse
+from ..models.status import JobStatus, TERMINAL_STATUSES
 from ..utils.time import to_cn_iso
 from ..deps import get_registry
 from ..templates.loader import TemplateRegistry
 from ..config import settings
+from ..runner.chunks import create_chunk_jobs, cancel_chunk_jobs, parent_job_ids, is_parent_job, chunks_to_retry, start_final_encode
+from ..runner.progress_ingest import progress_ingest
+from ..storage.multipart_upload import abort_streaming_upload
+from ..scheduler.dispatch import dispatch_queue
+from ..farm.coordinator import release_lease
 
 router = APIRouter(prefix="/jobs", tags=["jobs"])
 
@@ -58,6 +65,9 @@ async def create_job(req: CreateJobRequest, request: Request, registry: Template
     tpl = registry.get(req.template_id)
     if not tpl:
         raise HTTPException(status_code=400, detail={"code":"TEMPLATE_NOT_FOUND","message":"unknown template_id"})
+    # A job's cgroup is placed below the one the server was given, there is nothing to place it in without one
+    if req.encoder and req.encoder.cgroup and not settings.ENCODER_CGROUP:
+        raise HTTPException(status_code=400, detail={"code":"CGROUP_NOT_CONFIGURED","message":"encoder.cgroup needs ENCODER_CGROUP"})
     
     job_id = str(uuid.uuid4())
     
@@ -67,6 +77,9 @@ async def create_job(req: CreateJobRequest, request: Request, registry: Template
     except AttributeError:
         payload_dict = req.dict()
 
+    # Stored resolved, so the runner, the final chunk encode and the render cache see the same values
+    payload_dict["render"] = req.render.resolved() if req.render else None
+
     base_url = settings.MRQ_SERVER_BASE_URL or str(request.base_url)
     payload_dict["mrq_server_base_url"] = base_url
     payload = json.dumps(payload_dict, ensure_ascii=False)
@@ -76,11 +89,35 @@ async def create_job(req: CreateJobRequest, request: Request, registry: Template
         db.add(job)
         db.commit()
 
+        # Split into frame-range chunks that render in parallel; this job aggregates them.
+        # A coordinator leaves that to the worker that leases the job, where the chunks' frames come together.
+        first_job_id = job_id
+        if req.chunks > 1 and settings.NODE_ROLE != "coordinator":
+            children = create_chunk_jobs(db, job, req.chunks)
+            db.commit()
+            first_job_id = children[0].job_id
+            for child in children:
+                dispatch_queue.enqueue(child.job_id, child.created_at)
+        else:
+            dispatch_queue.enqueue(job.job_id, job.created_at)
+
         # Calculate queue position
-        pos = db.execute(select(Job).where(Job.status==JobStatus.queued.value).order_by(Job.created_at.asc())).scalars().all()
-        queue_pos = next((i for i, j in enumerate(pos) if j.job_id == job_id), len(pos)) + 1
+        pos = db.execute(select(Job).where(Job.status==JobStatus.queued.value, Job.job_id.notin_(parent_job_ids())).order_by(Job.created_at.asc())).scalars().all()
+        queue_pos = next((i for i, j in enumerate(pos) if j.job_id == first_job_id), len(pos)) + 1
     return {"session_id": req.session_id, "job_id": job_id, "status": JobStatus.queued.value, "queue_position": queue_pos, "template_id": req.template_id}
 
+def _preview_url(job_id: str, payload: dict) -> Optional[str]:
+    return f"/system/preview/{job_id}/index.m3u8" if payload.get("preview_playlist") else None
+
+@router.get("/events")
+async def job_events_stream(request: Request):
+    """
+    Server-sent events: a `job` event with a job's state whenever its status, progress, ETA or artifacts change.
+    Starts with the state of every job that hasn't ended. A client that falls behind gets each job's newest state
+    instead of every step in between.
+    """
+    return _event_stream(request, None)
+
 @router.get("/{job_id}", response_model=Union[JobResponse, UEJobResponse])
 async def get_job(job_id: str, x_client: Optional[str] = Header(default=None)):
     with session_scope() as db:
@@ -111,6 +148,7 @@ async def get_job(job_id: str, x_client: Optional[str] = Header(default=None)):
                 payload=json.loads(job.payload) if job.payload else None,
             )
         else:
+            payload = json.loads(job.payload) if job.payload else {}
             return JobResponse(
                 session_id=job.session_id, 
                 job_id=job.job_id, 
@@ -119,7 +157,10 @@ async def get_job(job_id: str, x_client: Optional[str] = Header(default=None)):
                 artifacts=artifacts, 
                 template_id=job.template_id, 
                 timestamps=ts,
-                params=json.loads(job.payload).get("params")
+                params=payload.get("params"),
+                metrics={**(payload.get("metrics") or {}), **progress_ingest.live_metrics(job.job_id)} or None,
+                render=payload.get("render"),
+                preview_url=_preview_url(job.job_id, payload),
             )
         
 @router.get("/{job_id}/progress", response_model=JobNoParamsResponse)
@@ -151,9 +192,61 @@ async def get_job_progress(job_id: str):
             status=JobStatus(job.status),
             progress=progress,
             artifacts=artifacts,
-            timestamps=ts
+            timestamps=ts,
+            preview_url=_preview_url(job.job_id, json.loads(job.payload) if job.payload else {}),
         )
 
+@router.get("/{job_id}/events")
+async def job_events_stream_for(job_id: str, request: Request):
+    """
+    Server-sent events of one job, like GET /jobs/events. Starts with its current state and ends with an `end` event
+    once the job has ended. An ended job answers 204, which tells EventSource to stop reconnecting.
+    """
+    with session_scope() as db:
+        job = db.get(Job, job_id)
+        if job is None:
+            raise HTTPException(status_code=404, detail={"code": "JOB_NOT_FOUND"})
+        if job.status in TERMINAL_STATUSES:
+            return Response(status_code=204)
+    return _event_stream(request, job_id)
+
+def _event_stream(request: Request, job_id: Optional[str]) -> StreamingResponse:
+    # Subscribed before the snapshot is read, so no change falls in between
+    subscriber = job_events.subscribe(job_id)
+    try:
+        with session_scope() as db:
+            if job_id is not None:
+                jobs = [db.get(Job, job_id)]
+            else:
+                jobs = db.execute(select(Job).where(Job.status.notin_(list(TERMINAL_STATUSES))).order_by(Job.created_at.desc()).limit(200)).scalars().all()
+            snapshot = [job_events.current(job) for job in jobs if job is not None]
+    except Exception:
+        job_events.unsubscribe(subscriber)
+        raise
+
+    def _format(state: dict) -> str:
+        return f"event: job\ndata: {json.dumps(state, ensure_ascii=False)}\n\n"
+
+    async def _events():
+        try:
+            for state in snapshot:
+                yield _format(state)
+            ended = job_id is not None and snapshot and snapshot[0].get("status") in TERMINAL_STATUSES
+            # One job's stream ends with the job
+            while not ended and not await request.is_disconnected():
+                batch = await subscriber.next_batch(settings.EVENTS_KEEPALIVE_SECONDS)
+                if not batch:
+                    yield ": keepalive\n\n"
+                for state in batch:
+                    yield _format(state)
+                    ended = job_id is not None and state.get("status") in TERMINAL_STATUSES
+            if ended:
+                yield "event: end\ndata: {}\n\n"
+        finally:
+            job_events.unsubscribe(subscriber)
+
+    return StreamingResponse(_events(), media_type="text/event-stream", headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"})
+
 @router.get("/{job_id}/params", response_model=JobParamsResponse)
 async def get_job_params(job_id: str):
     with session_scope() as db:
@@ -180,8 +273,46 @@ async def cancel_job(job_id: str):
         
         job.status = JobStatus.canceling.value
         db.commit()
+        cancel_chunk_jobs(db, job.job_id)
         if job.pid:
             kill_tree(job.pid)
+        abort_streaming_upload(job.job_id)
         job.status = JobStatus.canceled.value
         db.commit()
+        dispatch_queue.release(job.job_id)
+        if settings.NODE_ROLE == "coordinator":
+            release_lease(job.job_id)
         return CancelResponse(session_id=job.session_id, job_id=job.job_id, status=JobStatus(job.status), message="cancellation requested")
+
+
+@router.post("/{job_id}/retry", response_model=RetryResponse)
+async def retry_job(job_id: str):
+    """Requeue a failed or canceled job. UE resumes from the frames the previous attempt completed."""
+    from ..runner.runner import requeue_for_resume
+    with session_scope() as db:
+        job = db.get(Job, job_id)
+        if not job:
+            raise HTTPException(status_code=404, detail={"code": "JOB_NOT_FOUND"})
+        if job.status_enum not in (JobStatus.failed, JobStatus.canceled):
+            raise HTTPException(status_code=400, detail={"code": "JOB_NOT_RETRYABLE"})
+
+        # A split job renders nothing itself: its failed and canceled chunks go back in line instead,
+        # or, when every chunk rendered, the final encode runs again
+        if is_parent_job(db, job.job_id):
+            children = chunks_to_retry(db, job.job_id)
+            attempt = requeue_for_resume(job)
+            for child in children:
+                requeue_for_resume(child)
+            if not children:
+                job.status = JobStatus.encoding.value
+            db.commit()
+            for child in children:
+                dispatch_queue.enqueue(child.job_id, child.created_at)
+            if not children:
+                start_final_encode(job.job_id)
+            return RetryResponse(session_id=job.session_id, job_id=job.job_id, status=JobStatus(job.status), attempt=attempt, message=f"requeued {len(children)} chunks" if children else "final encode restarted")
+
+        attempt = requeue_for_resume(job)
+        db.commit()
+        dispatch_queue.enqueue(job.job_id, job.created_at)
+        return RetryResponse(session_id=job.session_id, job_id=job.job_id, status=JobStatus(job.status), attempt=attempt, message="requeued, resuming from last completed frame")
@@ -1,13 +1,16 @@
 from fastapi import APIRouter, HTTPException, Query
-from fastapi.responses import FileResponse, HTMLResponse
+from fastapi.responses import HTMLResponse
 from pydantic import BaseModel
 from pathlib import Path
 import sys
 import subprocess
 from ..config import settings
+from ..utils.ranged_file import RangedFileResponse
 import os
 from ..db.database import session_scope
-from ..db.models import JobArtifact
+from ..db.models import Job, JobArtifact
+from typing import Optional
+import json
 from urllib.parse import quote, unquote
 import html
 
@@ -81,6 +84,20 @@ def _is_allowed_path(target: Path) -> bool:
     return False
 
 
+def _preview_dir(job_id: str) -> Optional[Path]:
+    """Directory of the HLS preview UE reported for the job, None until the first segment exists."""
+    with session_scope() as db:
+        job = db.get(Job, job_id)
+        playlist = json.loads(job.payload).get("preview_playlist") if job and job.payload else None
+    if not playlist:
+        return None
+    # The path comes from an unauthenticated progress post; only ever the executor's <output>/preview/index.m3u8
+    playlist_path = Path(playlist).resolve()
+    if playlist_path.name != "index.m3u8" or playlist_path.parent.name != "preview":
+        return None
+    return playlist_path.parent
+
+
 def _media_type_for(target: Path) -> str:
     ext = target.suffix.lower()
     if ext == ".mp4":
@@ -91,11 +108,21 @@ def _media_type_for(target: Path) -> str:
         return "video/webm"
     if ext == ".mkv":
         return "video/x-matroska"
+    if ext == ".m3u8":
+        return "application/vnd.apple.mpegurl"
+    if ext == ".ts":
+        return "video/mp2t"
     return "application/octet-stream"
 
 
-@router.get("/video")
+def _video_cache_control() -> str:
+    # A re-rendered video gets a new ETag, browsers revalidate once max-age is up
+    return f"private, max-age={settings.VIDEO_CACHE_MAX_AGE}" if settings.VIDEO_CACHE_MAX_AGE > 0 else "no-cache"
+
+
+@router.api_route("/video", methods=["GET", "HEAD"])
 async def serve_video(path: str = Query(..., description="Absolute path to video file")):
+    """The video file, with byte ranges for seeking and ETag/Last-Modified for revalidation."""
     raw_path = unquote(path)
     target = Path(raw_path).resolve()
     if not _is_allowed_path(target):
@@ -103,26 +130,73 @@ async def serve_video(path: str = Query(..., description="Absolute path to video
     if not target.exists() or not target.is_file():
         raise HTTPException(status_code=404, detail={"code": "PATH_NOT_FOUND"})
     media = _media_type_for(target)
-    return FileResponse(
-        path=str(target),
+    return RangedFileResponse(
+        path=target,
         media_type=media,
         filename=target.name,
-        content_disposition_type="inline",
+        cache_control=_video_cache_control(),
     )
 
 
-@router.get("/player", response_class=HTMLResponse)
-async def video_player(path: str = Query(..., description="Absolute path to video file")):
-    raw_path = unquote(path)
-    target = Path(raw_path).resolve()
-    if not _is_allowed_path(target):
+@router.api_route("/preview/{job_id}/{name}", methods=["GET", "HEAD"])
+async def serve_preview(job_id: str, name: str):
+    """
+    Playlist and segments of a job's live HLS preview. Segment URIs in the playlist are relative, so they resolve
+    to this route too. The playlist grows while the job renders and must not be cached.
+    """
+    preview_dir = _preview_dir(job_id)
+    if preview_dir is None:
+        raise HTTPException(status_code=404, detail={"code": "PREVIEW_NOT_FOUND"})
+    target = (preview_dir / name).resolve()
+    if target.parent != preview_dir or target.suffix.lower() not in (".m3u8", ".ts"):
         raise HTTPException(status_code=400, detail={"code": "PATH_NOT_ALLOWED"})
-    if not target.exists() or not target.is_file():
+    if not target.is_file():
         raise HTTPException(status_code=404, detail={"code": "PATH_NOT_FOUND"})
+    # Segments never change once listed
+    cache_control = "no-cache" if target.suffix.lower() == ".m3u8" else _video_cache_control()
+    return RangedFileResponse(path=target, media_type=_media_type_for(target), cache_control=cache_control)
+
+
+@router.get("/player", response_class=HTMLResponse)
+async def video_player(
+    path: Optional[str] = Query(None, description="Absolute path to video file"),
+    job_id: Optional[str] = Query(None, description="Job whose live preview to play"),
+):
+    if path is None and job_id is None:
+        raise HTTPException(status_code=400, detail={"code": "PATH_REQUIRED"})
+
+    if path is not None:
+        raw_path = unquote(path)
+        target = Path(raw_path).resolve()
+        if not _is_allowed_path(target):
+            raise HTTPException(status_code=400, detail={"code": "PATH_NOT_ALLOWED"})
+        if not target.exists() or not target.is_file():
+            raise HTTPException(status_code=404, detail={"code": "PATH_NOT_FOUND"})
+    else:
+        preview_dir = _preview_dir(job_id)
+        if preview_dir is None:
+            raise HTTPException(status_code=404, detail={"code": "PREVIEW_NOT_FOUND"})
+        target = preview_dir / "index.m3u8"
 
     media = _media_type_for(target)
-    src = f"/system/video?path={quote(str(target))}"
-    safe_name = html.escape(target.name)
+    is_preview = media == "application/vnd.apple.mpegurl" and job_id is not None
+    if is_preview:
+        src = f"/system/preview/{quote(job_id)}/index.m3u8"
+    else:
+        src = f"/system/video?path={quote(str(target))}"
+    safe_name = html.escape(f"{job_id} preview" if is_preview else target.name)
+    # Safari plays HLS natively, elsewhere hls.js feeds it through Media Source Extensions
+    hls_script = f"""
+        <script src=\"https://cdn.jsdelivr.net/npm/hls.js@1\"></script>
+        <script>
+          const video = document.querySelector('video');
+          if (!video.canPlayType('{media}') && window.Hls && Hls.isSupported()) {{
+            const hls = new Hls();
+            hls.loadSource('{src}');
+            hls.attachMedia(video);
+          }}
+        </script>
+    """ if is_preview else ""
     body = f"""
     <!doctype html>
     <html lang=\"zh-CN\">
@@ -144,6 +218,7 @@ async def video_player(path: str = Query(..., description="Absolute path to vide
             您的浏览器不支持 HTML5 视频。
           </video>
         </div>
+        {hls_script}
       </body>
     </html>
     """
@@ -1,11 +1,19 @@
 from fastapi import APIRouter, BackgroundTasks, Request
 from sqlalchemy.orm import Session
 from ..db.database import session_scope
-from ..db.models import Job, JobArtifact
+from ..db.models import Job, JobArtifact, JobChunk
+from ..runner.chunks import sync_parent_job, start_final_encode
+from ..runner.render_cache import cache_key_for, remember_cache_key, try_complete_from_cache, store_cache_entry
+from ..runner.upload import finish_upload_in_background
+from ..runner.progress_ingest import progress_ingest, PROGRESS_FIELDS
+from ..storage.multipart_upload import start_streaming_upload, has_streaming_upload, abort_streaming_upload
+from ..scheduler.dispatch import dispatch_queue
+from ..scheduler.resources import record_usage
 from ..models.status import JobStatus
 from datetime import datetime
 from ..utils.time import now_cn
 import json
+from pathlib import Path
 from ..utils.misc import *
 
 router = APIRouter(prefix="/ue-notifications", tags=["ue-notifications"])
@@ -18,27 +26,51 @@ async def update_job_progress(job_id: str, request: Request):
     except json.JSONDecodeError:
         return {"error": "Invalid JSON data in request body", "status": "error"}
 
+    status_str = data.get("status")
+    if status_str is not None:
+        try:
+            status_str = JobStatus(status_str).value
+        except ValueError:
+            return {"error": "Invalid status"}
+
+    # Buffered and written in batches; status changes go to the database right away
+    fields = {k: data[k] for k in PROGRESS_FIELDS if k in data}
+    if not progress_ingest.report(job_id, fields, status_str):
+        return {"error": "Job not found"}
+
+    # UE names its output directory once encoding starts; the video is uploaded while it is being written
+    if status_str == JobStatus.encoding.value and data.get("video_directory"):
+        start_streaming_upload(job_id, data["video_directory"])
+
+    return {"status": "success"}
+
+@router.post("/job/{job_id}/render-fingerprint")
+async def render_fingerprint(job_id: str, request: Request):
+    """
+    Receive the job's render fingerprint from UE5 before it starts rendering.
+    Answers {"cached": true} when an identical job's video exists; the job is then already completed with it.
+    """
+    try:
+        data = await request.json()
+    except json.JSONDecodeError:
+        return {"error": "Invalid JSON data in request body", "status": "error"}
+
+    fingerprint = data.get("fingerprint")
+    if not fingerprint:
+        return {"error": "Missing fingerprint", "cached": False}
+
     with session_scope() as db:
         job = db.query(Job).filter(Job.job_id == job_id).first()
         if not job:
-            return {"error": "Job not found"}
-        
-        # update progress and status 
-        job.progress_percent = data.get("progress_percent", job.progress_percent)
-        job.progress_eta_seconds = data.get("progress_eta_seconds", job.progress_eta_seconds)
-        status_str = data.get("status")
-
-        if status_str is not None:
-            try:
-                job.status = JobStatus(status_str).value
-            except ValueError:
-                return {"error": "Invalid status"}
-            
-        percentage = job.progress_percent * 100 if job.progress_percent is not None else 0
-        print(f"JobId {job.job_id} progress: {percentage:.0f}%")
+            return {"error": "Job not found", "cached": False}
+
+        cache_key = cache_key_for(job, fingerprint)
+        remember_cache_key(job, cache_key)
+        cached = try_complete_from_cache(db, job, cache_key)
         db.commit()
-    
-    return {"status": "success"}
+
+    return {"status": "success", "cached": cached}
+
 
 @router.post("/job/{job_id}/render-complete")
 async def render_complete(job_id: str, request: Request):
@@ -48,6 +80,7 @@ async def render_complete(job_id: str, request: Request):
     except json.JSONDecodeError:
         return {"error": "Invalid JSON data in request body", "status": "error"}
     print(f"Received data from UE5: {data}")
+    progress_ingest.close(job_id)
 
     with session_scope() as db:
         job = db.query(Job).filter(Job.job_id == job_id).first()
@@ -56,6 +89,25 @@ async def render_complete(job_id: str, request: Request):
         
         job.status = JobStatus.completed.value
         job.ended_at = now_cn()
+
+        if isinstance(data.get("metrics"), dict):
+            payload = json.loads(job.payload) if job.payload else {}
+            payload["metrics"] = {**payload.get("metrics", {}), **data["metrics"]}
+            job.payload = json.dumps(payload, ensure_ascii=False)
+            record_usage(db, job, data["metrics"])
+
+        # A chunk leaves frames (no video); the parent encodes all chunks once the last one is in
+        chunk = db.get(JobChunk, job_id)
+        if chunk is not None:
+            if not data.get("movie_pipeline_success", True):
+                job.status = JobStatus.failed.value
+            chunk.frames_dir = data.get("video_directory")
+            parent_to_encode = sync_parent_job(db, job)
+            db.commit()
+            dispatch_queue.release(job_id)
+            if parent_to_encode:
+                start_final_encode(parent_to_encode)
+            return {"status": "success"}
         
         created_artifact = False
         if job.artifacts is None:
@@ -75,8 +127,25 @@ async def render_complete(job_id: str, request: Request):
         if created_artifact:
             db.add(job.artifacts)
 
+        upload_path = None
+        if data.get("movie_pipeline_success", True):
+            store_cache_entry(db, job)
+            if job.artifacts.video_path:
+                start_streaming_upload(job.job_id, Path(job.artifacts.video_path).parent)
+                if has_streaming_upload(job.job_id):
+                    job.status = JobStatus.uploading.value
+                    upload_path = job.artifacts.video_path
+        else:
+            abort_streaming_upload(job.job_id)
+
         db.commit()
 
+    # The job no longer counts against MAX_CONCURRENCY, the next one can start while UE shuts down
+    dispatch_queue.release(job_id)
+
+    if upload_path:
+        finish_upload_in_background(job_id, upload_path)
+
     return {"status": "success"}
 
 
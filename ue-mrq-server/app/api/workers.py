@@ -0,0 +1,48 @@
+from typing import Any, Dict
+from fastapi import APIRouter, Depends, HTTPException
+from ..config import settings
+from ..farm.coordinator import apply_states, heartbeat, lease_jobs, list_workers, register_worker
+from ..models.schemas import WorkerHeartbeatRequest, WorkerLeaseRequest, WorkerRegisterRequest
+
+def _require_coordinator():
+    if settings.NODE_ROLE != "coordinator":
+        raise HTTPException(status_code=404, detail={"code": "NOT_A_COORDINATOR"})
+
+router = APIRouter(prefix="/workers", tags=["workers"], dependencies=[Depends(_require_coordinator)])
+
+def _unknown_worker():
+    # Forgotten, or the coordinator's database was replaced; the worker registers again
+    return HTTPException(status_code=404, detail={"code": "WORKER_NOT_FOUND"})
+
+@router.get("")
+async def get_workers():
+    """Registered workers, whether their heartbeat is current, and the jobs each one holds."""
+    return {"workers": list_workers()}
+
+@router.post("/register")
+async def register(req: WorkerRegisterRequest):
+    worker_id = register_worker(req.name, req.url, req.capabilities)
+    return {"worker_id": worker_id, "lease_seconds": settings.LEASE_SECONDS}
+
+@router.post("/{worker_id}/heartbeat")
+async def worker_heartbeat(worker_id: str, req: WorkerHeartbeatRequest):
+    """Renew the leases of the jobs the worker still has. `release` lists jobs it has to stop (canceled or reassigned here)."""
+    release = heartbeat(worker_id, req.jobs)
+    if release is None:
+        raise _unknown_worker()
+    return {"release": release}
+
+@router.post("/{worker_id}/lease")
+async def lease(worker_id: str, req: WorkerLeaseRequest):
+    """Lease queued jobs to the worker, oldest first, for LEASE_SECONDS at a time."""
+    jobs = lease_jobs(worker_id, req.slots)
+    if jobs is None:
+        raise _unknown_worker()
+    return {"jobs": jobs, "lease_seconds": settings.LEASE_SECONDS}
+
+@router.post("/{worker_id}/jobs/{job_id}/state")
+async def job_state(worker_id: str, job_id: str, state: Dict[str, Any]):
+    """A state change of a leased job, pushed by the worker as it happens. 409 when the job isn't leased to it any more."""
+    if apply_states(worker_id, [{**state, "job_id": job_id}]):
+        raise HTTPException(status_code=409, detail={"code": "LEASE_LOST"})
+    return {"status": "success"}
@@ -1,6 +1,7 @@
 from pydantic_settings import BaseSettings
 from pydantic import Field
 from pathlib import Path
+from typing import Literal
 
 class Settings(BaseSettings):
     # Unreal & tools
@@ -16,8 +17,52 @@ class Settings(BaseSettings):
 
     # Scheduler
     MAX_CONCURRENCY: int = 2
-    MIN_FREE_VRAM_MB: int = 4096
-    SCHEDULER_POLL_MS: int = 1500
+    MIN_FREE_VRAM_MB: int = 4096  # VRAM a job needs until its template has a resource profile
+    SCHEDULER_POLL_MS: int = 1500  # retry interval while the GPU has less than MIN_FREE_VRAM_MB free
+    SCHEDULER_RECONCILE_SECONDS: float = 30  # resync the in-memory dispatch queue with the database
+
+    # Database
+    SQLITE_WAL: bool = True  # readers don't wait for the writer, and commits don't rewrite the database file
+    SQLITE_SYNCHRONOUS: str = "NORMAL"  # OFF | NORMAL | FULL | EXTRA; NORMAL is durable with WAL except on power loss
+    SQLITE_BUSY_TIMEOUT_MS: int = 5000  # how long a write waits for the lock before failing
+    PROGRESS_FLUSH_MS: int = 1000  # progress posts are buffered and written together at this interval
+
+    # Job event streams
+    EVENTS_KEEPALIVE_SECONDS: float = 15  # comment line sent on idle /jobs/events streams so proxies keep them open
+
+    # Resource-aware packing
+    DEVICE_BACKEND: str = "auto"  # auto | nvml | host | mock
+    MOCK_DEVICES: str | None = None  # JSON machine for the mock backend, e.g. {"gpus_mb": [24576, 24576], "cpu_cores": 16, "ram_mb": 65536, "disk_mb": 512000}
+    RESOURCE_HEADROOM: float = 0.15  # added on top of a template's measured peaks
+    CPU_OVERCOMMIT: float = 1.5  # cores handed out per physical core
+    DEFAULT_JOB_RAM_MB: int = 8192  # sizes of a job whose template has no resource profile yet
+    DEFAULT_JOB_CPU_CORES: float = 4
+    DEFAULT_JOB_DISK_MB: int = 10240
+
+    # Resume
+    AUTO_RESUME_ATTEMPTS: int = 1  # times a crashed UE process (or one that failed after rendering frames) is relaunched to continue from its last completed frame
+
+    # Render cache
+    RENDER_CACHE_ENABLED: bool = True  # complete jobs whose render fingerprint matches an earlier video without rendering
+
+    # Encoder process placement (defaults for jobs that don't set "encoder")
+    ENCODER_PRIORITY: int | None = None  # -2 (lowest) .. 2 (highest), UE default is below normal
+    ENCODER_CPU_AFFINITY: str | None = None  # cores the encoder may use, e.g. "8-15" or "4,6,8-11"
+    ENCODER_CPU_QUOTA: float | None = None  # cores worth of CPU time; Linux needs ENCODER_CGROUP to enforce it
+    ENCODER_CGROUP: str | None = None  # Linux cgroup v2 path below /sys/fs/cgroup, must be writable by the server user
+    ENCODER_TARGET_SECONDS: float | None = None  # encode deadline; slower encodes restart on a faster quality preset
+
+    # Shader warm-up
+    SHARED_DDC_PATH: str | None = None  # shared derived data cache UE renders and the shader warm-up use (-SharedDataCachePath)
+    SHADER_WARMUP_DIR: Path = Field(default=Path("./data/shader_warmup"))  # warm-up manifests, <template_id>.json
+
+    # Memory watchdog
+    MEMORY_WATCHDOG_FRAMES: int = 30  # UE samples its process and GPU-pool memory every this many frames
+    MEMORY_TRIM_THRESHOLD_MB: int | None = None  # process memory above which UE collects garbage and trims at the next shot boundary
+    GPU_MEMORY_TRIM_THRESHOLD_MB: int | None = None  # the same for textures and pooled render targets
+
+    # ETA
+    UPLOAD_ETA_SECONDS: float = 0  # added to UE's remaining-time estimate for the upload after encoding
 
     # OSS
     OSS_ENDPOINT: str | None = None
@@ -27,6 +72,30 @@ class Settings(BaseSettings):
     OSS_STS_TOKEN: str | None = None
     OSS_SIGNED_URL_EXPIRE: int = 7 * 24 * 3600
 
+    # Streaming upload
+    UPLOAD_STREAMING: bool = False  # encode fragmented MP4 and upload it in parts while encoding runs (needs OSS or UPLOAD_LOCAL_DIR)
+    UPLOAD_PART_SIZE_MB: int = 8  # multipart part size; every part but the last must be at least the store's minimum
+    UPLOAD_PARALLEL_PARTS: int = 4  # parts in flight at once
+    UPLOAD_LOCAL_DIR: str | None = None  # upload into this directory instead of OSS, for testing without a bucket
+
+    # Live preview
+    PREVIEW_HLS: bool = False  # UE writes a low bitrate HLS preview while rendering, served at /system/preview/<job_id>/
+    PREVIEW_HEIGHT: int = 360
+    PREVIEW_BITRATE_KBPS: int = 600
+    PREVIEW_SEGMENT_SECONDS: float = 2.0
+
+    # Video serving (/system/video, /system/preview)
+    VIDEO_CACHE_MAX_AGE: int = 3600  # seconds browsers may reuse a video or preview segment without revalidating; 0 always revalidates
+    VIDEO_HANDLE_CACHE_SIZE: int = 32  # open video files kept for range requests
+    VIDEO_HANDLE_IDLE_SECONDS: float = 5.0  # an unread video file is closed after this long (0 closes it at once)
+
+    # Render farm
+    NODE_ROLE: Literal["standalone", "coordinator", "worker"] = "standalone"  # coordinator queues jobs and leases them to workers; a worker renders jobs leased from COORDINATOR_URL
+    COORDINATOR_URL: str | None = None  # worker: base URL of the coordinator, e.g. http://10.0.0.2:8080/
+    WORKER_NAME: str | None = None  # worker: name the coordinator lists it under; defaults to MRQ_SERVER_BASE_URL
+    WORKER_HEARTBEAT_SECONDS: float = 5  # worker: how often it renews its leases and asks for work
+    LEASE_SECONDS: float = 30  # coordinator: a job whose worker stopped renewing it this long goes back in the queue
+
     # Misc
     API_KEY: str | None = None
     MRQ_SERVER_BASE_URL: str | None = None
@@ -1,10 +1,27 @@
-from sqlalchemy import create_engine
+from sqlalchemy import create_engine, event
 from sqlalchemy.orm import sessionmaker, DeclarativeBase, Session
 from pathlib import Path
 from ..config import settings
 
 DB_PATH = Path(settings.DATA_ROOT) / "jobs.sqlite"
 engine = create_engine(f"sqlite:///{DB_PATH}", echo=False, future=True)
+
+_SYNCHRONOUS_MODES = {"OFF", "NORMAL", "FULL", "EXTRA"}
+
+
+@event.listens_for(engine, "connect")
+def _configure_sqlite(dbapi_connection, _):
+    synchronous = settings.SQLITE_SYNCHRONOUS.upper()
+    if synchronous not in _SYNCHRONOUS_MODES:
+        raise ValueError(f"Unknown SQLITE_SYNCHRONOUS: {settings.SQLITE_SYNCHRONOUS}")
+    cursor = dbapi_connection.cursor()
+    # WAL sticks to the database file; leaving it takes `PRAGMA journal_mode=DELETE` with the server stopped
+    if settings.SQLITE_WAL:
+        cursor.execute("PRAGMA journal_mode=WAL")
+    cursor.execute(f"PRAGMA synchronous={synchronous}")
+    cursor.execute(f"PRAGMA busy_timeout={int(settings.SQLITE_BUSY_TIMEOUT_MS)}")
+    cursor.close()
+
 SessionLocal = sessionmaker(bind=engine, autoflush=False, autocommit=False, future=True)
 
 class Base(DeclarativeBase):
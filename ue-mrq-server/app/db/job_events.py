@@ -0,0 +1,164 @@
+"""
+Job state changes pushed to clients as they happen.
+
+Every committed change to a job row (status, progress, timestamps) and to its artifacts is published from session
+hooks, so whatever code path changes a job, subscribers hear about it without polling. Progress that is still
+buffered for the database (see runner.progress_ingest) is published right when UE reports it.
+
+A subscriber keeps only the newest unsent state per job. A client that reads slower than jobs change skips
+intermediate states instead of piling them up, so memory per subscriber is bounded by the number of jobs.
+"""
+from __future__ import annotations
+import asyncio
+import threading
+from typing import Any, Optional
+from sqlalchemy import event
+from sqlalchemy.orm import Session, attributes
+
+from ..models.status import TERMINAL_STATUSES
+from ..utils.time import to_cn_iso
+from .models import Job, JobArtifact
+
+
+def job_state(job: Job, with_artifacts: bool = False) -> dict[str, Any]:
+    """What subscribers get for a job; the same fields as GET /jobs/{job_id}/progress, as far as they are loaded."""
+    # Expired attributes are left out rather than fetched: inside a flush nothing may be loaded
+    values = attributes.instance_state(job).dict
+    state: dict[str, Any] = {"job_id": _primary_key(job)}
+    for field in ("session_id", "template_id", "status"):
+        if field in values:
+            state[field] = values[field]
+    progress = {name: values[field] for name, field in _PROGRESS_FIELDS.items() if field in values}
+    if progress:
+        state["progress"] = progress
+    timestamps = {name: to_cn_iso(values[field]) for name, field in _TIMESTAMP_FIELDS.items() if field in values}
+    if timestamps:
+        state["timestamps"] = timestamps
+    if with_artifacts and job.artifacts is not None:
+        state["artifacts"] = {"video_url": job.artifacts.video_url, "video_path": job.artifacts.video_path}
+    return state
+
+
+_PROGRESS_FIELDS = {"percent": "progress_percent", "eta_seconds": "progress_eta_seconds"}
+_TIMESTAMP_FIELDS = {"queued_at": "created_at", "started_at": "started_at", "updated_at": "updated_at", "ended_at": "ended_at"}
+
+
+def _primary_key(obj: Job | JobArtifact) -> str:
+    state = attributes.instance_state(obj)
+    return state.dict.get("job_id") or state.identity[0]
+
+
+class JobEventSubscriber:
+    def __init__(self, job_id: Optional[str], loop: asyncio.AbstractEventLoop):
+        self.job_id = job_id
+        self._loop = loop
+        self._wake = asyncio.Event()
+        self._lock = threading.Lock()
+        self._pending: dict[str, dict[str, Any]] = {}  # newest unsent state per job
+
+    def offer(self, state: dict[str, Any]) -> None:
+        """From any thread."""
+        if self.job_id is not None and state["job_id"] != self.job_id:
+            return
+        with self._lock:
+            was_empty = not self._pending
+            self._pending[state["job_id"]] = state
+        if was_empty:
+            self._loop.call_soon_threadsafe(self._wake.set)
+
+    async def next_batch(self, timeout: float) -> list[dict[str, Any]]:
+        """States changed since the last call, oldest change first; empty after `timeout` seconds without any."""
+        try:
+            await asyncio.wait_for(self._wake.wait(), timeout)
+        except asyncio.TimeoutError:
+            return []
+        self._wake.clear()
+        with self._lock:
+            batch, self._pending = list(self._pending.values()), {}
+        return batch
+
+
+class JobEventHub:
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._subscribers: set[JobEventSubscriber] = set()
+        self._states: dict[str, dict[str, Any]] = {}  # latest known state of jobs that haven't ended
+
+    def subscribe(self, job_id: Optional[str] = None) -> JobEventSubscriber:
+        """Called on the event loop the subscriber will be read on."""
+        subscriber = JobEventSubscriber(job_id, asyncio.get_running_loop())
+        with self._lock:
+            self._subscribers.add(subscriber)
+        return subscriber
+
+    def unsubscribe(self, subscriber: JobEventSubscriber) -> None:
+        with self._lock:
+            self._subscribers.discard(subscriber)
+
+    def current(self, job: Job) -> dict[str, Any]:
+        """A job's state as read from the database, updated with progress that is still buffered for it."""
+        state = job_state(job, with_artifacts=True)
+        with self._lock:
+            latest = self._states.get(job.job_id)
+        return _merge(state, latest) if latest else state
+
+    def publish(self, job_id: str, changes: dict[str, Any]) -> None:
+        """Merge `changes` into the job's state and send it to subscribers if anything but `updated_at` changed."""
+        with self._lock:
+            old = self._states.get(job_id) or {"job_id": job_id}
+            state = _merge(old, changes)
+            if _without_updated_at(state) == _without_updated_at(old):
+                return
+            if state.get("status") in TERMINAL_STATUSES:
+                self._states.pop(job_id, None)
+            else:
+                self._states[job_id] = state
+            subscribers = list(self._subscribers)
+        for subscriber in subscribers:
+            try:
+                subscriber.offer(state)
+            except RuntimeError:
+                # Its event loop is gone
+                self.unsubscribe(subscriber)
+
+
+def _merge(old: dict[str, Any], changes: dict[str, Any]) -> dict[str, Any]:
+    merged = dict(old)
+    for key, value in changes.items():
+        if isinstance(value, dict) and isinstance(merged.get(key), dict):
+            merged[key] = {**merged[key], **value}
+        else:
+            merged[key] = value
+    return merged
+
+
+def _without_updated_at(state: dict[str, Any]) -> dict[str, Any]:
+    return {**state, "timestamps": {k: v for k, v in (state.get("timestamps") or {}).items() if k != "updated_at"}}
+
+
+job_events = JobEventHub()
+
+
+@event.listens_for(Session, "after_flush")
+def _collect_job_changes(session: Session, _) -> None:
+    changes = session.info.setdefault("job_events", {})
+    for obj in list(session.new) + list(session.dirty):
+        if isinstance(obj, Job):
+            job_id = _primary_key(obj)
+            changes[job_id] = _merge(changes.get(job_id, {}), job_state(obj))
+        elif isinstance(obj, JobArtifact):
+            job_id = _primary_key(obj)
+            values = attributes.instance_state(obj).dict
+            artifacts = {field: values[field] for field in ("video_url", "video_path") if field in values}
+            changes[job_id] = _merge(changes.get(job_id, {}), {"job_id": job_id, "artifacts": artifacts})
+
+
+@event.listens_for(Session, "after_commit")
+def _publish_job_changes(session: Session) -> None:
+    for job_id, changes in session.info.pop("job_events", {}).items():
+        job_events.publish(job_id, changes)
+
+
+@event.listens_for(Session, "after_rollback")
+def _drop_job_changes(session: Session) -> None:
+    session.info.pop("job_events", None)
@@ -46,4 +46,56 @@ class JobArtifact(Base):
     ue_log: Mapped[str | None] = mapped_column(String(512))
     ffmpeg_log: Mapped[str | None] = mapped_column(String(512))
 
-    job = relationship("Job", back_populates="artifacts")
\ No newline at end of file
+    job = relationship("Job", back_populates="artifacts")
+
+class JobChunk(Base):
+    """A frame-range slice of a parent job, rendered by its own UE process (child job)."""
+    __tablename__ = "job_chunks"
+    child_job_id: Mapped[str] = mapped_column(ForeignKey("jobs.job_id"), primary_key=True)
+    parent_job_id: Mapped[str] = mapped_column(ForeignKey("jobs.job_id"), index=True)
+    chunk_index: Mapped[int] = mapped_column(Integer)
+    chunk_count: Mapped[int] = mapped_column(Integer)
+    frames_dir: Mapped[str | None] = mapped_column(String(512))
+
+class RenderCacheEntry(Base):
+    """Finished video for a render fingerprint (scene content + MRQ config + encoder + build, plus the job's params)."""
+    __tablename__ = "render_cache"
+    cache_key: Mapped[str] = mapped_column(String(64), primary_key=True)
+    video_path: Mapped[str] = mapped_column(String(512))
+    source_job_id: Mapped[str] = mapped_column(String(36))
+    hit_count: Mapped[int] = mapped_column(Integer, default=0)
+    created_at: Mapped[datetime] = mapped_column(DateTime(timezone=True), default=now_cn)
+    last_hit_at: Mapped[datetime | None] = mapped_column(DateTime(timezone=True), default=None)
+
+class TemplateResourceProfile(Base):
+    """Peak resource use of a template at one quality, learned from the jobs that rendered it. Sizes new jobs for the scheduler."""
+    __tablename__ = "template_resource_profiles"
+    template_id: Mapped[str] = mapped_column(String(64), primary_key=True)
+    quality: Mapped[str] = mapped_column(String(16), primary_key=True)
+    vram_mb: Mapped[float] = mapped_column(Float, default=0.0)
+    ram_mb: Mapped[float] = mapped_column(Float, default=0.0)
+    cpu_cores: Mapped[float] = mapped_column(Float, default=0.0)
+    disk_mb: Mapped[float] = mapped_column(Float, default=0.0)
+    samples: Mapped[int] = mapped_column(Integer, default=0)
+    updated_at: Mapped[datetime] = mapped_column(DateTime(timezone=True), default=now_cn, onupdate=now_cn)
+
+class Worker(Base):
+    """A render node registered with the coordinator. A new id per worker process, so a restarted worker's old leases run out."""
+    __tablename__ = "workers"
+    worker_id: Mapped[str] = mapped_column(String(36), primary_key=True)
+    name: Mapped[str] = mapped_column(String(128))
+    url: Mapped[str | None] = mapped_column(String(512))
+    capabilities: Mapped[str] = mapped_column(Text)  # JSON: templates, slots, gpus, cpu_cores, ram_mb
+    registered_at: Mapped[datetime] = mapped_column(DateTime(timezone=True), default=now_cn)
+    last_seen_at: Mapped[datetime] = mapped_column(DateTime(timezone=True), default=now_cn)
+
+class JobLease(Base):
+    """
+    A job handed to a worker until `expires_at`; the worker renews it with every heartbeat. On the coordinator it is
+    the worker's claim on the job, on a worker the record of which local jobs it renders for the coordinator.
+    """
+    __tablename__ = "job_leases"
+    job_id: Mapped[str] = mapped_column(ForeignKey("jobs.job_id"), primary_key=True)
+    worker_id: Mapped[str] = mapped_column(String(36), index=True)
+    leased_at: Mapped[datetime] = mapped_column(DateTime(timezone=True), default=now_cn)
+    expires_at: Mapped[datetime] = mapped_column(DateTime(timezone=True))
@@ -0,0 +1,266 @@
+"""
+Coordinator side of a render farm (NODE_ROLE=coordinator).
+
+The coordinator queues jobs like a standalone server but renders none itself. Workers register with what they can
+render and lease queued jobs: a lease hands a job to one worker until it expires, and every heartbeat of the worker
+renews the leases of the jobs it still has. Workers report state changes of their jobs as they happen and again
+with every heartbeat, so a lost report is made up by the next one. A job whose lease ran out (its worker died, hung
+or lost the network) goes back in the queue at its old place, for the next worker that asks. Videos come back as
+URLs of the storage the workers upload to.
+"""
+from __future__ import annotations
+import json
+import threading
+import uuid
+from datetime import timedelta
+from typing import Any, Optional
+from sqlalchemy import delete, select
+
+from ..config import settings
+from ..db.database import session_scope
+from ..db.models import Job, JobArtifact, JobLease, Worker
+from ..models.status import JobStatus, TERMINAL_STATUSES
+from ..runner.progress_ingest import progress_ingest
+from ..scheduler.dispatch import dispatch_queue
+from ..utils.time import now_cn
+
+# Workers not heard of for this long are dropped from the list
+FORGET_WORKER_AFTER = timedelta(days=1)
+
+
+def lease_expiry():
+    return now_cn() + timedelta(seconds=settings.LEASE_SECONDS)
+
+
+def register_worker(name: str, url: Optional[str], capabilities: dict[str, Any]) -> str:
+    with session_scope() as db:
+        worker = Worker(worker_id=str(uuid.uuid4()), name=name, url=url, capabilities=json.dumps(capabilities, ensure_ascii=False))
+        db.add(worker)
+        db.commit()
+        print(f"Worker {name} registered as {worker.worker_id}: {len(capabilities.get('templates') or [])} templates, {capabilities.get('slots')} slots")
+        return worker.worker_id
+
+
+def lease_jobs(worker_id: str, slots: int) -> Optional[list[dict[str, Any]]]:
+    """Hand up to `slots` queued jobs, oldest first, to the worker. None when the worker is unknown."""
+    leased = []
+    with session_scope() as db:
+        worker = db.get(Worker, worker_id)
+        if worker is None:
+            return None
+        worker.last_seen_at = now_cn()
+        templates = json.loads(worker.capabilities).get("templates")
+
+        for job_id in dispatch_queue.queued_ids():
+            if len(leased) >= slots:
+                break
+            job = db.get(Job, job_id)
+            # Canceled (or already leased) since it was queued
+            if not job or job.status != JobStatus.queued.value:
+                dispatch_queue.release(job_id)
+                continue
+            # Left for a worker that has the template
+            if templates is not None and job.template_id not in templates:
+                continue
+            if not dispatch_queue.claim(job_id):
+                continue
+
+            job.status = JobStatus.starting.value
+            job.started_at = now_cn()
+            db.add(JobLease(job_id=job_id, worker_id=worker_id, expires_at=lease_expiry()))
+            leased.append({
+                "job_id": job.job_id,
+                "session_id": job.session_id,
+                "template_id": job.template_id,
+                "payload": json.loads(job.payload) if job.payload else {},
+            })
+        db.commit()
+
+    for item in leased:
+        print(f"Job {item['job_id']} leased to worker {worker_id}")
+    return leased
+
+
+def heartbeat(worker_id: str, states: list[dict[str, Any]]) -> Optional[list[str]]:
+    """
+    Renew the leases of the jobs the worker reports and apply their states. Returns the jobs the worker has to drop
+    (no longer leased to it), None when the worker is unknown and has to register again.
+    """
+    held = {state["job_id"] for state in states}
+    dropped = []
+    with session_scope() as db:
+        worker = db.get(Worker, worker_id)
+        if worker is None:
+            return None
+        worker.last_seen_at = now_cn()
+        # Leased to the worker, but it doesn't have them (the lease answer got lost, or it restarted)
+        for lease in db.execute(select(JobLease).where(JobLease.worker_id == worker_id)).scalars().all():
+            if lease.job_id not in held:
+                db.delete(lease)
+                job = db.get(Job, lease.job_id)
+                if job is not None and job.status not in TERMINAL_STATUSES:
+                    _requeue(job)
+                    dropped.append(job)
+        db.commit()
+        for job in dropped:
+            print(f"Job {job.job_id} is no longer on worker {worker_id}, requeued")
+            dispatch_queue.enqueue(job.job_id, job.created_at)
+
+    return apply_states(worker_id, states)
+
+
+def apply_states(worker_id: str, states: list[dict[str, Any]]) -> list[str]:
+    """Apply job states the worker reported and renew their leases. Returns the jobs that aren't leased to it."""
+    rejected, running, finished = [], [], []
+    with session_scope() as db:
+        ids = [state["job_id"] for state in states]
+        leases = {lease.job_id: lease for lease in db.execute(select(JobLease).where(JobLease.job_id.in_(ids), JobLease.worker_id == worker_id)).scalars()}
+        expires_at = lease_expiry()
+        for state in states:
+            lease = leases.get(state["job_id"])
+            if lease is None:
+                rejected.append(state["job_id"])
+            elif state.get("status") in TERMINAL_STATUSES:
+                finished.append(state)
+            else:
+                lease.expires_at = expires_at
+                running.append(state)
+        db.commit()
+
+    # Progress takes the same buffered path as UE's own posts on a standalone server
+    for state in running:
+        progress = state.get("progress") or {}
+        fields = {field: progress[name] for name, field in (("percent", "progress_percent"), ("eta_seconds", "progress_eta_seconds")) if name in progress}
+        status = state.get("status")
+        if status == JobStatus.queued.value:
+            status = JobStatus.starting.value  # waits for a slot on the worker; leased is started as far as the queue here goes
+        elif status not in JobStatus._value2member_map_ or status == JobStatus.canceling.value:
+            status = None
+        progress_ingest.report(state["job_id"], fields, status)
+
+    for state in finished:
+        _finish(worker_id, state)
+    return rejected
+
+
+def _finish(worker_id: str, state: dict[str, Any]) -> None:
+    """The worker is done with the job: it completed or failed there, or was given back (canceled on the worker)."""
+    job_id = state["job_id"]
+    progress_ingest.close(job_id)
+    with session_scope() as db:
+        lease = db.get(JobLease, job_id)
+        if lease is None or lease.worker_id != worker_id:
+            return
+        db.delete(lease)
+        job = db.get(Job, job_id)
+        if job is None or job.status in TERMINAL_STATUSES:
+            db.commit()
+            return
+
+        status = state["status"]
+        if status == JobStatus.canceled.value:
+            _requeue(job)
+            db.commit()
+            print(f"Job {job_id} given back by worker {worker_id}, requeued")
+            dispatch_queue.enqueue(job_id, job.created_at)
+            return
+
+        progress = state.get("progress") or {}
+        job.status = status
+        job.ended_at = now_cn()
+        if progress.get("percent") is not None:
+            job.progress_percent = progress["percent"]
+        job.progress_eta_seconds = progress.get("eta_seconds")
+        video_url = (state.get("artifacts") or {}).get("video_url")
+        if video_url:
+            # The worker's local path means nothing here; the video is wherever the storage put it
+            if job.artifacts is None:
+                job.artifacts = JobArtifact(job_id=job.job_id)
+            job.artifacts.video_url = video_url
+        if isinstance(state.get("metrics"), dict):
+            payload = json.loads(job.payload) if job.payload else {}
+            payload["metrics"] = {**payload.get("metrics", {}), **state["metrics"], "worker_id": worker_id}
+            job.payload = json.dumps(payload, ensure_ascii=False)
+        db.commit()
+    dispatch_queue.release(job_id)
+    print(f"Job {job_id} {status} on worker {worker_id}")
+
+
+def release_lease(job_id: str) -> None:
+    """Job was canceled here; its worker learns so with its next heartbeat."""
+    with session_scope() as db:
+        db.execute(delete(JobLease).where(JobLease.job_id == job_id))
+
+
+def _requeue(job: Job) -> None:
+    job.status = JobStatus.queued.value
+    job.pid = None
+    job.started_at = None
+    job.ended_at = None
+    job.progress_percent = 0.0
+    job.progress_eta_seconds = None
+
+
+def list_workers() -> list[dict[str, Any]]:
+    with session_scope() as db:
+        leases: dict[str, list[str]] = {}
+        for lease in db.execute(select(JobLease)).scalars():
+            leases.setdefault(lease.worker_id, []).append(lease.job_id)
+        alive_since = now_cn() - timedelta(seconds=settings.LEASE_SECONDS)
+        workers = db.execute(select(Worker).order_by(Worker.registered_at.desc())).scalars().all()
+        return [{
+            "worker_id": w.worker_id,
+            "name": w.name,
+            "url": w.url,
+            "capabilities": json.loads(w.capabilities),
+            "alive": w.last_seen_at.replace(tzinfo=None) >= alive_since.replace(tzinfo=None),
+            "jobs": leases.get(w.worker_id, []),
+        } for w in workers]
+
+
+class LeaseMonitor:
+    """Puts jobs whose lease ran out back in the queue."""
+
+    def __init__(self):
+        self._th: threading.Thread | None = None
+        self._stop = threading.Event()
+
+    def start(self):
+        if self._th and self._th.is_alive():
+            return
+        self._stop.clear()
+        self._th = threading.Thread(target=self._loop, daemon=True)
+        self._th.start()
+
+    def stop(self):
+        self._stop.set()
+        if self._th:
+            self._th.join(timeout=1)
+
+    def _loop(self):
+        # Checked a few times per lease, so an expired job waits at most a quarter lease longer
+        while not self._stop.wait(max(settings.LEASE_SECONDS / 4, 0.5)):
+            try:
+                self.expire()
+            except Exception as e:
+                print(f"Lease check failed: {e}")
+
+    @staticmethod
+    def expire() -> None:
+        requeued = []
+        with session_scope() as db:
+            now = now_cn()
+            for lease in db.execute(select(JobLease).where(JobLease.expires_at < now)).scalars().all():
+                db.delete(lease)
+                job = db.get(Job, lease.job_id)
+                if job is not None and job.status not in TERMINAL_STATUSES:
+                    _requeue(job)
+                    requeued.append((job.job_id, job.created_at, lease.worker_id))
+            db.execute(delete(Worker).where(Worker.last_seen_at < now - FORGET_WORKER_AFTER))
+            db.commit()
+        for job_id, created_at, worker_id in requeued:
+            print(f"Lease of job {job_id} on worker {worker_id} expired, requeued")
+            dispatch_queue.enqueue(job_id, created_at)
+
+
+lease_monitor = LeaseMonitor()
@@ -0,0 +1,304 @@
+"""
+Worker side of a render farm (NODE_ROLE=worker).
+
+A worker is a standalone server that takes its jobs from the coordinator instead of from clients. It registers with
+what it can render, then every WORKER_HEARTBEAT_SECONDS (and as soon as one of its jobs ends) renews the leases of
+the jobs it has and leases more for its free slots. Leased jobs are queued here and run by the local scheduler like
+any other; their state changes are forwarded to the coordinator as they happen. A job the coordinator takes back
+(canceled there, or its lease ran out while the coordinator couldn't be reached) is canceled here.
+
+Videos are uploaded to the storage (OSS, or an UPLOAD_LOCAL_DIR the coordinator shares) and reach the coordinator
+as URLs; the worker's local paths mean nothing to it.
+"""
+from __future__ import annotations
+import asyncio
+import json
+import socket
+import threading
+from concurrent.futures import Future
+from datetime import timedelta
+from pathlib import Path
+from typing import Any, Optional
+from urllib.parse import urljoin
+
+import requests
+from sqlalchemy import delete, or_, select
+
+from ..config import settings
+from ..db.database import session_scope
+from ..db.job_events import job_events
+from ..db.models import Job, JobArtifact, JobChunk, JobLease
+from ..models.status import JobStatus, RUNNING_STATUSES, TERMINAL_STATUSES
+from ..runner.chunks import cancel_chunk_jobs, create_chunk_jobs, parent_job_ids
+from ..runner.progress_ingest import progress_ingest
+from ..runner.supervisor import supervisor
+from ..scheduler.devices import get_backend
+from ..scheduler.dispatch import dispatch_queue
+from ..storage.multipart_upload import abort_streaming_upload, finish_streaming_upload, start_streaming_upload, storage_configured
+from ..templates.loader import TemplateRegistry
+from ..utils.procs import kill_tree
+from ..utils.time import now_cn
+
+REQUEST_TIMEOUT_SECONDS = 10
+# Statuses of a held job that take a render slot here; one that is uploading leaves its slot to the next
+SLOT_STATUSES = RUNNING_STATUSES | {JobStatus.queued.value}
+
+
+class WorkerAgent:
+    def __init__(self, registry: TemplateRegistry):
+        self.registry = registry
+        self.name = settings.WORKER_NAME or settings.MRQ_SERVER_BASE_URL or socket.gethostname()
+        self.worker_id: Optional[str] = None
+        self.lease_seconds = settings.LEASE_SECONDS
+        self._held: set[str] = set()  # jobs leased from the coordinator that it hasn't acknowledged as ended
+        self._uploads: dict[str, bool] = {}  # completed jobs whose video is uploaded here: True while it runs
+        self._future: Optional[Future] = None
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._wake: Optional[asyncio.Event] = None
+
+    def start(self):
+        if not settings.COORDINATOR_URL:
+            raise RuntimeError("NODE_ROLE=worker needs COORDINATOR_URL")
+        if not settings.MRQ_SERVER_BASE_URL:
+            raise RuntimeError("NODE_ROLE=worker needs MRQ_SERVER_BASE_URL, the URL UE on this node reports to")
+        if not storage_configured():
+            print("Worker without OSS or UPLOAD_LOCAL_DIR: videos stay on this node and the coordinator gets no URL for them")
+        self._future = supervisor.submit(self._run())
+
+    def stop(self):
+        # Jobs keep rendering; their leases run out on the coordinator unless this worker comes back in time
+        if self._future is not None:
+            self._future.cancel()
+
+    # ---- loop ----
+
+    async def _run(self):
+        self._loop = asyncio.get_running_loop()
+        self._wake = asyncio.Event()
+        subscriber = job_events.subscribe()
+        forwarder = asyncio.create_task(self._forward(subscriber))
+        try:
+            while True:
+                try:
+                    await asyncio.to_thread(self._heartbeat)
+                    await asyncio.to_thread(self._lease)
+                except Exception as e:
+                    print(f"Coordinator {settings.COORDINATOR_URL} unreachable: {e}")
+                try:
+                    await asyncio.wait_for(self._wake.wait(), settings.WORKER_HEARTBEAT_SECONDS)
+                except asyncio.TimeoutError:
+                    pass
+                self._wake.clear()
+        finally:
+            forwarder.cancel()
+            job_events.unsubscribe(subscriber)
+
+    async def _forward(self, subscriber):
+        """Push every state change of a held job to the coordinator right away."""
+        while True:
+            for state in await subscriber.next_batch(60):
+                if state["job_id"] in self._held:
+                    try:
+                        await asyncio.to_thread(self._report, state["job_id"])
+                    except Exception as e:
+                        # The next heartbeat carries it
+                        print(f"Report of job {state['job_id']} to the coordinator failed: {e}")
+
+    def _wake_up(self):
+        if self._loop is not None and self._wake is not None:
+            self._loop.call_soon_threadsafe(self._wake.set)
+
+    # ---- coordinator calls ----
+
+    def _post(self, path: str, body: dict) -> requests.Response:
+        return requests.post(urljoin(settings.COORDINATOR_URL.rstrip("/") + "/", path), json=body, timeout=REQUEST_TIMEOUT_SECONDS)
+
+    def _register(self):
+        r = self._post("workers/register", {"name": self.name, "url": settings.MRQ_SERVER_BASE_URL, "capabilities": self._capabilities()})
+        r.raise_for_status()
+        data = r.json()
+        self.worker_id = data["worker_id"]
+        self.lease_seconds = float(data.get("lease_seconds", self.lease_seconds))
+        print(f"Registered with coordinator {settings.COORDINATOR_URL} as {self.name} ({self.worker_id})")
+        # Leases of an earlier registration are the coordinator's to hand out again
+        with session_scope() as db:
+            stale = db.execute(select(JobLease.job_id).where(JobLease.worker_id != self.worker_id)).scalars().all()
+        self._drop(stale)
+
+    def _capabilities(self) -> dict[str, Any]:
+        node = get_backend().query()
+        return {
+            "templates": [t["template_id"] for t in self.registry.templates],
+            "slots": settings.MAX_CONCURRENCY,
+            "gpus": [{"index": g.index, "total_mb": g.total_mb} for g in node.gpus],
+            "cpu_cores": node.cpu_cores,
+            "ram_mb": node.ram_total_mb,
+        }
+
+    def _heartbeat(self):
+        if self.worker_id is None:
+            self._register()
+        states = [s for s in (self._state(job_id) for job_id in list(self._held)) if s is not None]
+        r = self._post(f"workers/{self.worker_id}/heartbeat", {"jobs": states})
+        if r.status_code == 404:
+            self.worker_id = None
+            self._register()
+            return
+        r.raise_for_status()
+        self._drop(r.json().get("release") or [])
+        self._renew()
+        # Ended jobs the coordinator has now heard of, one way or the other
+        self._forget([s["job_id"] for s in states if s.get("status") in TERMINAL_STATUSES])
+
+    def _lease(self):
+        slots = settings.MAX_CONCURRENCY - self._busy_slots()
+        if slots <= 0 or self.worker_id is None:
+            return
+        r = self._post(f"workers/{self.worker_id}/lease", {"slots": slots})
+        if r.status_code == 404:
+            self.worker_id = None
+            return
+        r.raise_for_status()
+        for item in r.json().get("jobs") or []:
+            self._accept(item)
+
+    def _report(self, job_id: str):
+        state = self._state(job_id)
+        if state is None or self.worker_id is None:
+            return
+        r = self._post(f"workers/{self.worker_id}/jobs/{job_id}/state", state)
+        if r.status_code == 409:
+            self._drop([job_id])
+            return
+        r.raise_for_status()
+        if state.get("status") in TERMINAL_STATUSES:
+            self._forget([job_id])
+            self._wake_up()  # a slot is free, lease the next job now
+
+    # ---- local jobs ----
+
+    def _state(self, job_id: str) -> Optional[dict[str, Any]]:
+        """What the coordinator gets for a held job. A completed job counts as uploading until its video has a URL."""
+        with session_scope() as db:
+            job = db.get(Job, job_id)
+            if job is None:
+                return None
+            state = job_events.current(job)
+            payload = json.loads(job.payload) if job.payload else {}
+            metrics = {**(payload.get("metrics") or {}), **progress_ingest.live_metrics(job_id)}
+            if metrics:
+                state["metrics"] = metrics
+            video_path = job.artifacts.video_path if job.artifacts else None
+            needs_upload = job.status == JobStatus.completed.value and storage_configured() and video_path and not job.artifacts.video_url
+        # Served from the render cache, or the streaming upload failed: upload it now, once
+        if needs_upload and self._uploads.get(job_id) is not False:
+            if job_id not in self._uploads:
+                self._uploads[job_id] = True
+                threading.Thread(target=self._upload_video, args=(job_id, video_path), daemon=True).start()
+            state["status"] = JobStatus.uploading.value
+        return state
+
+    def _upload_video(self, job_id: str, video_path: str):
+        url = None
+        try:
+            start_streaming_upload(job_id, Path(video_path).parent)
+            url = finish_streaming_upload(job_id, video_path)
+        except Exception as e:
+            print(f"Upload of job {job_id} failed, the coordinator gets it without a video: {e}")
+        with session_scope() as db:
+            job = db.get(Job, job_id)
+            if url and job is not None and job.artifacts is not None:
+                job.artifacts.video_url = url
+        self._uploads[job_id] = False
+        if not url:
+            self._wake_up()  # report it completed with the next heartbeat
+
+    def _accept(self, item: dict[str, Any]):
+        """Queue a job the coordinator leased to this worker."""
+        job_id = item["job_id"]
+        payload = dict(item.get("payload") or {})
+        # UE reports to this server, which forwards to the coordinator
+        payload["mrq_server_base_url"] = settings.MRQ_SERVER_BASE_URL
+        payload.pop("gpu_index", None)
+        with session_scope() as db:
+            # Leased here before, under an earlier registration
+            _delete_local_job(db, job_id)
+            job = Job(job_id=job_id, session_id=item.get("session_id"), template_id=item["template_id"], payload=json.dumps(payload, ensure_ascii=False))
+            db.add(job)
+            db.add(JobLease(job_id=job_id, worker_id=self.worker_id, expires_at=now_cn() + timedelta(seconds=self.lease_seconds)))
+            db.commit()
+            self._held.add(job_id)
+
+            # Chunks are split here: their frames have to end up on the node that encodes them
+            chunks = int(payload.get("chunks") or 1)
+            if chunks > 1:
+                children = create_chunk_jobs(db, job, chunks)
+                db.commit()
+                for child in children:
+                    dispatch_queue.enqueue(child.job_id, child.created_at)
+            else:
+                dispatch_queue.enqueue(job.job_id, job.created_at)
+        print(f"Job {job_id} leased from the coordinator")
+
+    def _busy_slots(self) -> int:
+        """Renders of held jobs that wait for or hold a slot, counted like the local dispatch queue: a chunked job by its chunks."""
+        if not self._held:
+            return 0
+        held = list(self._held)
+        with session_scope() as db:
+            chunks = select(JobChunk.child_job_id).where(JobChunk.parent_job_id.in_(held))
+            return len(db.execute(
+                select(Job.job_id).where(
+                    or_(Job.job_id.in_(held), Job.job_id.in_(chunks)),
+                    Job.job_id.notin_(parent_job_ids()),
+                    Job.status.in_(list(SLOT_STATUSES)),
+                )
+            ).all())
+
+    def _renew(self):
+        """Local record of when the held leases run out, for whoever looks at this worker's database."""
+        if not self._held:
+            return
+        with session_scope() as db:
+            for lease in db.execute(select(JobLease).where(JobLease.job_id.in_(list(self._held)))).scalars():
+                lease.expires_at = now_cn() + timedelta(seconds=self.lease_seconds)
+
+    def _forget(self, job_ids: list[str]):
+        """The coordinator is done with these jobs; they stay in this worker's history."""
+        if not job_ids:
+            return
+        with session_scope() as db:
+            db.execute(delete(JobLease).where(JobLease.job_id.in_(job_ids)))
+        self._held.difference_update(job_ids)
+
+    def _drop(self, job_ids: list[str]):
+        """The coordinator took these jobs back: stop them here."""
+        if not job_ids:
+            return
+        pids = []
+        with session_scope() as db:
+            for job_id in job_ids:
+                job = db.get(Job, job_id)
+                if job is None or job.status in TERMINAL_STATUSES:
+                    continue
+                job.status = JobStatus.canceled.value
+                job.ended_at = now_cn()
+                cancel_chunk_jobs(db, job_id)
+                if job.pid:
+                    pids.append(job.pid)
+                abort_streaming_upload(job_id)
+                dispatch_queue.release(job_id)
+                print(f"Job {job_id} taken back by the coordinator, canceled")
+            db.execute(delete(JobLease).where(JobLease.job_id.in_(job_ids)))
+        self._held.difference_update(job_ids)
+        for pid in pids:
+            kill_tree(pid)
+
+
+def _delete_local_job(db, job_id: str) -> None:
+    children = db.execute(select(JobChunk.child_job_id).where(JobChunk.parent_job_id == job_id)).scalars().all()
+    ids = [job_id, *children]
+    db.execute(delete(JobChunk).where(JobChunk.parent_job_id == job_id))
+    db.execute(delete(JobArtifact).where(JobArtifact.job_id.in_(ids)))
+    db.execute(delete(JobLease).where(JobLease.job_id.in_(ids)))
+    db.execute(delete(Job).where(Job.job_id.in_(ids)))
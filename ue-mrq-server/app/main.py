@@ -7,9 +7,15 @@ from .db.database import engine, Base
 from .api import templates as templates_api, jobs as jobs_api
 from .templates.loader import TemplateRegistry
 from .scheduler.scheduler import Scheduler
+from .runner.progress_ingest import progress_ingest
+from .runner.upload import resume_uploads
 from contextlib import asynccontextmanager
 from .api import ue_notifications
 from .api import system as system_api
+from .api import workers as workers_api
+from .config import settings
+from .farm.coordinator import lease_monitor
+from .farm.worker import WorkerAgent
 from .middleware.error_handlers import *
 from .utils.logging import setup_logging
 from .utils.logging_tools import *
@@ -26,17 +32,32 @@ async def custom_lifespan(app: FastAPI):
     registry.load()
     app.state.registry = registry
 
+    progress_ingest.start()
+    resume_uploads()
+
     scheduler = Scheduler(registry)
     app.state.scheduler = scheduler
     scheduler.start()
 
+    if settings.NODE_ROLE == "coordinator":
+        lease_monitor.start()
+    elif settings.NODE_ROLE == "worker":
+        worker_agent = WorkerAgent(registry)
+        app.state.worker_agent = worker_agent
+        worker_agent.start()
+
     yield
 
     # Shutdown
     info("custom_lifespan: Shutdown")
+    worker_agent = getattr(app.state, "worker_agent", None)
+    if worker_agent:
+        worker_agent.stop()
+    lease_monitor.stop()
     scheduler = getattr(app.state, "scheduler", None)
     if scheduler:
         scheduler.stop()
+    progress_ingest.stop()
 
 app = FastAPI(title="UE MRQ Server", lifespan=custom_lifespan)
 
@@ -47,6 +68,7 @@ app.include_router(templates_api.router)
 app.include_router(jobs_api.router)
 app.include_router(ue_notifications.router)
 app.include_router(system_api.router)
+app.include_router(workers_api.router)
 
 # Mount static UI at /ui (same-origin)
 UI_DIR = Path(__file__).resolve().parent / "static" / "ui"
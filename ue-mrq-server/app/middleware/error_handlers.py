@@ -1,5 +1,6 @@
 import logging
 from fastapi import FastAPI, Request
+from fastapi.encoders import jsonable_encoder
 from fastapi.exceptions import RequestValidationError
 from fastapi import HTTPException
 from fastapi.responses import JSONResponse
@@ -25,10 +26,10 @@ def register_error_handlers(app: FastAPI):
     @app.exception_handler(RequestValidationError)
     async def validation_exception_handler(request: Request, exc: RequestValidationError):
         logger.info(f"Validation Error: {request.method} {request.url} - {exc.errors()}")
-        # Return detailed pydantic/validation errors
+        # Return detailed pydantic/validation errors; errors of model validators carry the exception in their ctx
         return JSONResponse(
             status_code=422,
-            content={"detail": exc.errors()}
+            content=jsonable_encoder({"detail": exc.errors()})
         )
     
     @app.exception_handler(Exception)
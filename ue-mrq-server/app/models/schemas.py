@@ -1,13 +1,63 @@
-from pydantic import BaseModel, Field
+from pydantic import BaseModel, Field, model_validator
 from typing import Literal, Optional, Dict, Any
 from .status import JobStatus
 
+class EncoderProcessOptions(BaseModel):
+    """Placement and deadline of the ffmpeg encoder UE spawns. Unset fields fall back to the ENCODER_* settings."""
+    priority: Optional[int] = Field(default=None, ge=-2, le=2)
+    cpu_affinity: Optional[str] = Field(default=None, pattern=r"^\d+(-\d+)?(,\d+(-\d+)?)*$")
+    cpu_quota: Optional[float] = Field(default=None, gt=0)
+    # Linux: group below ENCODER_CGROUP, never an absolute path or one that climbs out of it
+    cgroup: Optional[str] = Field(default=None, pattern=r"^[\w.-]+(/[\w.-]+)*$")
+    target_seconds: Optional[float] = Field(default=None, gt=0)  # encode deadline, trades quality for speed when needed
+
+    @model_validator(mode="after")
+    def _check_cgroup(self):
+        if self.cgroup is not None and any(part in (".", "..") for part in self.cgroup.split("/")):
+            raise ValueError("cgroup must not contain '.' or '..' components")
+        return self
+
+# Named bundles of RenderOptions; fields a job sets itself win over its profile's
+RENDER_PROFILES: Dict[str, Dict[str, Any]] = {
+    # Iteration renders: half resolution, no anti-aliasing accumulation or warm-up, every other frame
+    "draft": {"resolution_scale": 0.5, "spatial_samples": 1, "temporal_samples": 1, "warm_up_frames": 0, "frame_stride": 2},
+}
+
+class RenderOptions(BaseModel):
+    """Overrides of the MRQ output and anti-aliasing settings, for faster renders. Unset fields keep the project's."""
+    profile: Optional[Literal["draft"]] = None
+    resolution_scale: Optional[float] = Field(default=None, gt=0, le=1)  # of the output resolution
+    spatial_samples: Optional[int] = Field(default=None, ge=1, le=64)
+    temporal_samples: Optional[int] = Field(default=None, ge=1, le=64)
+    warm_up_frames: Optional[int] = Field(default=None, ge=0, le=1000)  # engine warm-up frames before each shot
+    frame_stride: Optional[int] = Field(default=None, ge=1, le=30)  # render every n-th frame, the video keeps its length
+    frame_start: Optional[int] = None  # display frames of the sequence, end exclusive
+    frame_end: Optional[int] = None
+
+    @model_validator(mode="after")
+    def _check_range(self):
+        if self.frame_start is not None and self.frame_end is not None and self.frame_end <= self.frame_start:
+            raise ValueError("frame_end must be greater than frame_start")
+        return self
+
+    def resolved(self) -> Dict[str, Any]:
+        """The profile's values overlaid with the fields set here, without the unset ones."""
+        values = dict(RENDER_PROFILES.get(self.profile or "", {}))
+        values.update({k: v for k, v in self.model_dump(exclude={"profile"}).items() if v is not None})
+        if self.profile:
+            values["profile"] = self.profile
+        return values
+
 class CreateJobRequest(BaseModel):
     template_id: str
     params: Dict[str, Any]
     quality: Literal["LOW","MEDIUM","HIGH","EPIC"] = "HIGH"
     format: Literal["mp4","mov"] = "mp4"
     session_id: Optional[str] = None
+    chunks: int = Field(default=1, ge=1, le=64)  # >1 splits the sequence into frame ranges rendered in parallel
+    encoder: Optional[EncoderProcessOptions] = None
+    preview: Optional[bool] = None  # live HLS preview while rendering; unset falls back to PREVIEW_HLS
+    render: Optional[RenderOptions] = None  # draft/preview overrides, e.g. {"profile": "draft"}
 
 class Progress(BaseModel):
     percent: float = 0.0
@@ -22,6 +72,9 @@ class JobResponse(BaseModel):
     template_id: str
     timestamps: dict | None = None
     params: Optional[Dict[str, Any]] = None
+    metrics: Optional[Dict[str, Any]] = None
+    render: Optional[Dict[str, Any]] = None  # resolved render overrides of a draft/preview job
+    preview_url: Optional[str] = None  # HLS playlist of the frames rendered so far
 
 class UEJobResponse(BaseModel):
     """
@@ -37,6 +90,13 @@ class CancelResponse(BaseModel):
     status: JobStatus
     message: str
 
+class RetryResponse(BaseModel):
+    session_id: Optional[str]
+    job_id: str
+    status: JobStatus
+    attempt: int
+    message: str
+
 class JobNoParamsResponse(BaseModel):
     """
     Response model for jobs without parameters.
@@ -48,9 +108,21 @@ class JobNoParamsResponse(BaseModel):
     artifacts: dict | None = None
     template_id: str
     timestamps: dict | None = None
+    preview_url: Optional[str] = None
 
 class JobParamsResponse(BaseModel):
     """
     Response model for jobs with parameters.
     """
-    params: Optional[Dict[str, Any]] = None
\ No newline at end of file
+    params: Optional[Dict[str, Any]] = None
+
+class WorkerRegisterRequest(BaseModel):
+    name: str
+    url: Optional[str] = None  # the worker's own server, where its UE processes report to
+    capabilities: Dict[str, Any] = Field(default_factory=dict)  # templates it can render (all when missing), slots, gpus, cpu_cores, ram_mb
+
+class WorkerHeartbeatRequest(BaseModel):
+    jobs: list[Dict[str, Any]] = Field(default_factory=list)  # state of every job the worker holds, as in GET /jobs/events
+
+class WorkerLeaseRequest(BaseModel):
+    slots: int = Field(default=1, ge=0, le=64)  # jobs the worker can take now
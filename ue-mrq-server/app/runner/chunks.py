@@ -0,0 +1,194 @@
+from __future__ import annotations
+import json
+import shutil
+import threading
+import uuid
+from pathlib import Path
+from sqlalchemy import select
+from sqlalchemy.orm import Session
+from ..config import settings
+from ..db.database import session_scope
+from ..db.models import Job, JobArtifact, JobChunk
+from ..models.status import JobStatus, RUNNING_STATUSES, TERMINAL_STATUSES
+from ..utils.procs import kill_tree
+from ..utils.time import now_cn
+from ..scheduler.dispatch import dispatch_queue
+from ..storage.multipart_upload import streaming_upload_enabled, start_streaming_upload, abort_streaming_upload
+from .ffmpeg import list_audio, make_audio_concat_file, make_concat_file, project_encoder_settings, run_ffmpeg_concat
+from .upload import finish_upload_in_background
+
+# Same mapping as the executor's -MovieQuality frame rates
+QUALITY_FPS = {"LOW": 24, "MEDIUM": 30, "HIGH": 60, "EPIC": 120}
+
+
+def parent_job_ids():
+    """Subquery of jobs that were split into chunks. They never run UE themselves."""
+    return select(JobChunk.parent_job_id)
+
+
+def is_parent_job(db: Session, job_id: str) -> bool:
+    return db.execute(select(JobChunk.child_job_id).where(JobChunk.parent_job_id == job_id).limit(1)).first() is not None
+
+
+def chunks_to_retry(db: Session, parent_job_id: str) -> list[Job]:
+    """Chunks of a parent that failed or were canceled. None means every chunk rendered and only the final encode failed."""
+    return [j for _, j in _children(db, parent_job_id) if j.status_enum in (JobStatus.failed, JobStatus.canceled)]
+
+
+def create_chunk_jobs(db: Session, parent: Job, chunk_count: int) -> list[Job]:
+    """Split `parent` into `chunk_count` queued child jobs, one frame range each."""
+    payload = json.loads(parent.payload) if parent.payload else {}
+    children = []
+    for i in range(chunk_count):
+        child_payload = dict(payload, parent_job_id=parent.job_id, chunk_index=i, chunk_count=chunk_count)
+        child = Job(
+            job_id=str(uuid.uuid4()),
+            session_id=parent.session_id,
+            template_id=parent.template_id,
+            payload=json.dumps(child_payload, ensure_ascii=False),
+        )
+        db.add(child)
+        db.add(JobChunk(child_job_id=child.job_id, parent_job_id=parent.job_id, chunk_index=i, chunk_count=chunk_count))
+        children.append(child)
+    return children
+
+
+def _children(db: Session, parent_job_id: str) -> list[tuple[JobChunk, Job]]:
+    rows = db.execute(
+        select(JobChunk, Job)
+        .join(Job, Job.job_id == JobChunk.child_job_id)
+        .where(JobChunk.parent_job_id == parent_job_id)
+        .order_by(JobChunk.chunk_index.asc())
+    ).all()
+    return [(c, j) for c, j in rows]
+
+
+def cancel_chunk_jobs(db: Session, parent_job_id: str) -> None:
+    """Cancel every unfinished chunk of a parent. Running UE processes are killed in the background."""
+    pids = []
+    for _, child in _children(db, parent_job_id):
+        if child.status in TERMINAL_STATUSES:
+            continue
+        child.status = JobStatus.canceled.value
+        child.ended_at = now_cn()
+        dispatch_queue.release(child.job_id)
+        if child.pid:
+            pids.append(child.pid)
+    for pid in pids:
+        threading.Thread(target=kill_tree, args=(pid,), daemon=True).start()
+
+
+def sync_parent_job(db: Session, child: Job) -> str | None:
+    """
+    Fold a chunk's state into its parent: progress is the mean of the chunks' render progress,
+    the ETA is the slowest chunk's. A failed chunk fails the parent and cancels its siblings.
+    Returns the parent job id when every chunk is done and the final encode should start
+    (call start_final_encode after committing).
+    """
+    chunk = db.get(JobChunk, child.job_id)
+    if chunk is None:
+        return None
+    parent = db.get(Job, chunk.parent_job_id)
+    if parent is None or parent.status in TERMINAL_STATUSES or parent.status_enum in (JobStatus.encoding, JobStatus.uploading, JobStatus.canceling):
+        return None
+
+    children = [j for _, j in _children(db, parent.job_id)]
+    statuses = {j.status for j in children}
+
+    if statuses & {JobStatus.failed.value, JobStatus.canceled.value}:
+        parent.status = JobStatus.failed.value
+        parent.ended_at = now_cn()
+        cancel_chunk_jobs(db, parent.job_id)
+        return None
+
+    parent.progress_percent = sum(min(j.progress_percent or 0.0, 1.0) for j in children) / len(children)
+    etas = [j.progress_eta_seconds for j in children if j.progress_eta_seconds is not None and j.progress_eta_seconds >= 0]
+    parent.progress_eta_seconds = max(etas) if etas else None
+
+    if statuses == {JobStatus.completed.value}:
+        parent.status = JobStatus.encoding.value
+        parent.progress_percent = 1.0
+        return parent.job_id
+
+    if statuses & RUNNING_STATUSES:
+        parent.status = JobStatus.rendering.value
+        if parent.started_at is None:
+            parent.started_at = now_cn()
+    return None
+
+
+def start_final_encode(parent_job_id: str) -> None:
+    threading.Thread(target=_final_encode, args=(parent_job_id,), daemon=True).start()
+
+
+def _final_encode(parent_job_id: str) -> None:
+    """Concat every chunk's frames (in chunk order) into the parent's video, then drop the chunk frames."""
+    with session_scope() as db:
+        parent = db.get(Job, parent_job_id)
+        if parent is None:
+            return
+        payload = json.loads(parent.payload) if parent.payload else {}
+        frames_dirs = [Path(c.frames_dir) for c, _ in _children(db, parent_job_id) if c.frames_dir]
+
+    fps = QUALITY_FPS.get(str(payload.get("quality", "MEDIUM")).upper(), 30)
+    # The chunks rendered every n-th frame only
+    stride = int((payload.get("render") or {}).get("frame_stride") or 1)
+    if stride > 1:
+        fps = fps / stride
+    work = Path(settings.DATA_ROOT) / "jobs" / parent_job_id
+    logs = work / "logs"
+    logs.mkdir(parents=True, exist_ok=True)
+    concat_txt = work / "chunks_concat.txt"
+    audio_concat_txt = work / "chunks_audio_concat.txt"
+    # The same container and codecs UE encodes an unchunked job with
+    video_format = payload.get("format") if payload.get("format") in ("mp4", "mov") else "mp4"
+    encoder = project_encoder_settings()
+    out_video = work / f"{parent_job_id}.{video_format}"
+
+    # Upload the video while ffmpeg writes it; a stale file from an earlier attempt must not be picked up
+    streaming = streaming_upload_enabled()
+    if streaming:
+        out_video.unlink(missing_ok=True)
+        start_streaming_upload(parent_job_id, work)
+
+    rc = -1
+    try:
+        make_concat_file(frames_dirs, concat_txt, fps=fps)
+        # Each chunk's wave output covers its own frame range; joined in chunk order they cover the sequence
+        audio_files = [a for d in frames_dirs for a in list_audio(d)]
+        if audio_files:
+            make_audio_concat_file(audio_files, audio_concat_txt)
+        rc = run_ffmpeg_concat(concat_txt, fps, out_video, logs / f"ffmpeg_{parent_job_id}.log", fragmented=streaming,
+                               audio_concat_txt=audio_concat_txt if audio_files else None,
+                               video_codec=encoder["VideoCodec"], audio_codec=encoder["AudioCodec"])
+    except Exception as e:
+        print(f"Final encode of job {parent_job_id} failed: {e}")
+
+    uploading = False
+
+    with session_scope() as db:
+        parent = db.get(Job, parent_job_id)
+        if parent is None:
+            return
+        if parent.status_enum != JobStatus.encoding:
+            abort_streaming_upload(parent_job_id)
+            return  # canceled meanwhile
+        parent.ended_at = now_cn()
+        if rc == 0 and out_video.exists():
+            if parent.artifacts is None:
+                parent.artifacts = JobArtifact(job_id=parent.job_id)
+            parent.artifacts.video_path = out_video.absolute().as_posix()
+            uploading = streaming
+            parent.status = JobStatus.uploading.value if uploading else JobStatus.completed.value
+            parent.progress_percent = 2.0  # render + encode, same scale UE reports
+            parent.progress_eta_seconds = 0
+        else:
+            abort_streaming_upload(parent_job_id)
+            parent.status = JobStatus.failed.value
+
+    if uploading:
+        finish_upload_in_background(parent_job_id, out_video.absolute().as_posix())
+
+    if rc == 0:
+        for d in frames_dirs:
+            shutil.rmtree(d, ignore_errors=True)
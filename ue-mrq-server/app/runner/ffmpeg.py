@@ -2,23 +2,98 @@ from pathlib import Path
 from ..config import settings
 from ..utils.procs import popen
 
+FRAME_MANIFEST = "frames.manifest"
+# Project settings of the Command Line Encoder UE encodes unchunked jobs with (Config/DefaultEngine.ini)
+ENCODER_SETTINGS_SECTION = "[/Script/MovieRenderPipelineCore.MoviePipelineCommandLineEncoderSettings]"
 
-def make_concat_file(frames_dir: Path, out_txt: Path) -> None:
-    # 按文件名排序写入 concat 列表
-    frames = sorted(list(frames_dir.glob("*.png")))
+
+def project_encoder_settings() -> dict[str, str]:
+    """VideoCodec and AudioCodec of the project's Command Line Encoder settings, with UE's defaults where unset."""
+    values = {"VideoCodec": "libx264", "AudioCodec": "aac"}
+    ini = Path(settings.UPROJECT).parent / "Config" / "DefaultEngine.ini"
+    try:
+        lines = ini.read_text(encoding="utf-8", errors="ignore").splitlines()
+    except OSError:
+        return values
+    in_section = False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("["):
+            in_section = line == ENCODER_SETTINGS_SECTION
+        elif in_section and "=" in line:
+            key, value = line.split("=", 1)
+            if key in values and value:
+                values[key] = value.strip().strip('"')
+    return values
+
+
+def list_audio(frames_dir: Path) -> list[Path]:
+    """Audio MRQ wrote next to a render's frames (its wave output), in shot order."""
+    return sorted(frames_dir.glob("*.wav"))
+
+
+def list_frames(frames_dir: Path) -> list[tuple[Path, int]]:
+    """
+    Frames of one render in order, as (file, held frame count).
+    Uses the executor's frames.manifest (first render pass) when present, which also covers deduplicated
+    frames; otherwise falls back to sorted file names.
+    """
+    manifest = frames_dir / FRAME_MANIFEST
+    if manifest.exists():
+        entries: list[tuple[Path, int]] = []
+        first_pass = None
+        for line in manifest.read_text(encoding="utf-8", errors="ignore").splitlines():
+            parts = line.split("\t")
+            if len(parts) != 3:
+                continue
+            first_pass = first_pass or parts[0]
+            if parts[0] == first_pass:
+                entries.append((Path(parts[2]), max(int(parts[1]), 1)))
+        if entries:
+            return entries
+    return [(p, 1) for p in sorted(frames_dir.glob("*.png"))]
+
+
+def make_concat_file(frames_dirs: Path | list[Path], out_txt: Path, fps: float | None = None) -> None:
+    # 按渲染顺序写入 concat 列表; 给定 fps 时写入每帧 duration (去重后的静止帧会更长)
+    dirs = [frames_dirs] if isinstance(frames_dirs, Path) else frames_dirs
+    frames = [entry for d in dirs for entry in list_frames(d)]
+    with open(out_txt, 'w', encoding='utf-8') as f:
+        for i, (p, held) in enumerate(frames):
+            # concat ignores the last entry's duration: split a held last frame and repeat the file once
+            is_last = i == len(frames) - 1
+            listed = held - 1 if (is_last and held > 1) else held
+            f.write(f"file '{p.as_posix()}'\n")
+            if fps:
+                f.write(f"duration {listed / fps:.6f}\n")
+            if listed != held:
+                f.write(f"file '{p.as_posix()}'\n")
+                if fps:
+                    f.write(f"duration {1 / fps:.6f}\n")
+
+
+def make_audio_concat_file(audio_files: list[Path], out_txt: Path) -> None:
     with open(out_txt, 'w', encoding='utf-8') as f:
-        for p in frames:
+        for p in audio_files:
             f.write(f"file '{p.as_posix()}'\n")
 
 
-def run_ffmpeg_concat(concat_txt: Path, fps: int, out_mp4: Path, log_path: Path, bitrate="20M", maxrate="30M") -> int:
+def run_ffmpeg_concat(concat_txt: Path, fps: float, out_video: Path, log_path: Path, bitrate="20M", maxrate="30M", fragmented: bool = False,
+                      audio_concat_txt: Path | None = None, video_codec: str = "h264_nvenc", audio_codec: str = "aac") -> int:
+    # Fragmented MP4 never rewrites what it has written, so it can be uploaded while ffmpeg runs; faststart moves the moov at the end
+    movflags = "+frag_keyframe+empty_moov+default_base_moof" if fragmented else "+faststart"
     cmd = [
         settings.FFMPEG, "-hide_banner", "-y", "-loglevel", "error",
-        "-f", "concat", "-safe", "0", "-r", str(fps), "-i", str(concat_txt),
-        "-c:v", "h264_nvenc", "-preset", "p4", "-rc", "vbr", "-b:v", bitrate, "-maxrate", maxrate,
-        "-pix_fmt", "yuv420p", "-movflags", "+faststart",
-        "-c:a", "aac", "-b:a", "192k",
-        str(out_mp4)
+        "-f", "concat", "-safe", "0", "-i", str(concat_txt),
     ]
+    if audio_concat_txt is not None:
+        cmd += ["-f", "concat", "-safe", "0", "-i", str(audio_concat_txt), "-map", "0:v", "-map", "1:a"]
+    cmd += ["-r", str(fps), "-c:v", video_codec]
+    # -preset/-rc are nvenc's names for rate control; other encoders get the bitrate alone
+    if video_codec.endswith("_nvenc"):
+        cmd += ["-preset", "p4", "-rc", "vbr"]
+    cmd += ["-b:v", bitrate, "-maxrate", maxrate, "-pix_fmt", "yuv420p", "-movflags", movflags]
+    cmd += ["-c:a", audio_codec, "-b:a", "192k"] if audio_concat_txt is not None else ["-an"]
+    cmd.append(str(out_video))
     proc = popen(cmd, log_path=log_path)
-    return proc.wait()
\ No newline at end of file
+    return proc.wait()
@@ -0,0 +1,152 @@
+"""
+Coalesced progress ingest.
+
+Every running UE process posts its progress about once a second. Committing each post on its own serialized them
+against the scheduler and the API, so posts now land in memory and a background thread writes what changed every
+PROGRESS_FLUSH_MS, all jobs in one transaction; a job that reported ten times since the last flush costs one row
+update, while subscribers to job events (db.job_events) still get every post right away. What others react to is
+written at once: a job's first report (to answer for an unknown job) and every status change, since those free
+slots, start uploads and move split jobs along. Memory figures change with every post but only matter once the job
+is over, so they stay in memory (live_metrics, merged into GET /jobs/{id}) and go into the job's metrics when UE
+is done with it.
+"""
+from __future__ import annotations
+import json
+import threading
+from typing import Any, Optional
+from sqlalchemy import select
+
+from ..config import settings
+from ..db.database import session_scope
+from ..db.job_events import job_events
+from ..db.models import Job
+from ..models.status import TERMINAL_STATUSES
+from .chunks import sync_parent_job
+
+# Memory of the UE process as its watchdog last sampled it, with high-water marks; kept in the job's metrics at close
+MEMORY_FIELDS = ("memory_mb", "memory_peak_mb", "gpu_memory_mb", "gpu_memory_peak_mb", "memory_trims")
+# Fields of a progress post that are coalesced; the latest value wins
+PROGRESS_FIELDS = ("progress_percent", "progress_eta_seconds", "preview_playlist") + MEMORY_FIELDS
+
+
+class ProgressIngest:
+    def __init__(self):
+        self._lock = threading.Lock()
+        # Held while writing, so a status change can't be overtaken by an older batch
+        self._write_lock = threading.Lock()
+        self._pending: dict[str, dict[str, Any]] = {}
+        self._memory: dict[str, dict[str, Any]] = {}  # latest memory figures of each reporting job
+        self._status: dict[str, Optional[str]] = {}  # last status each reporting job sent
+        self._stop = threading.Event()
+        self._th: threading.Thread | None = None
+
+    def report(self, job_id: str, fields: dict[str, Any], status: Optional[str]) -> bool:
+        """Take one progress post. False when there is no such job."""
+        memory = {k: fields[k] for k in MEMORY_FIELDS if k in fields}
+        fields = {k: v for k, v in fields.items() if k not in MEMORY_FIELDS}
+        with self._lock:
+            self._pending.setdefault(job_id, {}).update(fields)
+            if memory:
+                self._memory.setdefault(job_id, {}).update(memory)
+            first = job_id not in self._status
+            coalesced = not first and (status is None or status == self._status[job_id])
+        if not coalesced:
+            return self._write_now(job_id, status)
+        # Subscribers see it now, the database with the next flush
+        self._publish(job_id, fields)
+        return True
+
+    def close(self, job_id: str) -> None:
+        """UE for this job is done: write what it reported last, and treat a later report as a first one."""
+        with self._write_lock:
+            with self._lock:
+                fields = {**self._pending.pop(job_id, {}), **self._memory.pop(job_id, {})}
+                self._status.pop(job_id, None)
+            if fields:
+                self._write({job_id: fields})
+
+    def live_metrics(self, job_id: str) -> dict[str, Any]:
+        """Memory figures of a running job that aren't in its metrics yet."""
+        with self._lock:
+            return dict(self._memory.get(job_id) or {})
+
+    def flush(self) -> None:
+        with self._write_lock:
+            with self._lock:
+                pending, self._pending = self._pending, {}
+            if pending:
+                self._write(pending)
+
+    def start(self):
+        if self._th and self._th.is_alive():
+            return
+        self._stop.clear()
+        self._th = threading.Thread(target=self._loop, daemon=True)
+        self._th.start()
+
+    def stop(self):
+        self._stop.set()
+        if self._th:
+            self._th.join(timeout=1)
+        self.flush()
+
+    def _loop(self):
+        while not self._stop.wait(settings.PROGRESS_FLUSH_MS / 1000):
+            try:
+                self.flush()
+            except Exception as e:
+                print(f"Progress flush failed: {e}")
+
+    @staticmethod
+    def _publish(job_id: str, fields: dict[str, Any]) -> None:
+        progress = {name: fields[field] for name, field in (("percent", "progress_percent"), ("eta_seconds", "progress_eta_seconds")) if field in fields}
+        if progress:
+            job_events.publish(job_id, {"progress": progress})
+
+    def _write_now(self, job_id: str, status: Optional[str]) -> bool:
+        with self._write_lock:
+            with self._lock:
+                fields = self._pending.pop(job_id, {})
+            found = self._write({job_id: fields}, {job_id: status} if status is not None else None)
+            with self._lock:
+                if found:
+                    self._status[job_id] = status
+                else:
+                    self._status.pop(job_id, None)
+            return found
+
+    def _write(self, pending: dict[str, dict[str, Any]], statuses: Optional[dict[str, str]] = None) -> bool:
+        """Apply reported fields (and statuses) in one transaction. False when none of the jobs exists."""
+        with session_scope() as db:
+            jobs = db.execute(select(Job).where(Job.job_id.in_(list(pending)))).scalars().all()
+            for job in jobs:
+                fields = pending[job.job_id]
+                if "progress_percent" in fields:
+                    job.progress_percent = fields["progress_percent"]
+                if "progress_eta_seconds" in fields:
+                    job.progress_eta_seconds = fields["progress_eta_seconds"]
+                payload = json.loads(job.payload) if job.payload else {}
+                changed = False
+                # Sent once UE has written the first preview segment; /system/preview serves the playlist from there
+                if fields.get("preview_playlist") and payload.get("preview_playlist") != fields["preview_playlist"]:
+                    payload["preview_playlist"] = fields["preview_playlist"]
+                    changed = True
+                memory = {k: fields[k] for k in MEMORY_FIELDS if k in fields}
+                metrics = payload.get("metrics") or {}
+                if any(metrics.get(k) != v for k, v in memory.items()):
+                    payload["metrics"] = {**metrics, **memory}
+                    changed = True
+                if changed:
+                    job.payload = json.dumps(payload, ensure_ascii=False)
+                # A report that was on its way when the job ended (was canceled, say) doesn't revive it
+                if statuses and job.job_id in statuses and job.status not in TERMINAL_STATUSES:
+                    job.status = statuses[job.job_id]
+
+                percentage = job.progress_percent * 100 if job.progress_percent is not None else 0
+                print(f"JobId {job.job_id} progress: {percentage:.0f}%")
+                sync_parent_job(db, job)
+            db.commit()
+            return bool(jobs)
+
+
+progress_ingest = ProgressIngest()
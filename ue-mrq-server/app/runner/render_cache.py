@@ -0,0 +1,77 @@
+from __future__ import annotations
+import hashlib
+import json
+from pathlib import Path
+from sqlalchemy.orm import Session
+from ..config import settings
+from ..db.models import Job, JobArtifact, RenderCacheEntry
+from ..models.status import JobStatus
+from ..utils.time import now_cn
+
+# Request fields that change what UE renders. Everything else (session, server url, attempt, ...) does not.
+_RENDER_FIELDS = ("template_id", "params", "quality", "format", "render")
+
+
+def cache_key_for(job: Job, fingerprint: str) -> str:
+    """
+    Key of a job's result: the executor's fingerprint covers scene packages, MRQ config, encoder and build,
+    the request fields cover the template params the level applies at runtime.
+    """
+    payload = json.loads(job.payload) if job.payload else {}
+    request_fields = {k: payload.get(k) for k in _RENDER_FIELDS}
+    text = fingerprint + "\n" + json.dumps(request_fields, sort_keys=True, ensure_ascii=False)
+    return hashlib.sha256(text.encode("utf-8")).hexdigest()
+
+
+def remember_cache_key(job: Job, cache_key: str) -> None:
+    payload = json.loads(job.payload) if job.payload else {}
+    payload["render_cache_key"] = cache_key
+    job.payload = json.dumps(payload, ensure_ascii=False)
+
+
+def try_complete_from_cache(db: Session, job: Job, cache_key: str) -> bool:
+    """Complete `job` with a cached video if one exists for `cache_key`. Stale entries (file gone) are dropped."""
+    if not settings.RENDER_CACHE_ENABLED:
+        return False
+
+    entry = db.get(RenderCacheEntry, cache_key)
+    if entry is None:
+        return False
+    if not Path(entry.video_path).is_file():
+        db.delete(entry)
+        return False
+
+    entry.hit_count = (entry.hit_count or 0) + 1
+    entry.last_hit_at = now_cn()
+
+    if job.artifacts is None:
+        job.artifacts = JobArtifact(job_id=job.job_id)
+    job.artifacts.video_path = entry.video_path
+    source_artifacts = db.get(JobArtifact, entry.source_job_id)
+    if source_artifacts is not None and source_artifacts.video_url:
+        job.artifacts.video_url = source_artifacts.video_url
+    job.status = JobStatus.completed.value
+    job.progress_percent = 2.0  # render + encode, same scale UE reports
+    job.progress_eta_seconds = 0
+    job.ended_at = now_cn()
+    print(f"Job {job.job_id} served from render cache (video of job {entry.source_job_id}).")
+    return True
+
+
+def store_cache_entry(db: Session, job: Job) -> None:
+    """Index the finished video of `job` under the fingerprint it reported, so identical jobs can reuse it."""
+    if not settings.RENDER_CACHE_ENABLED or job.artifacts is None or not job.artifacts.video_path:
+        return
+    payload = json.loads(job.payload) if job.payload else {}
+    cache_key = payload.get("render_cache_key")
+    if not cache_key:
+        return
+
+    entry = db.get(RenderCacheEntry, cache_key)
+    if entry is None:
+        entry = RenderCacheEntry(cache_key=cache_key, video_path=job.artifacts.video_path, source_job_id=job.job_id)
+        db.add(entry)
+    elif entry.video_path != job.artifacts.video_path:
+        entry.video_path = job.artifacts.video_path
+        entry.source_job_id = job.job_id
+        entry.created_at = now_cn()
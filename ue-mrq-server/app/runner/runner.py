@@ -10,156 +10,322 @@ except Exception:
     from datetime import timezone, timedelta
     CN_TZ = timezone(timedelta(hours=8))
 
-import psutil
+from sqlalchemy import select
 from sqlalchemy.orm import Session
 import requests
+import asyncio
 import time
+from ..db.database import session_scope
 from ..db.models import Job, JobArtifact
 from ..models.status import JobStatus
-from ..utils.procs import popen, subprocess
+from ..utils.procs import spawn, subprocess
+from ..utils.misc import LogTail, read_tail_lines
+from ..storage.multipart_upload import streaming_upload_enabled
 from ..config import settings
 from .ue_command import build_ue_cmd
 from .ffmpeg import make_concat_file, run_ffmpeg_concat
+from .chunks import sync_parent_job, start_final_encode
+from .progress_ingest import progress_ingest
+
+
+def requeue_for_resume(job: Job) -> int:
+    """
+    Put a failed/interrupted job back in the queue so the next UE launch resumes from
+    the frames already on disk. Returns the new attempt number (stored in the payload).
+    """
+    try:
+        payload = json.loads(job.payload) if job.payload else {}
+    except Exception:
+        payload = {}
+
+    attempt = int(payload.get("attempt", 0)) + 1
+    payload["attempt"] = attempt
+    job.payload = json.dumps(payload, ensure_ascii=False)
+
+    job.status = JobStatus.queued.value
+    job.pid = None
+    job.ended_at = None
+    job.progress_eta_seconds = None
+    return attempt
+
+
+def encode_fps_hint(db: Session, template_id: str, quality: str) -> float | None:
+    """Encode rate UE measured on the latest completed job of the same template and quality, if any."""
+    payloads = db.execute(
+        select(Job.payload)
+        .where(Job.template_id == template_id, Job.status == JobStatus.completed.value)
+        .order_by(Job.ended_at.desc())
+        .limit(20)
+    ).scalars()
+    for raw in payloads:
+        try:
+            payload = json.loads(raw) if raw else {}
+        except Exception:
+            continue
+        fps = (payload.get("metrics") or {}).get("encode_fps")
+        if str(payload.get("quality", "MEDIUM")).upper() == quality and isinstance(fps, (int, float)) and fps > 0:
+            return float(fps)
+    return None
 
 
 @dataclass
 class RunnerContext:
-    job: Job
+    job_id: str
+    attempt: int
     work_dir: Path
     frames_dir: Path
     logs_dir: Path
     ue_log: Path
     ffmpeg_log: Path
+    encoder_log: Path
     out_mp4: Path
 
 
+# How often the UE log is read on while a job runs, so only the last few seconds are left to read at exit
+LOG_TAIL_INTERVAL_SECONDS = 5
 
-def run_job(db: Session, job: Job, template: dict) -> None:
-    # Init work dirs
-    work = Path(settings.DATA_ROOT) / "jobs" / job.job_id
-    frames = work / "frames"
-    logs = work / "logs"
-    frames.mkdir(parents=True, exist_ok=True)
-    logs.mkdir(parents=True, exist_ok=True)
+# What UE writes when it dies rather than exits: its crash handler, failed checks and a lost or exhausted GPU
+CRASH_LOG_MARKERS = (
+    "=== Critical error: ===",
+    "Fatal error",
+    "Unhandled Exception",
+    "Assertion failed",
+    "GPU crashed",
+    "Device Removed",
+    "DXGI_ERROR_DEVICE",
+    "Out of video memory",
+    "Ran out of memory",
+)
 
-    # payload = json.loads(job.payload)
 
-    ctx = RunnerContext(
-        job=job,
-        work_dir=work,
-        frames_dir=frames,
-        logs_dir=logs,
-        ue_log=logs / f"ue_{job.job_id}.log",
-        ffmpeg_log=logs / f"ffmpeg_{job.job_id}.log",
-        out_mp4=work / f"{job.job_id}.mp4",
-    )
+def _looks_like_crash(rc: int, ue_tail: LogTail | None) -> bool:
+    """
+    Killed by a signal (negative on POSIX), an NTSTATUS exception code on Windows (0xC0000005 access violation and
+    friends), or a crash report at the end of the log. A plain non-zero exit is UE refusing the job, which a relaunch
+    won't change.
+    """
+    if rc < 0 or rc >= 0xC0000000:
+        return True
+    if ue_tail is None:
+        return False
+    return any(marker in line for line in (*ue_tail.errors, *ue_tail.lines) for marker in CRASH_LOG_MARKERS)
 
-    job.status = JobStatus.starting.value
-    job.started_at = datetime.now(CN_TZ)
-    db.commit()
 
-    ue_log_absolute = ctx.ue_log.absolute()
+async def run_job(job_id: str, template: dict) -> datetime | None:
+    """
+    Start UE for a job the scheduler picked and see it through to UE's exit. Runs on the supervisor loop: UE's exit
+    is awaited, not polled, and the database work is done in worker threads so it never stalls the other jobs.
+    Returns the job's creation time when it was requeued to resume, to keep its place in the queue.
+    """
+    launch = await asyncio.to_thread(_prepare_launch, job_id, template)
+    if launch is None:
+        return None
+    ctx, ue_cmd = launch
 
     try:
-        req_payload = json.loads(job.payload) if job.payload else {}
-    except Exception:
-        req_payload = {}
+        proc = await spawn(ue_cmd, log_path=ctx.ue_log.absolute())
+    except Exception as e:
+        print(f"Start UE for job {job_id} failed: {e}")
+        return await asyncio.to_thread(_finish_job, ctx, None, None)
+    await asyncio.to_thread(_record_pid, job_id, proc.pid)
 
-    quality_str = str(req_payload.get("quality", "MEDIUM")).upper()
-    _qmap = {"LOW": 0, "MEDIUM": 1, "HIGH": 2, "EPIC": 3}
-    quality_num = _qmap.get(quality_str, 1)
+    ue_tail = LogTail(ctx.ue_log.absolute())
+    wait_start = time.monotonic()
+    while True:
+        try:
+            rc = await asyncio.wait_for(proc.wait(), timeout=LOG_TAIL_INTERVAL_SECONDS)
+            break
+        except asyncio.TimeoutError:
+            ue_tail.poll()
+    ue_tail.close()
+    print(f"Job {job_id}: process {proc.pid} return with code {rc} after {time.monotonic() - wait_start:.1f}s.")
 
-    movie_fmt = req_payload.get("format") # "mp4" or "mov"
+    return await asyncio.to_thread(_finish_job, ctx, rc, ue_tail)
 
-    mrq_server_base_url = req_payload.get("mrq_server_base_url") or None
 
-    ue_cmd = build_ue_cmd(
-        map_path=template.get("map_path"),
-        level_sequence=template.get("level_sequence"),
-        job_id=job.job_id,
-        log_path=ue_log_absolute,
-        movie_quality=str(quality_num),
-        movie_format=movie_fmt,
-        game_mode_class=settings.GAME_MODE_CLASS,
-        mrq_server_base_url=mrq_server_base_url,
-    )
+def _prepare_launch(job_id: str, template: dict) -> tuple[RunnerContext, list[str]] | None:
+    with session_scope() as db:
+        job = db.get(Job, job_id)
+        if job is None:
+            return None
 
-    debug_cmd_str = subprocess.list2cmdline(ue_cmd)
-    print("ue_cmd.exe content: " + debug_cmd_str)
+        try:
+            req_payload = json.loads(job.payload) if job.payload else {}
+        except Exception:
+            req_payload = {}
 
-    print(f"ue_cmd.exe log path: {ue_log_absolute}")
+        # Init work dirs
+        work = Path(settings.DATA_ROOT) / "jobs" / job.job_id
+        frames = work / "frames"
+        logs = work / "logs"
+        frames.mkdir(parents=True, exist_ok=True)
+        logs.mkdir(parents=True, exist_ok=True)
 
-    proc = popen(ue_cmd, log_path=ue_log_absolute)
-    
-    # Helper: print UE log tail for diagnostics (success or failure)
-    def _print_ue_log_tail(from_error: bool = False) -> None:
-        try:
-            lines = Path(ue_log_absolute).read_text(encoding='utf-8', errors='ignore').splitlines()
-            if not lines:
-                return
-            start_idx = max(0, len(lines) - 200)
-            if from_error:
-                for i in range(len(lines) - 1, -1, -1):
-                    if 'error' in lines[i].lower():
-                        start_idx = i
-                        break
-            tail = "\n".join(lines[start_idx:])
-            print("---- UE log tail ----")
-            print(tail)
-            print("---- UE log tail ----")
-            print(f"More details: {ue_log_absolute}")
-        except Exception as e:
-            print(f"Read UE log failed: {e}")
+        ctx = RunnerContext(
+            job_id=job.job_id,
+            attempt=int(req_payload.get("attempt", 0)),
+            work_dir=work,
+            frames_dir=frames,
+            logs_dir=logs,
+            ue_log=logs / f"ue_{job.job_id}.log",
+            ffmpeg_log=logs / f"ffmpeg_{job.job_id}.log",
+            encoder_log=logs / f"encoder_{job.job_id}.log",
+            out_mp4=work / f"{job.job_id}.mp4",
+        )
 
-    if (proc.pid is None) or (not psutil.pid_exists(proc.pid)):
-        job.status = JobStatus.failed.value
+        job.status = JobStatus.starting.value
+        job.started_at = datetime.now(CN_TZ)
+        # Counted from zero per attempt, so the exit can tell whether this attempt rendered anything
+        job.progress_percent = 0.0
         db.commit()
-        return 
-    
-    job.pid = proc.pid
-    db.commit()
 
-   
-    wait_start = time.time()
-    while True:
-        rc = proc.poll()
-        cost_time = time.time() - wait_start
-        print(f"Job {job.job_id} running {cost_time:.1f}s ...")
-        
+        ue_log_absolute = ctx.ue_log.absolute()
+
+        quality_str = str(req_payload.get("quality", "MEDIUM")).upper()
+        _qmap = {"LOW": 0, "MEDIUM": 1, "HIGH": 2, "EPIC": 3}
+        quality_num = _qmap.get(quality_str, 1)
+
+        movie_fmt = req_payload.get("format") # "mp4" or "mov"
+
+        mrq_server_base_url = req_payload.get("mrq_server_base_url") or None
+
+        render_chunk = None
+        if "chunk_index" in req_payload and "chunk_count" in req_payload:
+            render_chunk = (int(req_payload["chunk_index"]), int(req_payload["chunk_count"]))
+
+        encoder_controls = {
+            "priority": settings.ENCODER_PRIORITY,
+            "cpu_affinity": settings.ENCODER_CPU_AFFINITY,
+            "cpu_quota": settings.ENCODER_CPU_QUOTA,
+            "cgroup": settings.ENCODER_CGROUP,
+            "target_seconds": settings.ENCODER_TARGET_SECONDS,
+        }
+        encoder_controls.update({k: v for k, v in (req_payload.get("encoder") or {}).items() if v is not None})
+        if (req_payload.get("encoder") or {}).get("cgroup"):
+            # Validated as relative on creation; always below the server's group
+            encoder_controls["cgroup"] = f"{settings.ENCODER_CGROUP.rstrip('/')}/{req_payload['encoder']['cgroup']}" if settings.ENCODER_CGROUP else None
+
+        preview = None
+        preview_enabled = req_payload.get("preview")
+        if preview_enabled if preview_enabled is not None else settings.PREVIEW_HLS:
+            preview = {
+                "height": settings.PREVIEW_HEIGHT,
+                "bitrate_kbps": settings.PREVIEW_BITRATE_KBPS,
+                "segment_seconds": settings.PREVIEW_SEGMENT_SECONDS,
+            }
+
+        warmup_manifest = Path(settings.SHADER_WARMUP_DIR) / f"{job.template_id}.json"
+
+        ue_cmd = build_ue_cmd(
+            map_path=template.get("map_path"),
+            level_sequence=template.get("level_sequence"),
+            job_id=job.job_id,
+            log_path=ue_log_absolute,
+            movie_quality=str(quality_num),
+            movie_format=movie_fmt,
+            game_mode_class=settings.GAME_MODE_CLASS,
+            mrq_server_base_url=mrq_server_base_url,
+            resume=ctx.attempt > 0,
+            render_chunk=render_chunk,
+            encoder_controls=encoder_controls,
+            encode_fps_hint=encode_fps_hint(db, job.template_id, quality_str),
+            upload_eta_seconds=settings.UPLOAD_ETA_SECONDS,
+            encoder_log_path=ctx.encoder_log.absolute(),
+            fragmented_output=streaming_upload_enabled(),
+            preview=preview,
+            gpu_index=req_payload.get("gpu_index"),
+            shader_warmup_manifest=warmup_manifest.absolute() if warmup_manifest.exists() else None,
+            render_overrides=req_payload.get("render"),
+        )
+
+        debug_cmd_str = subprocess.list2cmdline(ue_cmd)
+        print("ue_cmd.exe content: " + debug_cmd_str)
+
+        print(f"ue_cmd.exe log path: {ue_log_absolute}")
+
+        return ctx, ue_cmd
+
+
+def _record_pid(job_id: str, pid: int) -> None:
+    with session_scope() as db:
+        job = db.get(Job, job_id)
+        if job is not None:
+            job.pid = pid
+
+
+def _print_encoder_log_tail(ctx: RunnerContext) -> None:
+    """The encoder's own output, which only reaches the UE log as rate-limited errors."""
+    if not ctx.encoder_log.exists():
+        return
+    try:
+        lines = read_tail_lines(ctx.encoder_log, max_lines=30)
+        print("---- Encoder log tail ----")
+        print("\n".join(lines))
+        print("---- Encoder log tail ----")
+        print(f"More details: {ctx.encoder_log}")
+    except Exception as e:
+        print(f"Read encoder log failed: {e}")
+
+
+def _finish_job(ctx: RunnerContext, rc: int | None, ue_tail: LogTail | None) -> datetime | None:
+    """Settle the job's state after UE exited with `rc` (None: it never started)."""
+    ue_log_absolute = ctx.ue_log.absolute()
+    progress_ingest.close(ctx.job_id)
+    with session_scope() as db:
+        job = db.get(Job, ctx.job_id)
+        if job is None:
+            return None
+
+        # Helper: propagate this job's final state to its parent when it is one chunk of a split job
+        def _sync_parent() -> None:
+            parent_to_encode = sync_parent_job(db, job)
+            db.commit()
+            if parent_to_encode:
+                start_final_encode(parent_to_encode)
+
         if rc is None:
-            print(f"Process {proc.pid} is still running...")
-        else:
-            print(f"Process {proc.pid} return with code {rc}.")
-
-            if rc == 0:
-                if job.status_enum in [JobStatus.queued, JobStatus.starting, JobStatus.rendering]: # Check error pre-exit
-                    job.status = JobStatus.failed.value
-                
-                job.ended_at = datetime.now(CN_TZ)
-                db.commit()
-                # On normal exit, also print a short log tail for visibility
-                # Limit to last ~50 lines to avoid overwhelming the console
-                try:
-                    lines = Path(ue_log_absolute).read_text(encoding='utf-8', errors='ignore').splitlines()
-                    if lines:
-                        tail = "\n".join(lines[-5:])
-                        print("---- UE log tail (last 5) ----")
-                        print(tail)
-                        print("---- UE log tail (last 5) ----")
-                        print(f"More details: {ue_log_absolute}")
-                except Exception as e:
-                    print(f"Read UE log failed: {e}")
-                return
-            else:
-                # Non-zero exit: print UE log tail from last 'error' line to end
-                _print_ue_log_tail(from_error=True)
+            job.status = JobStatus.failed.value
+            db.commit()
+            _sync_parent()
+            return None
+
+        if rc == 0:
+            if job.status_enum in [JobStatus.queued, JobStatus.starting, JobStatus.rendering]: # Check error pre-exit
                 job.status = JobStatus.failed.value
-                db.commit()
-                return
-            
 
-        db.refresh(job)
-        if job.status_enum in [JobStatus.completed, JobStatus.encoding, JobStatus.uploading]:
-            print(f"Job status has changed to {job.status} via ue_notifications api.")
+            job.ended_at = datetime.now(CN_TZ)
+            db.commit()
+            _sync_parent()
+            # On normal exit, also print a short log tail for visibility
+            if ue_tail is not None and ue_tail.lines:
+                print("---- UE log tail (last 5) ----")
+                print("\n".join(list(ue_tail.lines)[-5:]))
+                print("---- UE log tail (last 5) ----")
+                print(f"More details: {ue_log_absolute}")
+            return None
+
+        # Non-zero exit: the last errors UE logged, then how the log ended
+        if ue_tail is not None and (ue_tail.errors or ue_tail.lines):
+            if ue_tail.errors:
+                print("---- UE log errors ----")
+                print("\n".join(ue_tail.errors))
+            print("---- UE log tail ----")
+            print("\n".join(list(ue_tail.lines)[-50:]))
+            print("---- UE log tail ----")
+            print(f"More details: {ue_log_absolute}")
+        _print_encoder_log_tail(ctx)
+        if job.status_enum in (JobStatus.canceling, JobStatus.canceled):
+            return None
 
-        time.sleep(5)
+        # Only worth another attempt if it crashed, or rendered frames this time that the next one resumes after
+        rendered = (job.progress_percent or 0.0) > 0.0
+        if ctx.attempt < settings.AUTO_RESUME_ATTEMPTS and (_looks_like_crash(rc, ue_tail) or rendered):
+            next_attempt = requeue_for_resume(job)
+            print(f"Job {job.job_id} crashed, requeued to resume from its last completed frame (attempt {next_attempt}).")
+            db.commit()
+            return job.created_at
+
+        job.status = JobStatus.failed.value
+        db.commit()
+        _sync_parent()
+        return None
@@ -0,0 +1,51 @@
+"""
+The event loop UE processes are supervised on.
+
+One background thread runs an asyncio loop and every running job is a coroutine on it awaiting its UE process, so
+a job doesn't tie up a thread of its own and its exit is seen the moment it happens. On Windows the proactor loop
+waits on the process handles; on Linux exits are delivered through pidfds where the kernel has them.
+"""
+from __future__ import annotations
+import asyncio
+import os
+import sys
+import threading
+from concurrent.futures import Future
+from typing import Coroutine
+
+
+def _use_pidfd_watcher(loop: asyncio.AbstractEventLoop) -> None:
+    # Before 3.12 asyncio waits for every child on a thread of its own unless told otherwise;
+    # 3.12 picks pidfds by itself and deprecates child watchers.
+    if sys.platform == "win32" or sys.version_info >= (3, 12) or not hasattr(os, "pidfd_open"):
+        return
+    try:
+        os.close(os.pidfd_open(os.getpid()))
+    except OSError:
+        return
+    watcher = asyncio.PidfdChildWatcher()
+    watcher.attach_loop(loop)
+    asyncio.set_child_watcher(watcher)
+
+
+class ProcessSupervisor:
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._loop: asyncio.AbstractEventLoop | None = None
+
+    def submit(self, coro: Coroutine) -> Future:
+        """Run `coro` on the supervisor loop, from any thread."""
+        return asyncio.run_coroutine_threadsafe(coro, self._ensure_loop())
+
+    def _ensure_loop(self) -> asyncio.AbstractEventLoop:
+        with self._lock:
+            if self._loop is None:
+                self._loop = asyncio.new_event_loop()
+                _use_pidfd_watcher(self._loop)
+                # Daemon like the worker threads before it: stopping the server leaves UE rendering, the next
+                # server's reconcile picks those jobs up again.
+                threading.Thread(target=self._loop.run_forever, name="process-supervisor", daemon=True).start()
+            return self._loop
+
+
+supervisor = ProcessSupervisor()
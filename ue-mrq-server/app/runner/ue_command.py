@@ -1,7 +1,9 @@
+import sys
 from pathlib import Path
 from ..config import settings
 
-UNREAL = Path(settings.UE_ROOT) / "Engine" / "Binaries" / ("Win64" if (Path(settings.UE_ROOT)/"Engine").exists() else "Linux")
+# Every engine install has an Engine directory, the platform decides which binaries to run
+UNREAL = Path(settings.UE_ROOT) / "Engine" / "Binaries" / ("Win64" if sys.platform == "win32" else "Linux")
 UE_EDITOR_CMD = str(UNREAL / "UnrealEditor-Cmd.exe") if UNREAL.name == "Win64" else str(UNREAL / "UnrealEditor-Cmd")
 UE_EXECUTOR_CLASS = settings.EXECUTOR_CLASS
 
@@ -17,6 +19,17 @@ def build_ue_cmd(
     movie_pipeline_config: str | None = None,
     game_mode_class: str | None = None,
     mrq_server_base_url: str | None = None,
+    resume: bool = False,
+    render_chunk: tuple[int, int] | None = None,
+    encoder_controls: dict | None = None,
+    encode_fps_hint: float | None = None,
+    upload_eta_seconds: float | None = None,
+    encoder_log_path: Path | None = None,
+    fragmented_output: bool = False,
+    preview: dict | None = None,
+    gpu_index: int | None = None,
+    shader_warmup_manifest: Path | None = None,
+    render_overrides: dict | None = None,
     ) -> list[str]:
     
     final_cmd_list = [
@@ -38,6 +51,10 @@ def build_ue_cmd(
 
     final_cmd_list.append("-game")
 
+    if gpu_index is not None:
+        # GPU the scheduler placed the job on
+        final_cmd_list.append(f"-graphicsadapter={int(gpu_index)}")
+
     if level_sequence is not None:
         final_cmd_list.append(f"-LevelSequence={level_sequence}")
 
@@ -53,6 +70,84 @@ def build_ue_cmd(
     if mrq_server_base_url is not None:
         final_cmd_list.append(f"-MRQServerBaseUrl={mrq_server_base_url}")
 
+    if resume:
+        # Executor continues from the frames listed in the job's frame manifest
+        final_cmd_list.append("-ResumeRender")
+
+    if render_chunk is not None:
+        # (index, count): executor renders one slice of the sequence and skips encoding
+        chunk_index, chunk_count = render_chunk
+        final_cmd_list.append(f"-RenderChunk={chunk_index}")
+        final_cmd_list.append(f"-RenderChunkCount={chunk_count}")
+
+    if render_overrides:
+        # Draft/preview renders: smaller output, fewer samples and frames than the project's MRQ settings
+        if render_overrides.get("resolution_scale") is not None:
+            final_cmd_list.append(f"-ResolutionScale={float(render_overrides['resolution_scale'])}")
+        if render_overrides.get("spatial_samples") is not None:
+            final_cmd_list.append(f"-SpatialSamples={int(render_overrides['spatial_samples'])}")
+        if render_overrides.get("temporal_samples") is not None:
+            final_cmd_list.append(f"-TemporalSamples={int(render_overrides['temporal_samples'])}")
+        if render_overrides.get("warm_up_frames") is not None:
+            final_cmd_list.append(f"-WarmUpFrames={int(render_overrides['warm_up_frames'])}")
+        if render_overrides.get("frame_stride") is not None:
+            final_cmd_list.append(f"-FrameStride={int(render_overrides['frame_stride'])}")
+        if render_overrides.get("frame_start") is not None:
+            final_cmd_list.append(f"-FrameRangeStart={int(render_overrides['frame_start'])}")
+        if render_overrides.get("frame_end") is not None:
+            final_cmd_list.append(f"-FrameRangeEnd={int(render_overrides['frame_end'])}")
+
+    if encoder_controls:
+        # Priority, affinity, CPU quota and cgroup of the ffmpeg process UE spawns
+        if encoder_controls.get("priority") is not None:
+            final_cmd_list.append(f"-EncoderPriority={int(encoder_controls['priority'])}")
+        if encoder_controls.get("cpu_affinity"):
+            final_cmd_list.append(f"-EncoderCpuAffinity={encoder_controls['cpu_affinity']}")
+        if encoder_controls.get("cpu_quota"):
+            final_cmd_list.append(f"-EncoderCpuQuota={float(encoder_controls['cpu_quota'])}")
+        if encoder_controls.get("cgroup"):
+            final_cmd_list.append(f"-EncoderCgroup={encoder_controls['cgroup']}")
+        if encoder_controls.get("target_seconds"):
+            final_cmd_list.append(f"-EncoderTargetSeconds={float(encoder_controls['target_seconds'])}")
+
+    # Seed UE's ETA estimator before it has measured this job's encode rate
+    if encode_fps_hint:
+        final_cmd_list.append(f"-EncodeFpsHint={encode_fps_hint:.2f}")
+    if upload_eta_seconds:
+        final_cmd_list.append(f"-UploadEtaSeconds={float(upload_eta_seconds)}")
+
+    if fragmented_output:
+        # Fragmented MP4 so the server can upload the video while it is being encoded
+        final_cmd_list.append("-FragmentedOutput")
+
+    if preview:
+        # Low bitrate HLS segments of the finished frames, written while the render is still running
+        final_cmd_list.append("-PreviewHls")
+        if preview.get("height"):
+            final_cmd_list.append(f"-PreviewHeight={int(preview['height'])}")
+        if preview.get("bitrate_kbps"):
+            final_cmd_list.append(f"-PreviewBitrateKbps={int(preview['bitrate_kbps'])}")
+        if preview.get("segment_seconds"):
+            final_cmd_list.append(f"-PreviewSegmentSeconds={float(preview['segment_seconds'])}")
+
+    if settings.SHARED_DDC_PATH:
+        # Shader maps the warm-up compiled for this template
+        final_cmd_list.append(f"-SharedDataCachePath={settings.SHARED_DDC_PATH}")
+    if shader_warmup_manifest is not None:
+        # Executor reports which of the warmed up materials it found ready
+        final_cmd_list.append(f"-ShaderWarmUpManifest={shader_warmup_manifest}")
+
+    # Memory high-water marks go out with every progress report; the thresholds bound them across shots
+    final_cmd_list.append(f"-MemoryWatchdogFrames={settings.MEMORY_WATCHDOG_FRAMES}")
+    if settings.MEMORY_TRIM_THRESHOLD_MB:
+        final_cmd_list.append(f"-MemoryTrimThresholdMB={settings.MEMORY_TRIM_THRESHOLD_MB}")
+    if settings.GPU_MEMORY_TRIM_THRESHOLD_MB:
+        final_cmd_list.append(f"-GpuMemoryTrimThresholdMB={settings.GPU_MEMORY_TRIM_THRESHOLD_MB}")
+
+    if encoder_log_path is not None:
+        # ffmpeg output goes to its own file instead of the UE log
+        final_cmd_list.append(f"-EncoderLogPath={encoder_log_path}")
+
     final_cmd_list.extend(
         [
             f"-JobId={job_id}",
@@ -64,3 +159,24 @@ def build_ue_cmd(
 
 
     return final_cmd_list
+
+
+
+def build_warmup_cmd(template: dict, manifest_path: Path, log_path: Path, gpu_index: int | None = None) -> list[str]:
+    """Shader warm-up commandlet for one template: compiles its shaders into the DDC and writes its manifest."""
+    cmd = [
+        UE_EDITOR_CMD,
+        settings.UPROJECT,
+        "-run=MoviePipelineShaderWarmUp",
+        f"-Map={template.get('map_path') or template.get('map_name')}",
+        f"-LevelSequence={template['level_sequence']}",
+        f"-Manifest={manifest_path}",
+        # Compile for the RHI the renders run on, not the null RHI commandlets get by default
+        "-AllowCommandletRendering", "-RenderOffscreen",
+    ]
+    if gpu_index is not None:
+        cmd.append(f"-graphicsadapter={int(gpu_index)}")
+    if settings.SHARED_DDC_PATH:
+        cmd.append(f"-SharedDataCachePath={settings.SHARED_DDC_PATH}")
+    cmd.extend(["-Unattended", "-NOSPLASH", "-stdout", f"ABSLOG={log_path}"])
+    return cmd
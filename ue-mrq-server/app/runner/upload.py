@@ -0,0 +1,56 @@
+from __future__ import annotations
+import threading
+from pathlib import Path
+from sqlalchemy import select
+from ..db.database import session_scope
+from ..db.models import Job, JobArtifact
+from ..models.status import JobStatus
+from ..storage.multipart_upload import finish_streaming_upload, start_streaming_upload
+from ..utils.time import now_cn
+
+
+def finish_upload_in_background(job_id: str, video_path: str) -> None:
+    """
+    Commit the job's streaming upload now that the video is final. The caller has set the job `uploading`
+    (and committed that); it is completed with the video URL once the last part is in.
+    """
+    threading.Thread(target=_finish_upload, args=(job_id, video_path), daemon=True).start()
+
+
+def resume_uploads() -> None:
+    """
+    At startup: jobs that were `uploading` when the server stopped have nothing sending their video any more.
+    Upload each again; the parts the target still has from before are reused (<video>.upload.json).
+    """
+    with session_scope() as db:
+        jobs = db.execute(select(Job).where(Job.status == JobStatus.uploading.value)).scalars().all()
+        videos = {job.job_id: job.artifacts.video_path if job.artifacts else None for job in jobs}
+        for job in jobs:
+            if not videos[job.job_id] or not Path(videos[job.job_id]).is_file():
+                print(f"Job {job.job_id} was uploading a video that is gone, failing it")
+                job.status = JobStatus.failed.value
+                job.ended_at = now_cn()
+                videos.pop(job.job_id)
+    for job_id, video_path in videos.items():
+        print(f"Resuming upload of job {job_id}")
+        start_streaming_upload(job_id, Path(video_path).parent)
+        finish_upload_in_background(job_id, video_path)
+
+
+def _finish_upload(job_id: str, video_path: str) -> None:
+    url = None
+    try:
+        url = finish_streaming_upload(job_id, video_path)
+    except Exception as e:
+        print(f"Upload of job {job_id} failed, the video is only available locally: {e}")
+
+    with session_scope() as db:
+        job = db.get(Job, job_id)
+        if job is None or job.status_enum != JobStatus.uploading:
+            return  # canceled meanwhile
+        if url:
+            if job.artifacts is None:
+                job.artifacts = JobArtifact(job_id=job.job_id)
+            job.artifacts.video_url = url
+        job.status = JobStatus.completed.value
+        job.ended_at = now_cn()
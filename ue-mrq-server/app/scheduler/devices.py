@@ -0,0 +1,125 @@
+"""
+What the render node has to offer: GPUs with their memory, CPU cores, RAM and disk.
+
+The backend is chosen with DEVICE_BACKEND. "nvml" reads every NVIDIA GPU through NVML and the host through psutil,
+"mock" reports the machine described by MOCK_DEVICES so scheduling can be exercised without a GPU, and "auto" uses
+NVML when it initializes and otherwise the host without GPUs. More backends can be added with `register_backend`.
+"""
+from __future__ import annotations
+import json
+import os
+import shutil
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Callable, Protocol
+
+import psutil
+
+from ..config import settings
+
+try:
+    import pynvml
+    pynvml.nvmlInit()
+    _NVML_OK = True
+except Exception:
+    _NVML_OK = False
+
+
+@dataclass
+class GpuStatus:
+    index: int
+    total_mb: int
+    used_mb: int
+    free_mb: int
+
+
+@dataclass
+class NodeResources:
+    gpus: list[GpuStatus] = field(default_factory=list)  # empty: no GPU memory to account for
+    cpu_cores: float = 0
+    ram_total_mb: int = 0
+    ram_free_mb: int = 0
+    disk_total_mb: int = 0
+    disk_free_mb: int = 0
+
+
+class DeviceBackend(Protocol):
+    def query(self) -> NodeResources: ...
+
+
+def _render_disk() -> Path:
+    """Where UE writes frames and videos: the project's Saved directory, else DATA_ROOT."""
+    project_dir = Path(settings.UPROJECT).parent
+    return project_dir if project_dir.exists() else Path(settings.DATA_ROOT)
+
+
+def _query_host(resources: NodeResources) -> NodeResources:
+    mem = psutil.virtual_memory()
+    disk = shutil.disk_usage(_render_disk())
+    resources.cpu_cores = float(os.cpu_count() or 1)
+    resources.ram_total_mb = mem.total // (1024 * 1024)
+    resources.ram_free_mb = mem.available // (1024 * 1024)
+    resources.disk_total_mb = disk.total // (1024 * 1024)
+    resources.disk_free_mb = disk.free // (1024 * 1024)
+    return resources
+
+
+class HostBackend:
+    """CPU, RAM and disk of this machine, no GPUs."""
+
+    def query(self) -> NodeResources:
+        return _query_host(NodeResources())
+
+
+class NvmlBackend:
+    def query(self) -> NodeResources:
+        gpus = []
+        for index in range(pynvml.nvmlDeviceGetCount()):
+            mem = pynvml.nvmlDeviceGetMemoryInfo(pynvml.nvmlDeviceGetHandleByIndex(index))
+            gpus.append(GpuStatus(
+                index=index,
+                total_mb=int(mem.total) // (1024 * 1024),
+                used_mb=int(mem.used) // (1024 * 1024),
+                free_mb=int(mem.free) // (1024 * 1024),
+            ))
+        return _query_host(NodeResources(gpus=gpus))
+
+
+class MockBackend:
+    """
+    A fixed machine, e.g. MOCK_DEVICES='{"gpus_mb": [24576, 12288], "cpu_cores": 16, "ram_mb": 65536, "disk_mb": 512000}'.
+    Everything is free; the scheduler's reservations are what fill it up.
+    """
+
+    def query(self) -> NodeResources:
+        spec = json.loads(settings.MOCK_DEVICES or "{}")
+        ram_mb = int(spec.get("ram_mb", 65536))
+        disk_mb = int(spec.get("disk_mb", 512000))
+        return NodeResources(
+            gpus=[GpuStatus(index=i, total_mb=int(mb), used_mb=0, free_mb=int(mb)) for i, mb in enumerate(spec.get("gpus_mb", [24576]))],
+            cpu_cores=float(spec.get("cpu_cores", 16)),
+            ram_total_mb=ram_mb,
+            ram_free_mb=ram_mb,
+            disk_total_mb=disk_mb,
+            disk_free_mb=disk_mb,
+        )
+
+
+_backends: dict[str, Callable[[], DeviceBackend]] = {
+    "host": HostBackend,
+    "nvml": NvmlBackend,
+    "mock": MockBackend,
+}
+
+
+def register_backend(name: str, factory: Callable[[], DeviceBackend]) -> None:
+    _backends[name] = factory
+
+
+def get_backend(name: str | None = None) -> DeviceBackend:
+    name = (name or settings.DEVICE_BACKEND).lower()
+    if name == "auto":
+        name = "nvml" if _NVML_OK else "host"
+    if name not in _backends:
+        raise ValueError(f"Unknown DEVICE_BACKEND: {name}")
+    return _backends[name]()
@@ -0,0 +1,102 @@
+"""
+In-memory dispatch queue of the scheduler.
+
+The database stays the durable record of every job; this only mirrors which jobs wait for a render slot and which
+hold one, so the scheduler reacts to events instead of polling the database. Job creation and retry enqueue a job,
+render-complete, cancel and the UE process exiting release its slot, and each of them wakes the scheduler. The
+scheduler rebuilds the mirror from the database at start and every SCHEDULER_RECONCILE_SECONDS in case an event
+was missed.
+"""
+from __future__ import annotations
+import heapq
+import threading
+import time
+from datetime import datetime
+from typing import Iterable, Optional
+
+
+class DispatchQueue:
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._wake = threading.Event()
+        self._heap: list[tuple[float, str]] = []  # (created_at, job_id), oldest first; one entry per queued job
+        self._queued: set[str] = set()
+        self._running: set[str] = set()
+
+    def enqueue(self, job_id: str, created_at: Optional[datetime] = None) -> None:
+        """Job is queued (again) and waits for a slot."""
+        with self._lock:
+            if job_id not in self._queued:
+                self._queued.add(job_id)
+                self._running.discard(job_id)
+                heapq.heappush(self._heap, (_order_key(created_at), job_id))
+        self._wake.set()
+
+    def release(self, job_id: str) -> None:
+        """Job neither waits for nor holds a slot any more: it finished, failed or was canceled."""
+        with self._lock:
+            if job_id in self._queued:
+                self._queued.discard(job_id)
+                self._drop_entry(job_id)
+            self._running.discard(job_id)
+        self._wake.set()
+
+    def queued_ids(self) -> list[str]:
+        """Queued jobs, oldest first."""
+        with self._lock:
+            return [job_id for _, job_id in sorted(self._heap)]
+
+    def claim(self, job_id: str) -> bool:
+        """Queued job now holds a slot. False if it was released meanwhile."""
+        with self._lock:
+            if job_id not in self._queued:
+                return False
+            self._queued.discard(job_id)
+            self._running.add(job_id)
+            self._drop_entry(job_id)
+            return True
+
+    def running_ids(self) -> set[str]:
+        with self._lock:
+            return set(self._running)
+
+    def running_count(self) -> int:
+        with self._lock:
+            return len(self._running)
+
+    def queued_count(self) -> int:
+        with self._lock:
+            return len(self._queued)
+
+    def reset(self, queued: Iterable[tuple[str, Optional[datetime]]], running: Iterable[str]) -> None:
+        """Replace the mirror with what the database says."""
+        with self._lock:
+            self._queued = set()
+            self._heap = []
+            for job_id, created_at in queued:
+                if job_id not in self._queued:
+                    self._queued.add(job_id)
+                    self._heap.append((_order_key(created_at), job_id))
+            heapq.heapify(self._heap)
+            self._running = set(running)
+        self._wake.set()
+
+    def _drop_entry(self, job_id: str) -> None:
+        """Remove a job's heap entry, so enqueueing it again can't list it twice. Call with the lock held."""
+        self._heap = [entry for entry in self._heap if entry[1] != job_id]
+        heapq.heapify(self._heap)
+
+    def wake(self) -> None:
+        self._wake.set()
+
+    def wait(self, timeout: float) -> None:
+        """Block until something changed or `timeout` seconds passed."""
+        self._wake.wait(max(timeout, 0))
+        self._wake.clear()
+
+
+def _order_key(created_at: Optional[datetime]) -> float:
+    return created_at.timestamp() if created_at is not None else time.time()
+
+
+dispatch_queue = DispatchQueue()
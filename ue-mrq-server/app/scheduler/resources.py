@@ -0,0 +1,139 @@
+"""
+Sizing jobs and packing them onto the node.
+
+Every job reports its peak VRAM, RAM, CPU and disk use with render-complete. Those peaks are folded into a profile
+per template, quality and set of render overrides (job_quality): a bigger peak is taken over at once, smaller ones
+only pull the profile down gradually.
+A queued job needs its profile plus RESOURCE_HEADROOM, or the DEFAULT_JOB_* sizes until its template has run once,
+and never less than MIN_FREE_VRAM_MB of VRAM.
+
+Each started job holds a reservation of what it needs. A resource is available as far as neither the reservations
+nor the measured use exhaust it, so jobs that are still starting up count with their full size, and anything the
+jobs use beyond their reservation (or other processes use) is not handed out again. GPUs are chosen best fit: the
+one with the least VRAM left over after the job is placed.
+"""
+from __future__ import annotations
+import hashlib
+import json
+from dataclasses import dataclass, replace
+from typing import Iterable, Optional
+from sqlalchemy.orm import Session
+
+from ..config import settings
+from ..db.models import Job, TemplateResourceProfile
+from ..models.schemas import RENDER_PROFILES
+from .devices import NodeResources
+
+# Share of the old profile kept when a job peaks lower than it
+PROFILE_DECAY = 0.8
+
+
+@dataclass
+class ResourceNeed:
+    vram_mb: float
+    ram_mb: float
+    cpu_cores: float
+    disk_mb: float
+
+
+@dataclass
+class Reservation:
+    job_id: str
+    gpu_index: Optional[int]
+    need: ResourceNeed
+
+
+def job_quality(job: Job) -> str:
+    payload = json.loads(job.payload) if job.payload else {}
+    quality = str(payload.get("quality", "MEDIUM")).upper()
+    # Draft and other reduced renders need a fraction of a full render's resources, each set of overrides gets a
+    # profile of its own. The frame range only changes how long a job runs, not what it peaks at.
+    render = {k: v for k, v in (payload.get("render") or {}).items() if k not in ("frame_start", "frame_end")}
+    if not render:
+        return quality
+    profile = render.get("profile")
+    if profile and render == {**RENDER_PROFILES.get(profile, {}), "profile": profile}:
+        return f"{quality}/{profile}"
+    digest = hashlib.sha1(json.dumps(render, sort_keys=True).encode("utf-8")).hexdigest()[:8]
+    return f"{quality}/{digest}"
+
+
+def default_need() -> ResourceNeed:
+    return ResourceNeed(
+        vram_mb=settings.MIN_FREE_VRAM_MB,
+        ram_mb=settings.DEFAULT_JOB_RAM_MB,
+        cpu_cores=settings.DEFAULT_JOB_CPU_CORES,
+        disk_mb=settings.DEFAULT_JOB_DISK_MB,
+    )
+
+
+def need_for(db: Session, job: Job) -> ResourceNeed:
+    profile = db.get(TemplateResourceProfile, (job.template_id, job_quality(job)))
+    if profile is None or profile.samples == 0:
+        return default_need()
+    fallback = default_need()
+    scale = 1 + settings.RESOURCE_HEADROOM
+    # A metric the executor couldn't measure stays at its default. Where UE can only count its textures and render
+    # targets the VRAM peak misses buffers and driver memory, so MIN_FREE_VRAM_MB stays the floor.
+    return ResourceNeed(
+        vram_mb=max(profile.vram_mb * scale, fallback.vram_mb),
+        ram_mb=profile.ram_mb * scale if profile.ram_mb > 0 else fallback.ram_mb,
+        cpu_cores=profile.cpu_cores * scale if profile.cpu_cores > 0 else fallback.cpu_cores,
+        disk_mb=profile.disk_mb * scale if profile.disk_mb > 0 else fallback.disk_mb,
+    )
+
+
+def record_usage(db: Session, job: Job, metrics: dict) -> None:
+    """Fold the peaks a job reported into its template's profile."""
+    samples = {
+        "vram_mb": metrics.get("peak_vram_mb"),
+        "ram_mb": metrics.get("peak_ram_mb"),
+        "cpu_cores": metrics.get("peak_cpu_cores"),
+        "disk_mb": metrics.get("peak_disk_mb"),
+    }
+    samples = {k: float(v) for k, v in samples.items() if isinstance(v, (int, float)) and v > 0}
+    if not samples:
+        return
+
+    key = (job.template_id, job_quality(job))
+    profile = db.get(TemplateResourceProfile, key)
+    if profile is None:
+        profile = TemplateResourceProfile(template_id=key[0], quality=key[1], vram_mb=0.0, ram_mb=0.0, cpu_cores=0.0, disk_mb=0.0, samples=0)
+        db.add(profile)
+    for name, value in samples.items():
+        old = getattr(profile, name) or 0.0
+        setattr(profile, name, value if old <= 0 else max(value, PROFILE_DECAY * old + (1 - PROFILE_DECAY) * value))
+    profile.samples = (profile.samples or 0) + 1
+
+
+def place(need: ResourceNeed, node: NodeResources, reservations: Iterable[Reservation]) -> tuple[bool, Optional[int]]:
+    """Whether the job fits next to the reserved ones, and on which GPU (None when the node has none)."""
+    reservations = list(reservations)
+    ram = min(node.ram_total_mb - sum(r.need.ram_mb for r in reservations), node.ram_free_mb)
+    disk = min(node.disk_total_mb - sum(r.need.disk_mb for r in reservations), node.disk_free_mb)
+    # Too little CPU only slows jobs down, too little memory or disk fails them
+    cpu = node.cpu_cores * settings.CPU_OVERCOMMIT - sum(r.need.cpu_cores for r in reservations)
+    if need.ram_mb > ram or need.disk_mb > disk or need.cpu_cores > cpu:
+        return False, None
+
+    if not node.gpus:
+        return True, None
+
+    best_index, best_left = None, None
+    for gpu in node.gpus:
+        reserved = sum(r.need.vram_mb for r in reservations if r.gpu_index == gpu.index)
+        left = min(gpu.total_mb - reserved, gpu.free_mb) - need.vram_mb
+        if left >= 0 and (best_left is None or left < best_left):
+            best_index, best_left = gpu.index, left
+    return best_index is not None, best_index
+
+
+def fits_idle_node(need: ResourceNeed, node: NodeResources) -> bool:
+    """Whether the job would fit if nothing else used the node."""
+    idle = replace(
+        node,
+        gpus=[replace(gpu, used_mb=0, free_mb=gpu.total_mb) for gpu in node.gpus],
+        ram_free_mb=node.ram_total_mb,
+        disk_free_mb=node.disk_total_mb,
+    )
+    return place(need, idle, [])[0]
@@ -8,15 +8,21 @@ from ..db.models import Job
 from ..models.status import RUNNING_STATUSES, JobStatus
 from ..templates.loader import TemplateRegistry
 from ..config import settings
-from .gpu import query_gpu0
+from .devices import get_backend
+from .resources import Reservation, fits_idle_node, need_for, place
+from .dispatch import dispatch_queue
 from ..runner.runner import run_job
+from ..runner.supervisor import supervisor
+from ..runner.chunks import parent_job_ids, is_parent_job
 
 class Scheduler:
     def __init__(self, registry: TemplateRegistry):
         self.registry = registry
         self._th: threading.Thread | None = None
         self._stop = threading.Event()
-        self._workers: list[threading.Thread] = []
+        self._devices = get_backend()
+        self._reservations: dict[str, Reservation] = {}
+        self._waiting_job: str | None = None
 
     def start(self):
         if self._th and self._th.is_alive():
@@ -27,56 +33,123 @@ class Scheduler:
 
     def stop(self):
         self._stop.set()
+        dispatch_queue.wake()
         if self._th:
             self._th.join(timeout=1)
 
     def _loop(self):
+        next_reconcile = 0.0
         while not self._stop.is_set():
+            retry_after = None
             try:
-                self._tick()
+                if time.monotonic() >= next_reconcile:
+                    self._reconcile()
+                    next_reconcile = time.monotonic() + settings.SCHEDULER_RECONCILE_SECONDS
+                retry_after = self._dispatch()
             except Exception as e:
                 # TODO: add logging
                 pass
-            self._stop.wait(settings.SCHEDULER_POLL_MS / 1000)
+            timeout = next_reconcile - time.monotonic()
+            if retry_after is not None:
+                timeout = min(timeout, retry_after)
+            dispatch_queue.wait(timeout)
 
-    def _tick(self):
-        # check GPU memory
-        gpu = query_gpu0()
-        if gpu and gpu.free_mb < settings.MIN_FREE_VRAM_MB:
-            print(f"GPU memory is low: {gpu.free_mb}MB free")
-            return
+    def _reconcile(self):
+        """Rebuild the dispatch queue from the database, the durable record of queued and running jobs."""
         with session_scope() as db:
-            running = db.execute(select(Job).where(Job.status.in_(list(RUNNING_STATUSES))) ).scalars().all()
-            if len(running) >= settings.MAX_CONCURRENCY:
-                num_running = len(running)
-                num_max = settings.MAX_CONCURRENCY
-                print(f"Max concurrency reached. Current running jobs {num_running} MAX_CONCURRENCY={num_max}")
-                return
-            
-            job = db.execute(select(Job).where(Job.status==JobStatus.queued.value).order_by(Job.created_at.asc())).scalars().first()
-            if not job:
-                return
-            template = self.registry.get(job.template_id)
-            if not template:
-                job.status = JobStatus.failed.value; db.commit(); return
+            # Jobs split into chunks only aggregate their children; the children are what occupy render slots
+            queued = db.execute(select(Job.job_id, Job.created_at).where(Job.status == JobStatus.queued.value, Job.job_id.notin_(parent_job_ids()))).all()
+            running = db.execute(select(Job).where(Job.status.in_(list(RUNNING_STATUSES)), Job.job_id.notin_(parent_job_ids()))).scalars().all()
+            # Jobs started before a server restart hold what their profile says, on the GPU they were given
+            for job in running:
+                if job.job_id not in self._reservations:
+                    gpu_index = (json.loads(job.payload) if job.payload else {}).get("gpu_index")
+                    self._reservations[job.job_id] = Reservation(job.job_id, gpu_index, need_for(db, job))
+            running_ids = [job.job_id for job in running]
+        dispatch_queue.reset(((job_id, created_at) for job_id, created_at in queued), running_ids)
+
+    def _dispatch(self) -> float | None:
+        """
+        Start queued jobs, oldest first, as long as they fit on the node next to the running ones. Returns seconds
+        until the next attempt when the oldest job has to wait for resources (measured use changes without events).
+        """
+        # A coordinator renders nothing itself, workers lease its queued jobs (farm.coordinator)
+        if settings.NODE_ROLE == "coordinator":
+            return None
+
+        running_ids = dispatch_queue.running_ids()
+        self._reservations = {job_id: r for job_id, r in self._reservations.items() if job_id in running_ids}
+
+        free_slots = settings.MAX_CONCURRENCY - len(running_ids)
+        if free_slots <= 0 or dispatch_queue.queued_count() == 0:
+            return None
+
+        node = self._devices.query()
+        started: list[tuple[str, dict]] = []
+        retry_after = None
+        with session_scope() as db:
+            for job_id in dispatch_queue.queued_ids():
+                if len(started) >= free_slots:
+                    break
+                # Claimed earlier in this pass; reading it back as "starting" must not release the slot it now holds
+                if any(job_id == started_id for started_id, _ in started):
+                    continue
+                job = db.get(Job, job_id)
+                # Canceled (or already picked up) since it was queued
+                if not job or job.status != JobStatus.queued.value:
+                    dispatch_queue.release(job_id)
+                    continue
+                # Jobs split into chunks never run UE themselves, their chunks do
+                if is_parent_job(db, job_id):
+                    dispatch_queue.release(job_id)
+                    continue
+                template = self.registry.get(job.template_id)
+                if not template:
+                    job.status = JobStatus.failed.value
+                    dispatch_queue.release(job_id)
+                    continue
+
+                need = need_for(db, job)
+                fits, gpu_index = place(need, node, self._reservations.values())
+                if not fits and (self._reservations or fits_idle_node(need, node)):
+                    # First come, first served: younger jobs don't overtake it, or a big job would never get its room
+                    if self._waiting_job != job_id:
+                        print(f"Job {job_id} waits for resources: needs {need.vram_mb:.0f}MB VRAM, {need.ram_mb:.0f}MB RAM, {need.cpu_cores:.1f} cores, {need.disk_mb:.0f}MB disk")
+                        self._waiting_job = job_id
+                    retry_after = settings.SCHEDULER_POLL_MS / 1000
+                    break
+                if not fits:
+                    # Bigger than the whole node; run it alone rather than never
+                    print(f"Job {job_id} needs more than the node has, starting it on its own")
+                    gpu_index = node.gpus[0].index if node.gpus else None
+                if not dispatch_queue.claim(job_id):
+                    continue
 
-            # set job status to starting, to avoid concurrency window competition
-            job.status = JobStatus.starting.value
+                self._reservations[job_id] = Reservation(job_id, gpu_index, need)
+                payload = json.loads(job.payload) if job.payload else {}
+                payload["gpu_index"] = gpu_index
+                job.payload = json.dumps(payload, ensure_ascii=False)
+                # set job status to starting, to avoid concurrency window competition
+                job.status = JobStatus.starting.value
+                started.append((job_id, template))
             db.commit()
 
-            # running job in background thread
-            def _worker(job_id: str, tpl: dict):
-                from ..db.database import session_scope as _session_scope
-                from ..db.models import Job as _Job
-                try:
-                    with _session_scope() as _db:
-                        _job = _db.query(_Job).filter(_Job.job_id == job_id).first()
-                        if not _job:
-                            return
-                        run_job(_db, _job, tpl)
-                except Exception:
-                    pass
+        if retry_after is None:
+            self._waiting_job = None
+        for job_id, template in started:
+            supervisor.submit(self._supervise(job_id, template))
+        return retry_after
 
-            th = threading.Thread(target=_worker, args=(job.job_id, template), daemon=True)
-            th.start()
-            self._workers.append(th)
+    @staticmethod
+    async def _supervise(job_id: str, tpl: dict):
+        """Run one job on the supervisor loop. Its slot is free once UE exited, or it goes back in line when auto-resumed."""
+        requeued_at = None
+        try:
+            requeued_at = await run_job(job_id, tpl)
+        except Exception as e:
+            print(f"Job {job_id} supervision failed: {e}")
+        finally:
+            if requeued_at is not None:
+                dispatch_queue.enqueue(job_id, requeued_at)
+            else:
+                dispatch_queue.release(job_id)
@@ -0,0 +1,375 @@
+"""
+Upload a video while it is still being encoded.
+
+The encoder writes fragmented MP4 (ftyp + moov up front, then moof/mdat fragments), so bytes before the last
+complete top-level box never change again. Those bytes are cut into fixed size parts and uploaded as a multipart
+upload while the encoder keeps writing; when it exits only the tail is left to send before the upload is committed.
+Part numbers map to fixed byte ranges, so an interrupted upload resumes with the parts the target still has whose
+bytes on disk are unchanged (a relaunched encoder rewrites the file from the start). An encoder restarted while the
+upload runs (the encode deadline picking a faster preset) rewrites the file under it: the file shrinking, being
+replaced or its header changing starts the upload over, and every part is checked against the file once more
+before the upload is committed.
+"""
+from __future__ import annotations
+import hashlib
+import json
+import shutil
+import struct
+import threading
+import time
+from concurrent.futures import Future, ThreadPoolExecutor
+from pathlib import Path
+from typing import Optional
+
+try:
+    import oss2  # type: ignore
+except Exception:
+    oss2 = None
+
+from ..config import settings
+
+POLL_SECONDS = 1.0
+PART_ATTEMPTS = 3
+VIDEO_PATTERNS = ("*.mp4", "*.mov")
+HEADER_CHECK_BYTES = 64 * 1024  # start of the file hashed on every poll to notice it being rewritten
+_WRONG_FILE = object()  # StreamingUpload._upload_parts: finished with another video than the one streamed
+_REWRITTEN = object()  # StreamingUpload._upload_parts: the encoder started the file over, upload it from scratch
+
+
+class OssMultipartTarget:
+    def __init__(self, key: str):
+        if oss2 is None:
+            raise RuntimeError("oss2 is not installed")
+        if settings.OSS_STS_TOKEN:
+            auth = oss2.StsAuth(settings.OSS_ACCESS_KEY_ID, settings.OSS_ACCESS_KEY_SECRET, settings.OSS_STS_TOKEN)
+        else:
+            auth = oss2.Auth(settings.OSS_ACCESS_KEY_ID, settings.OSS_ACCESS_KEY_SECRET)
+        self.bucket = oss2.Bucket(auth, settings.OSS_ENDPOINT, settings.OSS_BUCKET)
+        self.key = key
+
+    def init(self) -> str:
+        return self.bucket.init_multipart_upload(self.key).upload_id
+
+    def uploaded_parts(self, upload_id: str) -> dict[int, str]:
+        return {p.part_number: p.etag for p in oss2.PartIterator(self.bucket, self.key, upload_id)}
+
+    def upload_part(self, upload_id: str, part_number: int, data: bytes) -> str:
+        return self.bucket.upload_part(self.key, upload_id, part_number, data).etag
+
+    def complete(self, upload_id: str, parts: dict[int, str]) -> str:
+        self.bucket.complete_multipart_upload(self.key, upload_id, [oss2.models.PartInfo(n, parts[n]) for n in sorted(parts)])
+        return self.bucket.sign_url("GET", self.key, settings.OSS_SIGNED_URL_EXPIRE)
+
+    def abort(self, upload_id: str) -> None:
+        # Parts of an upload that is never completed are stored (and billed) until it is aborted
+        self.bucket.abort_multipart_upload(self.key, upload_id)
+
+
+class LocalMultipartTarget:
+    """Stand-in for an object store: parts are files under UPLOAD_LOCAL_DIR, joined on complete."""
+
+    def __init__(self, key: str):
+        self.root = Path(settings.UPLOAD_LOCAL_DIR)
+        self.key = key
+
+    def _parts_dir(self, upload_id: str) -> Path:
+        return self.root / ".multipart" / upload_id
+
+    def init(self) -> str:
+        upload_id = f"{int(time.time() * 1000)}_{threading.get_ident()}"
+        self._parts_dir(upload_id).mkdir(parents=True, exist_ok=True)
+        return upload_id
+
+    def uploaded_parts(self, upload_id: str) -> dict[int, str]:
+        parts_dir = self._parts_dir(upload_id)
+        if not parts_dir.is_dir():
+            raise RuntimeError(f"No such upload: {upload_id}")
+        return {int(p.stem): str(p.stat().st_size) for p in parts_dir.glob("*.part")}
+
+    def upload_part(self, upload_id: str, part_number: int, data: bytes) -> str:
+        tmp = self._parts_dir(upload_id) / f"{part_number:05d}.tmp"
+        tmp.write_bytes(data)
+        tmp.replace(tmp.with_suffix(".part"))
+        return str(len(data))
+
+    def complete(self, upload_id: str, parts: dict[int, str]) -> str:
+        out = self.root / self.key
+        out.parent.mkdir(parents=True, exist_ok=True)
+        parts_dir = self._parts_dir(upload_id)
+        with open(out, "wb") as f:
+            for n in sorted(parts):
+                with open(parts_dir / f"{n:05d}.part", "rb") as part:
+                    shutil.copyfileobj(part, f)
+        shutil.rmtree(parts_dir, ignore_errors=True)
+        return out.absolute().as_uri()
+
+    def abort(self, upload_id: str) -> None:
+        shutil.rmtree(self._parts_dir(upload_id), ignore_errors=True)
+
+
+def storage_configured() -> bool:
+    return bool(settings.UPLOAD_LOCAL_DIR) or bool(settings.OSS_ENDPOINT and settings.OSS_BUCKET)
+
+
+def streaming_upload_enabled() -> bool:
+    # A farm worker always uploads: the storage is how its videos get back to the coordinator
+    return (settings.UPLOAD_STREAMING or settings.NODE_ROLE == "worker") and storage_configured()
+
+
+def _make_target(key: str):
+    return LocalMultipartTarget(key) if settings.UPLOAD_LOCAL_DIR else OssMultipartTarget(key)
+
+
+def stable_length(path: Path, start: int = 0) -> int:
+    """End of the last complete top-level MP4 box at or after `start` (a box boundary). Bytes before it are final."""
+    end = start
+    size = path.stat().st_size
+    with open(path, "rb") as f:
+        while end + 8 <= size:
+            f.seek(end)
+            box_size, = struct.unpack(">I", f.read(4))
+            f.read(4)  # box type
+            if box_size == 1:
+                if end + 16 > size:
+                    break
+                box_size, = struct.unpack(">Q", f.read(8))
+            if box_size < 8 or end + box_size > size:
+                break  # 0 = box runs to the end of the file, not known until the encoder closes it
+            end += box_size
+    return end
+
+
+class StreamingUpload:
+    """Uploads one growing file. `finish()` blocks until the upload is committed and returns the video URL."""
+
+    def __init__(self, job_id: str, video_dir: Path):
+        self.job_id = job_id
+        self.video_dir = video_dir
+        self.part_size = max(settings.UPLOAD_PART_SIZE_MB, 1) * 1024 * 1024
+        self._pool = ThreadPoolExecutor(max_workers=max(settings.UPLOAD_PARALLEL_PARTS, 1), thread_name_prefix=f"upload_{job_id}")
+        self._done = threading.Event()
+        self._final_path: Optional[Path] = None
+        self._result: Optional[str] = None
+        self._error: Optional[BaseException] = None
+        # Videos older than the upload are left over from an earlier attempt
+        self._started = time.time()
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def finish(self, final_path: Path, timeout: Optional[float] = None) -> str:
+        self._final_path = final_path
+        self._done.set()
+        self._thread.join(timeout)
+        if self._thread.is_alive():
+            raise TimeoutError(f"Upload of job {self.job_id} did not finish in time")
+        if self._error is not None:
+            raise self._error
+        return self._result or ""
+
+    def abort(self) -> None:
+        self._final_path = None
+        self._done.set()
+
+    def _wait_for_file(self) -> Optional[Path]:
+        """The video being written: the only one the encoder started since the upload began, else the final one once known."""
+        while True:
+            if self._done.is_set():
+                return self._final_path
+            fresh = [p for pattern in VIDEO_PATTERNS for p in self.video_dir.glob(pattern) if _mtime(p) >= self._started - POLL_SECONDS]
+            # Several passes encode several videos; which one is the job's is only known at the end
+            if len(fresh) == 1:
+                return fresh[0]
+            time.sleep(POLL_SECONDS)
+
+    def _run(self) -> None:
+        try:
+            self._result = self._upload()
+        except BaseException as e:
+            self._error = e
+            print(f"Streaming upload of job {self.job_id} failed: {e}")
+        finally:
+            self._pool.shutdown(wait=False)
+
+    def _upload(self) -> Optional[str]:
+        path = self._wait_for_file()
+        return self._upload_file(path) if path is not None else None
+
+    def _upload_file(self, path: Path) -> Optional[str]:
+        target = _make_target(f"videos/{self.job_id}/{path.name}")
+        state_path = path.with_name(path.name + ".upload.json")
+        resumed, upload_id = self._resume(target, state_path)
+        if upload_id is None:
+            upload_id = target.init()
+        try:
+            url = self._upload_parts(target, upload_id, path, state_path, resumed)
+        except BaseException:
+            _abort_quietly(target, upload_id)
+            state_path.unlink(missing_ok=True)
+            raise
+        if url is _WRONG_FILE:
+            # Streamed a video that turned out not to be the job's; send the right one whole
+            print(f"Job {self.job_id} finished with {self._final_path.name}, not the streamed {path.name}, uploading it instead")
+            return self._upload_file(self._final_path)
+        if url is _REWRITTEN:
+            print(f"Job {self.job_id}: {path.name} was rewritten from the start, uploading it again")
+            return self._upload_file(path)
+        return url
+
+    def _upload_parts(self, target, upload_id: str, path: Path, state_path: Path, resumed: dict[int, tuple[str, str]]) -> Optional[str]:
+        parts: dict[int, tuple[str, str]] = {}  # part number -> (etag, sha1 of the bytes)
+
+        pending: dict[int, Future] = {}
+        box_end = 0
+        next_part = 1
+        identity = _identity(path)
+        last_size = 0
+        header_sha1: Optional[str] = None
+        while True:
+            # Read the flag before the file size: once set, everything the encoder wrote is on disk.
+            finished = self._done.is_set()
+            if finished and (self._final_path is None or not _same_file(self._final_path, path)):
+                for fut in pending.values():
+                    fut.cancel()
+                _abort_quietly(target, upload_id)
+                state_path.unlink(missing_ok=True)
+                return None if self._final_path is None else _WRONG_FILE  # aborted, or finished with another video
+
+            # A restarted encoder truncates the file (or replaces it) and writes it again from byte 0
+            size = path.stat().st_size
+            rewritten = _identity(path) != identity or size < last_size
+            if not rewritten and header_sha1 is None and size >= HEADER_CHECK_BYTES:
+                header_sha1 = _read_sha1(path, 0, HEADER_CHECK_BYTES)
+            elif not rewritten and header_sha1 is not None:
+                rewritten = _read_sha1(path, 0, HEADER_CHECK_BYTES) != header_sha1
+            if rewritten:
+                for fut in pending.values():
+                    fut.cancel()
+                _abort_quietly(target, upload_id)
+                state_path.unlink(missing_ok=True)
+                return _REWRITTEN
+            last_size = size
+
+            box_end = stable_length(path, box_end)
+            limit = path.stat().st_size if finished else box_end
+
+            while (next_part * self.part_size <= limit) or (finished and (next_part - 1) * self.part_size < limit):
+                offset = (next_part - 1) * self.part_size
+                length = min(self.part_size, limit - offset)
+                earlier = resumed.pop(next_part, None)
+                if earlier is not None and earlier[1] == _read_sha1(path, offset, length):
+                    parts[next_part] = earlier
+                else:
+                    pending[next_part] = self._pool.submit(self._upload_part, target, upload_id, path, next_part, offset, length)
+                next_part += 1
+
+            for n in [n for n, fut in pending.items() if fut.done()]:
+                parts[n] = pending.pop(n).result()
+                self._save_state(state_path, upload_id, parts)
+
+            if finished:
+                for n, fut in pending.items():
+                    parts[n] = fut.result()
+                # Whatever was rewritten after its part went up since the last check is sent again
+                for n in range(1, next_part):
+                    offset = (n - 1) * self.part_size
+                    length = min(self.part_size, limit - offset)
+                    if _read_sha1(path, offset, length) != parts[n][1]:
+                        parts[n] = self._upload_part(target, upload_id, path, n, offset, length)
+                url = target.complete(upload_id, {n: parts[n][0] for n in range(1, next_part)})
+                state_path.unlink(missing_ok=True)
+                return url
+
+            self._done.wait(POLL_SECONDS)
+
+    @staticmethod
+    def _upload_part(target, upload_id: str, path: Path, part_number: int, offset: int, length: int) -> tuple[str, str]:
+        with open(path, "rb") as f:
+            f.seek(offset)
+            data = f.read(length)
+        for attempt in range(1, PART_ATTEMPTS + 1):
+            try:
+                return target.upload_part(upload_id, part_number, data), hashlib.sha1(data).hexdigest()
+            except Exception:
+                if attempt == PART_ATTEMPTS:
+                    raise
+                time.sleep(attempt)
+        raise AssertionError("unreachable")
+
+    def _resume(self, target, state_path: Path) -> tuple[dict[int, tuple[str, str]], Optional[str]]:
+        """Parts a previous attempt uploaded that the target still has, to be checked against the file before reuse."""
+        try:
+            state = json.loads(state_path.read_text(encoding="utf-8"))
+            if state.get("part_size") != self.part_size:
+                return {}, None
+            on_target = target.uploaded_parts(state["upload_id"])
+            resumed = {int(n): (etag, sha1) for n, (etag, sha1) in state["parts"].items() if on_target.get(int(n)) == etag}
+            return resumed, state["upload_id"]
+        except Exception:
+            return {}, None
+
+    def _save_state(self, state_path: Path, upload_id: str, parts: dict[int, tuple[str, str]]) -> None:
+        state = {"upload_id": upload_id, "part_size": self.part_size, "parts": {str(n): list(p) for n, p in parts.items()}}
+        state_path.write_text(json.dumps(state), encoding="utf-8")
+
+
+def _abort_quietly(target, upload_id: str) -> None:
+    try:
+        target.abort(upload_id)
+    except Exception as e:
+        print(f"Aborting multipart upload {upload_id} failed: {e}")
+
+
+def _mtime(path: Path) -> float:
+    try:
+        return path.stat().st_mtime
+    except OSError:
+        return 0.0
+
+
+def _identity(path: Path) -> tuple[int, int]:
+    stat = path.stat()
+    return stat.st_dev, stat.st_ino
+
+
+def _same_file(a: Path, b: Path) -> bool:
+    return a.resolve() == b.resolve()
+
+
+def _read_sha1(path: Path, offset: int, length: int) -> str:
+    with open(path, "rb") as f:
+        f.seek(offset)
+        return hashlib.sha1(f.read(length)).hexdigest()
+
+
+_uploads: dict[str, StreamingUpload] = {}
+_uploads_lock = threading.Lock()
+
+
+def start_streaming_upload(job_id: str, video_dir: str | Path) -> None:
+    """Start uploading the job's video as soon as it appears in `video_dir`. Does nothing if one is running."""
+    if not streaming_upload_enabled():
+        return
+    with _uploads_lock:
+        if job_id not in _uploads:
+            _uploads[job_id] = StreamingUpload(job_id, Path(video_dir))
+
+
+def has_streaming_upload(job_id: str) -> bool:
+    with _uploads_lock:
+        return job_id in _uploads
+
+
+def finish_streaming_upload(job_id: str, final_path: str | Path) -> Optional[str]:
+    """Send what is left of the finished video and commit the upload. Returns the URL, None if nothing was streaming."""
+    with _uploads_lock:
+        upload = _uploads.pop(job_id, None)
+    if upload is None:
+        return None
+    return upload.finish(Path(final_path))
+
+
+def abort_streaming_upload(job_id: str) -> None:
+    with _uploads_lock:
+        upload = _uploads.pop(job_id, None)
+    if upload is not None:
+        upload.abort()
@@ -1,5 +1,6 @@
 import glob
 import os
+from collections import deque
 from pathlib import Path
 from urllib.parse import urlparse
 from typing import Optional
@@ -26,4 +27,65 @@ def is_valid_url(url: Optional[str]) -> bool:
         parsed = urlparse(url)
         return all([parsed.scheme, parsed.netloc])
     except:
-        return False
\ No newline at end of file
+        return False
+
+def read_tail_lines(path: Path, max_lines: int = 200, max_bytes: int = 256 * 1024) -> list[str]:
+    """Last lines of a (possibly huge, still growing) log file without reading all of it."""
+    with open(path, "rb") as f:
+        f.seek(0, os.SEEK_END)
+        size = f.tell()
+        f.seek(max(0, size - max_bytes))
+        data = f.read()
+    lines = data.decode("utf-8", errors="ignore").splitlines()
+    if size > max_bytes and lines:
+        lines = lines[1:]  # first one is most likely cut in half
+    return lines[-max_lines:]
+
+
+class LogTail:
+    """
+    Follows a growing log file, reading only what was appended since the last `poll`, and keeps the most recent
+    lines and the most recent error lines. Memory stays the same however big the log gets. A file that shrank was
+    started anew (UE truncates its log on launch) and is followed from its beginning again.
+    """
+
+    def __init__(self, path: Path, max_lines: int = 200, max_errors: int = 50, chunk_bytes: int = 256 * 1024, max_line_bytes: int = 64 * 1024):
+        self.path = path
+        self.lines: deque[str] = deque(maxlen=max_lines)
+        self.errors: deque[str] = deque(maxlen=max_errors)
+        self._offset = 0
+        self._partial = b""
+        self._chunk_bytes = chunk_bytes
+        self._max_line_bytes = max_line_bytes
+
+    def poll(self) -> None:
+        try:
+            size = os.path.getsize(self.path)
+        except OSError:
+            return
+        if size < self._offset:
+            self._offset, self._partial = 0, b""
+        if size == self._offset:
+            return
+        with open(self.path, "rb") as f:
+            f.seek(self._offset)
+            while data := f.read(self._chunk_bytes):
+                self._offset += len(data)
+                *complete, self._partial = (self._partial + data).split(b"\n")
+                for raw in complete:
+                    self._add(raw)
+                # A "line" without any newline in sight is not worth keeping whole
+                self._partial = self._partial[:self._max_line_bytes]
+
+    def close(self) -> None:
+        """Read the rest once the writer is gone, including a last line without newline."""
+        self.poll()
+        if self._partial:
+            self._add(self._partial)
+            self._partial = b""
+
+    def _add(self, raw: bytes) -> None:
+        line = raw.decode("utf-8", errors="ignore").rstrip("\r")
+        self.lines.append(line)
+        if "error" in line.lower():
+            self.errors.append(line)
@@ -1,4 +1,4 @@
-import psutil, os, signal, subprocess, sys
+import asyncio, psutil, os, signal, subprocess, sys
 from pathlib import Path
 from typing import Sequence
 
@@ -35,6 +35,30 @@ def popen(
     )
 
 
+async def spawn(
+        cmd: Sequence[str],
+        cwd: str | None = None,
+        env: dict | None = None,
+        log_path: Path | None = None,
+    ) -> asyncio.subprocess.Process:
+    """
+    Same as `popen`, but started on the running event loop, so the process' exit can be awaited
+    (`await proc.wait()`) instead of polled.
+    """
+    if log_path is not None:
+        try:
+            os.makedirs(os.fspath(Path(log_path).parent), exist_ok=True)
+        except Exception:
+            pass
+
+    return await asyncio.create_subprocess_exec(
+        *cmd,
+        cwd=cwd,
+        env=env,
+        creationflags=CREATE_NO_WINDOW,
+    )
+
+
 def kill_tree(pid: int, sig=signal.SIGTERM, timeout: float = 5.0) -> None:
     try:
         proc = psutil.Process(pid)
@@ -0,0 +1,300 @@
+"""
+Serving large files with byte ranges.
+
+Players seek by requesting byte ranges; RangedFileResponse answers them with 206 and only the bytes asked for, and
+revalidation with 304 through ETag/Last-Modified. When the ASGI server offers the zero-copy extension the kernel
+sends the file (sendfile); otherwise it is read with positioned reads from a shared handle, so any number of
+requests can stream from the same file at once without reopening it or fighting over one file position.
+Open handles are kept in a small LRU keyed by path, size and modification time: a rewritten file gets a fresh one.
+One nobody is reading is closed after a few idle seconds, so the server does not keep finished videos locked.
+"""
+from __future__ import annotations
+import os
+import threading
+import time
+from collections import OrderedDict
+from email.utils import formatdate, parsedate_to_datetime
+from functools import partial
+from pathlib import Path
+from typing import Optional
+from urllib.parse import quote
+
+import anyio
+from starlette.responses import Response
+from starlette.types import Receive, Scope, Send
+
+from ..config import settings
+
+CHUNK_SIZE = 1024 * 1024
+
+
+class _Handle:
+    def __init__(self, path: Path):
+        self.file = open(path, "rb", buffering=0)
+        self.refs = 0
+        self.evicted = False
+        self.idle_since = 0.0
+        self._seek_lock = threading.Lock()
+
+    def read_at(self, offset: int, size: int) -> bytes:
+        if hasattr(os, "pread"):
+            return os.pread(self.file.fileno(), size, offset)
+        # No positioned reads on Windows; readers of the same handle take turns
+        with self._seek_lock:
+            self.file.seek(offset)
+            return self.file.read(size)
+
+
+class FileHandleCache:
+    """
+    Handles in use stay open for as long as a request reads them; an unused one only for idle_seconds, enough for a
+    player's next range request. Holding it longer would keep the file locked on Windows, where an open handle stops
+    a re-render or cleanup from replacing or deleting the video.
+    """
+
+    def __init__(self, capacity: int, idle_seconds: float):
+        self._capacity = max(1, capacity)
+        self._idle_seconds = max(0.0, idle_seconds)
+        self._lock = threading.Lock()
+        self._handles: OrderedDict[tuple, _Handle] = OrderedDict()
+        self._sweeper: Optional[threading.Timer] = None
+
+    def acquire(self, path: Path, stat: os.stat_result) -> _Handle:
+        key = (str(path), stat.st_size, stat.st_mtime_ns)
+        with self._lock:
+            handle = self._handles.get(key)
+            if handle is not None:
+                self._handles.move_to_end(key)
+                handle.refs += 1
+                return handle
+        opened = _Handle(path)
+        with self._lock:
+            handle = self._handles.get(key)
+            if handle is None:
+                handle = self._handles[key] = opened
+                opened = None
+            handle.refs += 1
+            evicted = []
+            while len(self._handles) > self._capacity:
+                _, old = self._handles.popitem(last=False)
+                old.evicted = True
+                if old.refs == 0:
+                    evicted.append(old)
+        if opened is not None:
+            opened.file.close()  # another request opened it meanwhile
+        for old in evicted:
+            old.file.close()
+        return handle
+
+    def release(self, handle: _Handle) -> None:
+        with self._lock:
+            handle.refs -= 1
+            close = handle.refs == 0 and (handle.evicted or self._idle_seconds == 0)
+            if close and not handle.evicted:
+                self._forget(handle)
+            elif handle.refs == 0:
+                handle.idle_since = time.monotonic()
+                if self._sweeper is None:
+                    self._schedule_sweep(self._idle_seconds)
+        if close:
+            handle.file.close()
+
+    def _forget(self, handle: _Handle) -> None:
+        for key, cached in self._handles.items():
+            if cached is handle:
+                del self._handles[key]
+                return
+
+    def _schedule_sweep(self, delay: float) -> None:
+        self._sweeper = threading.Timer(delay, self._sweep)
+        self._sweeper.daemon = True
+        self._sweeper.start()
+
+    def _sweep(self) -> None:
+        now = time.monotonic()
+        expired = []
+        with self._lock:
+            next_expiry = None
+            for key, handle in list(self._handles.items()):
+                if handle.refs > 0:
+                    continue
+                expires = handle.idle_since + self._idle_seconds
+                if expires <= now:
+                    del self._handles[key]
+                    expired.append(handle)
+                elif next_expiry is None or expires < next_expiry:
+                    next_expiry = expires
+            if threading.current_thread() is self._sweeper:
+                self._sweeper = None
+            if next_expiry is not None and self._sweeper is None:
+                self._schedule_sweep(max(next_expiry - now, 0.0))
+        for handle in expired:
+            handle.file.close()
+
+
+file_handles = FileHandleCache(settings.VIDEO_HANDLE_CACHE_SIZE, settings.VIDEO_HANDLE_IDLE_SECONDS)
+
+
+def _etag(stat: os.stat_result) -> str:
+    return f'"{stat.st_size:x}-{stat.st_mtime_ns:x}"'
+
+
+def _parse_range(header: str, size: int) -> Optional[tuple[int, int]]:
+    """
+    First and last byte of a single "bytes=" range, clamped to the file. None for a header to ignore (other units,
+    several ranges, garbage); (-1, -1) for a range that lies entirely past the end.
+    """
+    unit, _, spec = header.partition("=")
+    if unit.strip().lower() != "bytes" or "," in spec:
+        return None
+    first, sep, last = spec.strip().partition("-")
+    if not sep:
+        return None
+    try:
+        if first == "":
+            length = int(last)
+            if length <= 0:
+                return (-1, -1)
+            return max(0, size - length), size - 1
+        start = int(first)
+        end = int(last) if last else size - 1
+    except ValueError:
+        return None
+    if start >= size:
+        return (-1, -1)
+    if start > end:
+        return None
+    return start, min(end, size - 1)
+
+
+class RangedFileResponse(Response):
+    def __init__(
+        self,
+        path: str | os.PathLike,
+        media_type: str,
+        filename: Optional[str] = None,
+        cache_control: Optional[str] = None,
+    ):
+        self.path = Path(path)
+        self.media_type = media_type
+        self.filename = filename
+        self.cache_control = cache_control
+        self.background = None
+        self.body = b""
+        self.status_code = 200
+        self.raw_headers = []
+
+    async def __call__(self, scope: Scope, receive: Receive, send: Send) -> None:
+        try:
+            stat = await anyio.to_thread.run_sync(os.stat, self.path)
+        except FileNotFoundError:
+            await Response(status_code=404)(scope, receive, send)
+            return
+
+        request_headers = {k.decode("latin-1").lower(): v.decode("latin-1") for k, v in scope["headers"]}
+        etag = _etag(stat)
+        headers = {
+            "accept-ranges": "bytes",
+            "etag": etag,
+            "last-modified": formatdate(stat.st_mtime, usegmt=True),
+        }
+        if self.cache_control:
+            headers["cache-control"] = self.cache_control
+        if self.filename:
+            headers["content-disposition"] = f"inline; filename*=utf-8''{quote(self.filename)}"
+
+        if self._not_modified(request_headers, etag, stat):
+            await self._start(send, 304, headers)
+            await send({"type": "http.response.body", "body": b""})
+            return
+
+        size = stat.st_size
+        offset, count, status = 0, size, 200
+        range_header = request_headers.get("range")
+        if range_header and self._range_applies(request_headers.get("if-range"), etag, stat):
+            byte_range = _parse_range(range_header, size)
+            if byte_range == (-1, -1):
+                headers["content-range"] = f"bytes */{size}"
+                await self._start(send, 416, headers)
+                await send({"type": "http.response.body", "body": b""})
+                return
+            if byte_range is not None:
+                offset, count, status = byte_range[0], byte_range[1] - byte_range[0] + 1, 206
+                headers["content-range"] = f"bytes {byte_range[0]}-{byte_range[1]}/{size}"
+
+        headers["content-type"] = self.media_type
+        headers["content-length"] = str(count)
+        await self._start(send, status, headers)
+        if scope["method"].upper() == "HEAD" or count == 0:
+            await send({"type": "http.response.body", "body": b""})
+            return
+
+        handle = await anyio.to_thread.run_sync(file_handles.acquire, self.path, stat)
+        try:
+            async with anyio.create_task_group() as task_group:
+                async def until_done(func) -> None:
+                    await func()
+                    task_group.cancel_scope.cancel()
+
+                # Stop reading once the client is gone; scrubbing players abandon most range requests early
+                task_group.start_soon(until_done, partial(self._send_body, scope, send, handle, offset, count))
+                await until_done(partial(self._wait_for_disconnect, receive))
+        finally:
+            file_handles.release(handle)
+
+    @staticmethod
+    async def _start(send: Send, status: int, headers: dict[str, str]) -> None:
+        await send({
+            "type": "http.response.start",
+            "status": status,
+            "headers": [(k.encode("latin-1"), v.encode("latin-1")) for k, v in headers.items()],
+        })
+
+    @staticmethod
+    async def _send_body(scope: Scope, send: Send, handle: _Handle, offset: int, count: int) -> None:
+        if "http.response.zerocopy" in scope.get("extensions", {}):
+            await send({"type": "http.response.zerocopy", "file": handle.file, "offset": offset, "count": count, "more_body": False})
+            return
+        end = offset + count
+        while offset < end:
+            chunk = await anyio.to_thread.run_sync(handle.read_at, offset, min(CHUNK_SIZE, end - offset))
+            if not chunk:
+                break  # truncated underneath us; the client sees a short body
+            offset += len(chunk)
+            await send({"type": "http.response.body", "body": chunk, "more_body": offset < end})
+        if offset < end:
+            await send({"type": "http.response.body", "body": b""})
+
+    @staticmethod
+    async def _wait_for_disconnect(receive: Receive) -> None:
+        while True:
+            message = await receive()
+            if message["type"] == "http.disconnect":
+                return
+
+    @staticmethod
+    def _not_modified(request_headers: dict[str, str], etag: str, stat: os.stat_result) -> bool:
+        if_none_match = request_headers.get("if-none-match")
+        if if_none_match is not None:
+            tags = [tag.strip().removeprefix("W/") for tag in if_none_match.split(",")]
+            return "*" in tags or etag in tags
+        if_modified_since = request_headers.get("if-modified-since")
+        if if_modified_since:
+            try:
+                return int(stat.st_mtime) <= parsedate_to_datetime(if_modified_since).timestamp()
+            except (TypeError, ValueError):
+                return False
+        return False
+
+    @staticmethod
+    def _range_applies(if_range: Optional[str], etag: str, stat: os.stat_result) -> bool:
+        """A Range with If-Range only counts while the file is still what the client has part of."""
+        if if_range is None:
+            return True
+        if if_range.startswith('"') or if_range.startswith("W/"):
+            return if_range == etag
+        try:
+            return int(stat.st_mtime) <= parsedate_to_datetime(if_range).timestamp()
+        except (TypeError, ValueError):
+            return False
+
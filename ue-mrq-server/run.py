@@ -1,3 +1,4 @@
+import os
 import uvicorn
 import logging
 from app.utils.logging_formatters import (
@@ -59,5 +60,6 @@ log_config = {
 }
 
 if __name__ == "__main__":
-    uvicorn.run("app.main:app", host="0.0.0.0", port=8080, reload=True, 
+    # HOST/PORT let several farm workers run side by side on one machine
+    uvicorn.run("app.main:app", host=os.environ.get("HOST", "0.0.0.0"), port=int(os.environ.get("PORT", "8080")), reload=True,
                 access_log=True, log_config=log_config)
@@ -0,0 +1,78 @@
+"""
+Stand-in for UnrealEditor-Cmd that talks to the server like the MRQ executor does, without rendering anything.
+
+Takes the command line the runner builds (-JobId=, -MRQServerBaseUrl=, ABSLOG=), posts "starting", then "rendering"
+with rising progress for FAKE_UE_SECONDS (default 5), writes a small fragmented-MP4-shaped video next to the job's
+logs, posts "encoding" with its directory and finally render-complete, like a real job. FAKE_UE_EXIT_CODE makes it
+exit with that code before rendering, to exercise crash handling.
+
+Install it as <UE_ROOT>/Engine/Binaries/Linux/UnrealEditor-Cmd through a wrapper script, as tools/farm_test.py does.
+"""
+from __future__ import annotations
+import os
+import struct
+import sys
+import time
+from pathlib import Path
+
+import requests
+
+
+def _arg(argv: list[str], name: str) -> str | None:
+    for a in argv:
+        if a.startswith(name):
+            return a[len(name):]
+    return None
+
+
+def _box(kind: bytes, payload: bytes) -> bytes:
+    return struct.pack(">I", 8 + len(payload)) + kind + payload
+
+
+def main(argv: list[str]) -> int:
+    job_id = _arg(argv, "-JobId=")
+    base_url = (_arg(argv, "-MRQServerBaseUrl=") or "http://127.0.0.1:8080/").rstrip("/") + "/"
+    log_path = Path(_arg(argv, "ABSLOG=") or f"fake_ue_{job_id}.log")
+    seconds = float(os.environ.get("FAKE_UE_SECONDS", "5"))
+    exit_code = int(os.environ.get("FAKE_UE_EXIT_CODE", "0"))
+
+    log_path.parent.mkdir(parents=True, exist_ok=True)
+    log = open(log_path, "a", encoding="utf-8")
+    log.write(f"LogInit: fake UE for job {job_id}: {' '.join(argv)}\n")
+    log.flush()
+    if exit_code:
+        log.write("LogWindows: Error: fake crash\n")
+        return exit_code
+
+    url = f"{base_url}ue-notifications/job/{job_id}"
+    session = requests.Session()
+    session.post(f"{url}/progress", json={"status": "starting", "progress_percent": 0.0}, timeout=10)
+    steps = max(1, int(seconds * 2))
+    for step in range(1, steps + 1):
+        time.sleep(seconds / steps)
+        session.post(f"{url}/progress", json={"status": "rendering", "progress_percent": step / steps, "progress_eta_seconds": int((steps - step) * seconds / steps)}, timeout=10)
+        log.write(f"LogMovieRenderPipeline: frame {step}/{steps}\n")
+        log.flush()
+
+    # Job work dir is two levels up from the log (<DATA_ROOT>/jobs/<job_id>/logs/ue_<job_id>.log)
+    video_dir = log_path.parent.parent / "video"
+    video_dir.mkdir(parents=True, exist_ok=True)
+    video = video_dir / f"{job_id}.mp4"
+    session.post(f"{url}/progress", json={"status": "encoding", "progress_percent": 1.0, "video_directory": str(video_dir)}, timeout=10)
+    with open(video, "wb") as f:
+        f.write(_box(b"ftyp", b"isom\x00\x00\x02\x00isomiso6mp41"))
+        f.write(_box(b"moov", b"\x00" * 64))
+        for _ in range(4):
+            f.write(_box(b"moof", b"\x00" * 16))
+            f.write(_box(b"mdat", os.urandom(64 * 1024)))
+    session.post(f"{url}/render-complete", json={
+        "movie_pipeline_success": True,
+        "video_directory": str(video_dir),
+        "metrics": {"encode_fps": 100.0},
+    }, timeout=30)
+    log.write("LogExit: Exiting.\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,157 @@
+"""
+Render farm on one machine: a coordinator and N workers as separate server processes, rendering with tools/fake_ue.py.
+
+    python tools/farm_test.py --workers 3 --jobs 12 --kill-after 8
+
+Each node gets its own port and DATA_ROOT under a scratch directory; videos go to a shared UPLOAD_LOCAL_DIR, the
+storage the workers hand them back through. Jobs are submitted to the coordinator; --kill-after seconds in, the
+first worker is killed together with its UE processes, and the jobs it held have to finish on the others once their
+leases run out. Passes when every job completes with a video URL. Prints how many jobs each worker finished and
+the overall throughput, so runs with more workers can be compared.
+"""
+from __future__ import annotations
+import argparse
+import json
+import os
+import signal
+import socket
+import stat
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+import requests
+
+SERVER_DIR = Path(__file__).resolve().parent.parent
+MOCK_NODE = {"gpus_mb": [24576], "cpu_cores": 32, "ram_mb": 131072, "disk_mb": 1024000}
+
+
+def _free_port() -> int:
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def _install_fake_ue(ue_root: Path) -> None:
+    binaries = ue_root / "Engine" / "Binaries" / "Linux"
+    binaries.mkdir(parents=True, exist_ok=True)
+    wrapper = binaries / "UnrealEditor-Cmd"
+    wrapper.write_text(f'#!/bin/sh\nexec "{sys.executable}" "{SERVER_DIR / "tools" / "fake_ue.py"}" "$@"\n', encoding="utf-8")
+    wrapper.chmod(wrapper.stat().st_mode | stat.S_IXUSR | stat.S_IXGRP | stat.S_IXOTH)
+
+
+def _start_node(name: str, root: Path, port: int, env: dict[str, str]) -> subprocess.Popen:
+    data_root = root / name
+    node_env = dict(os.environ, **env, DATA_ROOT=str(data_root), LOG_ROOT=str(data_root / "logs"), MRQ_SERVER_BASE_URL=f"http://127.0.0.1:{port}/")
+    log = open(root / f"{name}.log", "w", encoding="utf-8")
+    # Own process group, so killing a worker takes its UE processes along like a node going down would
+    return subprocess.Popen(
+        [sys.executable, "-m", "uvicorn", "app.main:app", "--host", "127.0.0.1", "--port", str(port), "--log-level", "warning"],
+        cwd=SERVER_DIR, env=node_env, stdout=log, stderr=subprocess.STDOUT, start_new_session=True,
+    )
+
+
+def _wait_up(base: str, timeout: float = 30) -> None:
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            if requests.get(f"{base}/templates", timeout=2).ok:
+                return
+        except requests.RequestException:
+            pass
+        time.sleep(0.2)
+    raise RuntimeError(f"{base} did not come up")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--workers", type=int, default=3)
+    parser.add_argument("--slots", type=int, default=2, help="MAX_CONCURRENCY of each worker")
+    parser.add_argument("--jobs", type=int, default=12)
+    parser.add_argument("--render-seconds", type=float, default=5, help="how long each fake UE renders")
+    parser.add_argument("--lease-seconds", type=float, default=6)
+    parser.add_argument("--kill-after", type=float, default=None, help="kill the first worker this many seconds after submitting")
+    parser.add_argument("--timeout", type=float, default=300)
+    parser.add_argument("--root", type=Path, default=None, help="scratch directory (default: a temp directory)")
+    args = parser.parse_args()
+
+    root = args.root or Path(tempfile.mkdtemp(prefix="mrq-farm-"))
+    _install_fake_ue(root / "ue")
+    common = {
+        "UE_ROOT": str(root / "ue"),
+        "UPROJECT": str(root / "ue" / "Farm.uproject"),
+        "UPLOAD_LOCAL_DIR": str(root / "storage"),
+        "LEASE_SECONDS": str(args.lease_seconds),
+        "WORKER_HEARTBEAT_SECONDS": "1",
+        "DEVICE_BACKEND": "mock",
+        "MOCK_DEVICES": json.dumps(MOCK_NODE),
+        "RENDER_CACHE_ENABLED": "false",
+        "FAKE_UE_SECONDS": str(args.render_seconds),
+    }
+    print(f"Scratch directory {root} (node logs are there)")
+
+    nodes: list[subprocess.Popen] = []
+    try:
+        port = _free_port()
+        coordinator = f"http://127.0.0.1:{port}"
+        nodes.append(_start_node("coordinator", root, port, {**common, "NODE_ROLE": "coordinator"}))
+        _wait_up(coordinator)
+        workers = []
+        for i in range(args.workers):
+            port = _free_port()
+            name = f"worker{i + 1}"
+            workers.append(_start_node(name, root, port, {**common, "NODE_ROLE": "worker", "WORKER_NAME": name,
+                                                          "COORDINATOR_URL": coordinator + "/", "MAX_CONCURRENCY": str(args.slots)}))
+            _wait_up(f"http://127.0.0.1:{port}")
+        nodes.extend(workers)
+
+        started = time.monotonic()
+        job_ids = []
+        for _ in range(args.jobs):
+            r = requests.post(f"{coordinator}/jobs", json={"template_id": "Seq1", "params": {}}, timeout=10)
+            r.raise_for_status()
+            job_ids.append(r.json()["job_id"])
+        print(f"Submitted {len(job_ids)} jobs to {args.workers} workers with {args.slots} slots each")
+
+        killed = None
+        jobs: dict[str, dict] = {}
+        while time.monotonic() - started < args.timeout:
+            if args.kill_after is not None and killed is None and time.monotonic() - started >= args.kill_after:
+                held = next((w["jobs"] for w in requests.get(f"{coordinator}/workers", timeout=10).json()["workers"] if w["name"] == "worker1"), [])
+                os.killpg(workers[0].pid, signal.SIGKILL)
+                killed = held
+                print(f"Killed worker1 holding {len(held)} jobs")
+            jobs = {j: requests.get(f"{coordinator}/jobs/{j}", timeout=10).json() for j in job_ids}
+            if all(job["status"] in ("completed", "failed", "canceled") for job in jobs.values()):
+                break
+            time.sleep(0.5)
+        elapsed = time.monotonic() - started
+
+        statuses = [job["status"] for job in jobs.values()]
+        without_video = [j for j, job in jobs.items() if not (job.get("artifacts") or {}).get("video_url")]
+        per_worker: dict[str, int] = {}
+        names = {w["worker_id"]: w["name"] for w in requests.get(f"{coordinator}/workers", timeout=10).json()["workers"]}
+        for job in jobs.values():
+            worker_id = (job.get("metrics") or {}).get("worker_id")
+            per_worker[names.get(worker_id, str(worker_id))] = per_worker.get(names.get(worker_id, str(worker_id)), 0) + 1
+
+        print(f"{statuses.count('completed')}/{len(job_ids)} completed in {elapsed:.1f}s ({len(job_ids) / elapsed * 60:.1f} jobs/min)")
+        print(f"finished per worker: {dict(sorted(per_worker.items()))}")
+        if killed is not None:
+            print(f"jobs of the killed worker: {[jobs[j]['status'] for j in killed if j in jobs]}")
+        ok = statuses.count("completed") == len(job_ids) and not without_video
+        if without_video:
+            print(f"jobs without a video URL: {without_video}")
+        sys.exit(0 if ok else 1)
+    finally:
+        for node in nodes:
+            try:
+                os.killpg(node.pid, signal.SIGTERM)
+            except ProcessLookupError:
+                pass
+
+
+if __name__ == "__main__":
+    main()
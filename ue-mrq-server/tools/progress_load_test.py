@@ -0,0 +1,153 @@
+"""
+Load test for progress ingest: N simulated UE processes post progress while API clients list jobs.
+
+Runs the server in-process on a scratch database, so it needs no UE and leaves the real data alone:
+
+    python tools/progress_load_test.py --reporters 300 --seconds 30
+
+Every reporter posts "starting", then "rendering" once per --interval with rising progress, and "encoding" at the
+end, like the executor does. Prints throughput and latency percentiles of the progress posts and of GET /jobs, and
+checks that the database holds each job's last reported progress once the buffer is flushed.
+"""
+from __future__ import annotations
+import argparse
+import os
+import socket
+import statistics
+import sys
+import tempfile
+import threading
+import time
+import uuid
+from pathlib import Path
+
+import requests
+
+
+def _percentiles(samples: list[float]) -> str:
+    if not samples:
+        return "no samples"
+    ordered = sorted(samples)
+    pick = lambda q: ordered[min(len(ordered) - 1, int(q * len(ordered)))] * 1000
+    return (f"n={len(ordered)} mean={statistics.fmean(ordered) * 1000:.1f}ms p50={pick(0.5):.1f}ms "
+            f"p95={pick(0.95):.1f}ms p99={pick(0.99):.1f}ms max={ordered[-1] * 1000:.1f}ms")
+
+
+def _free_port() -> int:
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--reporters", type=int, default=200, help="simulated UE processes")
+    parser.add_argument("--seconds", type=float, default=20, help="how long each reporter runs")
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between one reporter's posts")
+    parser.add_argument("--readers", type=int, default=4, help="clients polling GET /jobs")
+    parser.add_argument("--data-root", type=Path, default=None, help="scratch DATA_ROOT (default: a temp directory)")
+    args = parser.parse_args()
+
+    # Configure before the app is imported; a scratch database, and placeholders for what a render would need
+    data_root = args.data_root or Path(tempfile.mkdtemp(prefix="mrq-load-"))
+    os.environ["DATA_ROOT"] = str(data_root)
+    os.environ["LOG_ROOT"] = str(data_root / "logs")
+    os.environ.setdefault("UE_ROOT", str(data_root))
+    os.environ.setdefault("UPROJECT", str(data_root / "LoadTest.uproject"))
+    sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+
+    import uvicorn
+    from app.main import app
+    from app.config import settings
+    from app.db.database import session_scope
+    from app.db.models import Job
+    from app.models.status import JobStatus
+    from app.runner.progress_ingest import progress_ingest
+
+    # Jobs already past dispatch, so the scheduler leaves them alone
+    job_ids = [str(uuid.uuid4()) for _ in range(args.reporters)]
+    with session_scope() as db:
+        for job_id in job_ids:
+            db.add(Job(job_id=job_id, template_id="load-test", status=JobStatus.starting.value, payload="{}"))
+
+    port = _free_port()
+    server = uvicorn.Server(uvicorn.Config(app, host="127.0.0.1", port=port, log_level="warning", access_log=False))
+    threading.Thread(target=server.run, daemon=True).start()
+    while not server.started:
+        time.sleep(0.05)
+    base = f"http://127.0.0.1:{port}"
+    print(f"Server on {base}, database {data_root / 'jobs.sqlite'}, WAL={settings.SQLITE_WAL}, "
+          f"synchronous={settings.SQLITE_SYNCHRONOUS}, flush every {settings.PROGRESS_FLUSH_MS}ms")
+
+    lock = threading.Lock()
+    post_latency: list[float] = []
+    list_latency: list[float] = []
+    errors = [0]
+    last_reported: dict[str, float] = {}
+    reporters_done = threading.Event()
+
+    def post(session: requests.Session, job_id: str, body: dict):
+        t0 = time.perf_counter()
+        try:
+            r = session.post(f"{base}/ue-notifications/job/{job_id}/progress", json=body, timeout=30)
+            ok = r.ok and r.json().get("status") == "success"
+        except requests.RequestException:
+            ok = False
+        with lock:
+            post_latency.append(time.perf_counter() - t0)
+            if not ok:
+                errors[0] += 1
+
+    def reporter(job_id: str, start_delay: float):
+        time.sleep(start_delay)  # spread the reporters over one interval, like processes started at different times
+        session = requests.Session()
+        post(session, job_id, {"status": "starting", "progress_percent": 0.0})
+        steps = max(1, int(args.seconds / args.interval))
+        for step in range(1, steps + 1):
+            time.sleep(args.interval)
+            percent = round(step / steps, 4)
+            post(session, job_id, {"status": "rendering", "progress_percent": percent, "progress_eta_seconds": (steps - step) * args.interval})
+        post(session, job_id, {"status": "encoding", "progress_percent": 1.25})
+        with lock:
+            last_reported[job_id] = 1.25
+
+    def reader():
+        session = requests.Session()
+        while not reporters_done.is_set():
+            t0 = time.perf_counter()
+            try:
+                ok = session.get(f"{base}/jobs", params={"limit": 50}, timeout=30).ok
+            except requests.RequestException:
+                ok = False
+            with lock:
+                list_latency.append(time.perf_counter() - t0)
+                if not ok:
+                    errors[0] += 1
+            time.sleep(0.2)
+
+    readers = [threading.Thread(target=reader, daemon=True) for _ in range(args.readers)]
+    reporters = [threading.Thread(target=reporter, args=(job_id, args.interval * i / len(job_ids)), daemon=True) for i, job_id in enumerate(job_ids)]
+    started = time.perf_counter()
+    for th in readers + reporters:
+        th.start()
+    for th in reporters:
+        th.join()
+    elapsed = time.perf_counter() - started
+    reporters_done.set()
+    for th in readers:
+        th.join()
+
+    progress_ingest.flush()
+    with session_scope() as db:
+        stale = [j.job_id for j in db.query(Job).filter(Job.job_id.in_(job_ids)) if j.progress_percent != last_reported.get(j.job_id)]
+
+    print(f"{len(post_latency)} progress posts in {elapsed:.1f}s ({len(post_latency) / elapsed:.0f}/s), {errors[0]} errors")
+    print(f"progress POST: {_percentiles(post_latency)}")
+    print(f"GET /jobs:     {_percentiles(list_latency)}")
+    print(f"jobs whose stored progress differs from their last report: {len(stale)}")
+    server.should_exit = True
+    sys.exit(1 if errors[0] or stale else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,66 @@
+"""
+Shader warm-up: compiles the shaders of every template (or the ones named) before the first job renders with them.
+
+    python tools/warm_shaders.py [--template Seq1 ...] [--gpu 0]
+
+Runs the MoviePipelineShaderWarmUp commandlet of the MoviePipelineExt plugin once per template, one after the other,
+with the server's .env: it loads the template's map and sequence, compiles the shader maps of every material they
+render with into the DDC (SHARED_DDC_PATH, when set, so every node and render finds them) and precaches the PSOs on
+this machine. Each template's manifest goes to SHADER_WARMUP_DIR/<template_id>.json, where the runner picks it up and
+passes it to UE, which reports shader_cache_hits and shader_cache_misses in the job's metrics.
+
+Run it again after changing content, the engine version or the GPU/driver: renders count materials changed since
+the warm-up, and every material of a manifest from another engine or shader platform, as misses.
+"""
+from __future__ import annotations
+import argparse
+import json
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+SERVER_DIR = Path(__file__).resolve().parent.parent
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--template", action="append", help="template_id to warm up (default: all)")
+    parser.add_argument("--gpu", type=int, default=None, help="-graphicsadapter of the commandlet, the GPU type renders use")
+    args = parser.parse_args()
+
+    sys.path.insert(0, str(SERVER_DIR))
+    from app.config import settings
+    from app.runner.ue_command import build_warmup_cmd
+    from app.templates.loader import TemplateRegistry
+
+    registry = TemplateRegistry(SERVER_DIR / "configs" / "templates.json")
+    registry.load()
+    templates = [t for t in registry.templates if not args.template or t["template_id"] in args.template]
+    unknown = set(args.template or []) - {t["template_id"] for t in templates}
+    if unknown:
+        sys.exit(f"Unknown templates: {', '.join(sorted(unknown))}")
+
+    warmup_dir = Path(settings.SHADER_WARMUP_DIR).absolute()
+    warmup_dir.mkdir(parents=True, exist_ok=True)
+    failed = []
+    for template in templates:
+        template_id = template["template_id"]
+        manifest = warmup_dir / f"{template_id}.json"
+        log = warmup_dir / f"{template_id}.log"
+        started = time.monotonic()
+        print(f"Warming up {template_id}: {template.get('map_path') or template.get('map_name')} + {template['level_sequence']}")
+        code = subprocess.call(build_warmup_cmd(template, manifest, log, args.gpu), cwd=SERVER_DIR)
+        if code != 0 or not manifest.exists():
+            failed.append(template_id)
+            print(f"  failed with code {code}, see {log}")
+            continue
+        data = json.loads(manifest.read_text(encoding="utf-8"))
+        print(f"  {len(data.get('materials') or [])} materials, {data.get('compile_jobs', 0)} shader jobs, "
+              f"{time.monotonic() - started:.0f}s on {data.get('shader_platform')}")
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()